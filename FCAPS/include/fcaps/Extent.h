@@ -9,6 +9,8 @@
 #include <common.h>
 #include <fcaps/BasicTypes.h>
 
+#include <stdint.h>
+
 ////////////////////////////////////////////////////////////////////////
 
 // A structure for encoding the image of a pattern
@@ -21,11 +23,15 @@ struct CPatternImage {
     int ImageSize;
 	// The image (the set of objects) of the pattern.
     const int* Objects;
+	// The depth of the pattern in the search tree of a depth-first enumerator, -1 if unknown.
+	//  The descendants of a pattern are the patterns following it with a greater depth.
+	int Depth;
 
 	CPatternImage() :
 		PatternId( -1 ),
 		ImageSize( 0 ),
-		Objects( 0 ) {}
+		Objects( 0 ),
+		Depth( -1 ) {}
 };
 
 ////////////////////////////////////////////////////////////////////////
@@ -42,6 +48,15 @@ interface IExtent : public virtual IObject {
 
 ////////////////////////////////////////////////////////////////////////
 
+// An extent kept as a bitset, it gives the objects without copying them.
+//  The object i is in the extent if the bit i % W of the block i / W is set, W is the number of bits in uintptr_t.
+interface IBitsetExtent : public virtual IObject {
+	// The blocks are valid while the extent exists
+	virtual void GetBitset( const uintptr_t*& blocks, DWORD& blocksCount ) const = 0;
+};
+
+////////////////////////////////////////////////////////////////////////
+
 class CPatternImageHolder {
 public:
 	CPatternImageHolder(const IExtent* _ext, CPatternImage& _ptrn) :
@@ -10,6 +10,8 @@
 #include <fcaps/BasicTypes.h>
 #include <fcaps/Extent.h>
 
+#include <vector>
+
 ////////////////////////////////////////////////////////////////////////
 
 const char OptimisticEstimatorModuleType[] = "OptimisticEstimatorModules";
@@ -33,5 +35,19 @@ interface IOptimisticEstimator : public virtual IObject {
 	virtual JSON GetJsonQuality(const IExtent* ext) const = 0;
 };
 
+////////////////////////////////////////////////////////////////////////
+
+// An optimistic estimator for a binary class. The value depends only on the weights of positive and of all objects in the extent,
+//  so the extent can be evaluated for other class labels of objects, e.g., in permutation tests.
+interface IBinaryClassificationOptimisticEstimator : public IOptimisticEstimator {
+	// The class of every object, true for the target class
+	virtual const std::vector<bool>& GetClasses() const = 0;
+	// The weight of every object
+	virtual const std::vector<double>& GetWeights() const = 0;
+	// Returns the value and the best subset estimate for an extent with the given weights of positive and of all objects.
+	//  The total weights of positive and of all objects should be the same as for the original classes.
+	virtual void GetValueByWeights( double wPlus, double wAll, COEstValue& val ) const = 0;
+};
+
 
 #endif // PATTERNENUMERATOR_H_INCLUDED
@@ -59,6 +59,19 @@ interface IPatternManager : public virtual IObject {
 	void WriteZero( const IPatternDescriptor* pattern, std::ostream& dst ) const;
 };
 
+// A pattern manager that knows if it can be used by several threads at once,
+//  i.e., if Compare, CalculateSimilarity and FreePattern can be called concurrently.
+interface IConcurrentPatternManager : public virtual IObject {
+	virtual bool IsThreadSafe() const = 0;
+};
+
+// A manager not implementing IConcurrentPatternManager is not known to be thread-safe
+inline bool IsThreadSafePatternManager( const IPatternManager& manager )
+{
+	const IConcurrentPatternManager* concurrent = dynamic_cast<const IConcurrentPatternManager*>( &manager );
+	return concurrent != 0 && concurrent->IsThreadSafe();
+}
+
 inline const IPatternDescriptor* IPatternManager::CalculateSimilarityZero(
 const IPatternDescriptor* first, const IPatternDescriptor* second )
 {
@@ -9,6 +9,8 @@
 #include <ListWrapper.h>
 #include <vector>
 
+class CJsonFileWriter;
+
 ////////////////////////////////////////////////////////////////////
 
 const char ProjectionChainModuleType[] = "ProjectionChainModules";
@@ -64,6 +66,10 @@ interface IProjectionChain : public virtual IObject {
 	// Saves extent and intent of a pattern
 	virtual JSON SaveExtent( const IPatternDescriptor* d ) const = 0;
 	virtual JSON SaveIntent( const IPatternDescriptor* d ) const = 0;
+	// Writes extent and intent of a pattern directly to the output stream,
+	//  the format is the same as for SaveExtent/SaveIntent
+	virtual void WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const = 0;
+	virtual void WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const = 0;
 };
 
 ////////////////////////////////////////////////////////////////////
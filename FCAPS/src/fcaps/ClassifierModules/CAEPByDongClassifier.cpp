@@ -13,28 +13,85 @@
 #include <StdTools.h>
 
 #include <rapidjson/document.h>
+#include <rapidjson/memorystream.h>
 #include <rapidjson/reader.h>
 
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
 using namespace std;
 using namespace boost;
 
 ////////////////////////////////////////////////////////////////////
 
+// Reads the patterns from a mapped file.
+//  The intents are taken as the original bytes of the file and the object names of the extents
+//  are received as typed SAX values, so no pattern is printed and parsed again.
 class CCAEPPatternAdder : public CSaxJsonDefaultTemplate {
 public:
 	CCAEPPatternAdder( CCAEPByDongClassifier& _cl) :
-		cl(_cl), status( S_Begin ), objectCounter(0) {}
+		cl(_cl), status( S_Begin ), objectCounter(0),
+		hasInt( false ), hasExt( false ), hasNames( false ), isBottom( false ) {}
 
 	// Methods of CSaxJsonDefaultTemplate
+	bool Null() { return wrongValue(); }
+	bool Bool(bool /*b*/) { return wrongValue(); }
+	bool Int(int /*i*/) { return wrongValue(); }
+	bool Uint(unsigned /*u*/) { return wrongValue(); }
+	bool Int64(int64_t /*i*/) { return wrongValue(); }
+	bool Uint64(int64_t /*u*/) { return wrongValue(); }
+	bool Double(double /*d*/) { return wrongValue(); }
+	bool String(const char* str, size_t length, bool /*copy*/) {
+		switch(status) {
+			case S_Int:
+				// An intent of a single string
+				hasInt = true;
+				isBottom = string( str, length ) == "BOTTOM";
+				if( !isBottom ) {
+					rapidjson::Document intent;
+					intent.SetString( str, length, intent.GetAllocator() );
+					CreateStringFromJSON( intent, intJson );
+				}
+				status = S_Node;
+				return true;
+			case S_ExtNames:
+				names.push_back( string( str, length ) );
+				return true;
+			default:
+				return wrongValue();
+		}
+	}
+
 	TPowerfulSaxJsonResults Key(const char* str, size_t length, bool copy) {
+		const string key( str, length );
 		switch(status) {
 			case S_Object:
-				if( string(str) == "Nodes" ) {
+				if( key == "Nodes" ) {
 					status=S_NodesArray;
 					return PSJR_Iterate;
 				} else {
 					return PSJR_Skip;
 				}
+			case S_Node:
+				if( key == "Int" ) {
+					status=S_Int;
+					return PSJR_Load;
+				} else if( key == "Ext" ) {
+					status=S_Ext;
+					hasExt = true;
+					return PSJR_Iterate;
+				} else {
+					return PSJR_Skip;
+				}
+			case S_ExtObject:
+				if( key == "Names" ) {
+					status=S_ExtNames;
+					hasNames = true;
+					return PSJR_Iterate;
+				} else {
+					return PSJR_Skip;
+				}
 			default:
 				return PSJR_Error;
 		}
@@ -52,12 +109,35 @@ public:
 				}
 			case S_NodesArray:
 				++objectCounter;
-				return PSJR_Load;
+				status=S_Node;
+				hasInt = false;
+				hasExt = false;
+				hasNames = false;
+				isBottom = false;
+				intJson.clear();
+				names.clear();
+				return PSJR_Iterate;
+			case S_Ext:
+				status=S_ExtObject;
+				return PSJR_Iterate;
 			default:
 				return PSJR_Error;
 		}
 
 	}
+	bool EndObject(size_t /*memberCount*/) {
+		switch(status) {
+			case S_Node:
+				addPattern();
+				status=S_NodesArray;
+				return true;
+			case S_ExtObject:
+				status=S_Node;
+				return true;
+			default:
+				return true;
+		}
+	}
 	TPowerfulSaxJsonResults StartArray() {
 		switch(status) {
 			case S_Begin:
@@ -67,64 +147,53 @@ public:
 			case S_NodesArray:
 				objectCounter=0;
 				return PSJR_Iterate;
+			case S_ExtNames:
+				return PSJR_Iterate;
+			case S_Ext:
+				wrongValue();
+				return PSJR_Error;
 			default:
 				return PSJR_Error;
 		}
 	}
 	bool EndArray(size_t /*elementCount*/) {
-		if( status == S_NodesArray ) {
-			status=S_End;
+		switch(status) {
+			case S_NodesArray:
+				status=S_End;
+				return true;
+			case S_ExtNames:
+				status=S_ExtObject;
+				return true;
+			default:
+				return true;
 		}
-		return true;
 	}
 
-	bool Load( const string& json ) {
-		static char place[]="CCAEPByDongClassifier::PatternReading";
-		rapidjson::Document patternJson;
-		CJsonError errorText;
-		if( !ReadJsonString( json, patternJson, errorText ) ) {
-			throw new CJsonException( place, errorText );
-		}
-		if( !patternJson.HasMember("Int") || !patternJson.HasMember("Ext") ) {
-			throw new CTextException( place, "Extent or Intent of pattert has not been found in pattern " + StdExt::to_string(objectCounter) );
-		}
-		if( patternJson["Int"].IsString() && string(patternJson["Int"].GetString()) == "BOTTOM" ) {
-			// Useless pattern
-			return true;
-		}
-		JSON intJson;
-		CreateStringFromJSON( patternJson["Int"], intJson );
-		if( !patternJson["Ext"].IsObject()
-			|| !patternJson["Ext"].HasMember("Names") || !patternJson["Ext"]["Names"].IsArray() )
-		{
-			throw new CTextException( place, "Wrong Extent (e.g., no 'Names' member) in pattern " + StdExt::to_string(objectCounter) );
-		}
-		const rapidjson::Value& objNames = patternJson["Ext"]["Names"];
-
-		vector<string> names;
-		for( int i = 0; i < objNames.Size(); ++i ) {
-			if( !objNames[i].IsString() ) {
-				throw new CTextException( place, "Wrong object name in the extent in pattern " + StdExt::to_string(objectCounter) );
-			}
-			names.push_back(objNames[i].GetString());
-		}
-		cl.AddPattern( names, intJson );
-
+	bool LoadRaw( const char* json, size_t length ) {
+		assert( status == S_Int );
+		hasInt = true;
+		intJson.assign( json, length );
+		status = S_Node;
 		return true;
 	}
 
 	void ProcessFile( const string& path ) {
 		static char place[]="CCAEPByDongClassifier::PatternReading";
 
-		char buffer[4096];
-
-		FILE* fp = fopen( path.c_str(), "r");
-		if( fp == 0 ) {
-			throw new CTextException( place, "File not found (" + path + ')' );
+		boost::interprocess::file_mapping mapping;
+		boost::interprocess::mapped_region region;
+		try {
+			boost::interprocess::file_mapping( path.c_str(), boost::interprocess::read_only ).swap( mapping );
+			boost::interprocess::mapped_region( mapping, boost::interprocess::read_only ).swap( region );
+		} catch( boost::interprocess::interprocess_exception& e ) {
+			throw new CTextException( place, "Cannot map the file '" + path + "': " + e.what() );
 		}
-		rapidjson::FileReadStream is( fp, buffer, sizeof(buffer) );
+		const char* data = static_cast<const char*>( region.get_address() );
+
+		rapidjson::MemoryStream is( data, region.get_size() );
 		rapidjson::Reader reader;
-		CPowerfulSaxJson<CCAEPPatternAdder> handler(*this);
+		CPowerfulSaxJson< CCAEPPatternAdder, CRawJsonPartLoader<rapidjson::MemoryStream> >
+			handler( *this, CRawJsonPartLoader<rapidjson::MemoryStream>( is, data ) );
 		reader.Parse(is, handler);
 	}
 
@@ -134,6 +203,11 @@ private:
 		S_Array,
 		S_Object,
 		S_NodesArray,
+		S_Node,
+		S_Int,
+		S_Ext,
+		S_ExtObject,
+		S_ExtNames,
 		S_End,
 
 		S_EnumCount
@@ -142,6 +216,42 @@ private:
 	CCAEPByDongClassifier& cl;
 	TStatus status;
 	int objectCounter;
+
+	// The current pattern
+	JSON intJson;
+	vector<string> names;
+	bool hasInt;
+	bool hasExt;
+	bool hasNames;
+	// The intent is BOTTOM, i.e., the pattern is useless
+	bool isBottom;
+
+	bool wrongValue() {
+		static char place[]="CCAEPByDongClassifier::PatternReading";
+		switch(status) {
+			case S_Int:
+				throw new CTextException( place, "Wrong Intent in pattern " + StdExt::to_string(objectCounter) );
+			case S_Ext:
+			case S_ExtNames:
+				throw new CTextException( place, "Wrong Extent (e.g., no 'Names' member) in pattern " + StdExt::to_string(objectCounter) );
+			default:
+				return true;
+		}
+	}
+	void addPattern() {
+		static char place[]="CCAEPByDongClassifier::PatternReading";
+		if( !hasInt || !hasExt ) {
+			throw new CTextException( place, "Extent or Intent of pattert has not been found in pattern " + StdExt::to_string(objectCounter) );
+		}
+		if( isBottom ) {
+			// Useless pattern
+			return;
+		}
+		if( !hasNames ) {
+			throw new CTextException( place, "Wrong Extent (e.g., no 'Names' member) in pattern " + StdExt::to_string(objectCounter) );
+		}
+		cl.AddPattern( names, intJson );
+	}
 };
 
 
@@ -7,6 +7,7 @@
 #include <fcaps/Swappable.h>
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 #include <ModuleJSONTools.h>
 #include <StdTools.h>
 
@@ -223,41 +224,46 @@ void CBestPatternFirstComputationProcedure::SaveResult( const std::string& baseP
 {
 	callback->ReportNextStage("Producing output");
 
-	CDestStream dst(basePath);
-	if( !bestMap.HasValues() ) {
-		// No pattern is found w.r.t. the input
-		dst << "[\n"
-			<< "{"
-				"\"NodesCount\":0,\"ArcsCount\":0,"
-				"\"Params\":" << SaveParams()
-			<< "},{ \"Nodes\":[\n"
-			"]}"
-			"]";
-	} else {
-		dst << "[\n"
-			<< "{"
-				"\"NodesCount\":1,\"ArcsCount\":0,"
-				"\"Params\":" << SaveParams()
-		    << "},{ \"Nodes\":[\n";
-
-		bool shouldAddComma = false;
+	CJsonFileWriter dst(basePath);
+	dst.StartArray();
+
+	dst.StartObject();
+		dst.Key( "NodesCount" );
+		// No pattern can be found w.r.t. the input
+		dst.Uint( bestMap.HasValues() ? 1 : 0 );
+		dst.Key( "ArcsCount" );
+		dst.Uint( 0 );
+		dst.Key( "Params" );
+		dst.RawValue( SaveParams() );
+	dst.EndObject();
+
+	dst.StartObject();
+		dst.Key( "Nodes" );
+		dst.StartArray();
 		for( auto itr = bestMap.Begin(); itr != bestMap.End();++itr ) {
-			if( shouldAddComma) {
-				dst << ",";
-			}
-			shouldAddComma = true;
 			const CBestPattern& best = itr->second;
-			dst	<< "{" "\"ExtSize\":" << lpChain->GetExtentSize( best.Pattern.get() )
-				<< ",\n\"Ext\":" << lpChain->SaveExtent( best.Pattern.get() )
-				<< ",\n\"Int\":" << lpChain->SaveIntent( best.Pattern.get() )
-				<< ",\n\"Thld\":" << thld << ", \"Value\":" << best.Quality << ", \"Interest\":" << itr->first
-				<< ",\n\"Quality\":" << oest->GetJsonQuality( dynamic_cast<const IExtent*>(best.Pattern.get()) )
-				<< "}\n" ;
+			const IPatternDescriptor* ptrn = best.Pattern.get();
+			dst.StartObject();
+			dst.Key( "ExtSize" );
+			dst.Uint( lpChain->GetExtentSize( ptrn ) );
+			dst.Key( "Ext" );
+			lpChain->WriteExtent( ptrn, dst );
+			dst.Key( "Int" );
+			lpChain->WriteIntent( ptrn, dst );
+			dst.Key( "Thld" );
+			dst.Double( thld );
+			dst.Key( "Value" );
+			dst.Double( best.Quality );
+			dst.Key( "Interest" );
+			dst.Double( itr->first );
+			dst.Key( "Quality" );
+			dst.RawValue( oest->GetJsonQuality( dynamic_cast<const IExtent*>(ptrn) ) );
+			dst.EndObject();
 		}
+		dst.EndArray();
+	dst.EndObject();
 
-		dst << "]}"
-			"]";
-	}
+	dst.EndArray();
 }
 
 void CBestPatternFirstComputationProcedure::LoadParams( const JSON& json )
@@ -3,6 +3,8 @@
 #include <fcaps/Filters/ComputeAttributeSHAPValues.h>
 
 #include <fcaps/ContextAttributes.h>
+#include <fcaps/SharedModulesLib/BinaryLattice.h>
+#include <fcaps/SharedModulesLib/LatticeStream.h>
 
 #include <ModuleJSONTools.h>
 
@@ -20,6 +22,27 @@ using namespace std;
 ////////////////////////////////////////////////////////////////////
 #define STR(...) #__VA_ARGS__
 
+////////////////////////////////////////////////////////////////////
+
+// Computes SHAP values for every node of a batch and writes the node
+class CComputeAttributeShapValues::CShapNodesProcessor : public ILatticeNodesProcessor {
+public:
+	CShapNodesProcessor( CComputeAttributeShapValues& _filter, CLatticeStreamWriter& _dst ) :
+		filter( _filter ), dst( _dst ) {}
+
+	// Methods of ILatticeNodesProcessor
+	virtual void ProcessNodes( DWORD firstNode, rapidjson::Value& nodes, rapidjson::MemoryPoolAllocator<>& alloc )
+	{
+		for( DWORD i = 0; i < nodes.Size(); ++i ) {
+			filter.processConcept( firstNode + i, nodes[i], alloc );
+			dst.WriteNode( nodes[i] );
+		}
+	}
+private:
+	CComputeAttributeShapValues& filter;
+	CLatticeStreamWriter& dst;
+};
+
 ////////////////////////////////////////////////////////////////////
 const CModuleRegistrar<CComputeAttributeShapValues> CComputeAttributeShapValues::registrar;
 
@@ -30,7 +53,9 @@ CComputeAttributeShapValues::CComputeAttributeShapValues() :
 	deltaThld(-1),
 	budgetRnd(10000),
 	budgetBF(10000),
+	batchSize(1000),
 	objectNum(0),
+	nodesCount(-1),
 	curExtSize(-1)
 {
 }
@@ -86,7 +111,9 @@ void CComputeAttributeShapValues::Process()
 {
 	results.clear();
 	if(outFile.empty()) {
-		results.push_back(latticeFile + outSuffix);
+		// The result is written in the same format as the input
+		results.push_back(latticeFile + outSuffix
+			+ ( IsBinaryLatticeFile( latticeFile ) ? BinaryLatticeExt : "" ));
 	} else {
 		results.push_back(outFile);
 	}
@@ -94,111 +121,109 @@ void CComputeAttributeShapValues::Process()
 	static const char place[] = "CComputeAttributeShapValues::Process";
 	CJsonError error(latticeFile, "");
 
-	rapidjson::Document doc;
-
-	// Loading lattice
-	{
-		CJsonFile file(latticeFile);
-		if( !file.Read(  doc, error ) ) {
-			throw new CJsonException( place, error );
-		}
-	}
-	if( !doc.IsArray() || doc.Size() < 2 || !doc[1].IsObject()
-		|| !doc[1].HasMember("Nodes") || !doc[1]["Nodes"].IsArray() )
-	{
-		error.Error = "InputLattice[1].Nodes not found. Not a valid lattice.";
+	// Loading lattice params
+	CLatticeStreamReader lattice( latticeFile );
+	rapidjson::Document params;
+	lattice.ReadParams( params );
+	if( !params.IsObject() ) {
+		error.Error = "InputLattice[0] is not an object. Not a valid lattice.";
 		throw new CJsonException( place, error );
 	}
 	if(deltaThld <= 0 ) {	
-		if( doc[0].IsObject() && doc[0].HasMember("Params") && doc[0]["Params"].IsObject()
-				&& doc[0]["Params"].HasMember("Params") && doc[0]["Params"]["Params"].HasMember("Thld")
-				&& doc[0]["Params"]["Params"]["Thld"].IsDouble() )
+		if( params.HasMember("Params") && params["Params"].IsObject()
+				&& params["Params"].HasMember("Params") && params["Params"]["Params"].HasMember("Thld")
+				&& params["Params"]["Params"]["Thld"].IsDouble() )
 		{
-			deltaThld = std::lround(doc[0]["Params"]["Params"]["Thld"].GetDouble());
+			deltaThld = std::lround(params["Params"]["Params"]["Thld"].GetDouble());
 		}
 	}
 	if(deltaThld <= 0 ) {	
 		deltaThld = 1;
 	}
+	nodesCount = -1;
+	if( params.HasMember("NodesCount") && params["NodesCount"].IsInt() ) {
+		nodesCount = params["NodesCount"].GetInt();
+	}
 
-	rapidjson::MemoryPoolAllocator<>& alloc = doc.GetAllocator();
-	rapidjson::Value& inputNodes = doc[1]["Nodes"];
+	rapidjson::MemoryPoolAllocator<>& alloc = params.GetAllocator();
 
-	assert(inputNodes.IsArray());
+	// Updating params of the lattice
+	JSON json = SaveParams();
+	rapidjson::Document thisParams;
+	if( !ReadJsonString( json, thisParams, error ) ) {
+		assert(false);
+	}
+	if( !params.HasMember("Filters") ) {
+		params.AddMember( "Filters", rapidjson::Value().SetArray(), alloc );
+	}
+	params["Filters"].PushBack(rapidjson::Value(thisParams, alloc), alloc );
+
+	// Saving new lattice, the nodes are processed by batches and the arcs are copied in the second pass
+	CLatticeStreamWriter dst( results[0] );
+	dst.WriteParams( params );
+	CShapNodesProcessor nodesProcessor( *this, dst );
+	lattice.ReadNodes( batchSize, nodesProcessor );
+	CLatticeArcsCopier arcsCopier( dst );
+	lattice.ReadArcs( arcsCopier );
+	dst.Close();
+}
 
-	for(int i = 0; i < inputNodes.Size(); ++i) {
-		rapidjson::Value& cpt = inputNodes[i];
-		curExtSize=-1;
-		curIntentInds.clear();
-		curExtent.reset();
-		curSHAPValues.clear();
+// Computes SHAP values for the concept with index i
+void CComputeAttributeShapValues::processConcept( int i, rapidjson::Value& cpt, rapidjson::MemoryPoolAllocator<>& alloc )
+{
+	curExtSize=-1;
+	curIntentInds.clear();
+	curExtent.reset();
+	curSHAPValues.clear();
 
-		if(cpt.HasMember("Ext") && cpt["Ext"].IsInt()) {
-			curExtSize = cpt["Ext"].GetInt();
-		}
-		if(cpt.HasMember("Ext") && cpt["Ext"].IsObject() 
-				&& cpt["Ext"].HasMember("Count") && cpt["Ext"]["Count"].IsInt() )
-		{
-			curExtSize = cpt["Ext"]["Count"].GetInt();
-		}
-		if(curExtSize <= 0 ) {
-			std::cout << "Concept " << i << " has no extent size information. IGNORED." << std::endl;
-			continue;
-		}
+	if(cpt.HasMember("Ext") && cpt["Ext"].IsInt()) {
+		curExtSize = cpt["Ext"].GetInt();
+	}
+	if(cpt.HasMember("Ext") && cpt["Ext"].IsObject() 
+			&& cpt["Ext"].HasMember("Count") && cpt["Ext"]["Count"].IsInt() )
+	{
+		curExtSize = cpt["Ext"]["Count"].GetInt();
+	}
+	if(curExtSize <= 0 ) {
+		std::cout << "Concept " << i << " has no extent size information. IGNORED." << std::endl;
+		return;
+	}
 
-		if(cpt.HasMember("Int") && cpt["Int"].IsObject() 
-				&& cpt["Int"].HasMember("Inds") && cpt["Int"]["Inds"].IsArray() )
-		{
-			rapidjson::Value& inds = cpt["Int"]["Inds"];
-			int a = 0;
-			for(; a < inds.Size(); ++a) {
-				rapidjson::Value& attr = inds[a];
-				if(!attr.IsInt()) {
-					std::cout << "Concept " << i << " intent has bad indices. The concept is IGNORED." << std::endl;
-					break;
-				}
-				curIntentInds.push_back(attr.GetInt());
-				if(curIntentInds.back() < 0 ) {
-					std::cout << "Concept " << i << " intent has bad indices. The concept is IGNORED." << std::endl;
-					break;
-				}
+	if(cpt.HasMember("Int") && cpt["Int"].IsObject() 
+			&& cpt["Int"].HasMember("Inds") && cpt["Int"]["Inds"].IsArray() )
+	{
+		rapidjson::Value& inds = cpt["Int"]["Inds"];
+		int a = 0;
+		for(; a < inds.Size(); ++a) {
+			rapidjson::Value& attr = inds[a];
+			if(!attr.IsInt()) {
+				std::cout << "Concept " << i << " intent has bad indices. The concept is IGNORED." << std::endl;
+				break;
 			}
-			if(a < inds.Size() ) {
-				continue;
+			curIntentInds.push_back(attr.GetInt());
+			if(curIntentInds.back() < 0 ) {
+				std::cout << "Concept " << i << " intent has bad indices. The concept is IGNORED." << std::endl;
+				break;
 			}
-
-		} else if(cpt.HasMember("Int") && cpt["Int"].IsObject()) {
-			std::cout << "Concept " << i << " has no intent indices information size information."
-				<< std::endl << "Accesing attributes by names is not supported yet." 
-				<< std::endl << "The concept is IGNORED." << std::endl;
-			continue;
-		} else {
-			std::cout << "Concept " << i << " has no intent information information. IGNORED." << std::endl;
-			continue;
 		}
-		std::cout << "\rProcessing Concept " << i << " out of " << inputNodes.Size() <<"...";
-		std::cout.flush();
-
-		computeSHAPValues();
-		addSHAPValuesToNode(curSHAPValues, cpt["Int"], alloc, shouldReorderAttributes);
-	}
+		if(a < inds.Size() ) {
+			return;
+		}
 
-	// Updating params of the lattice
-	JSON json = SaveParams();
-	rapidjson::Document thisParams;
-	if( !ReadJsonString( json, thisParams, error ) ) {
-		assert(false);
-	}
-	if( !doc[0].HasMember("Filters") ) {
-		doc[0].AddMember( "Filters", rapidjson::Value().SetArray(), alloc );
+	} else if(cpt.HasMember("Int") && cpt["Int"].IsObject()) {
+		std::cout << "Concept " << i << " has no intent indices information size information."
+			<< std::endl << "Accesing attributes by names is not supported yet." 
+			<< std::endl << "The concept is IGNORED." << std::endl;
+		return;
+	} else {
+		std::cout << "Concept " << i << " has no intent information information. IGNORED." << std::endl;
+		return;
 	}
-	doc[0]["Filters"].PushBack(thisParams, alloc );
+	std::cout << "\rProcessing Concept " << i << " out of " << nodesCount <<"...";
+	std::cout.flush();
 
-	// Saving new lattice
-	JSON outputStr;
-	CreateStringFromJSON( doc, outputStr, true );
-	CDestStream dst(results[0]);
-	dst << outputStr;
+	computeSHAPValues();
+	addSHAPValuesToNode(curSHAPValues, cpt["Int"], alloc, shouldReorderAttributes);
 }
 
 void CComputeAttributeShapValues::LoadParams( const JSON& json )
@@ -277,6 +302,9 @@ void CComputeAttributeShapValues::LoadParams( const JSON& json )
 	if( params.HasMember("ShouldReorderAttributes") && params["ShouldReorderAttributes"].IsBool() ) {
 		shouldReorderAttributes = params["ShouldReorderAttributes"].GetBool();
 	}
+	if( params.HasMember("BatchSize") && params["BatchSize"].IsUint() && params["BatchSize"].GetUint() > 0 ) {
+		batchSize = params["BatchSize"].GetUint();
+	}
 
 	results.clear();
 }
@@ -299,7 +327,8 @@ JSON CComputeAttributeShapValues::SaveParams() const
 			.AddMember( "DeltaThld", rapidjson::Value().SetInt(deltaThld), alloc )
 			.AddMember( "BudgetRnd", rapidjson::Value().SetInt(budgetRnd), alloc )
 			.AddMember( "BudgetBruteForce", rapidjson::Value().SetInt(budgetBF), alloc )
-			.AddMember( "ShouldReorderAttributes", rapidjson::Value().SetBool(shouldReorderAttributes), alloc ),
+			.AddMember( "ShouldReorderAttributes", rapidjson::Value().SetBool(shouldReorderAttributes), alloc )
+			.AddMember( "BatchSize", rapidjson::Value().SetUint(batchSize), alloc ),
 		alloc );
 	JSON result;
 	CreateStringFromJSON( params, result );
@@ -55,6 +55,8 @@ public:
 		{ return "{}"; }
 
 private:
+	class CShapNodesProcessor;
+
 	static const CModuleRegistrar<CComputeAttributeShapValues> registrar;
 	std::mt19937 rng;
 	// Resulting file, one file
@@ -77,12 +79,16 @@ private:
 	int budgetBF;
 	// Indicator for reordering attributes w.r.t. their significance
 	bool shouldReorderAttributes;
+	// The number of nodes of the lattice that are processed at once
+	DWORD batchSize;
 
 	// For comparison of extents
 	CVectorBinarySetJoinComparator cmp;
 	CPatternDeleter dlt;
 	std::deque< CSharedPtr<const CVectorBinarySetDescriptor> > context;
 	int objectNum;
+	// The number of nodes in the lattice (if known), for progress reporting
+	int nodesCount;
 
 	// Data for current concept
 	// The size of the current extent
@@ -99,6 +105,7 @@ private:
 	// The attributes that are involved in the curExtentComputation
 	std::set<int> ignoredAttrs;
 
+	void processConcept( int i, rapidjson::Value& cpt, rapidjson::MemoryPoolAllocator<>& alloc );
 	void computeSHAPValues();
 	double computeExactShap(int attr, int size);
 	int computeExactShapGenIntent(int attrIntentIndex, int prevAttrIndex, int size);
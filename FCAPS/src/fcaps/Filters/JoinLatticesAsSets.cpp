@@ -4,6 +4,7 @@
 
 #include <fcaps/SharedModulesLib/VectorBinarySetDescriptor.h>
 #include <fcaps/SharedModulesLib/FindConceptOrder.h>
+#include <fcaps/SharedModulesLib/LatticeStream.h>
 
 #include <JSONTools.h>
 #include <StdTools.h>
@@ -48,80 +49,138 @@ private:
 };
 
 ////////////////////////////////////////////////////////////////////
-const CModuleRegistrar<CJoinLatticesAsSets> CJoinLatticesAsSets::registrar;
 
-CJoinLatticesAsSets::CJoinLatticesAsSets() :
-	dlt(cmp),
-	shouldFindPartialOrder(true)
+// Returns the indices of the extent of a node
+static const rapidjson::Value& getExtentInds( const rapidjson::Value& node )
 {
+	if( !node.IsObject() || !node.HasMember("Ext") || !node["Ext"].IsObject()
+		|| !node["Ext"].HasMember("Inds") || !node["Ext"]["Inds"].IsArray() )
+	{
+		throw new CTextException( "CJoinLatticesAsSets::Process", "Extent indices are not found in the concept" );
+	}
+	return node["Ext"]["Inds"];
 }
 
-void CJoinLatticesAsSets::Process()
-{
-	static const char place[] = "CJoinLatticesAsSets::Process";
-	CJsonError error(inputFile,"");
-
-	rapidjson::Document doc;
+// Finds the number of objects, i.e., the maximal object index plus one
+class CObjectsCounter : public ILatticeNodesProcessor {
+public:
+	CObjectsCounter( DWORD& _objectNum ) :
+		objectNum( _objectNum ) {}
 
-	// Loading data
+	// Methods of ILatticeNodesProcessor
+	virtual void ProcessNodes( DWORD /*firstNode*/, rapidjson::Value& nodes, rapidjson::MemoryPoolAllocator<>& /*alloc*/ )
 	{
-		CJsonFile file(inputFile);
-		if( !file.Read(  doc, error ) ) {
-			throw new CJsonException( place, error );
+		for( DWORD i = 0; i < nodes.Size(); ++i ) {
+			const rapidjson::Value& ext = getExtentInds( nodes[i] );
+			assert(ext.Size() > 0);
+			objectNum = max<DWORD>(objectNum, ext[ext.Size() - 1].GetUint() + 1);
 		}
 	}
-	if( !doc.IsArray() || doc.Size() < 2 || !doc[1].IsObject()
-		|| !doc[1].HasMember("Nodes") || !doc[1]["Nodes"].IsArray() )
-	{
-		error.Error = "InputLattice[1].Nodes not found. Not a valid context";
-		throw new CJsonException( place, error );
-	}
-	rapidjson::Value& inputNodes = doc[1]["Nodes"];
+private:
+	DWORD& objectNum;
+};
 
-	rapidjson::Document otherDoc;
+// Loads the extents of the nodes
+class CExtentsLoader : public ILatticeNodesProcessor {
+public:
+	CExtentsLoader( CVectorBinarySetJoinComparator& _cmp, const CPatternDeleter& _dlt,
+			std::deque< CSharedPtr<const CVectorBinarySetDescriptor> >& _concepts ) :
+		cmp( _cmp ), dlt( _dlt ), concepts( _concepts ) {}
 
+	// Methods of ILatticeNodesProcessor
+	virtual void ProcessNodes( DWORD /*firstNode*/, rapidjson::Value& nodes, rapidjson::MemoryPoolAllocator<>& /*alloc*/ )
 	{
-		// Loading lattice
-		CJsonFile file( otherFile );
-		if( !file.Read( otherDoc, error ) ) {
-			throw new CJsonException( place, error );
+		for( DWORD i = 0; i < nodes.Size(); ++i ) {
+			getExtentInds( nodes[i] );
+			JSON extent;
+			CreateStringFromJSON( nodes[i]["Ext"], extent );
+			concepts.push_back( CSharedPtr<const CVectorBinarySetDescriptor>( cmp.LoadPattern( extent ), dlt ) );
 		}
 	}
-	if( !otherDoc.IsArray() || otherDoc.Size() < 2 
-		|| !otherDoc[1].IsObject() || !otherDoc[1].HasMember("Nodes") || !otherDoc[1]["Nodes"].IsArray()
-	  )
+private:
+	CVectorBinarySetJoinComparator& cmp;
+	const CPatternDeleter& dlt;
+	std::deque< CSharedPtr<const CVectorBinarySetDescriptor> >& concepts;
+};
+
+// Writes the nodes that are not removed, the nodes of a lattice start from firstConcept
+class CUniqueNodesWriter : public ILatticeNodesProcessor {
+public:
+	CUniqueNodesWriter( const std::vector<bool>& _conceptsToRemove, DWORD _firstConcept, CLatticeStreamWriter& _dst ) :
+		conceptsToRemove( _conceptsToRemove ), firstConcept( _firstConcept ), dst( _dst ) {}
+
+	// Methods of ILatticeNodesProcessor
+	virtual void ProcessNodes( DWORD firstNode, rapidjson::Value& nodes, rapidjson::MemoryPoolAllocator<>& /*alloc*/ )
 	{
-		error.Error = "OtherLattice[1].Nodes not found. Not a valid lattice";
-		throw new CJsonException( place, error );
+		assert( firstConcept + firstNode + nodes.Size() <= conceptsToRemove.size() );
+		for( DWORD i = 0; i < nodes.Size(); ++i ) {
+			if( !conceptsToRemove[firstConcept + firstNode + i] ) {
+				dst.WriteNode( nodes[i] );
+			}
+		}
 	}
-	rapidjson::MemoryPoolAllocator<>& alloc = doc.GetAllocator();
-	rapidjson::Value& otherNodes = otherDoc[1]["Nodes"];
-	for( int i = 0; i < otherNodes.Size(); ++i ) {
-		inputNodes.PushBack(otherNodes[i].Move(),alloc);
+private:
+	const std::vector<bool>& conceptsToRemove;
+	const DWORD firstConcept;
+	CLatticeStreamWriter& dst;
+};
+
+// Sets a member of an object whether it exists or not
+static void setMember( rapidjson::Value& obj, const char* name, rapidjson::Value& value, rapidjson::MemoryPoolAllocator<>& alloc )
+{
+	if( obj.HasMember( name ) ) {
+		obj[name] = value;
+	} else {
+		obj.AddMember( rapidjson::StringRef( name ), value, alloc );
 	}
+}
 
-	// Loading concepts
-	std::deque< CSharedPtr<const CVectorBinarySetDescriptor> > concepts;	
-	std::deque<DWORD> conceptInds;
-	concepts.resize( inputNodes.Size() );
-	conceptInds.resize(concepts.size(), -1);
-	std::vector<bool> conceptsToRemove;
-	conceptsToRemove.resize(concepts.size(), false);
+////////////////////////////////////////////////////////////////////
+const CModuleRegistrar<CJoinLatticesAsSets> CJoinLatticesAsSets::registrar;
 
-	DWORD objectNum = 0;
-	for( int i = 0; i < inputNodes.Size(); ++i ) {
-		const rapidjson::Value& ext = inputNodes[i]["Ext"]["Inds"];
-		assert(ext.Size() > 0);
-		objectNum = max<DWORD>(objectNum, ext[ext.Size() - 1].GetUint() + 1);
+CJoinLatticesAsSets::CJoinLatticesAsSets() :
+	dlt(cmp),
+	shouldFindPartialOrder(true),
+	batchSize(1000)
+{
+}
+
+void CJoinLatticesAsSets::Process()
+{
+	static const char place[] = "CJoinLatticesAsSets::Process";
+	CJsonError error(inputFile,"");
+
+	// Loading params
+	CLatticeStreamReader input( inputFile );
+	rapidjson::Document params;
+	input.ReadParams( params );
+	if( !params.IsObject() ) {
+		error.Error = "InputLattice[0] is not an object. Not a valid lattice";
+		throw new CJsonException( place, error );
 	}
+	rapidjson::MemoryPoolAllocator<>& alloc = params.GetAllocator();
+	CLatticeStreamReader other( otherFile );
+
+	// Loading concepts, the nodes of the other lattice follow the nodes of the input lattice
+	DWORD objectNum = 0;
+	CObjectsCounter objectsCounter( objectNum );
+	input.ReadNodes( batchSize, objectsCounter );
+	other.ReadNodes( batchSize, objectsCounter );
 	cmp.SetMaxAttrNumber(objectNum);
 
-	for( int i = 0; i < inputNodes.Size(); ++i ) {
-		JSON extent;
-		CreateStringFromJSON( inputNodes[i]["Ext"], extent );
-		concepts[i]= CSharedPtr<const CVectorBinarySetDescriptor>( cmp.LoadPattern( extent ), dlt);
+	std::deque< CSharedPtr<const CVectorBinarySetDescriptor> > concepts;
+	CExtentsLoader extentsLoader( cmp, dlt, concepts );
+	input.ReadNodes( batchSize, extentsLoader );
+	const DWORD inputNodesCount = concepts.size();
+	other.ReadNodes( batchSize, extentsLoader );
+
+	std::deque<DWORD> conceptInds;
+	conceptInds.resize(concepts.size(), -1);
+	for( int i = 0; i < conceptInds.size(); ++i ) {
 		conceptInds[i] = i;
 	}
+	std::vector<bool> conceptsToRemove;
+	conceptsToRemove.resize(concepts.size(), false);
 
 	// Finding duplicates
 	CConceptsForOrder conceptsForDupplicateRemoval( cmp, concepts  );
@@ -135,84 +194,71 @@ void CJoinLatticesAsSets::Process()
 		}
 	}
 
-	rapidjson::Value newNodes;
-	newNodes.SetArray();
 	std::deque<CSharedPtr<const CVectorBinarySetDescriptor> > newConcepts;
 	for( int i = 0; i < conceptsToRemove.size(); ++i ) {
 		if(conceptsToRemove[i]) {
 			continue;
 		}
-		newNodes.PushBack(inputNodes[i].Move(), doc.GetAllocator());
 		newConcepts.push_back(concepts[i]);
 	}
-
-	doc[1]["Nodes"] = newNodes;
-	doc[0]["NodesCount"] = rapidjson::Value().SetUint(doc[1]["Nodes"].Size());
+	concepts.clear();
+	setMember( params, "NodesCount", rapidjson::Value().SetUint(newConcepts.size()), alloc );
 
 	// Updating arcs
+	CConceptsForOrder conceptsForOrder( cmp, newConcepts  );
+	CFindConceptOrder<CConceptsForOrder> order( conceptsForOrder );
 	if( !shouldFindPartialOrder ) {
-		doc[2]=rapidjson::Value().Move();
-		doc[0]["ArcsCount"] = rapidjson::Value().SetInt(0);
+		setMember( params, "ArcsCount", rapidjson::Value().SetInt(0), alloc );
 	} else {
-		CConceptsForOrder conceptsForOrder( cmp, newConcepts  );
-		CFindConceptOrder<CConceptsForOrder> order( conceptsForOrder );
 		order.Compute();
+		setMember( params, "ArcsCount", rapidjson::Value().SetUint(order.GetArcsCount()), alloc );
+		assert(order.GetTops().Size() > 0 );
+		assert(order.GetBottoms().Size() > 0 );
 
-		CList<DWORD> tops;
-		vector<bool> bottoms;
-		bottoms.resize( newConcepts.size(), true );
-		doc[2]["Arcs"].SetArray();
-		for( DWORD i = 0; i < newConcepts.size(); ++i ) {
-			const CList<DWORD>& parents = order.GetParents( i );
-			if( parents.Size() == 0 ) {
-				tops.PushBack( i );
-			}
-			CStdIterator<CList<DWORD>::CConstIterator,false> p( parents );
-			for( ; !p.IsEnd(); ++p ) {
-				bottoms[*p] = false;
-				doc[2]["Arcs"].PushBack( 
-					rapidjson::Value().SetObject()
-						.AddMember("S", rapidjson::Value().SetUint(*p), alloc)
-						.AddMember("D", rapidjson::Value().SetUint(i), alloc)
-					,alloc);	
-			}
-		}
-
-		doc[0]["ArcsCount"].SetInt(doc[2]["Arcs"].Size());
-		assert(tops.Size() > 0 );
-
-		doc[0]["Top"].SetArray();
-		CStdIterator<CList<DWORD>::CConstIterator, false> top(tops);
+		rapidjson::Value tops;
+		tops.SetArray();
+		CStdIterator<CList<DWORD>::CConstIterator, false> top(order.GetTops());
 		for( ;!top.IsEnd(); ++top ) {
-			doc[0]["Top"].PushBack(rapidjson::Value().SetUint(*top), alloc);
+			tops.PushBack(rapidjson::Value().SetUint(*top), alloc);
 		}
+		setMember( params, "Top", tops, alloc );
 
-		doc[0]["Bottom"].SetArray();
-		for( DWORD i = 0; i < bottoms.size(); ++i ) {
-			if(!bottoms[i]) {
-				continue;
-			}
-			doc[0]["Bottom"].PushBack(rapidjson::Value().SetUint(i), alloc);
+		rapidjson::Value bottoms;
+		bottoms.SetArray();
+		CStdIterator<CList<DWORD>::CConstIterator, false> bottom(order.GetBottoms());
+		for( ;!bottom.IsEnd(); ++bottom ) {
+			bottoms.PushBack(rapidjson::Value().SetUint(*bottom), alloc);
 		}
-		assert(doc[0]["Bottom"].Size() > 0);
+		setMember( params, "Bottom", bottoms, alloc );
  	}
 
-
 	// Updating params of the lattice
 	JSON json = SaveParams();
 	rapidjson::Document thisParams;
 	if( !ReadJsonString( json, thisParams, error ) ) {
 		assert(false);
 	}
-	if( !doc[0].HasMember("Filters") ) {
-		doc[0].AddMember( "Filters", rapidjson::Value().SetArray(), alloc );
+	if( !params.HasMember("Filters") ) {
+		params.AddMember( "Filters", rapidjson::Value().SetArray(), alloc );
 	}
-	doc[0]["Filters"].PushBack(thisParams, alloc );
-
-	JSON outputStr;
-	CreateStringFromJSON( doc, outputStr );
-	CDestStream dst(results[0]);
-	dst << outputStr;
+	params["Filters"].PushBack(rapidjson::Value(thisParams, alloc), alloc );
+
+	// Writing the unique nodes, both lattices are read once more
+	CLatticeStreamWriter dst( results[0] );
+	dst.WriteParams( params );
+	CUniqueNodesWriter inputWriter( conceptsToRemove, 0, dst );
+	input.ReadNodes( batchSize, inputWriter );
+	CUniqueNodesWriter otherWriter( conceptsToRemove, inputNodesCount, dst );
+	other.ReadNodes( batchSize, otherWriter );
+	if( shouldFindPartialOrder ) {
+		for( DWORD i = 0; i < newConcepts.size(); ++i ) {
+			CStdIterator<CList<DWORD>::CConstIterator,false> p( order.GetParents( i ) );
+			for( ; !p.IsEnd(); ++p ) {
+				dst.WriteArc( *p, i );
+			}
+		}
+	}
+	dst.Close();
 }
 
 void CJoinLatticesAsSets::LoadParams( const JSON& json )
@@ -243,6 +289,10 @@ void CJoinLatticesAsSets::LoadParams( const JSON& json )
 		shouldFindPartialOrder = params["FindPartialOrder"].GetBool();
 	}
 
+	if( params.HasMember("BatchSize") && params["BatchSize"].IsUint() && params["BatchSize"].GetUint() > 0 ) {
+		batchSize = params["BatchSize"].GetUint();
+	}
+
 	results.clear();
 	if( params.HasMember("OutFile") && params["OutFile"].IsString() ) {
 		results.push_back(params["OutFile"].GetString());
@@ -263,6 +313,7 @@ JSON CJoinLatticesAsSets::SaveParams() const
 			.AddMember( "Lattice", rapidjson::Value().SetString(
 				rapidjson::StringRef(results[0].c_str())), alloc )
 			.AddMember( "FindPartialOrder", rapidjson::Value().SetBool(shouldFindPartialOrder), alloc)
+			.AddMember( "BatchSize", rapidjson::Value().SetUint(batchSize), alloc)
 			.AddMember( "Out", rapidjson::Value().SetString(
 				rapidjson::StringRef(results[0].c_str())), alloc ),
 		alloc );
@@ -61,6 +61,8 @@ private:
 	std::string otherFile;
 	// Should the partial order be found
 	bool shouldFindPartialOrder;
+	// The number of nodes of the lattices that are processed at once
+	DWORD batchSize;
 
 	// For comparison of extents
 	CVectorBinarySetJoinComparator cmp;
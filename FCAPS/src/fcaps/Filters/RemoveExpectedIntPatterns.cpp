@@ -2,9 +2,11 @@
 
 #include <fcaps/Filters/RemoveExpectedIntPatterns.h>
 
+#include <fcaps/SharedModulesLib/BinaryLattice.h>
 #include <fcaps/SharedModulesLib/FindConceptOrder.h>
+#include <fcaps/SharedModulesLib/LatticeStream.h>
 
-#include <fcaps/SharedModulesLib/details/JsonIntervalPattern.h>
+#include <fcaps/SharedModulesLib/details/JsonIntervalPattern.h>
 #include <ModuleTools.h>
 #include <JSONTools.h>
 #include <StdTools.h>
@@ -49,6 +51,89 @@ private:
 	const vector<DWORD>& extSize;
 };
 
+////////////////////////////////////////////////////////////////////
+
+// Loads parents of every node
+class CParentsLoader : public ILatticeArcsProcessor {
+public:
+	CParentsLoader( boost::container::multimap<DWORD,DWORD>& _parents ) :
+		parents( _parents ) {}
+
+	// Methods of ILatticeArcsProcessor
+	virtual void ProcessArc( DWORD s, DWORD d )
+		{ parents.insert( pair<DWORD,DWORD>( d, s ) ); }
+private:
+	boost::container::multimap<DWORD,DWORD>& parents;
+};
+
+// Loads intents and supports of the nodes
+class CConceptsLoader : public ILatticeNodesProcessor {
+public:
+	CConceptsLoader( IPatternManager& _cmp, const CPatternDeleter& _deleter,
+			std::deque< CSharedPtr<const IPatternDescriptor> >& _concepts, std::vector<DWORD>& _supports ) :
+		cmp( _cmp ), deleter( _deleter ), concepts( _concepts ), supports( _supports ) {}
+
+	// Methods of ILatticeNodesProcessor
+	virtual void ProcessNodes( DWORD firstNode, rapidjson::Value& nodes, rapidjson::MemoryPoolAllocator<>& /*alloc*/ )
+	{
+		static const char place[] = "CRemoveExpectedIntPatterns::Process";
+		assert( firstNode == concepts.size() );
+		for( DWORD i = 0; i < nodes.Size(); ++i ) {
+			const rapidjson::Value& node = nodes[i];
+			if(!node.HasMember("Ext")
+			   || (!node["Ext"].IsObject() || !node["Ext"].HasMember("Count") || !node["Ext"]["Count"].IsUint())
+				&& !node["Ext"].IsUint())
+			{
+				throw new CTextException(place, "Extent is not found in the concept");
+			}
+			supports.push_back( node["Ext"].IsUint() ? node["Ext"].GetUint() : node["Ext"]["Count"].GetUint() );
+
+			JSON intent;
+			CreateStringFromJSON( node["Int"], intent );
+			concepts.push_back( CSharedPtr<const IPatternDescriptor>( cmp.LoadPattern( intent ), deleter ) );
+		}
+	}
+private:
+	IPatternManager& cmp;
+	const CPatternDeleter& deleter;
+	std::deque< CSharedPtr<const IPatternDescriptor> >& concepts;
+	std::vector<DWORD>& supports;
+};
+
+// Writes the significant nodes together with their p-values
+class CSignificantNodesWriter : public ILatticeNodesProcessor {
+public:
+	CSignificantNodesWriter( const std::vector<double>& _pvals, double _significance, CLatticeStreamWriter& _dst ) :
+		pvals( _pvals ), significance( _significance ), dst( _dst ) {}
+
+	// Methods of ILatticeNodesProcessor
+	virtual void ProcessNodes( DWORD firstNode, rapidjson::Value& nodes, rapidjson::MemoryPoolAllocator<>& alloc )
+	{
+		assert( firstNode + nodes.Size() <= pvals.size() );
+		for( DWORD i = 0; i < nodes.Size(); ++i ) {
+			const double pval = pvals[firstNode + i];
+			if( pval < significance ) {
+				nodes[i].AddMember("P-Val",rapidjson::Value().SetDouble(pval),alloc);
+				dst.WriteNode( nodes[i] );
+			}
+		}
+	}
+private:
+	const std::vector<double>& pvals;
+	const double significance;
+	CLatticeStreamWriter& dst;
+};
+
+// Sets a member of an object whether it exists or not
+static void setMember( rapidjson::Value& obj, const char* name, rapidjson::Value& value, rapidjson::MemoryPoolAllocator<>& alloc )
+{
+	if( obj.HasMember( name ) ) {
+		obj[name] = value;
+	} else {
+		obj.AddMember( rapidjson::StringRef( name ), value, alloc );
+	}
+}
+
 ////////////////////////////////////////////////////////////////////
 const CModuleRegistrar<CRemoveExpectedIntPatterns> CRemoveExpectedIntPatterns::registrar(
 	LatticeFilterModuleType, RemoveExpectedIntPatterns );
@@ -59,7 +144,8 @@ CRemoveExpectedIntPatterns::CRemoveExpectedIntPatterns() :
 	deleter(cmp),
 	significance(-1),
 	outSuffix(".FILTERED"),
-	findPartialOrder(false)
+	findPartialOrder(false),
+	batchSize(1000)
 {
 	assert(cmp != 0);
 }
@@ -73,7 +159,8 @@ void CRemoveExpectedIntPatterns::SetInputFile( const char* path )
 	if( ext != string::npos ) {
 		resultFile = resultFile.substr(0,ext);
 	}
-	resultFile += outSuffix + ".json";
+	// The result is written in the same format as the input
+	resultFile += outSuffix + ( IsBinaryLatticeFile( inputFile ) ? BinaryLatticeExt : ".json" );
 	results.push_back( resultFile );
 }
 
@@ -112,37 +199,30 @@ void CRemoveExpectedIntPatterns::Process()
 		context[objectNum] = p;
 	}
 
-	// Loading lattice
-	CJsonFile inputFileObj( inputFile );
-	if( !inputFileObj.Read(  doc, error ) ) {
-		throw new CJsonException( place, error );
-	}
-	if( !doc.IsArray() || doc.Size() < 3 
-		|| !doc[1].IsObject() || !doc[1].HasMember("Nodes") || !doc[1]["Nodes"].IsArray()
-		|| !doc[2].IsObject() || !doc[2].HasMember("Arcs") || !doc[2]["Arcs"].IsArray()
-	  )
-	{
-		error.Error = "DATA[1].Nodes or DATA[2].Arcs not found. Not a valid lattice";
+	// Releasing the memory of the context
+	rapidjson::Document().Swap( doc );
+
+	// Loading lattice params
+	CLatticeStreamReader lattice( inputFile );
+	rapidjson::Document params;
+	lattice.ReadParams( params );
+	if( !params.IsObject() ) {
+		error.Data = inputFile;
+		error.Error = "DATA[0] is not an object. Not a valid lattice";
 		throw new CJsonException( place, error );
 	}
-	rapidjson::MemoryPoolAllocator<>& alloc = doc.GetAllocator();
-	boost::container::multimap<DWORD,DWORD> parents;
+	rapidjson::MemoryPoolAllocator<>& alloc = params.GetAllocator();
+
 	// Reading lattice structure
-	const rapidjson::Value& arcs=doc[2]["Arcs"];
-	for( int i = 0; i < arcs.Size(); ++i ) {
-		const DWORD from = arcs[i]["D"].GetUint();
-		const DWORD to = arcs[i]["S"].GetUint();
-		parents.insert(pair<DWORD,DWORD>( from, to ));
-	}
-	
+	boost::container::multimap<DWORD,DWORD> parents;
+	CParentsLoader parentsLoader( parents );
+	lattice.ReadArcs( parentsLoader );
+
 	// Loading concepts
-	rapidjson::Value& nodes=doc[1]["Nodes"];
-	concepts.resize( nodes.Size() );
-	for( int i = 0; i < nodes.Size(); ++i ) {
-		JSON intent;
-		CreateStringFromJSON( nodes[i]["Int"], intent );
-		concepts[i]= CSharedPtr<const IPatternDescriptor>( cmp->LoadPattern( intent ), deleter );
-	}
+	vector<DWORD> supports;
+	concepts.clear();
+	CConceptsLoader conceptsLoader( *cmp, deleter, concepts, supports );
+	lattice.ReadNodes( batchSize, conceptsLoader );
 
 	// To stare p-values
 	pvals.resize(concepts.size());
@@ -150,7 +230,7 @@ void CRemoveExpectedIntPatterns::Process()
 	// Computing P-value for every found concept
 	for( int i = 0; i < concepts.size(); ++i ) {
 		std::cout << "Concept " << i << " \r";
-		const DWORD support = nodes[i]["Ext"].GetUint();
+		const DWORD support = supports[i];
 		double pvalue = 1;
 		JsonIntervalPattern::CPattern current;
 		JsonIntervalPattern::LoadPattern(cmp->SavePattern( concepts[i].get() ), current);
@@ -161,7 +241,7 @@ void CRemoveExpectedIntPatterns::Process()
 			const DWORD parentIndex = (*prnt).second;
 			assert(parentIndex < concepts.size());
 
-			const DWORD supportParent = nodes[parentIndex]["Ext"].GetUint();
+			const DWORD supportParent = supports[parentIndex];
 			assert(supportParent > support);
 
 			// Need to find the attributes that has changed between them.
@@ -243,71 +323,45 @@ void CRemoveExpectedIntPatterns::Process()
 		pvals[i]= 1 - pvalue;
 	}	
 
-	//// Removing insignificant nodes from initial lattice
-	std::deque< CSharedPtr<const IPatternDescriptor> > fltrConcepts;	
-	rapidjson::Value newNodeArray;
-	newNodeArray.SetArray();
+	// Removing insignificant nodes from initial lattice
+	std::deque< CSharedPtr<const IPatternDescriptor> > fltrConcepts;
 	vector<DWORD> extSize;
 	for( int i = 0; i < pvals.size(); ++i ) {
 		if( pvals[i] < significance ) {
-			const DWORD support = nodes[i]["Ext"].GetUint();
-			nodes[i].AddMember("P-Val",rapidjson::Value().SetDouble(pvals[i]),alloc);
-			newNodeArray.PushBack(nodes[i].Move(), alloc);
 			fltrConcepts.push_back(concepts[i]);
-			extSize.push_back(support);
-		}	
+			extSize.push_back(supports[i]);
+		}
 	}
-	doc[1]["Nodes"] = newNodeArray;
-	doc[0]["NodesCount"] = rapidjson::Value().SetUint(doc[1]["Nodes"].Size());
+	concepts.clear();
+	setMember( params, "NodesCount", rapidjson::Value().SetUint(fltrConcepts.size()), alloc );
 
 	// Updating arcs
+	CConceptsForOrder conceptsForOrder( *cmp, fltrConcepts, extSize );
+	CFindConceptOrder<CConceptsForOrder> order( conceptsForOrder );
 	if( !findPartialOrder ) {
-		doc[2]=rapidjson::Value().Move();
-		doc[0]["ArcsCount"] = rapidjson::Value().SetInt(0);
+		setMember( params, "ArcsCount", rapidjson::Value().SetInt(0), alloc );
 	} else {
-		CConceptsForOrder conceptsForOrder( *cmp, fltrConcepts, extSize );
-		CFindConceptOrder<CConceptsForOrder> order( conceptsForOrder );
 		order.Compute();
+		setMember( params, "ArcsCount", rapidjson::Value().SetUint(order.GetArcsCount()), alloc );
+		assert(order.GetTops().Size() > 0 );
+		assert(order.GetBottoms().Size() > 0 );
 
-		CList<DWORD> tops;
-		vector<bool> bottoms;
-		bottoms.resize( fltrConcepts.size(), true );
-		doc[2]["Arcs"].SetArray();
-		for( DWORD i = 0; i < fltrConcepts.size(); ++i ) {
-			const CList<DWORD>& parents = order.GetParents( i );
-			if( parents.Size() == 0 ) {
-				tops.PushBack( i );
-			}
-			CStdIterator<CList<DWORD>::CConstIterator,false> p( parents );
-			for( ; !p.IsEnd(); ++p ) {
-				bottoms[*p] = false;
-				doc[2]["Arcs"].PushBack( 
-					rapidjson::Value().SetObject()
-						.AddMember("S", rapidjson::Value().SetUint(*p), alloc)
-						.AddMember("D", rapidjson::Value().SetUint(i), alloc)
-					,alloc);	
-			}
-		}
-
-		doc[0]["ArcsCount"].SetInt(doc[2]["Arcs"].Size());
-		assert(tops.Size() > 0 );
-
-		doc[0]["Top"].SetArray();
-		CStdIterator<CList<DWORD>::CConstIterator, false> top(tops);
+		rapidjson::Value tops;
+		tops.SetArray();
+		CStdIterator<CList<DWORD>::CConstIterator, false> top(order.GetTops());
 		for( ;!top.IsEnd(); ++top ) {
-			doc[0]["Top"].PushBack(rapidjson::Value().SetUint(*top), alloc);
+			tops.PushBack(rapidjson::Value().SetUint(*top), alloc);
 		}
+		setMember( params, "Top", tops, alloc );
 
-		doc[0]["Bottom"].SetArray();
-		for( DWORD i = 0; i < bottoms.size(); ++i ) {
-			if(!bottoms[i]) {
-				continue;
-			}
-			doc[0]["Bottom"].PushBack(rapidjson::Value().SetUint(i), alloc);
+		rapidjson::Value bottoms;
+		bottoms.SetArray();
+		CStdIterator<CList<DWORD>::CConstIterator, false> bottom(order.GetBottoms());
+		for( ;!bottom.IsEnd(); ++bottom ) {
+			bottoms.PushBack(rapidjson::Value().SetUint(*bottom), alloc);
 		}
-		assert(doc[0]["Bottom"].Size() > 0);
-	 }
-
+		setMember( params, "Bottom", bottoms, alloc );
+	}
 
 	// Updating params of the lattice
 	JSON json = SaveParams();
@@ -315,15 +369,25 @@ void CRemoveExpectedIntPatterns::Process()
 	if( !ReadJsonString( json, thisParams, error ) ) {
 		assert(false);
 	}
-	if( !doc[0].HasMember("Filters") ) {
-		doc[0].AddMember( "Filters", rapidjson::Value().SetArray(), alloc );
+	if( !params.HasMember("Filters") ) {
+		params.AddMember( "Filters", rapidjson::Value().SetArray(), alloc );
 	}
-	doc[0]["Filters"].PushBack(thisParams, alloc );
-
-	JSON outputStr;
-	CreateStringFromJSON( doc, outputStr );
-	CDestStream dst(results[0]);
-	dst << outputStr;
+	params["Filters"].PushBack(rapidjson::Value(thisParams, alloc), alloc );
+
+	// Writing the significant nodes, the input lattice is read once more
+	CLatticeStreamWriter dst( results[0] );
+	dst.WriteParams( params );
+	CSignificantNodesWriter nodesWriter( pvals, significance, dst );
+	lattice.ReadNodes( batchSize, nodesWriter );
+	if( findPartialOrder ) {
+		for( DWORD i = 0; i < fltrConcepts.size(); ++i ) {
+			CStdIterator<CList<DWORD>::CConstIterator,false> p( order.GetParents( i ) );
+			for( ; !p.IsEnd(); ++p ) {
+				dst.WriteArc( *p, i );
+			}
+		}
+	}
+	dst.Close();
 }
 
 void CRemoveExpectedIntPatterns::LoadParams( const JSON& json )
@@ -358,6 +422,10 @@ void CRemoveExpectedIntPatterns::LoadParams( const JSON& json )
 	if( params.HasMember("OutSuffix") && params["OutSuffix"].IsString() ) {
 		outSuffix = params["OutSuffix"].GetString();
 	}
+
+	if( params.HasMember("BatchSize") && params["BatchSize"].IsUint() && params["BatchSize"].GetUint() > 0 ) {
+		batchSize = params["BatchSize"].GetUint();
+	}
 }
 
 JSON CRemoveExpectedIntPatterns::SaveParams() const
@@ -372,7 +440,8 @@ JSON CRemoveExpectedIntPatterns::SaveParams() const
 			.AddMember( "Significance", rapidjson::Value().SetDouble(significance), alloc)
 			.AddMember( "FindPartialOrder", rapidjson::Value().SetBool(findPartialOrder), alloc)
 			.AddMember( "OutSuffix", rapidjson::Value().SetString(
-				rapidjson::StringRef(outSuffix.c_str())), alloc ),
+				rapidjson::StringRef(outSuffix.c_str())), alloc )
+			.AddMember( "BatchSize", rapidjson::Value().SetUint(batchSize), alloc),
 		alloc );
 	JSON result;
 	CreateStringFromJSON( params, result );
@@ -67,6 +67,8 @@ private:
 	std::string outSuffix;
 	// Should the order of filtered concepts be found
 	bool findPartialOrder; 
+	// The number of nodes of the lattice that are processed at once
+	DWORD batchSize;
 
 	// Comparator for patterns
 	CSharedPtr<IPatternManager> cmp;
@@ -9,6 +9,7 @@
 #include <fcaps/SharedModulesLib/VectorBinarySetDescriptor.h>
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 #include <ModuleJSONTools.h>
 #include <StdTools.h>
 
@@ -161,7 +162,7 @@ private:
 
 ////////////////////////////////////////////////////////////////////
 
-class CPattern : public IExtent, public IPatternDescriptor, public ISwappable {
+class CPattern : public IExtent, public IBitsetExtent, public IPatternDescriptor, public ISwappable {
 	
 public:
 	// Pattern controls memor for the extent
@@ -197,6 +198,10 @@ public:
 	virtual void ClearMemory( CPatternImage& e) const
 		{ delete[] e.Objects;}
 
+	// Methods of IBitsetExtent
+	virtual void GetBitset( const uintptr_t*& blocks, DWORD& blocksCount ) const
+		{ blocks = cmp.GetBlocks( Extent() ); blocksCount = cmp.GetBlocksCount(); }
+
 	// Methos of IPatternDescriptor
 	virtual bool IsMostGeneral() const
 		{return intent == -1;}
@@ -580,6 +585,15 @@ JSON CStabilityCbOLocalProjectionChain::SaveIntent( const IPatternDescriptor* d
 
 	return rslt;
 }
+void CStabilityCbOLocalProjectionChain::WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	extCmp->WritePattern( &to_pattern(d).Extent(), dst );
+}
+void CStabilityCbOLocalProjectionChain::WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	// The description of attributes is provided by the context attributes module
+	dst.RawValue( SaveIntent( d ) );
+}
 size_t CStabilityCbOLocalProjectionChain::GetTotalAllocatedPatterns() const
 {
 	return totalAllocatedPatterns;
@@ -112,6 +112,8 @@ public:
 	virtual int GetExtentSize( const IPatternDescriptor* d ) const;
 	virtual JSON SaveExtent( const IPatternDescriptor* d ) const;
 	virtual JSON SaveIntent( const IPatternDescriptor* d ) const;
+	virtual void WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
+	virtual void WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
 	virtual size_t GetTotalAllocatedPatterns() const;
 	virtual size_t GetTotalConsumedMemory() const;
 
@@ -9,6 +9,7 @@
 #include <fcaps/SharedModulesLib/VectorBinarySetDescriptor.h>
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 #include <ModuleJSONTools.h>
 #include <StdTools.h>
 
@@ -647,26 +648,8 @@ JSON CStabilityLPCbyPatriciaTree::SaveExtent( const IPatternDescriptor* d ) cons
 }
 JSON CStabilityLPCbyPatriciaTree::SaveIntent( const IPatternDescriptor* d ) const
 {
-	const CPTPattern& p = to_pattern(d);
-
 	set<int> intent;
-	auto itr = p.Begin();
-	int nodeCount = 0;
-	for(; itr != p.End(); ++itr, ++nodeCount) {
-		const CPatritiaTreeNode* node = *itr;
-		assert(node != 0);
-
-		if( nodeCount == 0) {
-			intent = node->CommonAttributes;
-			continue;
-		}
-
-		set<int> res;
-		set_intersection(node->CommonAttributes.begin(), node->CommonAttributes.end(),
-						 intent.begin(), intent.end(), inserter(res, res.end()));
-
-		intent.swap(res);
-	}
+	computeIntent( to_pattern(d), intent );
 
 	rapidjson::Document intentJson;
 	rapidjson::MemoryPoolAllocator<>& alloc = intentJson.GetAllocator();
@@ -688,6 +671,28 @@ JSON CStabilityLPCbyPatriciaTree::SaveIntent( const IPatternDescriptor* d ) cons
 	CreateStringFromJSON( intentJson, result );
 	return result;
 }
+void CStabilityLPCbyPatriciaTree::WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	CPatternImage img;
+	to_pattern(d).GetExtent(img);
+	dst.Indices( img.Objects, img.ImageSize );
+}
+void CStabilityLPCbyPatriciaTree::WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	set<int> intent;
+	computeIntent( to_pattern(d), intent );
+
+	dst.StartObject();
+	dst.Key( "Names" );
+	dst.StartArray();
+	for( auto attr = intent.begin(); attr != intent.end(); ++attr) {
+		dst.String( attrs->GetAttributeName(*attr) );
+	}
+	dst.EndArray();
+	dst.Key( "Count" );
+	dst.Uint( intent.size() );
+	dst.EndObject();
+}
 
 size_t CStabilityLPCbyPatriciaTree::GetTotalAllocatedPatterns() const
 {
@@ -1346,6 +1351,29 @@ const CPTPattern& CStabilityLPCbyPatriciaTree::to_pattern(const IPatternDescript
 	return debug_cast<const CPTPattern&>(*d);
 }
 
+// Computes the intent of p as the intersection of common attributes of its nodes
+void CStabilityLPCbyPatriciaTree::computeIntent(const CPTPattern& p, set<int>& intent) const
+{
+	intent.clear();
+	auto itr = p.Begin();
+	int nodeCount = 0;
+	for(; itr != p.End(); ++itr, ++nodeCount) {
+		const CPatritiaTreeNode* node = *itr;
+		assert(node != 0);
+
+		if( nodeCount == 0) {
+			intent = node->CommonAttributes;
+			continue;
+		}
+
+		set<int> res;
+		set_intersection(node->CommonAttributes.begin(), node->CommonAttributes.end(),
+						 intent.begin(), intent.end(), inserter(res, res.end()));
+
+		intent.swap(res);
+	}
+}
+
 // Computes the preimage of p w.r.t. the attribute a
 CPTPattern* CStabilityLPCbyPatriciaTree::computePreimage(const CPTPattern& p, CPatritiaTree::TAttribute a)
 {
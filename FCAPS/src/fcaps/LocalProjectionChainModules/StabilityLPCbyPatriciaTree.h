@@ -54,6 +54,8 @@ public:
 	virtual int GetExtentSize( const IPatternDescriptor* d ) const;
 	virtual JSON SaveExtent( const IPatternDescriptor* d ) const;
 	virtual JSON SaveIntent( const IPatternDescriptor* d ) const;
+	virtual void WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
+	virtual void WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
 	virtual size_t GetTotalAllocatedPatterns() const;
 	virtual size_t GetTotalConsumedMemory() const;
 
@@ -110,6 +112,7 @@ private:
 	bool checkPTValidity();
 
 	const CPTPattern& to_pattern(const IPatternDescriptor* d) const;
+	void computeIntent(const CPTPattern& p, std::set<int>& intent) const;
 	CPTPattern* computePreimage(const CPTPattern& p, CPatritiaTree::TAttribute a);
 
 	bool initializePreimage(const CPTPattern& parent, int genAttr, CPTPattern& res);
@@ -77,6 +77,11 @@ void CBinaryClassificationOEst::GetValue(const IExtent* ext, COEstValue& val ) c
 	double curWPlus = 0;
 	double curWAll = 0;
 	getObjectsWeight(ext, curWPlus, curWAll);
+	GetValueByWeights(curWPlus, curWAll, val);
+}
+
+void CBinaryClassificationOEst::GetValueByWeights( double curWPlus, double curWAll, COEstValue& val ) const
+{
 	assert(curWPlus <= curWAll);
 
 	val.Value = getValue(curWPlus,curWAll);
@@ -200,6 +205,7 @@ void CBinaryClassificationOEst::LoadParams( const JSON& json )
 		wPlus += classes[i] * weights[i];
 		wAll += weights[i];
 	}
+	masks.Build(classes, weights);
 
 	if(p.HasMember("FreqWeight") && p["FreqWeight"].IsNumber()) {
 		const double a =p["FreqWeight"].GetDouble();
@@ -239,7 +245,13 @@ JSON CBinaryClassificationOEst::SaveParams() const
 void CBinaryClassificationOEst::getObjectsWeight(const IExtent* ext, double& wPlus, double& wAll) const
 {
 	assert(ext!=0);
-	
+
+	if( masks.IsBuilt() ) {
+		masks.GetWeights(*ext, wPlus, wAll);
+		assert(wPlus <= wAll);
+		return;
+	}
+
 	CPatternImage img;
 	ext->GetExtent(img);
 	assert(img.ImageSize >= 0 && img.Objects != 0);
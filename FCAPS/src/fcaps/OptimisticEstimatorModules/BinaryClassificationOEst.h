@@ -8,6 +8,7 @@
 #include <fcaps/OptimisticEstimator.h>
 #include <fcaps/Module.h>
 #include <ModuleTools.h>
+#include <fcaps/SharedModulesLib/ClassMasks.h>
 
 #include <unordered_set>
 
@@ -17,7 +18,7 @@ const char BinaryClassificationOptimisticEstimator[] = "BinaryClassificationOpti
 
 ////////////////////////////////////////////////////////////////////
 
-class CBinaryClassificationOEst : public IOptimisticEstimator, public IModule {
+class CBinaryClassificationOEst : public IBinaryClassificationOptimisticEstimator, public IModule {
 public:
 	CBinaryClassificationOEst();
 
@@ -27,6 +28,13 @@ public:
 	virtual void GetValue(const IExtent* ext, COEstValue& val ) const;
 	virtual JSON GetJsonQuality(const IExtent* ext) const; 
 
+	// Methods of IBinaryClassificationOptimisticEstimator
+	virtual const std::vector<bool>& GetClasses() const
+		{ return classes; }
+	virtual const std::vector<double>& GetWeights() const
+		{ return weights; }
+	virtual void GetValueByWeights( double curWPlus, double curWAll, COEstValue& val ) const;
+
 	// Methods of IModule
 	virtual void LoadParams( const JSON& );
 	virtual JSON SaveParams() const;
@@ -55,6 +63,8 @@ private:
 	std::vector<bool> classes;
 	// The vector specifying the weights of the objects
 	std::vector<double> weights;
+	// The classes by the levels of weights, used if the weights take a few values
+	CClassMasks masks;
 
 	// The weight of positive objects
 	double wPlus;
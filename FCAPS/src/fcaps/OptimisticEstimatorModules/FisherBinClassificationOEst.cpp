@@ -11,6 +11,9 @@
 #include <rapidjson/document.h>
 
 #include <boost/math/distributions/chi_squared.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <sstream>
 
 #include <boost/math/special_functions/gamma.hpp>
@@ -51,6 +54,10 @@ STR(
 					"type": "number",
 					"minimum": 0,
 					"maximum": 1
+				},
+				"PrecomputeTable": {
+					"description": "If true, the values for all extent sizes and numbers of positive objects are computed in advance (if the table fits the memory limit). Otherwise they are memoized on the first use. Works only for integer weights.",
+					"type": "boolean"
 				}
 			}
 		}
@@ -69,14 +76,15 @@ const char* const CFisherBinClassificationOEst::Desc()
 CFisherBinClassificationOEst::CFisherBinClassificationOEst() :
 	wPlus(0),
 	wAll(0),
-	freqWeight(1)
+	freqWeight(1),
+	log_inv_binom_N_n(0),
+	memoSize(0),
+	isMemoUsed(false),
+	shouldPrecompute(false)
 {
 	log10_2 = log10(2.0);
 	log_10 = log(10);
-	log_method = 1;
-	log_inv_binom_N_n = 0;
 	log_method = -1;
-	loggamma = 0;
 }
 
 void CFisherBinClassificationOEst::GetValue(const IExtent* ext, COEstValue& val ) const
@@ -85,145 +93,26 @@ void CFisherBinClassificationOEst::GetValue(const IExtent* ext, COEstValue& val
 	double curWPlus = 0;
 	double curWAll = 0;
 	getObjectsWeight(ext, curWPlus, curWAll);
+	GetValueByWeights(curWPlus, curWAll, val);
+}
+
+void CFisherBinClassificationOEst::GetValueByWeights( double curWPlus, double curWAll, COEstValue& val ) const
+{
 	assert(curWPlus <= curWAll);
 
-/********************************************************************************************/
-//Method 1
-/*******************************************************************************************/
-	//BestSubsetEstimate defined in 2018 paper
-	/*
-	val.Value = getValue(curWPlus,curWAll);	
-        double maxQuality;
-	int N=(int)(wAll+0.5);
-	int n1=(int)(wPlus+0.5);	
-	int x=(int)(curWAll+0.5);
-	
-	if(x<=N&&x>n1)
-	{
-		val.BestSubsetEstimate=-1*(log_inv_binom_N_n/log_10);
-	}
-	else
-	{
-		int a_min = ((n1+x-N) > 0) ? (n1+x-N) : 0;//max(0,n+x-N)
-		int a_max = (x > n1) ? n1 : x;//min(x,n)
-		maxQuality=getValue(a_min,x);
-		for(int u=a_min+1;u<=a_max;u++)
-		{
-			double curQuality=getValue(u,x);
-			if(curQuality>maxQuality)
-				maxQuality=curQuality;
-		}
-		val.BestSubsetEstimate = maxQuality;
-        
+	const int x=(int)(curWAll+0.5);
+	const int a=(int)(curWPlus+0.5);
+	CFisherRow localRow;
+	const CFisherRow* row = &localRow;
+	if( isMemoUsed ) {
+		row = &getRow(x);
+	} else {
+		computeRow(x, localRow);
 	}
-	*/
-/******************************************************************************************/
-/********************************************************************************************/
-//Method 2
-/*******************************************************************************************/
-	
-	int N=(int)wAll;
-	int n1=(int)wPlus;	
-	int x=(int)curWAll;
-	int a=(int)curWPlus;
-	if( x<=N && x>n1 )
-	{
-		val.BestSubsetEstimate=-1*(log_inv_binom_N_n/log_10);
-		val.Value = getValue(curWPlus,curWAll);
-	}
-	else
-	{
-		double pre_comp_xterms, pval, p_left, p_right , p_left_log, p_right_log , pval_log;
-		int a_min, a_max;
-		// Compute the contribution of all terms depending on x but not on a
-		pre_comp_xterms = loggamma[x] + loggamma[N-x];
-		a_min = ((n1+x-N) > 0) ? (n1+x-N) : 0;//max(0,n+x-N)
-		a_max = (x > n1) ? n1 : x;//min(x,n)
-
-		double maxQuality=INT_MAX;
-		// log values computation
-		pval_log = 0;
-	
-		while(a_min<a_max){
-			p_left_log = (pre_comp_xterms + log_inv_binom_N_n - (loggamma[a_min] + loggamma[n1-a_min] + loggamma[x-a_min] + loggamma[(N-n1)-(x-a_min)]))/log_10;
-			p_right_log = (pre_comp_xterms + log_inv_binom_N_n - (loggamma[a_max] + loggamma[n1-a_max] + loggamma[x-a_max] + loggamma[(N-n1)-(x-a_max)]))/log_10;
-
-			if(p_left_log == p_right_log) {
-
-				// log increment
-				if(pval_log == 0){
-				pval_log = p_left_log + log10_2;
-				}
-				else{
-					double temp = p_left_log + log10_2;
-					//pval_log = pval_log + log10(1 + pow(10.0,(temp - pval_log)));
-					pval_log = pval_log + (log1p(exp((temp - pval_log) * log_10)) / log_10);
-					//pval_log = sumlogs(pval_log , temp);
-				}
-				if(a_min==a)
-					val.Value=pval_log;
-				if(pval_log<maxQuality)
-					maxQuality=pval_log;
-				// movement of indices
-				a_min++;
-				a_max--;
+	assert(row->AMin <= a && a - row->AMin < row->Values.size());
+	val.Value = row->Values[a - row->AMin];
+	val.BestSubsetEstimate = row->Bound;
 
-			}
-			else
-			if(p_left_log < p_right_log){
-
-				// log increment
-				if(pval_log == 0){
-					pval_log = p_left_log;
-				}
-				else{
-					//pval_log = pval_log + log10(1 + pow(10.0,(p_left_log - pval_log)));
-					pval_log = pval_log + (log1p(exp((p_left_log - pval_log) * log_10)) / log_10);
-					//pval_log = sumlogs(pval_log , p_left_log);
-				}
-
-				if(a_min==a)
-					val.Value=pval_log;
-				if(pval_log<maxQuality)
-					maxQuality=pval_log;
-
-				// move index
-				a_min++;
-			}
-			else{
-
-				// log increment
-				if(pval_log == 0){
-					pval_log = p_right_log;
-				}
-				else{
-					//pval_log = pval_log + log10(1 + pow(10.0,(p_right_log - pval_log)));
-					pval_log = pval_log + (log1p(exp((p_right_log - pval_log) * log_10)) / log_10);
-					//pval_log = sumlogs(pval_log , p_right_log);
-				}
-
-				if(a_max==a)
-					val.Value=pval_log;
-				if(pval_log<maxQuality)
-					maxQuality=pval_log;
-
-				// move index
-				a_max--;
-			}
-
-		}
-		// In this case a_min=a_max is the mode of the distribution and its p-value is 1 by definition
-		if(a_min==a_max){
-			if(a_min==a)
-				val.Value=0;
-			if(maxQuality>0)
-				maxQuality=0;
-        	}
-		val.Value=-1*val.Value;
-		val.BestSubsetEstimate=-1*maxQuality;
-	}
-/********************************************************************************************/
-/*******************************************************************************************/
 	assert( val.BestSubsetEstimate - val.Value > -1e-10);
 }
 
@@ -310,6 +199,7 @@ void CFisherBinClassificationOEst::LoadParams( const JSON& json )
 		wPlus += classes[i] * weights[i];
 		wAll += weights[i];
 	}
+	masks.Build(classes, weights);
 
 	if(p.HasMember("FreqWeight") && p["FreqWeight"].IsNumber()) {
 		const double a =p["FreqWeight"].GetDouble();
@@ -317,24 +207,41 @@ void CFisherBinClassificationOEst::LoadParams( const JSON& json )
 			freqWeight = a;
 		}
 	}
+	if(p.HasMember("PrecomputeTable") && p["PrecomputeTable"].IsBool()) {
+		shouldPrecompute = p["PrecomputeTable"].GetBool();
+	}
 	/**********************************************************************************/
 	//Initialization 
 	/**********************************************************************************/
-	int N=(int)(wAll+0.5);
-	int n1=(int)(wPlus+0.5);
-	int x;
-	// Allocate memory for log-gamma cache, raising error if it fails
-	loggamma = (double *)malloc((N+1)*sizeof(double));
-	if(!loggamma){
-		fprintf(stderr,"Error in function loggamma_init: couldn't allocate memory for array loggamma\n");
-		exit(1);
-	}
-	// Initialise cache with appropriate values
-	for(x=0;x<=N;x++) {
+	const int N=(int)(wAll+0.5);
+	const int n1=(int)(wPlus+0.5);
+	// Log-factorials of all possible numbers of objects
+	loggamma.resize(N+1);
+	for(int x=0;x<=N;x++) {
 		loggamma[x] = lgamma(static_cast<double>(x+1));//Gamma(x) = (x-1)!
 	}
 	// Initialise log_inv_binom_N_n
 	log_inv_binom_N_n = loggamma[n1] + loggamma[N-n1] - loggamma[N];
+
+	// The values depend only on the extent size and the number of positive objects if the weights are integer
+	isMemoUsed = true;
+	for( size_t i = 0; i < weights.size(); ++i ) {
+		if( weights[i] != floor(weights[i]) ) {
+			isMemoUsed = false;
+			break;
+		}
+	}
+	rows.clear();
+	memoSize = 0;
+	if( !isMemoUsed ) {
+		return;
+	}
+	rows.resize(N+1);
+	if( shouldPrecompute && static_cast<double>(N+1) * (min(N, n1)+1) <= MaxMemoSize ) {
+		for(int x=0;x<=N;x++) {
+			getRow(x);
+		}
+	}
 }
 
 JSON CFisherBinClassificationOEst::SaveParams() const
@@ -346,6 +253,7 @@ JSON CFisherBinClassificationOEst::SaveParams() const
 		.AddMember( "Name", FisherBinClassificationOptimisticEstimator, alloc )
 		.AddMember( "Params", rapidjson::Value().SetObject()
 		            .AddMember("FreqWeight",rapidjson::Value().SetDouble(freqWeight),alloc)
+		            .AddMember("PrecomputeTable",rapidjson::Value().SetBool(shouldPrecompute),alloc)
 		            , alloc );
 
 	rapidjson::Value& p = params["Params"];
@@ -368,7 +276,13 @@ JSON CFisherBinClassificationOEst::SaveParams() const
 void CFisherBinClassificationOEst::getObjectsWeight(const IExtent* ext, double& wPlus, double& wAll) const
 {
 	assert(ext!=0);
-	
+
+	if( masks.IsBuilt() ) {
+		masks.GetWeights(*ext, wPlus, wAll);
+		assert(wPlus <= wAll);
+		return;
+	}
+
 	CPatternImage img;
 	ext->GetExtent(img);
 	assert(img.ImageSize >= 0 && img.Objects != 0);
@@ -390,41 +304,113 @@ void CFisherBinClassificationOEst::getObjectsWeight(const IExtent* ext, double&
 	assert(wPlus <= wAll);
 }
 
-// Returns the value given the number of positive objects and the extent size
-double CFisherBinClassificationOEst::getValue( const double& curWPlus, const double& curWAll ) const
+// Returns log10 of the probability of a positive objects in an extent of size x
+inline double CFisherBinClassificationOEst::getHypergeomLog( int x, int a ) const
+{
+	const int N=(int)(wAll+0.5);
+	const int n1=(int)(wPlus+0.5);
+	return (loggamma[x] + loggamma[N-x] + log_inv_binom_N_n
+		- (loggamma[a] + loggamma[n1-a] + loggamma[x-a] + loggamma[(N-n1)-(x-a)])) / log_10;
+}
+
+// Returns log10(10^first + 10^second)
+inline double CFisherBinClassificationOEst::addLogs( double first, double second ) const
+{
+	if( first < second ) {
+		swap( first, second );
+	}
+	return first + log1p(exp((second - first) * log_10)) / log_10;
+}
+
+// Computes the values of an extent of size x for all numbers of positive objects and the best value of its subsets
+void CFisherBinClassificationOEst::computeRow( int x, CFisherRow& row ) const
 {
-	//cout<<"Inside function getValue..";
-	//cout<<"\n curWPlus: "<<curWPlus<<" curWAll: "<<curWAll;
-	double pre_comp_xterms, pval, p_left, p_right , p_left_log, p_right_log , pval_log;
-	int a, a_min, a_max;
-	int N=(int)(wAll+0.5);
-	int n1=(int)(wPlus+0.5);	
-	int x=(int)(curWAll+0.5);
-
-	pre_comp_xterms = loggamma[x] + loggamma[N-x];
-	a_min = ((n1+x-N) > 0) ? (n1+x-N) : 0;//max(0,n+x-N)
-	a_max = (x > n1) ? n1 : x;//min(x,n)
-	a=(int)(curWPlus+0.5);
-	// Precompute the hypergeometric PDF in the range of interest
-	//double hypergeom_pvals_a = exp(pre_comp_xterms + log_inv_binom_N_n - (loggamma[a] + loggamma[n1-a] + loggamma[x-a] + loggamma[(N-n1)-(x-a)]));
-	double temp_value = pre_comp_xterms + log_inv_binom_N_n - (loggamma[a] + loggamma[n1-a] + loggamma[x-a] + loggamma[(N-n1)-(x-a)]);
-	double hypergeom_pvals_log_a = temp_value / log_10;
-	//pval = 0;
-	pval_log = 0;
-	for(a=a_min; a<=a_max; a++) {
-		//double hypergeom_pvals_a_curr = exp(pre_comp_xterms + log_inv_binom_N_n - (loggamma[a] + loggamma[n1-a] + loggamma[x-a] + loggamma[(N-n1)-(x-a)]));
-		temp_value = pre_comp_xterms + log_inv_binom_N_n - (loggamma[a] + loggamma[n1-a] + loggamma[x-a] + loggamma[(N-n1)-(x-a)]);
-		double temp = temp_value / log_10;
-		if(hypergeom_pvals_log_a>=temp){
-		//if(hypergeom_pvals_a>=hypergeom_pvals_a_curr){
-			 //pval+=hypergeom_pvals_a_curr;
-			 if(pval_log == 0){
-				pval_log = temp;
-			 }
-			 else
-			 	pval_log = pval_log + (log1p(exp((temp - pval_log) * log_10)) / log_10);
+	const int N=(int)(wAll+0.5);
+	const int n1=(int)(wPlus+0.5);
+	assert(0 <= x && x <= N);
+	row.AMin = max(0, n1+x-N);
+	const int aMax = min(x, n1);
+	row.Values.assign(aMax - row.AMin + 1, 0);
+
+	if( x > n1 ) {
+		// The p-value of a is the total probability of the numbers of positive objects that are not more probable than a
+		vector<double> probs(row.Values.size());
+		for( int a = row.AMin; a <= aMax; ++a ) {
+			probs[a - row.AMin] = getHypergeomLog(x, a);
+		}
+		vector<double> sorted(probs);
+		sort(sorted.begin(), sorted.end());
+		vector<double> sums(sorted.size());
+		sums[0] = sorted[0];
+		for( size_t i = 1; i < sorted.size(); ++i ) {
+			sums[i] = addLogs(sums[i-1], sorted[i]);
+		}
+		for( size_t i = 0; i < probs.size(); ++i ) {
+			const size_t last = upper_bound(sorted.begin(), sorted.end(), probs[i]) - sorted.begin() - 1;
+			row.Values[i] = -sums[last];
 		}
+		row.Bound = -1*(log_inv_binom_N_n/log_10);
+		return;
+	}
+
+	// The least probable numbers of positive objects are taken one by one from both tails of the distribution,
+	//  so the p-value of a number is the accumulated probability when it is taken
+	int aLeft = row.AMin;
+	int aRight = aMax;
+	double pvalLog = 0;
+	bool isEmpty = true;
+	double maxQuality = INT_MAX;
+	while( aLeft < aRight ) {
+		const double pLeft = getHypergeomLog(x, aLeft);
+		const double pRight = getHypergeomLog(x, aRight);
+		if( pLeft == pRight ) {
+			pvalLog = isEmpty ? pLeft + log10_2 : addLogs(pvalLog, pLeft + log10_2);
+			row.Values[aLeft - row.AMin] = pvalLog;
+			row.Values[aRight - row.AMin] = pvalLog;
+			++aLeft;
+			--aRight;
+		} else if( pLeft < pRight ) {
+			pvalLog = isEmpty ? pLeft : addLogs(pvalLog, pLeft);
+			row.Values[aLeft - row.AMin] = pvalLog;
+			++aLeft;
+		} else {
+			pvalLog = isEmpty ? pRight : addLogs(pvalLog, pRight);
+			row.Values[aRight - row.AMin] = pvalLog;
+			--aRight;
+		}
+		isEmpty = false;
+		maxQuality = min(maxQuality, pvalLog);
+	}
+	// In this case aLeft=aRight is the mode of the distribution and its p-value is 1 by definition
+	if( aLeft == aRight ) {
+		row.Values[aLeft - row.AMin] = 0;
+		maxQuality = min(maxQuality, 0.0);
+	}
+	for( size_t i = 0; i < row.Values.size(); ++i ) {
+		row.Values[i] = -row.Values[i];
+	}
+	row.Bound = -maxQuality;
+}
+
+// Returns the memoized row of an extent of size x, the row can be freed by the next call
+const CFisherBinClassificationOEst::CFisherRow& CFisherBinClassificationOEst::getRow( int x ) const
+{
+	assert(0 <= x && x < rows.size());
+	CFisherRow& row = rows[x];
+	if( row.Values.empty() ) {
+		if( memoSize + x + 1 > MaxMemoSize ) {
+			clearRows();
+		}
+		computeRow(x, row);
+		memoSize += row.Values.size();
+	}
+	return row;
+}
+
+void CFisherBinClassificationOEst::clearRows() const
+{
+	for( size_t i = 0; i < rows.size(); ++i ) {
+		vector<double>().swap(rows[i].Values);
 	}
-	//cout<<"pval: "<<pval<<"pval_log: "<<pval_log;
-	return -1*pval_log;
+	memoSize = 0;
 }
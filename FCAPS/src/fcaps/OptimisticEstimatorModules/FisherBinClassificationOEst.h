@@ -8,6 +8,7 @@
 #include <fcaps/OptimisticEstimator.h>
 #include <fcaps/Module.h>
 #include <ModuleTools.h>
+#include <fcaps/SharedModulesLib/ClassMasks.h>
 
 #include <unordered_set>
 
@@ -17,7 +18,9 @@ const char FisherBinClassificationOptimisticEstimator[] = "FisherBinClassificati
 
 ////////////////////////////////////////////////////////////////////
 
-class CFisherBinClassificationOEst : public IOptimisticEstimator, public IModule {
+// Not thread-safe: GetValue and GetValueByWeights fill the memo of rows without synchronization,
+//  so concurrent users should have their own copies of the estimator.
+class CFisherBinClassificationOEst : public IBinaryClassificationOptimisticEstimator, public IModule {
 public:
 	CFisherBinClassificationOEst();
 
@@ -27,6 +30,13 @@ public:
 	virtual void GetValue(const IExtent* ext, COEstValue& val ) const;
 	virtual JSON GetJsonQuality(const IExtent* ext) const {return "";}
 
+	// Methods of IBinaryClassificationOptimisticEstimator
+	virtual const std::vector<bool>& GetClasses() const
+		{ return classes; }
+	virtual const std::vector<double>& GetWeights() const
+		{ return weights; }
+	virtual void GetValueByWeights( double curWPlus, double curWAll, COEstValue& val ) const;
+
 	// Methods of IModule
 	virtual void LoadParams( const JSON& );
 	virtual JSON SaveParams() const;
@@ -55,21 +65,47 @@ private:
 	std::vector<bool> classes;
 	// The vector specifying the weights of the objects
 	std::vector<double> weights;
+	// The classes by the levels of weights, used if the weights take a few values
+	CClassMasks masks;
 
 	// The weight of positive objects
 	double wPlus;
 	// The total weiht of all objets
 	double wAll;
 
+	// The values of the extents of one size, indexed by the number of positive objects minus AMin
+	struct CFisherRow {
+		int AMin;
+		std::vector<double> Values;
+		// The best value of the subsets of the extents
+		double Bound;
+
+		CFisherRow() : AMin( 0 ), Bound( 0 ) {}
+	};
+	// The maximal number of memoized values
+	static const size_t MaxMemoSize = 1 << 22;
+
 	// For efficient Fisher test computation
-	double *loggamma;
+	std::vector<double> loggamma;
 	double log_inv_binom_N_n;
 	double log10_2;
 	double log_10;
 	int log_method;
 
+	// The memoized rows for every extent size, used if the weights are integer.
+	//  A full memo is cleared, so a row returned by getRow is valid only until the next call to getRow.
+	mutable std::vector<CFisherRow> rows;
+	mutable size_t memoSize;
+	bool isMemoUsed;
+	// Should all rows be computed in LoadParams
+	bool shouldPrecompute;
+
 	void getObjectsWeight(const IExtent* ext, double& wPlus, double& wAll) const;
-	double getValue( const double& curWPlus, const double& curWAll ) const;
+	double getHypergeomLog( int x, int a ) const;
+	double addLogs( double first, double second ) const;
+	void computeRow( int x, CFisherRow& row ) const;
+	const CFisherRow& getRow( int x ) const;
+	void clearRows() const;
 };
 
 #endif // BINARYCLASSIFICATIONOEST_H
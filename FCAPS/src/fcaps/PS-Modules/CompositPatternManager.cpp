@@ -9,6 +9,9 @@
 
 #include <rapidjson/document.h>
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <sstream>
 
 using namespace std;
@@ -60,6 +63,15 @@ STR(
 					"items":{
 						"type":"@PatternManagerModules"
 					}
+				},
+				"AdaptiveOrder":{
+					"description": "Should the components be compared in the order of their ability to find patterns incomparable per unit of time (measured on a sample of comparisons). Up to 16 components.",
+					"type":"boolean"
+				},
+				"ThreadsCount":{
+					"description": "The number of threads computing the similarity of components, including the calling thread. If more than one, the managers of components should allow for concurrent similarity computation.",
+					"type":"integer",
+					"minimum":1
 				}
 			}
 		}
@@ -76,11 +88,61 @@ const char* const CCompositPatternManager::Desc()
 }
 ////////////////////////////////////////////////////////////////////
 
+// The similarity computation of the components of a pair of patterns
+struct CCompositPatternManager::CSimilarityBatch {
+	boost::mutex Access;
+	boost::condition_variable IsDone;
+	// The number of unfinished tasks
+	DWORD Left;
+
+	CSimilarityBatch( DWORD left ) : Left( left ) {}
+};
+
+// The similarity computation of one component
+struct CCompositPatternManager::CSimilarityTask {
+	IPatternManager* Manager;
+	const IPatternDescriptor* First;
+	const IPatternDescriptor* Second;
+	const IPatternDescriptor* Result;
+	CException* Error;
+	CSimilarityBatch* Batch;
+
+	CSimilarityTask() :
+		Manager( 0 ), First( 0 ), Second( 0 ), Result( 0 ), Error( 0 ), Batch( 0 ) {}
+};
+
+class CCompositPatternManager::CSimilarityThread {
+public:
+	explicit CSimilarityThread( CCompositPatternManager& _pm ) :
+		pm( _pm ) {}
+
+	void operator()()
+	{
+		CSimilarityTask* task = 0;
+		while( pm.popTask( task, true ) ) {
+			runTask( *task );
+		}
+	}
 
+private:
+	CCompositPatternManager& pm;
+};
 
-CCompositPatternManager::CCompositPatternManager()
+////////////////////////////////////////////////////////////////////
+
+CCompositPatternManager::CCompositPatternManager() :
+	isAdaptiveOrder( true ),
+	packedOrder( 0 ),
+	comparisonsCount( 0 ),
+	sampledCount( 0 ),
+	threadsCount( 1 ),
+	isStopping( false )
 {
-	//ctor
+}
+
+CCompositPatternManager::~CCompositPatternManager()
+{
+	stopThreads();
 }
 
 const CCompositePatternDescriptor* CCompositPatternManager::LoadObject( const JSON& json )
@@ -104,6 +166,10 @@ const CCompositePatternDescriptor* CCompositPatternManager::CalculateSimilarity(
 	const CCompositePatternDescriptor& scnd = getCompositPattern( second );
 	assert( scnd.ptrns.size() == cmps.size() );
 
+	if( !threads.empty() ) {
+		return calculateSimilarityInParallel( frst, scnd );
+	}
+
 	unique_ptr<CCompositePatternDescriptor> result( new CCompositePatternDescriptor );
 	result->ptrns.reserve( cmps.size() );
 	for( size_t i = 0; i < cmps.size(); ++i ) {
@@ -126,8 +192,17 @@ TCompareResult CCompositPatternManager::Compare(
 	const DWORD internalInterestingResults = interestingResults | CR_Equal;
 	const DWORD internalPossibleResults = possibleResults | CR_Equal;
 
-	for( size_t i = 0; i < cmps.size(); ++i ) {
-		const TCompareResult cmp = cmps[i].Compare( frst.ptrns[i], scnd.ptrns[i],
+	DWORD localOrder[MaxAdaptiveCount];
+	TCompareResult results[MaxAdaptiveCount];
+	const bool isOrderUsed = isOrdered();
+	const bool isSampled = isOrderUsed && getOrder( localOrder );
+	if( isSampled ) {
+		sampleComponents( frst, scnd, internalInterestingResults, internalPossibleResults, results );
+	}
+
+	for( size_t k = 0; k < cmps.size(); ++k ) {
+		const size_t i = isOrderUsed ? localOrder[k] : k;
+		const TCompareResult cmp = isSampled ? results[i] : cmps[i].Compare( frst.ptrns[i], scnd.ptrns[i],
 			internalInterestingResults, internalPossibleResults );
 		switch( cmp ) {
 			case CR_Incomparable:
@@ -180,6 +255,16 @@ void CCompositPatternManager::Write( const IPatternDescriptor* pattern, std::ost
 	dst << ">";
 }
 
+bool CCompositPatternManager::IsThreadSafe() const
+{
+	for( size_t i = 0; i < cmps.size(); ++i ) {
+		if( !IsThreadSafePatternManager( cmps[i] ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
 void CCompositPatternManager::LoadParams( const JSON& json )
 {
 	CJsonError errorText;
@@ -214,6 +299,18 @@ void CCompositPatternManager::LoadParams( const JSON& json )
 		}
 		cmps.push_back( newPM.release() );
 	}
+
+	const rapidjson::Value& p = params["Params"];
+	isAdaptiveOrder = true;
+	if( p.HasMember( "AdaptiveOrder" ) && p["AdaptiveOrder"].IsBool() ) {
+		isAdaptiveOrder = p["AdaptiveOrder"].GetBool();
+	}
+	threadsCount = 1;
+	if( p.HasMember( "ThreadsCount" ) && p["ThreadsCount"].IsUint() && p["ThreadsCount"].GetUint() > 0 ) {
+		threadsCount = p["ThreadsCount"].GetUint();
+	}
+	resetOrder();
+	startThreads();
 }
 JSON CCompositPatternManager::SaveParams() const
 {
@@ -223,7 +320,9 @@ JSON CCompositPatternManager::SaveParams() const
 		.AddMember( "Type", PatternManagerModuleType, alloc )
 		.AddMember( "Name", CompositPatternManager, alloc )
 		.AddMember( "Params", rapidjson::Value().SetObject()
-			.AddMember( "PMs", rapidjson::Value().SetArray(), alloc ),
+			.AddMember( "PMs", rapidjson::Value().SetArray(), alloc )
+			.AddMember( "AdaptiveOrder", rapidjson::Value().SetBool( isAdaptiveOrder ), alloc )
+			.AddMember( "ThreadsCount", rapidjson::Value().SetUint( threadsCount ), alloc ),
 		alloc );
 	rapidjson::Value& pms = params["Params"]["PMs"];
 	for( size_t i = 0; i < cmps.size(); ++i ) {
@@ -244,6 +343,179 @@ inline const CCompositePatternDescriptor& CCompositPatternManager::getCompositPa
 	return debug_cast<const CCompositePatternDescriptor&>( *ptrn );
 }
 
+// Copies the current order of components, returns if the comparison should be sampled. Takes no locks.
+bool CCompositPatternManager::getOrder( DWORD* localOrder )
+{
+	const unsigned long long currOrder = packedOrder.load( memory_order_acquire );
+	for( DWORD k = 0; k < cmps.size(); ++k ) {
+		localOrder[k] = ( currOrder >> ( 4 * k ) ) & 0xF;
+	}
+	return ( comparisonsCount.fetch_add( 1, memory_order_relaxed ) + 1 ) % SamplePeriod == 0;
+}
+
+// Compares all components measuring the time and updates the order if enough comparisons are sampled
+void CCompositPatternManager::sampleComponents(
+	const CCompositePatternDescriptor& first, const CCompositePatternDescriptor& second,
+	DWORD interestingResults, DWORD possibleResults, TCompareResult* results )
+{
+	double times[MaxAdaptiveCount];
+	for( size_t i = 0; i < cmps.size(); ++i ) {
+		const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		results[i] = cmps[i].Compare( first.ptrns[i], second.ptrns[i], interestingResults, possibleResults );
+		times[i] = chrono::duration<double, nano>( chrono::steady_clock::now() - start ).count();
+	}
+
+	boost::lock_guard<boost::mutex> lock( orderAccess );
+	for( size_t i = 0; i < cmps.size(); ++i ) {
+		stats[i].Time += times[i];
+		if( results[i] == CR_Incomparable ) {
+			stats[i].Decisions += 1;
+		}
+	}
+	++sampledCount;
+	if( sampledCount < ReorderPeriod ) {
+		return;
+	}
+	sampledCount = 0;
+
+	// The expected time of a comparison is minimal if the components are sorted
+	//  by the decreasing ratio of the probability to stop the comparison to its time
+	vector< pair<double, DWORD> > ranks( cmps.size() );
+	for( DWORD i = 0; i < cmps.size(); ++i ) {
+		ranks[i].first = -( stats[i].Decisions + 1 ) / ( stats[i].Time + 1 );
+		ranks[i].second = i;
+		// The old statistics fade out, so the order follows the data
+		stats[i].Decisions /= 2;
+		stats[i].Time /= 2;
+	}
+	sort( ranks.begin(), ranks.end() );
+	unsigned long long newOrder = 0;
+	for( DWORD k = 0; k < ranks.size(); ++k ) {
+		newOrder |= static_cast<unsigned long long>( ranks[k].second ) << ( 4 * k );
+	}
+	packedOrder.store( newOrder, memory_order_release );
+}
+
+void CCompositPatternManager::resetOrder()
+{
+	boost::lock_guard<boost::mutex> lock( orderAccess );
+	unsigned long long newOrder = 0;
+	for( DWORD k = 0; k < cmps.size() && k < MaxAdaptiveCount; ++k ) {
+		newOrder |= static_cast<unsigned long long>( k ) << ( 4 * k );
+	}
+	packedOrder.store( newOrder, memory_order_release );
+	stats.assign( cmps.size(), CComponentStats() );
+	comparisonsCount.store( 0, memory_order_relaxed );
+	sampledCount = 0;
+}
+
+void CCompositPatternManager::startThreads()
+{
+	stopThreads();
+	isStopping = false;
+	// The calling thread computes one of the components
+	const DWORD count = min<DWORD>( threadsCount, cmps.size() );
+	for( DWORD i = 1; i < count; ++i ) {
+		threads.push_back( new boost::thread( CSimilarityThread( *this ) ) );
+	}
+}
+
+void CCompositPatternManager::stopThreads()
+{
+	{
+		boost::lock_guard<boost::mutex> lock( tasksAccess );
+		isStopping = true;
+	}
+	hasTasks.notify_all();
+	for( DWORD i = 0; i < threads.size(); ++i ) {
+		threads[i].join();
+	}
+	threads.clear();
+}
+
+// Takes a waiting task, returns false if there is no task and the threads are stopping (or shouldWait is false)
+bool CCompositPatternManager::popTask( CSimilarityTask*& task, bool shouldWait )
+{
+	boost::unique_lock<boost::mutex> lock( tasksAccess );
+	while( shouldWait && tasks.empty() && !isStopping ) {
+		hasTasks.wait( lock );
+	}
+	if( tasks.empty() ) {
+		return false;
+	}
+	task = tasks.front();
+	tasks.pop_front();
+	return true;
+}
+
+void CCompositPatternManager::runTask( CSimilarityTask& task )
+{
+	try {
+		task.Result = task.Manager->CalculateSimilarity( task.First, task.Second );
+	} catch( CException* e ) {
+		task.Error = e;
+	} catch( std::exception& e ) {
+		task.Error = new CTextException( "CCompositPatternManager::runTask", e.what() );
+	}
+	// The batch can be destroyed as soon as the last task is done, so it is notified under the lock
+	boost::lock_guard<boost::mutex> lock( task.Batch->Access );
+	assert( task.Batch->Left > 0 );
+	--task.Batch->Left;
+	if( task.Batch->Left == 0 ) {
+		task.Batch->IsDone.notify_all();
+	}
+}
+
+const CCompositePatternDescriptor* CCompositPatternManager::calculateSimilarityInParallel(
+	const CCompositePatternDescriptor& first, const CCompositePatternDescriptor& second )
+{
+	vector<CSimilarityTask> localTasks( cmps.size() );
+	CSimilarityBatch batch( cmps.size() );
+	for( size_t i = 0; i < cmps.size(); ++i ) {
+		localTasks[i].Manager = &cmps[i];
+		localTasks[i].First = first.ptrns[i];
+		localTasks[i].Second = second.ptrns[i];
+		localTasks[i].Batch = &batch;
+	}
+	{
+		boost::lock_guard<boost::mutex> lock( tasksAccess );
+		for( size_t i = 1; i < localTasks.size(); ++i ) {
+			tasks.push_back( &localTasks[i] );
+		}
+	}
+	hasTasks.notify_all();
+
+	runTask( localTasks[0] );
+	// The calling thread helps with the waiting tasks
+	CSimilarityTask* task = 0;
+	while( popTask( task, false ) ) {
+		runTask( *task );
+	}
+	{
+		boost::unique_lock<boost::mutex> lock( batch.Access );
+		while( batch.Left > 0 ) {
+			batch.IsDone.wait( lock );
+		}
+	}
+
+	unique_ptr<CCompositePatternDescriptor> result( new CCompositePatternDescriptor );
+	result->ptrns.reserve( cmps.size() );
+	CException* error = 0;
+	for( size_t i = 0; i < localTasks.size(); ++i ) {
+		if( localTasks[i].Error == 0 ) {
+			result->ptrns.push_back( localTasks[i].Result );
+		} else if( error == 0 ) {
+			error = localTasks[i].Error;
+		} else {
+			delete localTasks[i].Error;
+		}
+	}
+	if( error != 0 ) {
+		throw error;
+	}
+	return result.release();
+}
+
 JSON CCompositPatternManager::savePattern( const IPatternDescriptor* pattern ) const
 {
 	const CCompositePatternDescriptor& ptrn = getCompositPattern( pattern );
@@ -10,6 +10,10 @@
 #include <ModuleTools.h>
 
 #include<boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <deque>
 
 ////////////////////////////////////////////////////////////////////
 
@@ -38,9 +42,23 @@ private:
 
 ////////////////////////////////////////////////////////////////////
 
-class CCompositPatternManager : public IPatternManager, public IModule {
+// The components are compared in the order of their ability to find the patterns incomparable per unit of time,
+//  the ability and the time are measured on every SamplePeriod-th comparison where all components are compared.
+//  Comparisons read the order without locks, only the sampled comparisons take the lock to update the statistics.
+//  The similarity of components can be computed in parallel, then the component managers should
+//  allow for concurrent similarity computation.
+class CCompositPatternManager : public IPatternManager, public IConcurrentPatternManager, public IModule {
+public:
+	// Every SamplePeriod-th comparison is sampled for the statistics
+	static const DWORD SamplePeriod = 32;
+	// The order is updated after ReorderPeriod sampled comparisons
+	static const DWORD ReorderPeriod = 64;
+	// The order is adapted only for this number of components or less (4 bits per component in the packed order)
+	static const DWORD MaxAdaptiveCount = 16;
+
 public:
 	CCompositPatternManager();
+	~CCompositPatternManager();
 
 	// Methods of IPatternManagerr
 	virtual const CCompositePatternDescriptor* LoadObject( const JSON& );
@@ -57,6 +75,10 @@ public:
 
 	virtual void Write( const IPatternDescriptor* pattern, std::ostream& dst ) const;
 
+	// Methods of IConcurrentPatternManager
+	//  Thread-safe if all the components are
+	virtual bool IsThreadSafe() const;
+
 	// Methods of IModule
 	virtual void LoadParams( const JSON& );
 	virtual JSON SaveParams() const;
@@ -71,12 +93,56 @@ public:
 		{ return CompositPatternManager; }
 	static const char* const Desc();
 
+private:
+	// Statistics of a component on the sampled comparisons
+	struct CComponentStats {
+		// The number of comparisons where the component has found the patterns incomparable
+		double Decisions;
+		// The time of comparisons in nanoseconds
+		double Time;
+
+		CComponentStats() : Decisions( 0 ), Time( 0 ) {}
+	};
+	struct CSimilarityBatch;
+	struct CSimilarityTask;
+	class CSimilarityThread;
+
 private:
 	static const CModuleRegistrar<CCompositPatternManager> registrar;
 
 	boost::ptr_vector<IPatternManager> cmps;
 
+	// Should the order of comparison of components be adapted
+	bool isAdaptiveOrder;
+	// The current order of comparison, the k-th component to compare is in the bits [4k, 4k+4)
+	std::atomic<unsigned long long> packedOrder;
+	std::atomic<DWORD> comparisonsCount;
+	// The statistics for the next order, guarded by orderAccess
+	std::vector<CComponentStats> stats;
+	DWORD sampledCount;
+	boost::mutex orderAccess;
+
+	// The number of threads computing the similarity of components, including the calling thread
+	DWORD threadsCount;
+	boost::ptr_vector<boost::thread> threads;
+	std::deque<CSimilarityTask*> tasks;
+	boost::mutex tasksAccess;
+	boost::condition_variable hasTasks;
+	bool isStopping;
+
 	static const CCompositePatternDescriptor& getCompositPattern( const IPatternDescriptor* ptrn );
+	bool isOrdered() const
+		{ return isAdaptiveOrder && cmps.size() > 1 && cmps.size() <= MaxAdaptiveCount; }
+	bool getOrder( DWORD* localOrder );
+	void sampleComponents( const CCompositePatternDescriptor& first, const CCompositePatternDescriptor& second,
+		DWORD interestingResults, DWORD possibleResults, TCompareResult* results );
+	void resetOrder();
+	void startThreads();
+	void stopThreads();
+	bool popTask( CSimilarityTask*& task, bool shouldWait );
+	static void runTask( CSimilarityTask& task );
+	const CCompositePatternDescriptor* calculateSimilarityInParallel(
+		const CCompositePatternDescriptor& first, const CCompositePatternDescriptor& second );
 	JSON savePattern( const IPatternDescriptor* ) const;
 	const CCompositePatternDescriptor* loadPattern( const JSON& );
 };
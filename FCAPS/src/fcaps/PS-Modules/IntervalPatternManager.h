@@ -32,7 +32,7 @@ private:
 
 ////////////////////////////////////////////////////////////////////
 
-class CIntervalPatternManager : public IPatternManager, public IModule {
+class CIntervalPatternManager : public IPatternManager, public IConcurrentPatternManager, public IModule {
 public:
 	CIntervalPatternManager();
 
@@ -50,6 +50,10 @@ public:
 
 	virtual void Write( const IPatternDescriptor* pattern, std::ostream& dst ) const;
 
+	// Methods of IConcurrentPatternManager
+	virtual bool IsThreadSafe() const
+		{ return true; }
+
 	// Methods of IModule
 	virtual void LoadParams( const JSON& );
 	virtual JSON SaveParams() const;
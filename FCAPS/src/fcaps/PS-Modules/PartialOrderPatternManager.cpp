@@ -15,6 +15,15 @@ using namespace std;
 
 ////////////////////////////////////////////////////////////////////
 
+CPartialOrderPatternDescriptor::~CPartialOrderPatternDescriptor()
+{
+	// The elements are owned by the pattern
+	CStdIterator<CElementSet::CConstIterator, false> itr( elements );
+	for( ; !itr.IsEnd(); ++itr ) {
+		elemsCmp->FreeElement( *itr );
+	}
+}
+
 void CPartialOrderPatternDescriptor::AddElement(
 	const IPartialOrderElement* el )
 {
@@ -100,8 +109,11 @@ const CPartialOrderPatternDescriptor* CPartialOrderPatternManager::CalculateSimi
 			IPartialOrderElementsComparator::CElementSet parents;
 			elemsCmp->FindAllParents( *el1, *el2, parents );
 			for( int p = 0; p < parents.Count; ++p ) {
-				addElementToPattern( parents.Elements[p], *result );
+				if( !addElementToPattern( parents.Elements[p], *result ) ) {
+					elemsCmp->FreeElement( parents.Elements[p] );
+				}
 			}
+			elemsCmp->FreeElementSet( parents );
 		}
 	}
 
@@ -287,6 +299,7 @@ CElementSet::CIterator begin = ptrn.GetElements().Begin();
 				// the pattern already has the eling
 				return false;
 			case CR_MoreGeneral:
+				elemsCmp->FreeElement( *patternEl );
 				ptrn.GetElements().Erase( patternEl );
 				break;
 			default:
@@ -25,8 +25,7 @@ public:
 public:
 	CPartialOrderPatternDescriptor( const CSharedPtr<IPartialOrderElementsComparator>& _elemsCmp ) :
 		elemsCmp( _elemsCmp ) { assert( elemsCmp != 0 ); }
-	virtual ~CPartialOrderPatternDescriptor()
-		{}
+	virtual ~CPartialOrderPatternDescriptor();
 
 	// Methods of IPatternDescriptor
 	virtual bool IsMostGeneral() const
@@ -9,11 +9,13 @@ struct CParams {
     DWORD MinStrLength;
     // Should cut a string an empty elements, e.g., after a projection.
     bool CutOnEmptySymbs;
+    // Should index strings for fast comparison.
+    bool UseIndex;
 
     CParams() :
-        MinStrLength( 0 ), CutOnEmptySymbs( true ) {}
-    CParams( DWORD minLength, bool cut ) :
-        MinStrLength( minLength ), CutOnEmptySymbs( cut ) {}
+        MinStrLength( 0 ), CutOnEmptySymbs( true ), UseIndex( false ) {}
+    CParams( DWORD minLength, bool cut, bool useIndex ) :
+        MinStrLength( minLength ), CutOnEmptySymbs( cut ), UseIndex( useIndex ) {}
 };
 
 void loadParams( const JSON& json, rapidjson::Document& params, CParams& result )
@@ -32,6 +34,9 @@ void loadParams( const JSON& json, rapidjson::Document& params, CParams& result
 	if( paramsObj.HasMember( "CutOnEmptySymbs") && paramsObj["CutOnEmptySymbs"].IsBool() ) {
         result.CutOnEmptySymbs = paramsObj["CutOnEmptySymbs"].GetBool();
 	}
+	if( paramsObj.HasMember( "UseIndex") && paramsObj["UseIndex"].IsBool() ) {
+        result.UseIndex = paramsObj["UseIndex"].GetBool();
+	}
 }
 
 void saveParams( const CParams& params, rapidjson::Document& doc )
@@ -41,7 +46,8 @@ void saveParams( const CParams& params, rapidjson::Document& doc )
 		.AddMember( "Type", PartialOrderElementsComparatorModuleType, alloc )
 		.AddMember( "Params", rapidjson::Value().SetObject()
 			.AddMember( "MinStrLength", rapidjson::Value().SetUint( params.MinStrLength ), alloc )
-			.AddMember( "CutOnEmptySymbs", rapidjson::Value().SetUint( params.CutOnEmptySymbs), alloc ),
+			.AddMember( "CutOnEmptySymbs", rapidjson::Value().SetUint( params.CutOnEmptySymbs), alloc )
+			.AddMember( "UseIndex", rapidjson::Value().SetBool( params.UseIndex ), alloc ),
 		alloc );
 }
 
@@ -57,6 +63,7 @@ void CDwordStringPartialOrderComparator::LoadParams( const JSON& json )
     loadParams( json, doc, params );
     SetMinStrLength( params.MinStrLength );
     SetCutOnEmptyElems( params.CutOnEmptySymbs );
+    SetUseIndex( params.UseIndex );
 
   	const rapidjson::Value& paramsObj = doc["Params"];
 	if( paramsObj.HasMember( "GeneralSymbol") && paramsObj["GeneralSymbol"].IsUint() ) {
@@ -67,7 +74,7 @@ JSON CDwordStringPartialOrderComparator::SaveParams() const
 {
     rapidjson::Document doc;
 	rapidjson::MemoryPoolAllocator<>& alloc = doc.GetAllocator();
-    saveParams( CParams( GetMinStrLength(), GetCutOnEmptyElems() ), doc );
+    saveParams( CParams( GetMinStrLength(), GetCutOnEmptyElems(), GetUseIndex() ), doc );
 
     doc.AddMember( "Name", DwordStringPartialOrderComparator, alloc );
     doc["Params"]
@@ -99,12 +106,13 @@ void CCharStringPartialOrderComparator::LoadParams( const JSON& json )
     loadParams( json, doc, params );
     SetMinStrLength( params.MinStrLength );
     SetCutOnEmptyElems( params.CutOnEmptySymbs );
+    SetUseIndex( params.UseIndex );
 }
 JSON CCharStringPartialOrderComparator::SaveParams() const
 {
     rapidjson::Document doc;
 	rapidjson::MemoryPoolAllocator<>& alloc = doc.GetAllocator();
-    saveParams( CParams( GetMinStrLength(), GetCutOnEmptyElems() ), doc );
+    saveParams( CParams( GetMinStrLength(), GetCutOnEmptyElems(), GetUseIndex() ), doc );
 
     doc.AddMember( "Name", CharStringPartialOrderComparator, alloc );
 
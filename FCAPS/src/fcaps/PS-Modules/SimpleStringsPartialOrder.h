@@ -10,6 +10,8 @@
 #include <fcaps/Module.h>
 #include <ModuleTools.h>
 
+#include <fcaps/PS-Modules/details/SuffixAutomaton.h>
+
 #include <vector>
 
 // For the implementation
@@ -20,6 +22,8 @@
 
 #include <rapidjson/document.h>
 
+#include <algorithm>
+
 ////////////////////////////////////////////////////////////////////
 
 const char DwordStringPartialOrderComparator[] = "DwordStringPartialOrderComparatorModule";
@@ -47,9 +51,15 @@ public:
 		{ return str; }
 	const CString& String() const
 		{ return str; }
+	// Index of substrings, built only in the indexed mode of the comparator
+	CSuffixAutomaton<TSymb>& Index()
+		{ return index; }
+	const CSuffixAutomaton<TSymb>& Index() const
+		{ return index; }
 
 private:
 	CString str;
+	CSuffixAutomaton<TSymb> index;
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -58,7 +68,7 @@ template <typename TSymb>
 class CStringsPartialOrderComparator : public IPartialOrderElementsComparator {
 public:
 	CStringsPartialOrderComparator() :
-		minStrLength( 1 ), cutOnEmptyElems( true ) {}
+		minStrLength( 1 ), cutOnEmptyElems( true ), useIndex( false ) {}
 
 	// Methods of IPartialOrderElementsComparator
 	virtual TPartialOrderType GetElementType() const
@@ -84,6 +94,12 @@ public:
 		{ return cutOnEmptyElems; }
 	void SetCutOnEmptyElems( bool value )
 		{ cutOnEmptyElems = value; }
+	// Set wether the elements should be indexed by suffix automata.
+	//  Works only if symbols are comparable just when they are equal.
+	bool GetUseIndex() const
+		{ return useIndex; }
+	void SetUseIndex( bool value )
+		{ useIndex = value; }
 
 protected:
     // Save/Load symbols to/from JSON
@@ -95,17 +111,34 @@ protected:
 	virtual TSymb CalculateSymbSimilarity( const TSymb& first, const TSymb& last ) const = 0;
 	// Check if the element is the most general one;
 	virtual bool IsMostGeneralSymb( const TSymb& el ) const = 0;
+	// Check if two symbols are comparable only when they are equal
+	virtual bool IsSymbOrderTrivial() const
+		{ return false; }
 
 private:
 	typedef typename CStringPartialOrderElement<TSymb>::CString CString;
+	// A run of non general similarities of two strings, the positions are given in the first string
+	struct CRun {
+		int Shift;
+		DWORD Begin;
+		DWORD End;
+
+		CRun( int shift, DWORD begin, DWORD end ) :
+			Shift( shift ), Begin( begin ), End( end ) {}
+		bool operator<( const CRun& other ) const
+			{ return Begin < other.Begin || ( Begin == other.Begin && End > other.End ); }
+	};
 
 
 private:
 	DWORD minStrLength;
 	bool cutOnEmptyElems;
+	bool useIndex;
 
+	bool isIndexed() const
+		{ return useIndex && IsSymbOrderTrivial(); }
 	void intersectStrings( const CString& str1, const CString& str2, int str2Shift, CString& result ) const;
-	void splitString( const CString& str, CList<CStringPartialOrderElement<TSymb>*>& parents ) const;
+	void findRuns( const CString& str1, const CString& str2, std::vector<CRun>& runs ) const;
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -124,6 +157,8 @@ protected:
 		{ if( first == last ) { return first; } else { return mostGeneralElem; } }
 	virtual bool IsMostGeneralSymb( const TSymb& el ) const
 		{ return el == mostGeneralElem; }
+	virtual bool IsSymbOrderTrivial() const
+		{ return true; }
 
     TSymb& MostGeneralElem()
         { return mostGeneralElem; }
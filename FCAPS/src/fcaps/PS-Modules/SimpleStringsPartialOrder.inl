@@ -42,7 +42,7 @@ void CStringsPartialOrderComparator<TSymb>::LoadElements( const JSON& json, CEle
         return;
 	}
 	// Loading elements
-	CList<const CStringPartialOrderElement<TSymb>*> result;
+	CList<CStringPartialOrderElement<TSymb>*> result;
 	std::unique_ptr< CStringPartialOrderElement<TSymb> > nexTSymb( new CStringPartialOrderElement<TSymb> );
 	for( size_t i = 0; i < patternJSON.Size(); ++i ) {
 		const TSymb& el = LoadSymb( patternJSON[i] );
@@ -64,9 +64,12 @@ void CStringsPartialOrderComparator<TSymb>::LoadElements( const JSON& json, CEle
     parts.Elements=new const IPartialOrderElement*[result.Size()];
     parts.Count=result.Size();
 
-    CStdIterator<typename CList<const CStringPartialOrderElement<TSymb>*>::CConstIterator, false> str( result );
+    CStdIterator<typename CList<CStringPartialOrderElement<TSymb>*>::CConstIterator, false> str( result );
     int i = 0;
     for(; !str.IsEnd(); ++str, ++i ) {
+        if( isIndexed() ) {
+            (*str)->Index().Build( (*str)->String() );
+        }
         parts.Elements[i] = *str;
     }
 }
@@ -93,11 +96,26 @@ void CStringsPartialOrderComparator<TSymb>::FindAllParents(
 
     CList<CStringPartialOrderElement<TSymb>*> tmpParents;
 
+	if( cutOnEmptyElems ) {
+		// The parents are the runs of non general similarities, so only they are allocated
+		std::vector<CRun> runs;
+		findRuns( str1, str2, runs );
+		for( size_t r = 0; r < runs.size(); ++r ) {
+			std::unique_ptr< CStringPartialOrderElement<TSymb> > newElem( new CStringPartialOrderElement<TSymb> );
+			CString& intersection = newElem->String();
+			intersection.reserve( runs[r].End - runs[r].Begin );
+			for( DWORD i = runs[r].Begin; i < runs[r].End; ++i ) {
+				intersection.push_back( CalculateSymbSimilarity( str1[i], str2[i - runs[r].Shift] ) );
+			}
+			tmpParents.PushBack( newElem.release() );
+		}
+	}
+
 	const int str1size = str1.size();
 	const int str2size = str2.size();
 	const int lastIntersection = str1size - minStrLength;
 	int j = -str2size + minStrLength;
-	for( ; j <= lastIntersection; ++j ) {
+	for( ; !cutOnEmptyElems && j <= lastIntersection; ++j ) {
 		std::unique_ptr< CStringPartialOrderElement<TSymb> > newElem( new CStringPartialOrderElement<TSymb> );
 		CString& intersection = newElem->String();
 		intersectStrings( str1, str2, j, intersection );
@@ -109,16 +127,15 @@ void CStringsPartialOrderComparator<TSymb>::FindAllParents(
 		if( intersection.size() < minStrLength ) {
 			continue;
 		}
-		if( !cutOnEmptyElems ) {
-			tmpParents.PushBack( newElem.release() );
-		} else {
-			splitString( intersection, tmpParents );
-		}
+		tmpParents.PushBack( newElem.release() );
 	}
 	parents.Count = tmpParents.Size();
 	parents.Elements = new const IPartialOrderElement*[parents.Count];
 	CStdIterator<typename CList<CStringPartialOrderElement<TSymb>*>::CConstIterator, false> p(tmpParents);
 	for( int i = 0; !p.IsEnd(); ++p, ++i ) {
+		if( isIndexed() ) {
+			(*p)->Index().Build( (*p)->String() );
+		}
         parents.Elements[i]=*p;
 	}
 }
@@ -171,6 +188,16 @@ TCompareResult CStringsPartialOrderComparator<TSymb>::Compare( DWORD interesting
 	}
 	const CString& small = isFirstSmaller ? str1 : str2;
 	const CString& big = isFirstSmaller ? str2 : str1;
+	if( isIndexed() ) {
+		const CSuffixAutomaton<TSymb>& index =
+			debug_cast<const CStringPartialOrderElement<TSymb>&>( isFirstSmaller ? *second : *first ).Index();
+		if( index.IsBuilt() ) {
+			if( !index.HasSubstring( small ) ) {
+				return CR_Incomparable;
+			}
+			return isFirstSmaller ? CR_MoreGeneral : CR_LessGeneral;
+		}
+	}
 	const DWORD sizeDiff = big.size() - small.size();
 	for( DWORD i = 0; i <= sizeDiff; ++i ) {
 		DWORD j = 0;
@@ -212,25 +239,46 @@ void CStringsPartialOrderComparator<TSymb>::intersectStrings(
 	result.resize( firstMostGeneral );
 }
 
+// Finds the runs of non general similarities of the strings for all the shifts of str2.
+//  In the indexed mode the runs inside other runs are removed.
 template<typename TSymb>
-void CStringsPartialOrderComparator<TSymb>::splitString( const CString& str,  CList<CStringPartialOrderElement<TSymb>*>& parents ) const
+void CStringsPartialOrderComparator<TSymb>::findRuns(
+	const CString& str1, const CString& str2, std::vector<CRun>& runs ) const
 {
-	CList<TSymb> tmpStr;
-	bool isFinish = false;
-	for( DWORD i = 0; !isFinish ; ++i ) {
-		isFinish = i >= str.size();
-		if( !isFinish && !IsMostGeneralSymb( str[i] ) ) {
-			tmpStr.PushBack( str[i] );
-		} else if( tmpStr.Size() >= minStrLength ) {
-			std::unique_ptr< CStringPartialOrderElement<TSymb> > next( new CStringPartialOrderElement<TSymb> );
-			next->String().reserve( tmpStr.Size() );
-			next->String().insert( next->String().begin(), tmpStr.Begin(), tmpStr.End() );
-			parents.PushBack( next.release() );
-			tmpStr.Clear();
-		} else {
-			tmpStr.Clear();
+	const int str1size = str1.size();
+	const int str2size = str2.size();
+	const int lastShift = str1size - static_cast<int>( minStrLength );
+	for( int j = static_cast<int>( minStrLength ) - str2size; j <= lastShift; ++j ) {
+		const DWORD startIndex = std::max( 0, j );
+		const DWORD endIndex = std::min( j + str2size, str1size );
+		DWORD runBegin = startIndex;
+		for( DWORD i = startIndex; i <= endIndex; ++i ) {
+			if( i < endIndex && !IsMostGeneralSymb( CalculateSymbSimilarity( str1[i], str2[i - j] ) ) ) {
+				continue;
+			}
+			if( i - runBegin >= minStrLength ) {
+				runs.push_back( CRun( j, runBegin, i ) );
+			}
+			runBegin = i + 1;
+		}
+	}
+
+	if( !isIndexed() ) {
+		return;
+	}
+	// With the trivial order of symbols a run is a substring of str1,
+	//  so a run inside another one in str1 is more general than the other and is not a parent.
+	std::sort( runs.begin(), runs.end() );
+	size_t last = 0;
+	DWORD maxEnd = 0;
+	for( size_t r = 0; r < runs.size(); ++r ) {
+		if( r == 0 || runs[r].End > maxEnd ) {
+			maxEnd = runs[r].End;
+			runs[last] = runs[r];
+			++last;
 		}
 	}
+	runs.erase( runs.begin() + last, runs.end() );
 }
 
 #undef DEBUG_INFO
@@ -11,7 +11,8 @@ using namespace boost;
 
 const CModuleRegistrar<CTaxonomyPatternManager> CTaxonomyPatternManager::registrar( PatternManagerModuleType, TaxonomyPatternManager );
 
-CTaxonomyPatternManager::CTaxonomyPatternManager()
+CTaxonomyPatternManager::CTaxonomyPatternManager() :
+	lcaCache( 0 )
 {
 	//ctor
 }
@@ -56,7 +57,7 @@ const CTaxonomyElementDescriptor* CTaxonomyPatternManager::CalculateSimilarity(
 	assert( lca != 0 );
 	const CTaxonomyElementDescriptor& frst = getTaxonomyElement( first );
 	const CTaxonomyElementDescriptor& scnd = getTaxonomyElement( second );
-	unique_ptr<CTaxonomyElementDescriptor> rslt( new CTaxonomyElementDescriptor( lca->GetParent( frst.id, scnd.id ) ) );
+	unique_ptr<CTaxonomyElementDescriptor> rslt( new CTaxonomyElementDescriptor( getLca( frst.id, scnd.id ) ) );
 	return rslt.release();
 }
 
@@ -70,7 +71,7 @@ TCompareResult CTaxonomyPatternManager::Compare(
 	if( frst.id == scnd.id ) {
 		return HasAllFlags( interestingResults, CR_Equal ) ? CR_Equal : CR_Incomparable;
 	}
-	const DWORD rslt = lca->GetParent( frst.id, scnd.id );
+	const DWORD rslt = getLca( frst.id, scnd.id );
 	if( rslt == frst.id ) {
 		return HasAllFlags( interestingResults, CR_MoreGeneral ) ? CR_MoreGeneral : CR_Incomparable;
 	}
@@ -102,10 +103,16 @@ void CTaxonomyPatternManager::LoadParams( const JSON& json )
 			"No 'TreePath' is found in <<\n" + json + "\n>>" );
 	}
 	pathToTree = params["Params"]["TreePath"].GetString();
+	size_t lcaCacheSize = 0;
+	if( params["Params"].HasMember( "LcaCacheSize" ) && params["Params"]["LcaCacheSize"].IsUint() ) {
+		lcaCacheSize = params["Params"]["LcaCacheSize"].GetUint();
+	}
+	lcaCache.SetCapacity( lcaCacheSize );
 
 	CTaxonomyJsonReader(tree, nameToIndexMap).ReadTree( pathToTree );
 	lca.reset( new CLcaAlgorithm<CTaxonomyJsonReader::CNodeInfo, DWORD>( tree ) );
 	lca->Initialize();
+	lcaCache.Clear();
 }
 
 JSON CTaxonomyPatternManager::SaveParams() const
@@ -118,12 +125,34 @@ JSON CTaxonomyPatternManager::SaveParams() const
 		.AddMember( "Params", rapidjson::Value().SetObject()
 			.AddMember( "TreePath", rapidjson::StringRef( pathToTree.c_str() ), alloc ),
 		alloc );
+	if( lcaCache.Capacity() > 0 ) {
+		// The statistics show if the cache pays off, they are ignored by LoadParams
+		params["Params"]
+			.AddMember( "LcaCacheSize", rapidjson::Value().SetUint( lcaCache.Capacity() ), alloc )
+			.AddMember( "LcaCacheHits", rapidjson::Value().SetUint64( lcaCache.Hits() ), alloc )
+			.AddMember( "LcaCacheMisses", rapidjson::Value().SetUint64( lcaCache.Misses() ), alloc );
+	}
 
 	JSON result;
 	CreateStringFromJSON( params, result );
 	return result;
 }
 
+// The LCA of two nodes, through the cache if it is switched on
+DWORD CTaxonomyPatternManager::getLca( DWORD first, DWORD second )
+{
+	if( first == second ) {
+		return first;
+	}
+	TIntentId result = -1;
+	if( lcaCache.Find( first, second, result ) ) {
+		return static_cast<DWORD>( result );
+	}
+	const DWORD parent = lca->GetParent( first, second );
+	lcaCache.Add( first, second, parent );
+	return parent;
+}
+
 inline const CTaxonomyElementDescriptor& CTaxonomyPatternManager::getTaxonomyElement( const IPatternDescriptor* ptrn )
 {
 	assert( ptrn != 0 && dynamic_cast<const CTaxonomyElementDescriptor*>(ptrn) != 0  );
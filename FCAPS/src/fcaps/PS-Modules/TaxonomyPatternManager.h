@@ -7,6 +7,7 @@
 #include <fcaps/Module.h>
 #include <ModuleTools.h>
 #include <fcaps/PS-Modules/details/TaxonomyJsonReader.h>
+#include <fcaps/storages/SimilarityCache.h>
 
 #include <Lca.h>
 
@@ -36,7 +37,7 @@ private:
 
 ////////////////////////////////////////////////////////////////////
 
-class CTaxonomyPatternManager : public IPatternManager, public IModule {
+class CTaxonomyPatternManager : public IPatternManager, public IConcurrentPatternManager, public IModule {
 public:
 	CTaxonomyPatternManager();
 
@@ -55,6 +56,18 @@ public:
 
 	virtual void Write( const IPatternDescriptor* ptrn, std::ostream& dst ) const;
 
+	// Methods of IConcurrentPatternManager
+	virtual bool IsThreadSafe() const
+		{ return true; }
+
+	// Methods of this class
+	// The memo of computed LCAs, off by default (capacity 0).
+	//  An LCA is a constant time RMQ query, so the cache pays off only if RMQ misses the CPU cache.
+	void SetLcaCacheCapacity( size_t capacity )
+		{ lcaCache.SetCapacity( capacity ); }
+	const CSimilarityCache& GetLcaCache() const
+		{ return lcaCache; }
+
 	// Methods of IModule
 	virtual void LoadParams( const JSON& );
 	virtual JSON SaveParams() const;
@@ -84,7 +97,10 @@ private:
 	CNameToIndexMap nameToIndexMap;
 	// Least common ancestor in a tree.
 	CPtrOwner< CLcaAlgorithm<CTaxonomyJsonReader::CNodeInfo, DWORD> > lca;
+	// The same pairs of elements are intersected many times during the mining, off by default
+	CSimilarityCache lcaCache;
 
+	DWORD getLca( DWORD first, DWORD second );
 	static const CTaxonomyElementDescriptor& getTaxonomyElement( const IPatternDescriptor* );
 	static std::string parseJsonString( const std::string& str );
 };
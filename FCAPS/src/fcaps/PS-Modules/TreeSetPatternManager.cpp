@@ -5,7 +5,7 @@
 #include <fcaps/PS-Modules/details/TaxonomyJsonReader.h>
 #include <JSONTools.h>
 
-#include <fcaps/SharedModulesLib/ParallelListIteration.inl> 
+#include <algorithm>
 
 using namespace std;
 using namespace boost;
@@ -29,6 +29,7 @@ const CModuleRegistrar<CTreeSetDescriptorsComparator> CTreeSetDescriptorsCompara
 	PatternManagerModuleType, TreeSetPatternManager );
 
 CTreeSetDescriptorsComparator::CTreeSetDescriptorsComparator() :
+	precomputeAncestors( false ),
 	maxDiff(-1)
 {
 }
@@ -59,58 +60,53 @@ const CTreeSetPatternDescriptor* CTreeSetDescriptorsComparator::CalculateSimilar
 #endif
 
 
-	const CTreeSetPatternDescriptor& first = getDescriptor( firstPattern );
-	const CTreeSetPatternDescriptor& second = getDescriptor( secondPattern );
-	CList<DWORD> resultIndexes;
+	const CTreeSetPatternDescriptor::CAttrsList& first = getDescriptor( firstPattern ).GetAttribs();
+	const CTreeSetPatternDescriptor::CAttrsList& second = getDescriptor( secondPattern ).GetAttribs();
+	unique_ptr<CTreeSetPatternDescriptor> patternRW( new CTreeSetPatternDescriptor );
+	CTreeSetPatternDescriptor::CAttrsList& resultIndexes = patternRW->GetAttribs();
+	resultIndexes.reserve( first.size() + second.size() );
 	const DWORD noPrevElement = 1 << 31;
 	DWORD last = noPrevElement;
 	bool isLastFromFirst = false;
 
-	// Find possible result antichain.
-	PARALLEL_LIST_ITERATION_BEGIN( CTreeSetPatternDescriptor::CAttrsList, CTreeSetPatternDescriptor::CAttrsList::CConstIterator,
-			first.GetAttribs(), second.GetAttribs(), firstItr, secondItr );
-		assert( last == noPrevElement || *firstItr >= last && *secondItr >= last );
-		if( *firstItr < *secondItr ) {
-			if( last == noPrevElement ) {
-				// Nothing yet to intersect with
-				last = *firstItr;
-			} else if( isLastFromFirst ) {
-				// Just renew,because there is no need to intersect with itself
-				last = *firstItr;
-			} else {
-				resultIndexes.PushBack( rmq->GetMinIndexOnRange( last, *firstItr ) );
-
-				last = *firstItr;
+	// Find possible result antichain, the LCA is taken only for the neighbours from different antichains.
+	size_t i = 0;
+	size_t j = 0;
+	while( i < first.size() && j < second.size() ) {
+		assert( last == noPrevElement || first[i] >= last && second[j] >= last );
+		if( first[i] < second[j] ) {
+			if( last != noPrevElement && !isLastFromFirst ) {
+				resultIndexes.push_back( getLca( last, first[i] ) );
 			}
+			last = first[i];
 			isLastFromFirst = true;
-		} else if( *firstItr > *secondItr ) {
-			if( last == noPrevElement ) {
-				// Nothing yet to intersect with
-				last = *secondItr;
-			} else if( !isLastFromFirst ) {
-				// Just renew,because there is no need to intersect with itself
-				last = *secondItr;
-			} else {
-				resultIndexes.PushBack( rmq->GetMinIndexOnRange( last, *secondItr ) );
-
-				last = *secondItr;
+			++i;
+		} else if( first[i] > second[j] ) {
+			if( last != noPrevElement && isLastFromFirst ) {
+				resultIndexes.push_back( getLca( last, second[j] ) );
 			}
+			last = second[j];
 			isLastFromFirst = false;
+			++j;
 		} else {
-			resultIndexes.PushBack( *firstItr );
+			resultIndexes.push_back( first[i] );
 			last = noPrevElement;
+			++i;
+			++j;
 		}
-	PARALLEL_LIST_ITERATION_END( firstItr, secondItr );
+	}
 
 	// Process the rest of the "longest" anti-chain
 	if( last != noPrevElement ) {
-		if( isLastFromFirst && secondItr != second.GetAttribs().End() ) {
-			resultIndexes.PushBack( rmq->GetMinIndexOnRange( last, *secondItr ) );
-		} else {
-			resultIndexes.PushBack( rmq->GetMinIndexOnRange( last, *firstItr ) );
+		if( isLastFromFirst && j < second.size() ) {
+			resultIndexes.push_back( getLca( last, second[j] ) );
+		} else if( !isLastFromFirst && i < first.size() ) {
+			resultIndexes.push_back( getLca( last, first[i] ) );
 		}
 	}
 
+	// The LCAs are not necessary in the order of the Euler tour
+	sort( resultIndexes.begin(), resultIndexes.end() );
 	filterAntichain( resultIndexes );
 
 // TOKILL?
@@ -119,10 +115,6 @@ const CTreeSetPatternDescriptor* CTreeSetDescriptorsComparator::CalculateSimilar
 //		projectIndexes( resultIndexes );
 //	}
 
-	// In resultIndexes now result antichain. We should create new pattern.
-	unique_ptr<CTreeSetPatternDescriptor> patternRW( new CTreeSetPatternDescriptor );
-	patternRW->AddList( resultIndexes );
-
 #ifdef DEBUG_CMP
 	// Debuging
 	cout << "Result:\n";
@@ -149,40 +141,38 @@ TCompareResult CTreeSetDescriptorsComparator::Compare(
 	cout << "\n";
 #endif
 
-	const CTreeSetPatternDescriptor& first = getDescriptor( firstPattern );
-	const CTreeSetPatternDescriptor& second = getDescriptor( secondPattern );
+	const CTreeSetPatternDescriptor::CAttrsList& first = getDescriptor( firstPattern ).GetAttribs();
+	const CTreeSetPatternDescriptor::CAttrsList& second = getDescriptor( secondPattern ).GetAttribs();
 
 	interestingResults &= possibleResults & CR_AllResults;
 
-	if( first.GetAttribs().Size() < second.GetAttribs().Size() ){
+	if( first.size() < second.size() ){
 		// Could not be equal.
 		interestingResults &= ~CR_Equal;
 		// Could not be less general because if it is less general then for every path from node to root can exist only one node in second
 		interestingResults &= ~CR_LessGeneral;
-	} else if( first.GetAttribs().Size() > second.GetAttribs().Size() ){
+	} else if( first.size() > second.size() ){
 		// Could not be equal.
 		interestingResults &= ~CR_Equal;
 		// Could not be less general because if it is less general then for every path from node to root can exist only one node in second
 		interestingResults &= ~CR_MoreGeneral;
 	}
 
-	PARALLEL_LIST_ITERATION_BEGIN( CTreeSetPatternDescriptor::CAttrsList, CTreeSetPatternDescriptor::CAttrsList::CConstIterator,
-			first.GetAttribs(), second.GetAttribs(), firstItr, secondItr );
-
+	size_t i = 0;
+	size_t j = 0;
+	while( i < first.size() && j < second.size() ) {
 		// Check the comparison between indices
 
-		TCompareResult result = compareIndexes( *firstItr, *secondItr );
-		while( firstItr != first.GetAttribs().End()
-			&& secondItr != second.GetAttribs().End()
-			&& result == CR_Equal )
-		{
-			++firstItr;
-			++secondItr;
-			result = compareIndexes( *firstItr, *secondItr );
+		TCompareResult result = compareIndexes( first[i], second[j] );
+		while( result == CR_Equal ) {
+			++i;
+			++j;
+			if( i == first.size() || j == second.size() ) {
+				break;
+			}
+			result = compareIndexes( first[i], second[j] );
 		}
-		if(firstItr == first.GetAttribs().End()
-			|| secondItr == second.GetAttribs().End())
-		{
+		if( i == first.size() || j == second.size() ) {
 			break;
 		}
 		changePossibleFlags( result, interestingResults );
@@ -190,7 +180,7 @@ TCompareResult CTreeSetDescriptorsComparator::Compare(
 			// The smallest is uncovered
 			//	i.e. 'the corresponding pattern' can be only uncovered
 			changePossibleFlags(
-				*firstItr < *secondItr ? CR_LessGeneral : CR_MoreGeneral, interestingResults );
+				first[i] < second[j] ? CR_LessGeneral : CR_MoreGeneral, interestingResults );
 		}
 		if( interestingResults == 0 ) {
 			debug_return(CR_Incomparable);
@@ -198,41 +188,50 @@ TCompareResult CTreeSetDescriptorsComparator::Compare(
 
 		// 'Eat' all second that should be more specific
 		while( result == CR_MoreGeneral ) {
-			++secondItr;
-			if( secondItr == second.GetAttribs().End() ) {
+			++j;
+			if( j == second.size() ) {
 				break;
 			}
-			result = compareIndexes( *firstItr, *secondItr );
+			result = compareIndexes( first[i], second[j] );
 			assert( result == CR_MoreGeneral
-				|| (result == CR_Incomparable && *firstItr < *secondItr ) );
+				|| (result == CR_Incomparable && first[i] < second[j] ) );
 		}
 
 		// 'Eat' all first that should be more specific
 		while( result == CR_LessGeneral ) {
-			++firstItr;
-			if( firstItr == first.GetAttribs().End() ) {
+			++i;
+			if( i == first.size() ) {
 				break;
 			}
-			result = compareIndexes( *firstItr, *secondItr );
+			result = compareIndexes( first[i], second[j] );
 			assert( result == CR_LessGeneral
-				|| result == CR_Incomparable && *firstItr > *secondItr );
+				|| result == CR_Incomparable && first[i] > second[j] );
 		}
 		// If we found 'END' it is done by one of the while,
 		//  i.e. the other element have been "eaten".
-		if( firstItr == first.GetAttribs().End() ) {
-			++secondItr;
+		if( i == first.size() ) {
+			++j;
 			break;
 		}
-		if( secondItr == second.GetAttribs().End() ) {
-			++firstItr;
+		if( j == second.size() ) {
+			++i;
 			break;
 		}
-	PARALLEL_LIST_ITERATION_END( firstItr, secondItr );
 
-	if( firstItr != first.GetAttribs().End() ) {
+		if( first[i] < second[j] ) {
+			++i;
+		} else if( first[i] > second[j] ) {
+			++j;
+		} else {
+			++i;
+			++j;
+		}
+	}
+
+	if( i < first.size() ) {
 		changePossibleFlags( CR_LessGeneral, interestingResults );
 	}
-	if( secondItr != second.GetAttribs().End() ) {
+	if( j < second.size() ) {
 		changePossibleFlags( CR_MoreGeneral, interestingResults );
 	}
 
@@ -259,15 +258,13 @@ TCompareResult CTreeSetDescriptorsComparator::Compare(
 void CTreeSetDescriptorsComparator::Write( const IPatternDescriptor* iPtrn, std::ostream& dst ) const
 {
 	const CTreeSetPatternDescriptor& ptrn = getDescriptor( iPtrn );
-	CStdIterator<CTreeSetPatternDescriptor::CAttrsList::CConstIterator, false> itr( ptrn.GetAttribs() );
+	const CTreeSetPatternDescriptor::CAttrsList& attribs = ptrn.GetAttribs();
 	dst << "{";
-	for( ; !itr.IsEnd();  ) {
-		dst << tree.GetNode( indexToNode[*itr] ).Data.ID;
-		++itr;
-		if( itr.IsEnd() ) {
-			break;
+	for( size_t i = 0; i < attribs.size(); ++i ) {
+		if( i > 0 ) {
+			dst << ",";
 		}
-		dst << ",";
+		dst << tree.GetNode( indexToNode[attribs[i]] ).Data.ID;
 	}
 	dst << "}";
 }
@@ -291,6 +288,9 @@ void CTreeSetDescriptorsComparator::LoadParams( const JSON& json )
 	if( params["Params"].HasMember("MaxWeightDifference") && params["Params"]["MaxWeightDifference"].IsUint() ) {
 		maxDiff = params["Params"]["MaxWeightDifference"].GetUint();
 	}
+	if( params["Params"].HasMember("PrecomputeAncestors") && params["Params"]["PrecomputeAncestors"].IsBool() ) {
+		precomputeAncestors = params["Params"]["PrecomputeAncestors"].GetBool();
+	}
 	CTaxonomyJsonReader( tree, nameToIndexMap ).ReadTree( pathToTree );
 	initMultiLca();
 }
@@ -302,7 +302,8 @@ JSON CTreeSetDescriptorsComparator::SaveParams() const
 		.AddMember( "Type", PatternManagerModuleType, alloc )
 		.AddMember( "Name", TreeSetPatternManager, alloc )
 		.AddMember( "Params", rapidjson::Value().SetObject()
-			.AddMember( "TreePath", rapidjson::StringRef( pathToTree.c_str() ), alloc ),
+			.AddMember( "TreePath", rapidjson::StringRef( pathToTree.c_str() ), alloc )
+			.AddMember( "PrecomputeAncestors", rapidjson::Value().SetBool( precomputeAncestors ), alloc ),
 		alloc );
 
 	if( maxDiff != -1 ) {
@@ -336,6 +337,8 @@ const CTreeSetPatternDescriptor* CTreeSetDescriptorsComparator::loadPattern( con
 	assert( names.IsArray() );
 
 	unique_ptr<CTreeSetPatternDescriptor> ptrn( new CTreeSetPatternDescriptor );
+	CTreeSetPatternDescriptor::CAttrsList& attribs = ptrn->GetAttribs();
+	attribs.reserve( names.Size() );
 	for( DWORD i = 0; i < names.Size(); ++i ) {
 		if( !names[i].IsString() ) {
 			throw new CTextException( "CTreeSetDescriptorsComparator::loadPattern", "A name in 'Names' is not a string" );
@@ -344,10 +347,11 @@ const CTreeSetPatternDescriptor* CTreeSetDescriptorsComparator::loadPattern( con
 		if( itr == nameToIndexMap.end() ) {
 			throw new CTextException( "CTreeSetDescriptorsComparator::loadPattern", string("The name '") + names[i].GetString() + "' is not found in the taxonomy" );
 		}
-		ptrn->AddNextAttribNumber( itr->second );
+		attribs.push_back( itr->second );
 	}
 
-	filterAntichain( ptrn->GetAttribs() );
+	sort( attribs.begin(), attribs.end() );
+	filterAntichain( attribs );
 
 	return ptrn.release();
 }
@@ -359,13 +363,13 @@ inline JSON CTreeSetDescriptorsComparator::savePattern( const IPatternDescriptor
 	rapidjson::Document doc;
 	rapidjson::MemoryPoolAllocator<>& alloc = doc.GetAllocator();
 	doc.SetObject();
-	doc.AddMember( "Count", rapidjson::Value().SetInt( ptrn.GetAttribs().Size() ), alloc )
+	const CTreeSetPatternDescriptor::CAttrsList& attribs = ptrn.GetAttribs();
+	doc.AddMember( "Count", rapidjson::Value().SetInt( attribs.size() ), alloc )
 		.AddMember( "Names", rapidjson::Value().SetArray(), alloc );
 
 	rapidjson::Value& arr = doc["Names"];
-	CStdIterator<CList<DWORD>::CConstIterator, false> itr( ptrn.GetAttribs() );
-	for( ; !itr.IsEnd(); ++itr ) {
-		arr.PushBack( rapidjson::Value().SetString( tree.GetNode( indexToNode[*itr] ).Data.ID.c_str(), alloc), alloc );
+	for( size_t i = 0; i < attribs.size(); ++i ) {
+		arr.PushBack( rapidjson::Value().SetString( tree.GetNode( indexToNode[attribs[i]] ).Data.ID.c_str(), alloc), alloc );
 	}
 
 	JSON result;
@@ -379,6 +383,18 @@ void CTreeSetDescriptorsComparator::initMultiLca()
 	const size_t size = tree.GetSize();
 	depthArray.resize( size * 2 - 1 );
 	indexToNode.resize( depthArray.size() );
+	nodeToIndex.assign( size, -1 );
+	intervalEnds.resize( depthArray.size() );
+	ancestors.clear();
+	ancestorOffsets.clear();
+	if( precomputeAncestors ) {
+		ancestorOffsets.resize( size );
+	}
+
+	// Last occurrence of a node in the Euler tour
+	vector<DWORD> lastIndex( size );
+	// The ancestors of the current node
+	vector<DWORD> path;
 
 	CDeepFirstStaticTreeIterator<CTaxonomyJsonReader::CNodeInfo> node( tree.GetRoot(), tree );
 	DWORD depth = -1;
@@ -389,97 +405,126 @@ void CTreeSetDescriptorsComparator::initMultiLca()
 		const CTree::TNodeIndex nodeIndex = *node;
 		assert( 0 <= nodeIndex );
 		indexToNode[index] = nodeIndex;
+		lastIndex[nodeIndex] = index;
 
 		if( node.IsForward() ) {
 			depth++;
 			// Save the only one index for every label in the tree
 			nameToIndexMap[tree.GetNode( nodeIndex ).Data.ID] = index;
+			nodeToIndex[nodeIndex] = index;
+			if( precomputeAncestors ) {
+				path.resize( depth );
+				path.push_back( index );
+				ancestorOffsets[nodeIndex] = ancestors.size();
+				ancestors.insert( ancestors.end(), path.begin(), path.end() );
+			}
 		} else {
 			depth--;
 		}
 
 		depthArray[index] = depth;
 	}
-	rmq.reset( new CRmqAlgorithmAuto<DWORD>( depthArray ) );
-	rmq->Initialize();
+	for( size_t i = 0; i < intervalEnds.size(); ++i ) {
+		intervalEnds[i] = lastIndex[indexToNode[i]];
+	}
+
+	if( precomputeAncestors ) {
+		rmq.reset();
+	} else {
+		rmq.reset( new CRmqAlgorithmAuto<DWORD>( depthArray ) );
+		rmq->Initialize();
+	}
 }
 
-// filters a set of attributes to form an antichain
-void CTreeSetDescriptorsComparator::filterAntichain( CList<DWORD>& chain ) const
+// filters a sorted set of attributes to form an antichain
+void CTreeSetDescriptorsComparator::filterAntichain( CTreeSetPatternDescriptor::CAttrsList& chain ) const
 {
-	// Filter antichain comparing neighbourhoods
-	CStdIterator<CList<DWORD>::CIterator, false> i( chain );
-	DWORD last = *i;
-	++i;
-	CStdIterator<CList<DWORD>::CIterator, false> itr;
-
-	for( ; !i.IsEnd(); ) {
-		assert( last <= *i );
-		const TCompareResult result = compareIndexes( last, *i );
-		itr = i;
-		++i;
-
-		switch( result ) {
+	if( chain.empty() ) {
+		return;
+	}
+	// Filter antichain comparing neighbourhoods,
+	//  the descendants of a node follow it in the Euler tour, so only the last kept attribute should be checked.
+	size_t last = 0;
+	for( size_t i = 1; i < chain.size(); ++i ) {
+		assert( chain[last] <= chain[i] );
+		switch( compareIndexes( chain[last], chain[i] ) ) {
 			case CR_Equal:
 				// We already have this one
-				chain.Erase( itr );
 				break;
 			case CR_MoreGeneral:
-				// Prev attrib is more general, so remove it
-				last = *itr;
-				--itr;
-				chain.Erase( itr );
+				// Prev attrib is more general, so replace it
+				chain[last] = chain[i];
 				break;
 			case CR_LessGeneral:
-				// This is more general, remove.
-				chain.Erase( itr );
+				// This is more general, skip.
 				break;
 			case CR_Incomparable:
 				// New candidate to antichain
-				last = *itr;
+				++last;
+				chain[last] = chain[i];
 				break;
 			default:
 				assert( false );
 		}
 	}
+	chain.resize( last + 1 );
 }
 
 // Compare to elements by their indexes.
+//  The first node is an ancestor of the second one if the Euler interval of the first contains the second.
 inline TCompareResult CTreeSetDescriptorsComparator::compareIndexes( DWORD first, DWORD second ) const
 {
-	if( indexToNode[first] == indexToNode[second] ) {
+	assert( nodeToIndex[indexToNode[first]] == first && nodeToIndex[indexToNode[second]] == second );
+	if( first == second ) {
 		return CR_Equal;
 	}
+	if( first < second ) {
+		return second <= intervalEnds[first] ? CR_MoreGeneral : CR_Incomparable;
+	}
+	return first <= intervalEnds[second] ? CR_LessGeneral : CR_Incomparable;
+}
 
-	const DWORD minIndex = first <= second ? rmq->GetMinIndexOnRange( first, second ) : rmq->GetMinIndexOnRange( second, first );
-	if( indexToNode[first] == indexToNode[minIndex] ) {
-		return CR_MoreGeneral;
+// Finds the index of the lowest common ancestor of two elements, first < second.
+DWORD CTreeSetDescriptorsComparator::getLca( DWORD first, DWORD second ) const
+{
+	assert( first < second );
+	if( !precomputeAncestors ) {
+		return nodeToIndex[indexToNode[rmq->GetMinIndexOnRange( first, second )]];
 	}
-	if( indexToNode[minIndex] == indexToNode[second] ) {
-		return CR_LessGeneral;
+
+	// The deepest ancestor of the first whose interval contains the second,
+	//  the intervals are nested along the path, so the binary search is possible.
+	const DWORD* path = &ancestors[ancestorOffsets[indexToNode[first]]];
+	DWORD lo = 0;
+	DWORD hi = depthArray[first] + 1;
+	while( hi - lo > 1 ) {
+		const DWORD mid = ( lo + hi ) / 2;
+		if( second <= intervalEnds[path[mid]] ) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
 	}
-	return CR_Incomparable;
+	return path[lo];
 }
 
 // Project indecis in such a way that diff in weight between any two indexes is smaller than maxDiff.
 // inds -- the in/out indecis
-void CTreeSetDescriptorsComparator::projectIndexes( CList<DWORD>& inds ) const
+void CTreeSetDescriptorsComparator::projectIndexes( CTreeSetPatternDescriptor::CAttrsList& inds ) const
 {
 	// Finds min weight value
 	DWORD minWeight = -1;
-	CStdIterator<CList<DWORD>::CIterator,false> i(inds);
-	for( ; !i.IsEnd(); ++i ) {
-		const DWORD weight = tree.GetNode( indexToNode[*i] ).Data.Weight;
+	for( size_t i = 0; i < inds.size(); ++i ) {
+		const DWORD weight = tree.GetNode( indexToNode[inds[i]] ).Data.Weight;
 		minWeight = min(minWeight, weight);
 	}
 
 	DWORD prevMinWeight = -1;
 	while( minWeight != prevMinWeight ) {
 		prevMinWeight = minWeight;
-		i.Reset(inds);
-		for( ; !i.IsEnd(); ++i ) {
-			*i = projectIndex( *i, minWeight + maxDiff );
-			minWeight = min( minWeight, tree.GetNode( indexToNode[*i] ).Data.Weight );
+		for( size_t i = 0; i < inds.size(); ++i ) {
+			inds[i] = projectIndex( inds[i], minWeight + maxDiff );
+			minWeight = min( minWeight, tree.GetNode( indexToNode[inds[i]] ).Data.Weight );
 		}
 	}
 }
@@ -495,7 +540,7 @@ DWORD CTreeSetDescriptorsComparator::projectIndex( DWORD ind, DWORD maxWeight )
 		assert( tree.GetNode(treeNode).Data.Weight >= tree.GetNode(parentNode).Data.Weight );
 		treeNode = parentNode;
 	}
-	return nameToIndexMap.at(tree.GetNode( treeNode ).Data.ID);
+	return nodeToIndex[treeNode];
 }
 
 // Correct flags for possible values of comparation
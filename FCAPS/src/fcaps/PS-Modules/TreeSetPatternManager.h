@@ -7,8 +7,6 @@
 #include <fcaps/Module.h>
 #include <ModuleTools.h>
 
-#include <fcaps/SharedModulesLib/BinarySetPatternManager.h> // Used for pattern
-
 #include <fcaps/PS-Modules/details/TaxonomyJsonReader.h>
 
 #include <StaticTree.h>
@@ -16,8 +14,11 @@
 
 #include <rapidjson/document.h>
 
+#include <boost/functional/hash.hpp>
 #include <boost/unordered_map.hpp>
 
+#include <vector>
+
 ////////////////////////////////////////////////////////////////////
 
 const char TreeSetPatternManager[] = "TreeSetPatternManagerModule";
@@ -29,38 +30,29 @@ class CTreeSetDescriptorsComparator;
 class CTreeSetPatternDescriptor : public IPatternDescriptor {
 	friend class CTreeSetDescriptorsComparator;
 public:
-	typedef CBinarySetPatternDescriptor::CAttrsList CAttrsList;
+	// The sorted indices of the first occurrences of the nodes in the Euler tour of the taxonomy
+	typedef std::vector<DWORD> CAttrsList;
 
 public:
 	CTreeSetPatternDescriptor() {}
 
 	//Methods of IPatternDescriptor
 	virtual bool IsMostGeneral() const
-		{ return data.IsMostGeneral(); /*TODO*/ }
+		{ return attribs.empty(); /*TODO*/ }
 	virtual size_t Hash() const
-		{ return data.Hash(); }
+		{ return boost::hash_range( attribs.begin(), attribs.end() ); }
 
 private:
-	CBinarySetPatternDescriptor data;
+	CAttrsList attribs;
 
 	CTreeSetPatternDescriptor( const CTreeSetPatternDescriptor& other ) :
-		data( other.data ) {}
+		attribs( other.attribs ) {}
 
 	// Methods of class
-	// Add attribute to the set.
-	void AddNextAttribNumber( DWORD attribNum )
-		{ data.AddNextAttribNumber( attribNum ); }
-	//  only in the case of sorted array.
-	void AddSortedNextAttribNumber( DWORD attribNum )
-		{ data.AddSortedNextAttribNumber( attribNum ); }
-	// Add a set of attributes to the set.
-	void AddList( const CAttrsList& listToAdd )
-		{ data.AddList( listToAdd ); }
-
 	const CAttrsList& GetAttribs() const
-		{ return data.GetAttribs(); }
+		{ return attribs; }
 	CAttrsList& GetAttribs()
-		{ return data.GetAttribs(); }
+		{ return attribs; }
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -117,6 +109,17 @@ private:
 	std::vector<DWORD> depthArray;
 
 	std::vector<DWORD> indexToNode;
+	// The index of the first occurrence of a node in the Euler tour
+	std::vector<DWORD> nodeToIndex;
+	// The index of the last occurrence in the Euler tour of the node at an index,
+	//  i.e. the descendants of a node are the nodes with the first index in [index, intervalEnds[index]]
+	std::vector<DWORD> intervalEnds;
+	// If the ancestors of every node are stored, the LCA is found by binary search instead of RMQ.
+	//  Needs depth * size memory, so it is worth only for shallow taxonomies.
+	bool precomputeAncestors;
+	// The indices of the ancestors from the root to the node, ancestorOffsets gives the start for a node
+	std::vector<DWORD> ancestors;
+	std::vector<DWORD> ancestorOffsets;
 
 	// Max diff in a description between different elements
 	DWORD maxDiff;
@@ -130,9 +133,10 @@ private:
 
 	void initMultiLca();
 
-	void filterAntichain( CList<DWORD>& chain ) const;
+	void filterAntichain( CTreeSetPatternDescriptor::CAttrsList& chain ) const;
 	TCompareResult compareIndexes( DWORD first, DWORD second ) const;
-	void projectIndexes( CList<DWORD>& inds ) const;
+	DWORD getLca( DWORD first, DWORD second ) const;
+	void projectIndexes( CTreeSetPatternDescriptor::CAttrsList& inds ) const;
 	DWORD projectIndex( DWORD ind, DWORD maxWeight ) const;
 	static void changePossibleFlags( TCompareResult attrsPairCmp, DWORD& possibleFlag );
 };
@@ -0,0 +1,245 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include <fcaps/PS-Modules/VectorIntervalPatternManager.h>
+
+#include <fcaps/SharedModulesLib/details/JsonIntervalPattern.h>
+
+#include <Exception.h>
+#include <StdTools.h>
+#include <JSONTools.h>
+
+#include <rapidjson/document.h>
+
+#include <boost/functional/hash.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+// The number of doubles processed by one instruction
+#ifdef USE_SSE2
+static const DWORD LanesCount = 2;
+#else
+static const DWORD LanesCount = 1;
+#endif
+
+CVectorIntervalPatternDescriptor::CVectorIntervalPatternDescriptor( DWORD _intsCount ) :
+	intsCount( _intsCount ),
+	paddedCount( ( _intsCount + Alignment / sizeof( double ) - 1 ) / ( Alignment / sizeof( double ) ) * ( Alignment / sizeof( double ) ) ),
+	bounds( 2 * paddedCount + ( paddedCount == 0 ? 1 : 0 ), 0 )
+{
+}
+
+size_t CVectorIntervalPatternDescriptor::Hash() const
+{
+	size_t hashVal = 0;
+	boost::hash<double> doubleHash;
+	const double* lo = Lo();
+	const double* hi = Hi();
+	for( DWORD i = 0; i < intsCount; ++i ) {
+		boost::hash_combine( hashVal, doubleHash( lo[i] ) );
+		boost::hash_combine( hashVal, doubleHash( hi[i] ) );
+	}
+	return hashVal;
+}
+
+////////////////////////////////////////////////////////////////////
+
+const CModuleRegistrar<CVectorIntervalPatternManager> CVectorIntervalPatternManager::registrar(
+	PatternManagerModuleType, VectorIntervalPatternManagerModule );
+
+CVectorIntervalPatternManager::CVectorIntervalPatternManager() :
+	intsCount(-1)
+{
+	//ctor
+}
+
+const CVectorIntervalPatternDescriptor* CVectorIntervalPatternManager::LoadObject( const JSON& json )
+{
+	return loadPattern( json );
+}
+JSON CVectorIntervalPatternManager::SavePattern( const IPatternDescriptor* p ) const
+{
+	const CVectorIntervalPatternDescriptor& ptrn = getPattern( p );
+	JsonIntervalPattern::CPattern ints( ptrn.Size() );
+	for( DWORD i = 0; i < ptrn.Size(); ++i ) {
+		ints[i].first = ptrn.Lo()[i];
+		ints[i].second = ptrn.Hi()[i];
+	}
+	return JsonIntervalPattern::SavePattern( ints );
+}
+const CVectorIntervalPatternDescriptor* CVectorIntervalPatternManager::LoadPattern( const JSON& json )
+{
+	return loadPattern( json );
+}
+
+const CVectorIntervalPatternDescriptor* CVectorIntervalPatternManager::CalculateSimilarity(
+	const IPatternDescriptor* first, const IPatternDescriptor* second )
+{
+	const CVectorIntervalPatternDescriptor& p1 = getPattern(first);
+	const CVectorIntervalPatternDescriptor& p2 = getPattern(second);
+	assert( p1.Size() == p2.Size() );
+	unique_ptr<CVectorIntervalPatternDescriptor> res( new CVectorIntervalPatternDescriptor( p1.Size() ) );
+
+	const double* lo1 = p1.Lo();
+	const double* lo2 = p2.Lo();
+	const double* hi1 = p1.Hi();
+	const double* hi2 = p2.Hi();
+	double* lo = res->Lo();
+	double* hi = res->Hi();
+	// The padding intervals are the same in all patterns, so they are processed as usual
+	const DWORD size = p1.PaddedSize();
+#ifdef USE_SSE2
+	for( DWORD i = 0; i < size; i += LanesCount ) {
+		_mm_store_pd( lo + i, _mm_min_pd( _mm_load_pd( lo1 + i ), _mm_load_pd( lo2 + i ) ) );
+		_mm_store_pd( hi + i, _mm_max_pd( _mm_load_pd( hi1 + i ), _mm_load_pd( hi2 + i ) ) );
+	}
+#else
+	for( DWORD i = 0; i < size; ++i ) {
+		lo[i] = min( lo1[i], lo2[i] );
+		hi[i] = max( hi1[i], hi2[i] );
+	}
+#endif
+	return res.release();
+}
+
+// Removes the results that are impossible if the first pattern is wider (narrower) somewhere
+static inline DWORD getReachableResults( DWORD results, bool isWider, bool isNarrower )
+{
+	if( isWider ) {
+		results &= ~( CR_Equal | CR_LessGeneral );
+	}
+	if( isNarrower ) {
+		results &= ~( CR_Equal | CR_MoreGeneral );
+	}
+	return results;
+}
+
+TCompareResult CVectorIntervalPatternManager::Compare(
+	const IPatternDescriptor* first, const IPatternDescriptor* second,
+	DWORD interestingResults, DWORD possibleResults )
+{
+	possibleResults &= interestingResults | CR_Incomparable;
+
+	const CVectorIntervalPatternDescriptor& p1 = getPattern(first);
+	const CVectorIntervalPatternDescriptor& p2 = getPattern(second);
+	assert( p1.Size() == p2.Size() );
+
+	const double* lo1 = p1.Lo();
+	const double* lo2 = p2.Lo();
+	const double* hi1 = p1.Hi();
+	const double* hi2 = p2.Hi();
+	const DWORD size = p1.PaddedSize();
+	// If the first pattern is wider (narrower) somewhere
+	bool isWider = false;
+	bool isNarrower = false;
+	// The interesting results that are still possible, the patterns are incomparable once none is left
+	DWORD results = possibleResults & CR_AllResults;
+	if( results == 0 ) {
+		return CR_Incomparable;
+	}
+#ifdef USE_SSE2
+	for( DWORD i = 0; i < size; i += LanesCount ) {
+		const __m128d l1 = _mm_load_pd( lo1 + i );
+		const __m128d l2 = _mm_load_pd( lo2 + i );
+		const __m128d h1 = _mm_load_pd( hi1 + i );
+		const __m128d h2 = _mm_load_pd( hi2 + i );
+		isWider |= _mm_movemask_pd( _mm_or_pd( _mm_cmplt_pd( l1, l2 ), _mm_cmpgt_pd( h1, h2 ) ) ) != 0;
+		isNarrower |= _mm_movemask_pd( _mm_or_pd( _mm_cmpgt_pd( l1, l2 ), _mm_cmplt_pd( h1, h2 ) ) ) != 0;
+		results = getReachableResults( results, isWider, isNarrower );
+		if( results == 0 ) {
+			return CR_Incomparable;
+		}
+	}
+#else
+	for( DWORD i = 0; i < size; ++i ) {
+		isWider |= lo1[i] < lo2[i] || hi1[i] > hi2[i];
+		isNarrower |= lo1[i] > lo2[i] || hi1[i] < hi2[i];
+		results = getReachableResults( results, isWider, isNarrower );
+		if( results == 0 ) {
+			return CR_Incomparable;
+		}
+	}
+#endif
+
+	if( !isWider && !isNarrower ) {
+		return HasAllFlags( results, CR_Equal ) ? CR_Equal : CR_Incomparable;
+	}
+	if( isWider ) {
+		return HasAllFlags( results, CR_MoreGeneral ) ? CR_MoreGeneral : CR_Incomparable;
+	}
+	assert( isNarrower );
+	return HasAllFlags( results, CR_LessGeneral ) ? CR_LessGeneral : CR_Incomparable;
+}
+
+void CVectorIntervalPatternManager::FreePattern( const IPatternDescriptor * p )
+{
+	delete p;
+}
+
+void CVectorIntervalPatternManager::Write( const IPatternDescriptor* pattern, std::ostream& dst ) const
+{
+	dst << SavePattern( pattern );
+}
+
+void CVectorIntervalPatternManager::LoadParams( const JSON& json )
+{
+	CJsonError errorText;
+	rapidjson::Document params;
+	if( !ReadJsonString( json, params, errorText ) ) {
+		throw new CJsonException( "CVectorIntervalPatternManager::LoadParams", errorText );
+	}
+	assert( string( params["Type"].GetString() ) == PatternManagerModuleType );
+	assert( string( params["Name"].GetString() ) == VectorIntervalPatternManagerModule );
+	if( !(params.HasMember( "Params" ) && params["Params"].IsObject()) ) {
+		return;
+	}
+	const rapidjson::Value& paramsObj = params["Params"];
+	if( paramsObj.HasMember( "IntervalsCount" ) && paramsObj["IntervalsCount"].IsUint() ) {
+		intsCount = paramsObj["IntervalsCount"].GetUint();
+	}
+}
+JSON CVectorIntervalPatternManager::SaveParams() const
+{
+	rapidjson::Document params;
+	rapidjson::MemoryPoolAllocator<>& alloc = params.GetAllocator();
+	params.SetObject()
+		.AddMember( "Type", PatternManagerModuleType, alloc )
+		.AddMember( "Name", VectorIntervalPatternManagerModule, alloc )
+		.AddMember( "Params", rapidjson::Value().SetObject()
+			.AddMember( "IntervalsCount", rapidjson::Value().SetUint( intsCount ), alloc ),
+		alloc );
+
+	JSON result;
+	CreateStringFromJSON( params, result );
+	return result;
+}
+
+const CVectorIntervalPatternDescriptor* CVectorIntervalPatternManager::loadPattern( const JSON& json )
+{
+	JsonIntervalPattern::CPattern ints;
+	JsonIntervalPattern::LoadPattern( json, ints );
+	if( intsCount == -1 ) {
+		intsCount = ints.size();
+	} else if( intsCount != ints.size() ) {
+		throw new CTextException( "CVectorIntervalPatternManager::LoadObject", "Number of intervals in a pattern is different from " + StdExt::to_string(intsCount) );
+	}
+
+	unique_ptr<CVectorIntervalPatternDescriptor> ptrn( new CVectorIntervalPatternDescriptor( intsCount ) );
+	for( DWORD i = 0; i < ints.size(); ++i ) {
+		ptrn->Lo()[i] = ints[i].first;
+		ptrn->Hi()[i] = ints[i].second;
+	}
+	return ptrn.release();
+}
+
+const CVectorIntervalPatternDescriptor& CVectorIntervalPatternManager::getPattern( const IPatternDescriptor* p )
+{
+	assert( p != 0 && dynamic_cast<const CVectorIntervalPatternDescriptor*>(p) != 0  );
+	return debug_cast<const CVectorIntervalPatternDescriptor&>(*p);
+}
@@ -0,0 +1,111 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Interval patterns stored as two aligned arrays of lower and upper bounds (structure of arrays).
+//  Similarity and comparison process several intervals per instruction.
+//  The patterns are read and written in the same format as by IntervalPatternManagerModule.
+
+#ifndef CVECTORINTERVALPATTERNMANAGER_H
+#define CVECTORINTERVALPATTERNMANAGER_H
+
+#include <fcaps/PatternManager.h>
+#include <fcaps/Module.h>
+#include <ModuleTools.h>
+
+#include <boost/align/aligned_allocator.hpp>
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+
+const char VectorIntervalPatternManagerModule[] = "VectorIntervalPatternManagerModule";
+
+////////////////////////////////////////////////////////////////////
+
+class CVectorIntervalPatternDescriptor : public IPatternDescriptor {
+public:
+	// The bounds are aligned for vector instructions
+	static const DWORD Alignment = 32;
+	typedef std::vector<double, boost::alignment::aligned_allocator<double, Alignment> > CBounds;
+
+public:
+	// intsCount -- the number of intervals, the arrays are padded to the alignment by zero intervals
+	explicit CVectorIntervalPatternDescriptor( DWORD intsCount );
+
+	// Methods of IPatternDescriptor
+	virtual bool IsMostGeneral() const
+		{return false;}
+	virtual size_t Hash() const;
+
+	DWORD Size() const
+		{ return intsCount; }
+	// The number of bounds in Lo (Hi) with the padding
+	DWORD PaddedSize() const
+		{ return paddedCount; }
+
+	double* Lo()
+		{ return &bounds[0]; }
+	const double* Lo() const
+		{ return &bounds[0]; }
+	double* Hi()
+		{ return &bounds[paddedCount]; }
+	const double* Hi() const
+		{ return &bounds[paddedCount]; }
+
+private:
+	const DWORD intsCount;
+	const DWORD paddedCount;
+	// Lower bounds followed by upper bounds
+	CBounds bounds;
+};
+
+////////////////////////////////////////////////////////////////////
+
+class CVectorIntervalPatternManager : public IPatternManager, public IConcurrentPatternManager, public IModule {
+public:
+	CVectorIntervalPatternManager();
+
+	virtual const CVectorIntervalPatternDescriptor* LoadObject( const JSON& );
+	virtual JSON SavePattern( const IPatternDescriptor* ) const;
+	virtual const CVectorIntervalPatternDescriptor* LoadPattern( const JSON& );
+
+	virtual const CVectorIntervalPatternDescriptor* CalculateSimilarity(
+		const IPatternDescriptor* first, const IPatternDescriptor* second );
+	virtual TCompareResult Compare(
+		const IPatternDescriptor* first, const IPatternDescriptor* second,
+		DWORD interestingResults = CR_AllResults, DWORD possibleResults = CR_AllResults | CR_Incomparable );
+
+	virtual void FreePattern( const IPatternDescriptor * );
+
+	virtual void Write( const IPatternDescriptor* pattern, std::ostream& dst ) const;
+
+	// Methods of IConcurrentPatternManager
+	virtual bool IsThreadSafe() const
+		{ return true; }
+
+	// Methods of IModule
+	virtual void LoadParams( const JSON& );
+	virtual JSON SaveParams() const;
+	virtual const char* const GetType() const
+		{ return Type(); };
+	virtual const char* const GetName() const
+		{ return Name(); };
+	// For CModuleRegistrar
+	static const char* const Type()
+		{ return PatternManagerModuleType;}
+	static const char* const Name()
+		{ return VectorIntervalPatternManagerModule; }
+	static const char* const Desc()
+		{ return "{}"; }
+
+private:
+	static const CModuleRegistrar<CVectorIntervalPatternManager> registrar;
+
+	// Number of intervals in patterns;
+	DWORD intsCount;
+
+	const CVectorIntervalPatternDescriptor* loadPattern( const JSON& json );
+	static const CVectorIntervalPatternDescriptor& getPattern( const IPatternDescriptor* p );
+};
+
+#endif // CVECTORINTERVALPATTERNMANAGER_H
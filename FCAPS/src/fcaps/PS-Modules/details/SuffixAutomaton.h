@@ -0,0 +1,142 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Suffix automaton of a string. It checks if a string is a substring of the indexed one
+//  in the time linear in the length of the checked string.
+//  The transitions of a state are kept in a list within one array, since the alphabet of a state is usually small.
+
+#ifndef SUFFIXAUTOMATON_H
+#define SUFFIXAUTOMATON_H
+
+#include <common.h>
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+
+template<typename TSymb>
+class CSuffixAutomaton {
+public:
+	// Builds the automaton for the string, the previous one is forgotten
+	void Build( const std::vector<TSymb>& str );
+	void Clear()
+		{ states.clear(); transitions.clear(); }
+	bool IsBuilt() const
+		{ return !states.empty(); }
+
+	// Checks if the string is a substring of the indexed one
+	bool HasSubstring( const std::vector<TSymb>& str ) const;
+
+private:
+	static const DWORD None = static_cast<DWORD>( -1 );
+
+	struct CState {
+		// The length of the longest string in the state
+		DWORD Length;
+		// Suffix link
+		DWORD Link;
+		// The head of the list of transitions
+		DWORD FirstTransition;
+
+		CState( DWORD length = 0, DWORD link = None ) :
+			Length( length ), Link( link ), FirstTransition( None ) {}
+	};
+	struct CTransition {
+		TSymb Symb;
+		DWORD Target;
+		DWORD Next;
+	};
+
+	std::vector<CState> states;
+	std::vector<CTransition> transitions;
+
+	DWORD findTransition( DWORD state, const TSymb& symb ) const;
+	void addTransition( DWORD state, const TSymb& symb, DWORD target );
+};
+
+////////////////////////////////////////////////////////////////////
+
+template<typename TSymb>
+void CSuffixAutomaton<TSymb>::Build( const std::vector<TSymb>& str )
+{
+	Clear();
+	states.reserve( 2 * str.size() + 1 );
+	transitions.reserve( 3 * str.size() );
+	states.push_back( CState() );
+
+	DWORD last = 0;
+	for( size_t i = 0; i < str.size(); ++i ) {
+		const TSymb& symb = str[i];
+		const DWORD cur = states.size();
+		states.push_back( CState( states[last].Length + 1 ) );
+
+		DWORD p = last;
+		for( ; p != None && findTransition( p, symb ) == None; p = states[p].Link ) {
+			addTransition( p, symb, cur );
+		}
+		if( p == None ) {
+			states[cur].Link = 0;
+		} else {
+			const DWORD q = transitions[findTransition( p, symb )].Target;
+			if( states[p].Length + 1 == states[q].Length ) {
+				states[cur].Link = q;
+			} else {
+				// q is split, the clone gets the shorter strings
+				const DWORD clone = states.size();
+				states.push_back( CState( states[p].Length + 1, states[q].Link ) );
+				for( DWORD t = states[q].FirstTransition; t != None; t = transitions[t].Next ) {
+					const TSymb cloneSymb = transitions[t].Symb;
+					addTransition( clone, cloneSymb, transitions[t].Target );
+				}
+				for( ; p != None; p = states[p].Link ) {
+					const DWORD t = findTransition( p, symb );
+					if( t == None || transitions[t].Target != q ) {
+						break;
+					}
+					transitions[t].Target = clone;
+				}
+				states[q].Link = clone;
+				states[cur].Link = clone;
+			}
+		}
+		last = cur;
+	}
+}
+
+template<typename TSymb>
+bool CSuffixAutomaton<TSymb>::HasSubstring( const std::vector<TSymb>& str ) const
+{
+	assert( IsBuilt() );
+	DWORD state = 0;
+	for( size_t i = 0; i < str.size(); ++i ) {
+		const DWORD t = findTransition( state, str[i] );
+		if( t == None ) {
+			return false;
+		}
+		state = transitions[t].Target;
+	}
+	return true;
+}
+
+// Returns the index of the transition by the symbol or None
+template<typename TSymb>
+inline DWORD CSuffixAutomaton<TSymb>::findTransition( DWORD state, const TSymb& symb ) const
+{
+	DWORD t = states[state].FirstTransition;
+	for( ; t != None && !( transitions[t].Symb == symb ); t = transitions[t].Next ) {
+	}
+	return t;
+}
+
+template<typename TSymb>
+inline void CSuffixAutomaton<TSymb>::addTransition( DWORD state, const TSymb& symb, DWORD target )
+{
+	CTransition transition;
+	transition.Symb = symb;
+	transition.Target = target;
+	transition.Next = states[state].FirstTransition;
+	states[state].FirstTransition = transitions.size();
+	transitions.push_back( transition );
+}
+
+#endif // SUFFIXAUTOMATON_H
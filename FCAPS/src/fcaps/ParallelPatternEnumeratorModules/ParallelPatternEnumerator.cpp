@@ -16,6 +16,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
+#include <algorithm>
 #include <sstream>
 
 //#define DEBUG_OUTPUT
@@ -39,30 +40,64 @@ using namespace boost;
 ////////////////////////////////////////////////////////////////////////
 
 struct CParallelPatternEnumerator::CSyncData{
-	// A mutex to ensure run of only one thread.
+	// A slot of the ring
+	struct CSlot {
+		CPatternImage Image;
+		// Was the pattern expanded before its usage is known
+		bool IsSpeculative;
+	};
+
+	// A mutex protecting all the data below.
 	boost::mutex Access;
-	// Thread is active when new graph arrives.
+	// Consumer is active when new pattern arrives.
 	boost::condition_variable HasNewPattern;
-	// Thread is active when new graph is requested
-	boost::condition_variable NewPatternRequested;
+	// ALGO is active when a pattern is taken or its usage is known
+	boost::condition_variable HasDecision;
 
 	// DATA
-	enum TDataState{
-		DS_Ready = 0,
-		DS_InPreparation,
-		DS_End,
-
-		DS_EnumCount
-	} DataState;
-	bool IsPatternRequested;
-
-	// The curr graph pattern
-	CPatternImage PatternImage;
-	// Was the found graph usefull
-	TCurrentPatternUsage currPatternUsage;
+	// The ring of reported patterns that are not taken yet
+	std::vector<CSlot> Ring;
+	DWORD Head;
+	DWORD Count;
+	// The number of reported patterns and the number of patterns with known usage
+	DWORD Reported;
+	DWORD Decided;
+	// The usage of the last decided pattern
+	TCurrentPatternUsage LastUsage;
+	// ALGO drops patterns deeper than SkipDepth, they are descendants of a rejected pattern
+	int SkipDepth;
+	bool IsEnd;
+
+	// The pattern taken by the consumer and waiting for its usage
+	bool HasCurrent;
+	CSlot Current;
+
+	// Buffers of objects, the first element of a buffer is its capacity
+	std::vector<int*> Pool;
 
 	CSyncData() :
-		DataState( DS_InPreparation ), IsPatternRequested( false ), currPatternUsage( CPU_EnumCount ) {}
+		Head( 0 ), Count( 0 ), Reported( 0 ), Decided( 0 ), LastUsage( CPU_EnumCount ),
+		SkipDepth( -1 ), IsEnd( false ), HasCurrent( false ) {}
+	~CSyncData()
+	{
+		for( DWORD i = 0; i < Count; ++i ) {
+			freeBuffer( Ring[( Head + i ) % Ring.size()].Image.Objects );
+		}
+		for( DWORD i = 0; i < Pool.size(); ++i ) {
+			delete[] Pool[i];
+		}
+	}
+
+	static int* NewBuffer( int size )
+	{
+		int* buffer = new int[size + 1];
+		buffer[0] = size;
+		return buffer;
+	}
+	static int* GetBuffer( const int* objects )
+		{ return const_cast<int*>( objects ) - 1; }
+	static void freeBuffer( const int* objects )
+		{ if( objects != 0 ) { delete[] GetBuffer( objects ); } }
 };
 
 ////////////////////////////////////////////////////////////////////////
@@ -71,7 +106,8 @@ CModuleRegistrar<CParallelPatternEnumerator> CParallelPatternEnumerator::regista
 
 CParallelPatternEnumerator::CParallelPatternEnumerator() :
 	syncData( new CSyncData ),
-	isAlgoRun( false )
+	isAlgoRun( false ),
+	lookahead( 16 )
 {
     //ctor
 }
@@ -91,7 +127,10 @@ TNextPatternStatut CParallelPatternEnumerator::GetNextPattern( TCurrentPatternUs
 }
 void CParallelPatternEnumerator::ClearMemory( CPatternImage& pattern )
 {
-	delete[] pattern.Objects;
+	if( pattern.Objects != 0 ) {
+		boost::unique_lock<boost::mutex> lock( syncData->Access );
+		releaseBuffer( pattern.Objects );
+	}
 	pattern.Objects=0;
 	pattern.ImageSize=0;
 }
@@ -126,6 +165,10 @@ void CParallelPatternEnumerator::LoadParams( const JSON& json )
 		}
 		throw new CTextException( "CParallelPatternEnumerator::LoadParams", destStr.str() );
 	}
+
+	if( params["Params"].HasMember( "Lookahead" ) && params["Params"]["Lookahead"].IsUint() ) {
+		lookahead = params["Params"]["Lookahead"].GetUint();
+	}
 }
 
 JSON CParallelPatternEnumerator::SaveParams() const
@@ -135,7 +178,8 @@ JSON CParallelPatternEnumerator::SaveParams() const
 	params.SetObject()
 		.AddMember( "Type", PatternEnumeratorModuleType, alloc )
 		.AddMember( "Name", ParallelPatternEnumeratorModule, alloc )
-		.AddMember( "Params", rapidjson::Value().SetObject(), alloc );
+		.AddMember( "Params", rapidjson::Value().SetObject()
+			.AddMember( "Lookahead", rapidjson::Value().SetUint( lookahead ), alloc ), alloc );
 
     const IModule& module = dynamic_cast<const IModule&>( *peByCallback );
     rapidjson::Document internalParams;
@@ -151,21 +195,8 @@ void CParallelPatternEnumerator::RunAlgoThread()
 {
 	assert(syncData != 0);
 	assert(peByCallback != 0);
-    {
-        // It should be unlocked before running the Algo in order to lock it later in callback when we are going to report a graph
-        boost::unique_lock<boost::mutex> lock( syncData->Access );
-        COUT << "(!) ALGO: Waiting until first pattern requested\n";
-
-        // Waiting until the first pattern is requested
-        while(!syncData->IsPatternRequested) {
-            syncData->NewPatternRequested.wait(lock);
-        }
-        syncData->IsPatternRequested = false;
-
-        // We are not accessing syncData now
-    }
 
-	// Just run the ALGO
+	// Just run the ALGO, it is not waiting for the first request.
 	COUT << "(!) ALGO: Starting\n";
 	peByCallback->Run(&callback,this);
 
@@ -173,7 +204,7 @@ void CParallelPatternEnumerator::RunAlgoThread()
         // But now we need a new access to syncData.
         boost::unique_lock<boost::mutex> lock( syncData->Access );
 
-        syncData->DataState = CSyncData::DS_End;
+        syncData->IsEnd = true;
         syncData->HasNewPattern.notify_one();
     }
 }
@@ -200,73 +231,132 @@ private:
 void CParallelPatternEnumerator::createAlgoThread()
 {
 	COUT << "(!) Starting ALGO thread\n";
+	syncData->Ring.resize( max<DWORD>( lookahead, 1 ) );
 	boost::thread( CThreadStarter( *this ) );
 }
 // Registers a graph found by the ALGO.
+//  If the depth of the pattern is known, the pattern is expanded speculatively
+//  and ALGO goes on while there are less than lookahead patterns with unknown usage.
 bool CParallelPatternEnumerator::registerPattern( const CPatternImage& ptrn )
 {
 	COUT << "(!) ALGO: callback entry for a pattern " << ptrn.PatternId << "\n";
-
-	boost::unique_lock<boost::mutex> lock( syncData->Access );
-	//Updating currPatternNumber
-	syncData->PatternImage.PatternId = ptrn.PatternId;
-	COUT << "(!) ALGO: Registering a pattern " << syncData->PatternImage.PatternId << "\n";
-
-
-	// Updating pattern info
-	CPatternImage& pi = syncData->PatternImage;
-	if( pi.ImageSize > 0 ) {
-		delete[] pi.Objects;
+	CSyncData& sd = *syncData;
+	const bool isSpeculative = lookahead > 0 && ptrn.Depth >= 0;
+
+	int* buffer = 0;
+	{
+		boost::unique_lock<boost::mutex> lock( sd.Access );
+		while( sd.Count == sd.Ring.size() || ( isSpeculative && sd.Reported - sd.Decided >= lookahead ) ) {
+			sd.HasDecision.wait( lock );
+		}
+		if( !sd.Pool.empty() ) {
+			buffer = sd.Pool.back();
+			sd.Pool.pop_back();
+		}
 	}
 
-	pi.ImageSize = ptrn.ImageSize;
-	COUT << "\t ptrn SIZE: " << ptrn.ImageSize << "\n";
-	pi.Objects = new int[pi.ImageSize];
-	memcpy(const_cast<int*>(pi.Objects), ptrn.Objects, pi.ImageSize * sizeof( pi.Objects[0] ));
-
-	syncData->DataState = CSyncData::DS_Ready;
-	syncData->HasNewPattern.notify_one();
-
-	COUT << "(!) Algo: Registered graph " << syncData->PatternImage.PatternId << "\n";
+	// Objects are copied in parallel with the consumer
+	if( buffer == 0 || buffer[0] < ptrn.ImageSize ) {
+		delete[] buffer;
+		buffer = CSyncData::NewBuffer( ptrn.ImageSize );
+	}
+	memcpy( buffer + 1, ptrn.Objects, ptrn.ImageSize * sizeof( ptrn.Objects[0] ) );
+
+	boost::unique_lock<boost::mutex> lock( sd.Access );
+	if( sd.SkipDepth >= 0 ) {
+		if( ptrn.Depth > sd.SkipDepth ) {
+			// A descendant of a rejected pattern
+			sd.Pool.push_back( buffer );
+			return false;
+		}
+		sd.SkipDepth = -1;
+	}
 
-	// Waiting untill the next graph is requested
-	while(!syncData->IsPatternRequested) {
-		syncData->NewPatternRequested.wait(lock);
+	CSyncData::CSlot& slot = sd.Ring[( sd.Head + sd.Count ) % sd.Ring.size()];
+	slot.Image.PatternId = ptrn.PatternId;
+	slot.Image.ImageSize = ptrn.ImageSize;
+	slot.Image.Objects = buffer + 1;
+	slot.Image.Depth = ptrn.Depth;
+	slot.IsSpeculative = isSpeculative;
+	++sd.Count;
+	const DWORD index = sd.Reported;
+	++sd.Reported;
+	sd.HasNewPattern.notify_one();
+	COUT << "(!) Algo: Registered graph " << ptrn.PatternId << "\n";
+
+	if( isSpeculative ) {
+		return true;
+	}
+	// Waiting untill the usage of the pattern is known
+	while( sd.Decided <= index ) {
+		sd.HasDecision.wait( lock );
 	}
-	syncData->IsPatternRequested = false;
-	COUT << "(!) ALGO: Return from callback for a pattern " << syncData->PatternImage.PatternId << "\n";
-	return syncData->currPatternUsage == CPU_Expand;
+	COUT << "(!) ALGO: Return from callback for a pattern " << ptrn.PatternId << "\n";
+	return sd.LastUsage == CPU_Expand;
 }
 // Takes the next pattern. Function is used to put together with registerPattern.
 inline TNextPatternStatut CParallelPatternEnumerator::getNextPattern( TCurrentPatternUsage usage, CPatternImage& pattern )
 {
-	boost::unique_lock<boost::mutex> lock( syncData->Access );
-
-	// Requesting next graph
-	COUT << "(!) SOFIA: requesting next graph (curr is " << syncData->PatternImage.PatternId << ") \n";
-	syncData->currPatternUsage = usage;
-	syncData->IsPatternRequested = true;
-	syncData->NewPatternRequested.notify_one();
+	CSyncData& sd = *syncData;
+	boost::unique_lock<boost::mutex> lock( sd.Access );
+
+	if( sd.HasCurrent ) {
+		COUT << "(!) SOFIA: requesting next graph (curr is " << sd.Current.Image.PatternId << ") \n";
+		sd.HasCurrent = false;
+		sd.LastUsage = usage;
+		++sd.Decided;
+		if( usage != CPU_Expand && sd.Current.IsSpeculative ) {
+			dropDescendants( sd.Current.Image.Depth );
+		}
+		sd.HasDecision.notify_one();
+	}
 
 	// Waiting while the next graph is ready
-	while( syncData->DataState == CSyncData::DS_InPreparation ) {
-		syncData->HasNewPattern.wait(lock);
+	while( sd.Count == 0 && !sd.IsEnd ) {
+		sd.HasNewPattern.wait( lock );
 	}
-	if( syncData->DataState == CSyncData::DS_End ) {
+	if( sd.Count == 0 ) {
 		return NPS_None;
 	}
-	assert( syncData->DataState == CSyncData::DS_Ready );
 
-	syncData->DataState = CSyncData::DS_InPreparation;
-	COUT << "(!) SOFIA: pattern " << syncData->PatternImage.PatternId << " is ready\n";
-
-	ClearMemory( pattern );
-	pattern.PatternId = syncData->PatternImage.PatternId;
-	pattern.ImageSize = syncData->PatternImage.ImageSize;
-	pattern.Objects = syncData->PatternImage.Objects;
+	if( pattern.Objects != 0 ) {
+		releaseBuffer( pattern.Objects );
+	}
+	sd.Current = sd.Ring[sd.Head];
+	sd.HasCurrent = true;
+	sd.Head = ( sd.Head + 1 ) % sd.Ring.size();
+	--sd.Count;
+	sd.HasDecision.notify_one();
+	COUT << "(!) SOFIA: pattern " << sd.Current.Image.PatternId << " is ready\n";
 
-	syncData->PatternImage.Objects = 0;
-	syncData->PatternImage.ImageSize = 0;
+	pattern = sd.Current.Image;
 
 	return NPS_New; // TODO sometimes it is not New
 }
+// Drops the descendants of a rejected pattern, they follow the pattern in the ring and are deeper.
+//  If the ring is exhausted, ALGO is still in the subtree of the pattern and drops the next descendants itself.
+void CParallelPatternEnumerator::dropDescendants( int depth )
+{
+	CSyncData& sd = *syncData;
+	while( sd.Count > 0 && sd.Ring[sd.Head].Image.Depth > depth ) {
+		releaseBuffer( sd.Ring[sd.Head].Image.Objects );
+		sd.Head = ( sd.Head + 1 ) % sd.Ring.size();
+		--sd.Count;
+		++sd.Decided;
+		sd.LastUsage = CPU_Reject;
+	}
+	if( sd.Count == 0 ) {
+		sd.SkipDepth = depth;
+	}
+}
+// Returns the buffer of objects to the pool, syncData->Access should be locked
+void CParallelPatternEnumerator::releaseBuffer( const int* objects )
+{
+	assert( objects != 0 );
+	CSyncData& sd = *syncData;
+	if( sd.Pool.size() <= sd.Ring.size() + 1 ) {
+		sd.Pool.push_back( CSyncData::GetBuffer( objects ) );
+	} else {
+		delete[] CSyncData::GetBuffer( objects );
+	}
+}
@@ -5,6 +5,8 @@
 //  In order to rely on existing code of ALGO, the most simple thing is to find places in this code where patterns are reported
 //  and then report the patterns by a callback. However in this case pattern reported by callback is hard to translate to the IPatternEnumerator interface
 //  Accordingly, we run ALGO in parallel thread and are switching between threads when we want to get next pattern by the callback.
+//  Patterns are passed through a bounded ring, so ALGO can run ahead for Lookahead patterns if it reports their depth.
+//  In this case their expansion is speculative and the descendants of a rejected pattern are dropped.
 
 #ifndef PARALLELPATTERNENUMERATOR_H
 #define PARALLELPATTERNENUMERATOR_H
@@ -62,12 +64,16 @@ private:
 	CPtrOwner<CSyncData> syncData;
 	// A flag to mark the fact the the algo is started.
 	bool isAlgoRun;
+	// The number of patterns that ALGO can report before the usage of them is known
+	DWORD lookahead;
 
 	static bool callback( PECDataRef data, const CPatternImage& ptrn );
 
 	void createAlgoThread();
 	bool registerPattern( const CPatternImage& ptrn );
     TNextPatternStatut getNextPattern( TCurrentPatternUsage usage, CPatternImage& pattern );
+	void dropDescendants( int depth );
+	void releaseBuffer( const int* objects );
 };
 
 ////////////////////////////////////////////////////////////////////////
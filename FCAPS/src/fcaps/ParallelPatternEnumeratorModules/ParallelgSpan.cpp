@@ -0,0 +1,782 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Parallel enumeration of frequent connected subgraphs by gSpan.
+
+#include "ParallelgSpan.h"
+
+#include <Exception.h>
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <map>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+CParallelgSpan::CGraphs::CGraphs() :
+	maxVertexCount( 0 ),
+	maxEdgeCount( 0 ),
+	isBuilt( false )
+{
+	vertexOffsets.push_back( 0 );
+}
+
+void CParallelgSpan::CGraphs::Clear()
+{
+	vertexOffsets.assign( 1, 0 );
+	labels.clear();
+	edgeCounts.clear();
+	edgeOffsets.clear();
+	edges.clear();
+	added.clear();
+	maxVertexCount = 0;
+	maxEdgeCount = 0;
+	isBuilt = false;
+}
+
+void CParallelgSpan::CGraphs::AddGraph()
+{
+	vertexOffsets.push_back( vertexOffsets.back() );
+	edgeCounts.push_back( 0 );
+	isBuilt = false;
+}
+
+void CParallelgSpan::CGraphs::AddVertex( int label )
+{
+	assert( Size() > 0 );
+	labels.push_back( label );
+	++vertexOffsets.back();
+	maxVertexCount = max( maxVertexCount, VertexCount( Size() - 1 ) );
+	isBuilt = false;
+}
+
+void CParallelgSpan::CGraphs::AddEdge( DWORD from, DWORD to, int label, int reverseLabel )
+{
+	assert( Size() > 0 );
+	const DWORD g = Size() - 1;
+	assert( from < VertexCount( g ) && to < VertexCount( g ) );
+
+	CEdge edge;
+	edge.From = from;
+	edge.To = to;
+	edge.Label = label;
+	edge.Id = edgeCounts[g];
+	added.push_back( edge );
+	// Every edge is in the rows of both vertices
+	edge.From = to;
+	edge.To = from;
+	edge.Label = reverseLabel;
+	added.push_back( edge );
+
+	++edgeCounts[g];
+	maxEdgeCount = max( maxEdgeCount, edgeCounts[g] );
+	isBuilt = false;
+}
+
+// Counting sort of the edges by the global id of the source vertex, the order of addition is kept in a row
+void CParallelgSpan::CGraphs::Build()
+{
+	if( isBuilt ) {
+		return;
+	}
+	edgeOffsets.assign( labels.size() + 1, 0 );
+	DWORD pos = 0;
+	for( DWORD g = 0; g < Size(); ++g ) {
+		for( DWORD i = 0; i < 2 * edgeCounts[g]; ++i, ++pos ) {
+			++edgeOffsets[vertexOffsets[g] + added[pos].From + 1];
+		}
+	}
+	for( DWORD v = 0; v < labels.size(); ++v ) {
+		edgeOffsets[v + 1] += edgeOffsets[v];
+	}
+
+	edges.resize( added.size() );
+	vector<DWORD> ends( edgeOffsets.begin(), edgeOffsets.end() - 1 );
+	pos = 0;
+	for( DWORD g = 0; g < Size(); ++g ) {
+		for( DWORD i = 0; i < 2 * edgeCounts[g]; ++i, ++pos ) {
+			edges[ends[vertexOffsets[g] + added[pos].From]++] = added[pos];
+		}
+	}
+	added.clear();
+	isBuilt = true;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// An embedding of a DFS code, the edges are taken from the last to the first by Prev
+struct CParallelgSpan::CEmbedding {
+	DWORD Graph;
+	const CEdge* Edge;
+	const CEmbedding* Prev;
+
+	CEmbedding( DWORD graph, const CEdge* edge, const CEmbedding* prev ) :
+		Graph( graph ), Edge( edge ), Prev( prev ) {}
+};
+
+////////////////////////////////////////////////////////////////////
+
+// The edges of an embedding in the order of the DFS code and the used edges and vertices
+class CParallelgSpan::CHistory {
+public:
+	void Build( const CEmbedding& embedding, DWORD vertexCount, DWORD edgeCount );
+	// Should be called before the edges of the graph are changed
+	void Clear();
+
+	const CEdge& operator[]( DWORD i ) const
+		{ return *edges[i]; }
+	bool HasEdge( DWORD id ) const
+		{ return edgeMarks[id] != 0; }
+	bool HasVertex( DWORD v ) const
+		{ return vertexMarks[v] != 0; }
+
+private:
+	vector<const CEdge*> edges;
+	vector<char> edgeMarks;
+	vector<char> vertexMarks;
+};
+
+void CParallelgSpan::CHistory::Build( const CEmbedding& embedding, DWORD vertexCount, DWORD edgeCount )
+{
+	// Only the marks of the previous embedding are cleared
+	for( DWORD i = 0; i < edges.size(); ++i ) {
+		edgeMarks[edges[i]->Id] = 0;
+		vertexMarks[edges[i]->From] = 0;
+		vertexMarks[edges[i]->To] = 0;
+	}
+	if( edgeMarks.size() < edgeCount ) {
+		edgeMarks.resize( edgeCount, 0 );
+	}
+	if( vertexMarks.size() < vertexCount ) {
+		vertexMarks.resize( vertexCount, 0 );
+	}
+
+	edges.clear();
+	for( const CEmbedding* e = &embedding; e != 0; e = e->Prev ) {
+		edges.push_back( e->Edge );
+	}
+	reverse( edges.begin(), edges.end() );
+	for( DWORD i = 0; i < edges.size(); ++i ) {
+		edgeMarks[edges[i]->Id] = 1;
+		vertexMarks[edges[i]->From] = 1;
+		vertexMarks[edges[i]->To] = 1;
+	}
+}
+
+void CParallelgSpan::CHistory::Clear()
+{
+	edges.clear();
+	fill( edgeMarks.begin(), edgeMarks.end(), 0 );
+	fill( vertexMarks.begin(), vertexMarks.end(), 0 );
+}
+
+////////////////////////////////////////////////////////////////////
+
+// A rightmost path extension
+struct CParallelgSpan::CExtension {
+	bool IsForward;
+	// The vertices of the DFS code, To is only used by backward extensions
+	int From;
+	int To;
+	int EdgeLabel;
+	int ToLabel;
+
+	CExtension( bool isForward, int from, int to, int edgeLabel, int toLabel ) :
+		IsForward( isForward ), From( from ), To( to ), EdgeLabel( edgeLabel ), ToLabel( toLabel ) {}
+};
+
+// The order of DFS codes: backward extensions go first, forward extensions from the deepest vertex go first
+class CParallelgSpan::CExtensionOrder {
+public:
+	bool operator()( const CExtension& a, const CExtension& b ) const
+	{
+		if( a.IsForward != b.IsForward ) {
+			return !a.IsForward;
+		}
+		if( !a.IsForward ) {
+			return a.To < b.To || ( a.To == b.To && a.EdgeLabel < b.EdgeLabel );
+		}
+		if( a.From != b.From ) {
+			return a.From > b.From;
+		}
+		return a.EdgeLabel < b.EdgeLabel || ( a.EdgeLabel == b.EdgeLabel && a.ToLabel < b.ToLabel );
+	}
+};
+
+////////////////////////////////////////////////////////////////////
+
+// A node of the search. The children are found by one of the threads.
+struct CParallelgSpan::CNode {
+	enum TState {
+		S_Waiting = 0,
+		S_Running,
+		S_Done,
+		S_Cancelled
+	};
+
+	CDFSCode Code;
+	CProjection Projection;
+	CBitset Image;
+	vector< CSharedPtr<CNode> > Children;
+	TState State;
+
+	CNode() :
+		State( S_Waiting ) {}
+};
+
+// The memory reused by a thread
+struct CParallelgSpan::CWorkspace {
+	CHistory History;
+	// The graph of a DFS code and its minimal DFS code for the test of minimality
+	CGraphs Graph;
+	CHistory GraphHistory;
+	CDFSCode MinCode;
+};
+
+////////////////////////////////////////////////////////////////////
+
+// The nodes waiting for the expansion.
+//  Every worker takes the newest node of its queue, if the queue is empty it steals the oldest node of another queue.
+//  The reporting thread expands the node itself if it needs the children and nobody took the node.
+class CParallelgSpan::CTaskPool {
+public:
+	CTaskPool( const CParallelgSpan& gspan, DWORD workersCount );
+	~CTaskPool();
+
+	void Push( const vector< CSharedPtr<CNode> >& nodes );
+	// Returns when the children of the node are found
+	void Expand( CNode& node, CWorkspace& ws );
+	// The node is not expanded, waits if a worker is expanding it
+	void Cancel( CNode& node );
+
+	void Work( DWORD worker );
+	// Rethrows the first error of the workers
+	void CheckError();
+
+private:
+	const CParallelgSpan& gspan;
+	boost::mutex access;
+	boost::condition_variable hasTasks;
+	boost::condition_variable taskDone;
+	vector< deque< CSharedPtr<CNode> > > queues;
+	DWORD nextQueue;
+	bool isStopped;
+	CException* error;
+	boost::thread_group threads;
+
+	bool pop( DWORD worker, CSharedPtr<CNode>& node );
+	void checkError();
+};
+
+class CParallelgSpan::CWorkThread {
+public:
+	CWorkThread( CTaskPool& _pool, DWORD _worker ) :
+		pool( _pool ), worker( _worker ) {}
+
+	void operator()()
+		{ pool.Work( worker ); }
+private:
+	CTaskPool& pool;
+	const DWORD worker;
+};
+
+CParallelgSpan::CTaskPool::CTaskPool( const CParallelgSpan& _gspan, DWORD workersCount ) :
+	gspan( _gspan ),
+	queues( workersCount ),
+	nextQueue( 0 ),
+	isStopped( false ),
+	error( 0 )
+{
+	for( DWORD i = 0; i < workersCount; ++i ) {
+		threads.create_thread( CWorkThread( *this, i ) );
+	}
+}
+
+CParallelgSpan::CTaskPool::~CTaskPool()
+{
+	{
+		boost::lock_guard<boost::mutex> lock( access );
+		isStopped = true;
+	}
+	hasTasks.notify_all();
+	threads.join_all();
+	delete error;
+}
+
+void CParallelgSpan::CTaskPool::Push( const vector< CSharedPtr<CNode> >& nodes )
+{
+	if( queues.empty() || nodes.empty() ) {
+		return;
+	}
+	{
+		boost::lock_guard<boost::mutex> lock( access );
+		for( DWORD i = 0; i < nodes.size(); ++i ) {
+			queues[nextQueue].push_back( nodes[i] );
+			nextQueue = ( nextQueue + 1 ) % queues.size();
+		}
+	}
+	hasTasks.notify_all();
+}
+
+void CParallelgSpan::CTaskPool::Expand( CNode& node, CWorkspace& ws )
+{
+	{
+		boost::unique_lock<boost::mutex> lock( access );
+		while( node.State == CNode::S_Running ) {
+			taskDone.wait( lock );
+		}
+		checkError();
+		if( node.State == CNode::S_Done ) {
+			return;
+		}
+		assert( node.State == CNode::S_Waiting );
+		node.State = CNode::S_Running;
+	}
+
+	gspan.expand( node, ws );
+
+	boost::lock_guard<boost::mutex> lock( access );
+	node.State = CNode::S_Done;
+}
+
+void CParallelgSpan::CTaskPool::Cancel( CNode& node )
+{
+	boost::unique_lock<boost::mutex> lock( access );
+	while( node.State == CNode::S_Running ) {
+		taskDone.wait( lock );
+	}
+	if( node.State == CNode::S_Waiting ) {
+		node.State = CNode::S_Cancelled;
+	}
+}
+
+void CParallelgSpan::CTaskPool::Work( DWORD worker )
+{
+	CWorkspace ws;
+	boost::unique_lock<boost::mutex> lock( access );
+	while( true ) {
+		CSharedPtr<CNode> node;
+		while( !isStopped && !pop( worker, node ) ) {
+			hasTasks.wait( lock );
+		}
+		if( isStopped ) {
+			return;
+		}
+		node->State = CNode::S_Running;
+		lock.unlock();
+
+		CException* taskError = 0;
+		try {
+			gspan.expand( *node, ws );
+		} catch( CException* e ) {
+			taskError = e;
+		} catch( std::exception& e ) {
+			taskError = new CTextException( "CParallelgSpan::CTaskPool::Work", e.what() );
+		}
+
+		lock.lock();
+		if( taskError != 0 ) {
+			if( error == 0 ) {
+				error = taskError;
+			} else {
+				delete taskError;
+			}
+		}
+		node->State = CNode::S_Done;
+		taskDone.notify_all();
+	}
+}
+
+// The queues can have the nodes that are already expanded by the reporting thread or cancelled, they are skipped
+bool CParallelgSpan::CTaskPool::pop( DWORD worker, CSharedPtr<CNode>& node )
+{
+	deque< CSharedPtr<CNode> >& own = queues[worker];
+	while( !own.empty() ) {
+		node = own.back();
+		own.pop_back();
+		if( node->State == CNode::S_Waiting ) {
+			return true;
+		}
+	}
+	for( DWORD i = 1; i < queues.size(); ++i ) {
+		deque< CSharedPtr<CNode> >& other = queues[( worker + i ) % queues.size()];
+		while( !other.empty() ) {
+			node = other.front();
+			other.pop_front();
+			if( node->State == CNode::S_Waiting ) {
+				return true;
+			}
+		}
+	}
+	node.reset();
+	return false;
+}
+
+void CParallelgSpan::CTaskPool::CheckError()
+{
+	boost::lock_guard<boost::mutex> lock( access );
+	checkError();
+}
+
+// access should be locked
+void CParallelgSpan::CTaskPool::checkError()
+{
+	if( error != 0 ) {
+		CException* e = error;
+		error = 0;
+		throw e;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+CParallelgSpan::CParallelgSpan( DWORD _threadsCount ) :
+	threadsCount( max<DWORD>( _threadsCount, 1 ) ),
+	isDirected( false ),
+	minSupport( 1 ),
+	maxEdges( -1 )
+{
+}
+
+void CParallelgSpan::AddGraph()
+{
+	graphs.AddGraph();
+}
+
+void CParallelgSpan::AddVertex( int label )
+{
+	assert( label >= 0 );
+	graphs.AddVertex( label );
+}
+
+// For directed graphs the arc is in the row of from with the label 2*label+1 and in the row of to with 2*label.
+void CParallelgSpan::AddEdge( DWORD from, DWORD to, int label )
+{
+	assert( label >= 0 );
+	const int edgeLabel = isDirected ? 2 * label + 1 : 2 * label;
+	graphs.AddEdge( from, to, edgeLabel, reverseLabel( edgeLabel ) );
+}
+
+void CParallelgSpan::Run( DWORD _minSupport, DWORD _maxEdges, IReceiver& receiver )
+{
+	minSupport = max<DWORD>( _minSupport, 1 );
+	maxEdges = _maxEdges;
+	graphs.Build();
+
+	vector< CSharedPtr<CNode> > roots;
+	findRoots( roots );
+
+	CWorkspace ws;
+	CTaskPool pool( *this, threadsCount - 1 );
+	pool.Push( roots );
+	for( DWORD i = 0; i < roots.size(); ++i ) {
+		visit( *roots[i], pool, ws, receiver );
+	}
+	pool.CheckError();
+}
+
+// The frequent single edges
+void CParallelgSpan::findRoots( vector< CSharedPtr<CNode> >& roots ) const
+{
+	// Projections of single edges by the labels of the source vertex, of the edge and of the destination vertex
+	typedef map< pair< int, pair<int, int> >, CProjection > CRootProjections;
+	CRootProjections projections;
+	for( DWORD g = 0; g < graphs.Size(); ++g ) {
+		for( DWORD v = 0; v < graphs.VertexCount( g ); ++v ) {
+			const int fromLabel = graphs.Label( g, v );
+			for( const CEdge* e = graphs.EdgesBegin( g, v ); e != graphs.EdgesEnd( g, v ); ++e ) {
+				const int toLabel = graphs.Label( g, e->To );
+				if( fromLabel < toLabel || ( fromLabel == toLabel && e->Label <= reverseLabel( e->Label ) ) ) {
+					projections[make_pair( fromLabel, make_pair( e->Label, toLabel ) )].push_back( CEmbedding( g, e, 0 ) );
+				}
+			}
+		}
+	}
+
+	for( CRootProjections::iterator itr = projections.begin(); itr != projections.end(); ++itr ) {
+		CSharedPtr<CNode> root( new CNode );
+		root->Image.resize( graphs.Size() );
+		for( DWORD i = 0; i < itr->second.size(); ++i ) {
+			root->Image.set( itr->second[i].Graph );
+		}
+		if( root->Image.count() < minSupport ) {
+			continue;
+		}
+		root->Code.push_back( CDFSEdge( 0, 1, itr->first.first, itr->first.second.first, itr->first.second.second ) );
+		root->Projection.swap( itr->second );
+		roots.push_back( root );
+	}
+}
+
+// Finds the frequent children of the node with minimal DFS codes
+void CParallelgSpan::expand( CNode& node, CWorkspace& ws ) const
+{
+	typedef map<CExtension, CProjection, CExtensionOrder> CExtensions;
+
+	const CDFSCode& code = node.Code;
+	assert( !code.empty() );
+	vector<DWORD> rmpath;
+	buildRightmostPath( code, rmpath );
+	const int minLabel = code[0].FromLabel;
+	const int maxToc = code[rmpath[0]].To;
+
+	CExtensions extensions;
+	CHistory& history = ws.History;
+	for( DWORD n = 0; n < node.Projection.size(); ++n ) {
+		const CEmbedding& cur = node.Projection[n];
+		const DWORD g = cur.Graph;
+		history.Build( cur, graphs.VertexCount( g ), graphs.EdgeCount( g ) );
+		const CEdge& last = history[rmpath[0]];
+
+		// Backward edges from the rightmost vertex.
+		//  The conditions on labels skip the codes that cannot be minimal, they rely on the symmetry of edges.
+		for( int i = static_cast<int>( rmpath.size() ) - 1; i >= 1; --i ) {
+			const CEdge& target = history[rmpath[i]];
+			for( const CEdge* e = graphs.EdgesBegin( g, last.To ); e != graphs.EdgesEnd( g, last.To ); ++e ) {
+				if( history.HasEdge( e->Id ) || e->To != target.From ) {
+					continue;
+				}
+				if( isDirected || target.Label < e->Label
+					|| ( target.Label == e->Label && graphs.Label( g, target.To ) <= graphs.Label( g, last.To ) ) )
+				{
+					extensions[CExtension( false, maxToc, code[rmpath[i]].From, e->Label, -1 )].push_back( CEmbedding( g, e, &cur ) );
+				}
+			}
+		}
+		// Forward edges from the rightmost vertex
+		for( const CEdge* e = graphs.EdgesBegin( g, last.To ); e != graphs.EdgesEnd( g, last.To ); ++e ) {
+			const int toLabel = graphs.Label( g, e->To );
+			if( minLabel > toLabel || history.HasVertex( e->To ) ) {
+				continue;
+			}
+			extensions[CExtension( true, maxToc, -1, e->Label, toLabel )].push_back( CEmbedding( g, e, &cur ) );
+		}
+		// Forward edges from the rightmost path
+		for( DWORD i = 0; i < rmpath.size(); ++i ) {
+			const CEdge& pathEdge = history[rmpath[i]];
+			const int pathToLabel = graphs.Label( g, pathEdge.To );
+			for( const CEdge* e = graphs.EdgesBegin( g, pathEdge.From ); e != graphs.EdgesEnd( g, pathEdge.From ); ++e ) {
+				const int toLabel = graphs.Label( g, e->To );
+				if( pathEdge.To == e->To || minLabel > toLabel || history.HasVertex( e->To ) ) {
+					continue;
+				}
+				if( isDirected || pathEdge.Label < e->Label || ( pathEdge.Label == e->Label && pathToLabel <= toLabel ) ) {
+					extensions[CExtension( true, code[rmpath[i]].From, -1, e->Label, toLabel )].push_back( CEmbedding( g, e, &cur ) );
+				}
+			}
+		}
+	}
+
+	for( CExtensions::iterator itr = extensions.begin(); itr != extensions.end(); ++itr ) {
+		const CExtension& ext = itr->first;
+		CProjection& projection = itr->second;
+		// The embeddings are sorted by graphs
+		DWORD support = 0;
+		for( DWORD i = 0; i < projection.size(); ++i ) {
+			if( i == 0 || projection[i].Graph != projection[i - 1].Graph ) {
+				++support;
+			}
+		}
+		if( support < minSupport ) {
+			continue;
+		}
+
+		CSharedPtr<CNode> child( new CNode );
+		child->Code.reserve( code.size() + 1 );
+		child->Code = code;
+		if( ext.IsForward ) {
+			child->Code.push_back( CDFSEdge( ext.From, maxToc + 1, -1, ext.EdgeLabel, ext.ToLabel ) );
+		} else {
+			child->Code.push_back( CDFSEdge( ext.From, ext.To, -1, ext.EdgeLabel, -1 ) );
+		}
+		if( !isMin( child->Code, ws ) ) {
+			continue;
+		}
+		child->Image.resize( graphs.Size() );
+		for( DWORD i = 0; i < projection.size(); ++i ) {
+			child->Image.set( projection[i].Graph );
+		}
+		// The embeddings keep their addresses, the children of the child point to them
+		child->Projection.swap( projection );
+		node.Children.push_back( child );
+	}
+}
+
+// Reports the node and its subtree in the depth-first order
+void CParallelgSpan::visit( CNode& node, CTaskPool& pool, CWorkspace& ws, IReceiver& receiver ) const
+{
+	const bool isExpanded = receiver.OnPattern( node.Code, node.Image ) && node.Code.size() < maxEdges;
+	if( isExpanded ) {
+		pool.Expand( node, ws );
+		pool.Push( node.Children );
+		for( DWORD i = 0; i < node.Children.size(); ++i ) {
+			visit( *node.Children[i], pool, ws, receiver );
+		}
+	} else {
+		pool.Cancel( node );
+	}
+
+	// Nobody points to the embeddings of the node any more
+	node.Children.clear();
+	CProjection().swap( node.Projection );
+	CBitset().swap( node.Image );
+}
+
+// Builds the minimal DFS code of the graph of the code in parallel with comparing it to the code
+bool CParallelgSpan::isMin( const CDFSCode& code, CWorkspace& ws ) const
+{
+	if( code.size() == 1 ) {
+		return true;
+	}
+
+	int verticesCount = 0;
+	for( DWORD i = 0; i < code.size(); ++i ) {
+		verticesCount = max( verticesCount, max( code[i].From, code[i].To ) + 1 );
+	}
+	vector<int> labels( verticesCount, -1 );
+	for( DWORD i = 0; i < code.size(); ++i ) {
+		if( code[i].FromLabel != -1 ) {
+			labels[code[i].From] = code[i].FromLabel;
+		}
+		if( code[i].ToLabel != -1 ) {
+			labels[code[i].To] = code[i].ToLabel;
+		}
+	}
+	CGraphs& graph = ws.Graph;
+	ws.GraphHistory.Clear();
+	graph.Clear();
+	graph.AddGraph();
+	for( int v = 0; v < verticesCount; ++v ) {
+		graph.AddVertex( labels[v] );
+	}
+	for( DWORD i = 0; i < code.size(); ++i ) {
+		graph.AddEdge( code[i].From, code[i].To, code[i].EdgeLabel, reverseLabel( code[i].EdgeLabel ) );
+	}
+	graph.Build();
+
+	typedef map< pair< int, pair<int, int> >, CProjection > CRootProjections;
+	CRootProjections projections;
+	for( int v = 0; v < verticesCount; ++v ) {
+		for( const CEdge* e = graph.EdgesBegin( 0, v ); e != graph.EdgesEnd( 0, v ); ++e ) {
+			if( graph.Label( 0, v ) <= graph.Label( 0, e->To ) ) {
+				projections[make_pair( graph.Label( 0, v ), make_pair( e->Label, graph.Label( 0, e->To ) ) )].push_back( CEmbedding( 0, e, 0 ) );
+			}
+		}
+	}
+	assert( !projections.empty() );
+	CRootProjections::const_iterator first = projections.begin();
+	const CDFSEdge firstEdge( 0, 1, first->first.first, first->first.second.first, first->first.second.second );
+	if( firstEdge != code[0] ) {
+		return false;
+	}
+	ws.MinCode.assign( 1, firstEdge );
+	return isMinProjection( code, first->second, ws );
+}
+
+// Extends ws.MinCode by the minimal extension and compares it with the code
+bool CParallelgSpan::isMinProjection( const CDFSCode& code, const CProjection& projection, CWorkspace& ws ) const
+{
+	CDFSCode& minCode = ws.MinCode;
+	if( minCode.size() == code.size() ) {
+		return true;
+	}
+	vector<DWORD> rmpath;
+	buildRightmostPath( minCode, rmpath );
+	const int minLabel = minCode[0].FromLabel;
+	const int maxToc = minCode[rmpath[0]].To;
+	const CGraphs& graph = ws.Graph;
+	CHistory& history = ws.GraphHistory;
+
+	{
+		// Backward edges to the earliest vertex of the rightmost path
+		map<int, CProjection> backward;
+		int newTo = 0;
+		for( int i = static_cast<int>( rmpath.size() ) - 1; backward.empty() && i >= 1; --i ) {
+			for( DWORD n = 0; n < projection.size(); ++n ) {
+				history.Build( projection[n], graph.VertexCount( 0 ), graph.EdgeCount( 0 ) );
+				const CEdge& target = history[rmpath[i]];
+				const CEdge& last = history[rmpath[0]];
+				for( const CEdge* e = graph.EdgesBegin( 0, last.To ); e != graph.EdgesEnd( 0, last.To ); ++e ) {
+					if( history.HasEdge( e->Id ) || e->To != target.From ) {
+						continue;
+					}
+					if( isDirected || target.Label < e->Label
+						|| ( target.Label == e->Label && graph.Label( 0, target.To ) <= graph.Label( 0, last.To ) ) )
+					{
+						backward[e->Label].push_back( CEmbedding( 0, e, &projection[n] ) );
+						newTo = minCode[rmpath[i]].From;
+					}
+				}
+			}
+		}
+		if( !backward.empty() ) {
+			minCode.push_back( CDFSEdge( maxToc, newTo, -1, backward.begin()->first, -1 ) );
+			if( code[minCode.size() - 1] != minCode.back() ) {
+				return false;
+			}
+			return isMinProjection( code, backward.begin()->second, ws );
+		}
+	}
+
+	{
+		// Forward edges from the deepest vertex of the rightmost path
+		map< pair<int, int>, CProjection > forward;
+		int newFrom = 0;
+		for( DWORD n = 0; n < projection.size(); ++n ) {
+			history.Build( projection[n], graph.VertexCount( 0 ), graph.EdgeCount( 0 ) );
+			const CEdge& last = history[rmpath[0]];
+			for( const CEdge* e = graph.EdgesBegin( 0, last.To ); e != graph.EdgesEnd( 0, last.To ); ++e ) {
+				const int toLabel = graph.Label( 0, e->To );
+				if( minLabel > toLabel || history.HasVertex( e->To ) ) {
+					continue;
+				}
+				forward[make_pair( e->Label, toLabel )].push_back( CEmbedding( 0, e, &projection[n] ) );
+				newFrom = maxToc;
+			}
+		}
+		for( DWORD i = 0; forward.empty() && i < rmpath.size(); ++i ) {
+			for( DWORD n = 0; n < projection.size(); ++n ) {
+				history.Build( projection[n], graph.VertexCount( 0 ), graph.EdgeCount( 0 ) );
+				const CEdge& pathEdge = history[rmpath[i]];
+				const int pathToLabel = graph.Label( 0, pathEdge.To );
+				for( const CEdge* e = graph.EdgesBegin( 0, pathEdge.From ); e != graph.EdgesEnd( 0, pathEdge.From ); ++e ) {
+					const int toLabel = graph.Label( 0, e->To );
+					if( pathEdge.To == e->To || minLabel > toLabel || history.HasVertex( e->To ) ) {
+						continue;
+					}
+					if( isDirected || pathEdge.Label < e->Label || ( pathEdge.Label == e->Label && pathToLabel <= toLabel ) ) {
+						forward[make_pair( e->Label, toLabel )].push_back( CEmbedding( 0, e, &projection[n] ) );
+						newFrom = minCode[rmpath[i]].From;
+					}
+				}
+			}
+		}
+		if( !forward.empty() ) {
+			minCode.push_back( CDFSEdge( newFrom, maxToc + 1, -1, forward.begin()->first.first, forward.begin()->first.second ) );
+			if( code[minCode.size() - 1] != minCode.back() ) {
+				return false;
+			}
+			return isMinProjection( code, forward.begin()->second, ws );
+		}
+	}
+
+	return true;
+}
+
+// The indices of forward edges on the path from the rightmost vertex to the root, the deepest edge is the first one
+void CParallelgSpan::buildRightmostPath( const CDFSCode& code, vector<DWORD>& rmpath )
+{
+	rmpath.clear();
+	int prevFrom = -1;
+	for( int i = static_cast<int>( code.size() ) - 1; i >= 0; --i ) {
+		if( code[i].From < code[i].To && ( rmpath.empty() || prevFrom == code[i].To ) ) {
+			rmpath.push_back( i );
+			prevFrom = code[i].From;
+		}
+	}
+}
@@ -0,0 +1,149 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Parallel enumeration of frequent connected subgraphs by gSpan.
+//  The graphs are stored in compressed sparse rows, the images of patterns are bitsets of graphs.
+//  Patterns are reported in the depth-first order of DFS codes, so the expansion of a pattern can be rejected.
+//  Rightmost path extensions of the siblings of the reported pattern are computed by other threads,
+//  every thread has its own queue and steals from the other queues when its queue is empty.
+
+// Yan X., Han J.
+// gSpan: Graph-Based Substructure Pattern Mining
+// // Proceedings of IEEE International Conference on Data Mining (ICDM). 2002. P. 721–724.
+
+#ifndef PARALLELGSPAN_H_
+#define PARALLELGSPAN_H_
+
+#include <common.h>
+
+#include <boost/dynamic_bitset.hpp>
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+
+class CParallelgSpan {
+public:
+	typedef boost::dynamic_bitset<unsigned long long> CBitset;
+	// An edge of a DFS code. The labels of vertices are -1 if the vertices are known from the previous edges.
+	//  For directed graphs the lowest bit of EdgeLabel is set if the arc goes from From to To.
+	struct CDFSEdge {
+		int From;
+		int To;
+		int FromLabel;
+		int EdgeLabel;
+		int ToLabel;
+
+		CDFSEdge( int from = 0, int to = 0, int fromLabel = -1, int edgeLabel = -1, int toLabel = -1 ) :
+			From( from ), To( to ), FromLabel( fromLabel ), EdgeLabel( edgeLabel ), ToLabel( toLabel ) {}
+		bool operator==( const CDFSEdge& other ) const
+		{
+			return From == other.From && To == other.To && FromLabel == other.FromLabel
+				&& EdgeLabel == other.EdgeLabel && ToLabel == other.ToLabel;
+		}
+		bool operator!=( const CDFSEdge& other ) const
+			{ return !( *this == other ); }
+	};
+	typedef std::vector<CDFSEdge> CDFSCode;
+
+	// Receives the found patterns, returns if the pattern should be expanded.
+	interface IReceiver {
+		virtual bool OnPattern( const CDFSCode& code, const CBitset& image ) = 0;
+	};
+
+public:
+	CParallelgSpan( DWORD threadsCount = 1 );
+
+	// The database of graphs. Labels should be nonnegative.
+	void SetDirected( bool value )
+		{ isDirected = value; }
+	bool IsDirected() const
+		{ return isDirected; }
+	// Adds a graph, the next vertices and edges go to it
+	void AddGraph();
+	void AddVertex( int label );
+	void AddEdge( DWORD from, DWORD to, int label );
+	DWORD GraphsCount() const
+		{ return graphs.Size(); }
+
+	// Enumerates the patterns with at least minSupport graphs and at most maxEdges edges.
+	void Run( DWORD minSupport, DWORD maxEdges, IReceiver& receiver );
+
+private:
+	// An edge of a graph, the ids are local to the graph.
+	struct CEdge {
+		DWORD From;
+		DWORD To;
+		int Label;
+		DWORD Id;
+	};
+	struct CEmbedding;
+	typedef std::vector<CEmbedding> CProjection;
+	class CHistory;
+	struct CExtension;
+	class CExtensionOrder;
+	struct CNode;
+	struct CWorkspace;
+	class CTaskPool;
+	class CWorkThread;
+
+	// The set of graphs in compressed sparse rows
+	class CGraphs {
+	public:
+		CGraphs();
+
+		void Clear();
+		void AddGraph();
+		void AddVertex( int label );
+		void AddEdge( DWORD from, DWORD to, int label, int reverseLabel );
+		// Builds the rows of edges, should be called after adding the graphs
+		void Build();
+
+		DWORD Size() const
+			{ return vertexOffsets.size() - 1; }
+		DWORD MaxVertexCount() const
+			{ return maxVertexCount; }
+		DWORD MaxEdgeCount() const
+			{ return maxEdgeCount; }
+		DWORD VertexCount( DWORD g ) const
+			{ return vertexOffsets[g + 1] - vertexOffsets[g]; }
+		DWORD EdgeCount( DWORD g ) const
+			{ return edgeCounts[g]; }
+		int Label( DWORD g, DWORD v ) const
+			{ return labels[vertexOffsets[g] + v]; }
+		const CEdge* EdgesBegin( DWORD g, DWORD v ) const
+			{ return edges.data() + edgeOffsets[vertexOffsets[g] + v]; }
+		const CEdge* EdgesEnd( DWORD g, DWORD v ) const
+			{ return edges.data() + edgeOffsets[vertexOffsets[g] + v + 1]; }
+
+	private:
+		std::vector<DWORD> vertexOffsets;
+		std::vector<int> labels;
+		std::vector<DWORD> edgeCounts;
+		std::vector<DWORD> edgeOffsets;
+		std::vector<CEdge> edges;
+		// The edges in the order of addition
+		std::vector<CEdge> added;
+		DWORD maxVertexCount;
+		DWORD maxEdgeCount;
+		bool isBuilt;
+	};
+
+private:
+	const DWORD threadsCount;
+	bool isDirected;
+	CGraphs graphs;
+	DWORD minSupport;
+	DWORD maxEdges;
+
+	int reverseLabel( int label ) const
+		{ return isDirected ? ( label ^ 1 ) : label; }
+	void findRoots( std::vector< CSharedPtr<CNode> >& roots ) const;
+	void expand( CNode& node, CWorkspace& ws ) const;
+	void visit( CNode& node, CTaskPool& pool, CWorkspace& ws, IReceiver& receiver ) const;
+	bool isMin( const CDFSCode& code, CWorkspace& ws ) const;
+	bool isMinProjection( const CDFSCode& code, const CProjection& projection, CWorkspace& ws ) const;
+	static void buildRightmostPath( const CDFSCode& code, std::vector<DWORD>& rmpath );
+};
+
+#endif // PARALLELGSPAN_H_
@@ -0,0 +1,223 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Enumeration of frequent subgraphs by the in-tree parallel gSpan.
+
+#include "ParallelgSpanGraphPatternEnumerator.h"
+
+#include <JSONTools.h>
+#include <RelativePathes.h>
+#include <StdTools.h>
+
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////
+
+CModuleRegistrar<CParallelgSpanGraphPatternEnumerator> CParallelgSpanGraphPatternEnumerator::registar(
+	                  PatternEnumeratorByCallbackModuleType, ParallelgSpanGraphPatternEnumeratorModule);
+
+CParallelgSpanGraphPatternEnumerator::CParallelgSpanGraphPatternEnumerator() :
+	pecCallback( 0 ),
+	pecData( 0 ),
+	subgraphId( -1 ),
+	minSupport( 0 ),
+	minPtrnSize( 0 ),
+	maxPtrnSize( -1 ),
+	isDirected( false ),
+	threadsCount( 1 )
+{
+}
+
+void CParallelgSpanGraphPatternEnumerator::Run( PECReportPatternCallback callback, PECDataRef data )
+{
+	pecCallback = callback;
+	pecData = data;
+
+	CParallelgSpan gspan( threadsCount );
+	gspan.SetDirected( isDirected );
+	loadGraphs( gspan );
+	gspan.Run( max( minSupport, 1 ), maxPtrnSize < 0 ? static_cast<DWORD>( -1 ) : maxPtrnSize, *this );
+}
+
+void CParallelgSpanGraphPatternEnumerator::LoadParams( const JSON& json )
+{
+	CJsonError errorText;
+	rapidjson::Document params;
+	if( !ReadJsonString( json, params, errorText ) ) {
+		throw new CJsonException( "CParallelgSpanGraphPatternEnumerator::LoadParams", errorText );
+	}
+	assert( string( params["Type"].GetString() ) == GetType() );
+	assert( string( params["Name"].GetString() ) == GetName());
+
+	if( params.HasMember( "Params" ) && params["Params"].IsObject() ) {
+		const rapidjson::Value& paramsObj = params["Params"];
+
+		if( paramsObj.HasMember("InputPath") && paramsObj["InputPath"].IsString() ) {
+			RelativePathes::GetFullPath( paramsObj["InputPath"].GetString(), inputPath);
+		}
+		if( paramsObj.HasMember("PatternPath") && paramsObj["PatternPath"].IsString() ) {
+			RelativePathes::GetFullPath( paramsObj["PatternPath"].GetString(), patternPath);
+			if( !patternPath.empty() ) {
+				patternStream.open( patternPath );
+			}
+		}
+		if( paramsObj.HasMember("MinSupport") && paramsObj["MinSupport"].IsInt() ) {
+			minSupport = paramsObj["MinSupport"].GetInt();
+		}
+		if( paramsObj.HasMember("MinGraphSize") && paramsObj["MinGraphSize"].IsInt() ) {
+			minPtrnSize = paramsObj["MinGraphSize"].GetInt();
+		}
+		if( paramsObj.HasMember("MaxGraphSize") && paramsObj["MaxGraphSize"].IsInt() ) {
+			maxPtrnSize = paramsObj["MaxGraphSize"].GetInt();
+		}
+		if( paramsObj.HasMember("IsDirected") && paramsObj["IsDirected"].IsBool() ) {
+			isDirected = paramsObj["IsDirected"].GetBool();
+		}
+		if( paramsObj.HasMember("ThreadsCount") && paramsObj["ThreadsCount"].IsUint() && paramsObj["ThreadsCount"].GetUint() > 0 ) {
+			threadsCount = paramsObj["ThreadsCount"].GetUint();
+		}
+	}
+}
+JSON CParallelgSpanGraphPatternEnumerator::SaveParams() const
+{
+	rapidjson::Document params;
+	rapidjson::MemoryPoolAllocator<>& alloc = params.GetAllocator();
+	params.SetObject()
+		.AddMember( "Type", PatternEnumeratorByCallbackModuleType, alloc )
+		.AddMember( "Name", ParallelgSpanGraphPatternEnumeratorModule, alloc )
+		.AddMember( "Params", rapidjson::Value().SetObject()
+		            .AddMember( "InputPath", rapidjson::Value().SetString( rapidjson::StringRef(inputPath.c_str())), alloc )
+		            .AddMember( "PatternPath", rapidjson::Value().SetString( rapidjson::StringRef(patternPath.c_str())), alloc )
+		            .AddMember( "MinSupport", rapidjson::Value().SetInt(minSupport), alloc )
+		            .AddMember( "MinGraphSize", rapidjson::Value().SetInt(minPtrnSize), alloc )
+		            .AddMember( "MaxGraphSize", rapidjson::Value().SetInt(maxPtrnSize), alloc )
+		            .AddMember( "IsDirected", rapidjson::Value().SetBool(isDirected), alloc )
+		            .AddMember( "ThreadsCount", rapidjson::Value().SetUint(threadsCount), alloc ),
+			alloc );
+
+	JSON result;
+	CreateStringFromJSON( params, result );
+	return result;
+}
+
+// Registers a graph found by gSpan.
+bool CParallelgSpanGraphPatternEnumerator::OnPattern( const CParallelgSpan::CDFSCode& code, const CParallelgSpan::CBitset& image )
+{
+	++subgraphId;
+	if( static_cast<int>( code.size() ) < minPtrnSize ) {
+		return true;
+	}
+
+	objects.clear();
+	for( CParallelgSpan::CBitset::size_type g = image.find_first(); g != CParallelgSpan::CBitset::npos; g = image.find_next( g ) ) {
+		objects.push_back( graphIds[g] );
+	}
+	writePattern( code );
+
+	CPatternImage pi;
+	pi.PatternId = subgraphId;
+	pi.ImageSize = objects.size();
+	pi.Objects = objects.empty() ? 0 : &objects[0];
+	pi.Depth = code.size();
+
+	return pecCallback( pecData, pi );
+}
+
+// Reads the graphs in the format of gSpan, the vertices of a graph are numbered from 0.
+void CParallelgSpanGraphPatternEnumerator::loadGraphs( CParallelgSpan& gspan )
+{
+	static const char place[] = "CParallelgSpanGraphPatternEnumerator::loadGraphs";
+	ifstream input( inputPath.c_str() );
+	if( !input.is_open() ) {
+		throw new CTextException( place, "Cannot open the file '" + inputPath + "'" );
+	}
+
+	graphIds.clear();
+	DWORD verticesCount = 0;
+	string line;
+	for( DWORD lineNum = 1; getline( input, line ); ++lineNum ) {
+		istringstream str( line );
+		char type = 0;
+		if( !( str >> type ) ) {
+			continue;
+		}
+		bool isOk = true;
+		if( type == 't' ) {
+			char sharp = 0;
+			int id = -1;
+			isOk = ( str >> sharp >> id ) && sharp == '#';
+			if( isOk && id == -1 ) {
+				// The end of the file
+				break;
+			}
+			graphIds.push_back( id );
+			gspan.AddGraph();
+			verticesCount = 0;
+		} else if( type == 'v' ) {
+			DWORD id = 0;
+			int label = 0;
+			isOk = ( str >> id >> label ) && !graphIds.empty() && id == verticesCount && label >= 0;
+			if( isOk ) {
+				gspan.AddVertex( label );
+				++verticesCount;
+			}
+		} else if( type == 'e' ) {
+			DWORD from = 0;
+			DWORD to = 0;
+			int label = 0;
+			isOk = ( str >> from >> to >> label ) && !graphIds.empty()
+				&& from < verticesCount && to < verticesCount && from != to && label >= 0;
+			if( isOk ) {
+				gspan.AddEdge( from, to, label );
+			}
+		}
+		if( !isOk ) {
+			throw new CTextException( place, "Wrong line " + StdExt::to_string( lineNum ) + " in '" + inputPath + "': " + line );
+		}
+	}
+}
+
+void CParallelgSpanGraphPatternEnumerator::writePattern( const CParallelgSpan::CDFSCode& code )
+{
+	if( !patternStream.is_open() ) {
+		return;
+	}
+
+	patternStream << "# " << objects.size() << "\n";
+	patternStream << "t # " << subgraphId << "\n";
+
+	vector<int> labels;
+	for( DWORD i = 0; i < code.size(); ++i ) {
+		const int last = max( code[i].From, code[i].To );
+		if( static_cast<int>( labels.size() ) <= last ) {
+			labels.resize( last + 1, -1 );
+		}
+		if( code[i].FromLabel != -1 ) {
+			labels[code[i].From] = code[i].FromLabel;
+		}
+		if( code[i].ToLabel != -1 ) {
+			labels[code[i].To] = code[i].ToLabel;
+		}
+	}
+	for( DWORD i = 0; i < labels.size(); ++i ) {
+		patternStream << "v " << i << " " << labels[i] << "\n";
+	}
+	for( DWORD i = 0; i < code.size(); ++i ) {
+		// For directed graphs the lowest bit of the label is set if the arc goes in the order of the DFS code
+		const bool isReversed = isDirected && ( code[i].EdgeLabel & 1 ) == 0;
+		patternStream << "e " << i
+		              << " " << ( isReversed ? code[i].To : code[i].From )
+		              << " " << ( isReversed ? code[i].From : code[i].To )
+		              << " " << ( code[i].EdgeLabel >> 1 ) << "\n";
+	}
+	patternStream << "x";
+	for( DWORD i = 0; i < objects.size(); ++i ) {
+        patternStream << " " << objects[i];
+	}
+	patternStream << "\n";
+
+	patternStream.flush();
+}
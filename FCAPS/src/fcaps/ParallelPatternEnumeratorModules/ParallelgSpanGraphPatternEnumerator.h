@@ -0,0 +1,87 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Enumeration of frequent subgraphs by the in-tree parallel gSpan.
+//  The graphs are read from a file in the format of gSpan ('t # id', 'v id label', 'e from to label').
+//  The image of a pattern is the set of graph ids, the patterns are reported with the depth equal to their number of edges.
+
+#ifndef PARALLELGSPANGRAPHPATTERNENUMERATOR_H
+#define PARALLELGSPANGRAPHPATTERNENUMERATOR_H
+
+#include <fcaps/PatternEnumeratorByCallback.h>
+
+#include <fcaps/Module.h>
+#include <ModuleTools.h>
+
+#include "ParallelgSpan.h"
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+
+const char ParallelgSpanGraphPatternEnumeratorModule [] = "ParallelgSpanGraphPatternEnumeratorModule";
+
+////////////////////////////////////////////////////////////////////////
+
+class CParallelgSpanGraphPatternEnumerator : public IPatternEnumeratorByCallback, public IModule,
+	private CParallelgSpan::IReceiver {
+public:
+	CParallelgSpanGraphPatternEnumerator();
+
+	// Methods of IPatternEnumeratorByCallback
+	virtual void Run( PECReportPatternCallback callback, PECDataRef data = 0 );
+
+	// Methods of IModule
+	virtual void LoadParams( const JSON& );
+	virtual JSON SaveParams() const;
+	virtual const char* const GetType() const
+		{ return Type(); };
+	virtual const char* const GetName() const
+		{ return Name(); };
+	// For CModuleRegistrar
+	static const char* const Type()
+		{ return PatternEnumeratorByCallbackModuleType;}
+	static const char* const Name()
+		{ return ParallelgSpanGraphPatternEnumeratorModule; }
+	static const char* const Desc()
+		{ return "{}"; }
+
+private:
+	static CModuleRegistrar<CParallelgSpanGraphPatternEnumerator> registar;
+
+	// Callback and data for running return a new subgraph to a user.
+	//  The values are passed within the Run(...).
+	PECReportPatternCallback pecCallback;
+	PECDataRef pecData;
+
+	// The ID of the current subgraph
+	int subgraphId;
+
+	// Path to file with the input graphs
+	std::string inputPath;
+	// Path for saving the patterns
+	std::string patternPath;
+	CDestStream patternStream;
+	// Original ids of graphs
+	std::vector<int> graphIds;
+	// The ids of graphs in the image of the current pattern
+	std::vector<int> objects;
+	// Min support of a pattern
+	int minSupport;
+	// Min and max number of edges of a reported pattern
+	int minPtrnSize;
+	int maxPtrnSize;
+	// Indicate if the graphs are directed
+	bool isDirected;
+	DWORD threadsCount;
+
+	// Methods of CParallelgSpan::IReceiver
+	virtual bool OnPattern( const CParallelgSpan::CDFSCode& code, const CParallelgSpan::CBitset& image );
+
+	void loadGraphs( CParallelgSpan& gspan );
+	void writePattern( const CParallelgSpan::CDFSCode& code );
+};
+
+////////////////////////////////////////////////////////////////////////
+
+#endif // PARALLELGSPANGRAPHPATTERNENUMERATOR_H
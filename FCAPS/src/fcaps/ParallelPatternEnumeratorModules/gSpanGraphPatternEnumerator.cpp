@@ -248,6 +248,8 @@ bool CgSpanGraphPatternEnumerator::registerGraph( const LibgSpanGraph* graph )
 	pi.PatternId = subgraphId;
 	pi.ImageSize = graph->Support;
 	pi.Objects = graph->Objects;
+	// Every extension of a DFS code adds one edge
+	pi.Depth = graph->EdgeCount;
 
 	return pecCallback( pecData, pi );
 }
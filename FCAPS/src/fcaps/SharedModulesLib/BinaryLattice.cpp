@@ -0,0 +1,588 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include <fcaps/SharedModulesLib/BinaryLattice.h>
+
+#include <Exception.h>
+#include <StdTools.h>
+
+#include <boost/interprocess/exceptions.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+static const char binaryLatticeMagic[8] = { 'F', 'C', 'A', 'P', 'S', 'L', 'A', 'T' };
+static const DWORD binaryLatticeVersion = 1;
+// Non-null pointer to an empty set of indices
+static const DWORD noInds[1] = { 0 };
+
+////////////////////////////////////////////////////////////////////
+
+CBinaryLatticeWriter::CBinaryLatticeWriter( const std::string& path ) :
+	file( fopen( path.c_str(), "wb" ) ),
+	offset( 0 ),
+	params( "{}" )
+{
+	if( file == 0 ) {
+		throw new CTextException( "CBinaryLatticeWriter::CBinaryLatticeWriter", "Cannot open the file '" + path + "' for writing" );
+	}
+	// The place for the header, it is rewritten on Close
+	CBinaryLatticeHeader header;
+	memset( &header, 0, sizeof( header ) );
+	writeBytes( &header, sizeof( header ) );
+}
+
+CBinaryLatticeWriter::~CBinaryLatticeWriter()
+{
+	if( file == 0 ) {
+		return;
+	}
+	// A destructor should not throw, the errors are reported only by explicit Close
+	try {
+		Close();
+	} catch( CException* e ) {
+		delete e;
+	} catch( std::exception& ) {
+	}
+	if( file != 0 ) {
+		fclose( file );
+		file = 0;
+	}
+}
+
+void CBinaryLatticeWriter::SetParams( const JSON& p )
+{
+	params = p;
+}
+
+void CBinaryLatticeWriter::AddNode( const rapidjson::Value& node )
+{
+	assert( file != 0 );
+	assert( node.IsObject() );
+
+	CBinaryLatticeNode n;
+	memset( &n, 0, sizeof( n ) );
+	n.Extra = BinaryLatticeNoString;
+
+	rapidjson::Document extra;
+	extra.SetObject();
+	rapidjson::MemoryPoolAllocator<>& alloc = extra.GetAllocator();
+
+	for( rapidjson::Value::ConstMemberIterator m = node.MemberBegin(); m != node.MemberEnd(); ++m ) {
+		const string name( m->name.GetString(), m->name.GetStringLength() );
+		const rapidjson::Value& value = m->value;
+		bool useNames = false;
+		if( name == "Ext" ) {
+			if( value.IsUint() ) {
+				n.ExtCodec = BLC_None;
+				n.ExtSize = value.GetUint();
+			} else if( readInds( value, objNames, useNames ) ) {
+				writeExtent( inds.empty() ? noInds : &inds[0], inds.size(), n );
+				if( useNames ) {
+					n.Flags |= BLNF_ExtentNames;
+				}
+			} else {
+				JSON json;
+				CreateStringFromJSON( value, json );
+				n.ExtCodec = BLC_Json;
+				n.ExtOffset = addString( json );
+				if( value.IsObject() && value.HasMember( "Count" ) && value["Count"].IsUint() ) {
+					n.ExtSize = value["Count"].GetUint();
+				}
+			}
+		} else if( name == "Int" ) {
+			if( readInds( value, attrNames, useNames ) ) {
+				writeIntent( inds.empty() ? noInds : &inds[0], inds.size(), n );
+				if( useNames ) {
+					n.Flags |= BLNF_IntentNames;
+				}
+			} else {
+				JSON json;
+				CreateStringFromJSON( value, json );
+				n.IntCodec = BLC_Json;
+				n.IntOffset = addString( json );
+			}
+		} else if( name == "Interest" && value.IsNumber() ) {
+			n.Interest = value.GetDouble();
+			n.Flags |= BLNF_HasInterest;
+		} else {
+			extra.AddMember( rapidjson::Value( m->name, alloc ), rapidjson::Value( value, alloc ), alloc );
+		}
+	}
+
+	if( extra.MemberCount() > 0 ) {
+		JSON json;
+		CreateStringFromJSON( extra, json );
+		n.Extra = addString( json );
+	}
+	nodes.push_back( n );
+}
+
+void CBinaryLatticeWriter::AddNode( const DWORD* ext, DWORD extSize, const DWORD* intent, DWORD intSize, const JSON& extra )
+{
+	assert( file != 0 );
+
+	CBinaryLatticeNode n;
+	memset( &n, 0, sizeof( n ) );
+	writeExtent( ext, extSize, n );
+	writeIntent( intent, intSize, n );
+	n.Extra = extra.empty() ? BinaryLatticeNoString : addString( extra );
+	nodes.push_back( n );
+}
+
+void CBinaryLatticeWriter::AddArc( DWORD s, DWORD d )
+{
+	arcs.push_back( pair<DWORD,DWORD>( d, s ) );
+}
+
+void CBinaryLatticeWriter::Close()
+{
+	assert( file != 0 );
+
+	CBinaryLatticeHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.Magic, binaryLatticeMagic, sizeof( header.Magic ) );
+	header.Version = binaryLatticeVersion;
+	header.NodesCount = nodes.size();
+	header.ArcsCount = arcs.size();
+	header.Params = addString( params );
+	header.ObjNamesCount = objNames.size();
+	header.ObjNames = writeNames( objNames );
+	header.AttrNamesCount = attrNames.size();
+	header.AttrNames = writeNames( attrNames );
+
+	// Node table
+	alignData();
+	header.NodesOffset = offset;
+	if( !nodes.empty() ) {
+		writeBytes( &nodes[0], nodes.size() * sizeof( CBinaryLatticeNode ) );
+	}
+
+	// Arcs in CSR form, parents of a node are stored in one row
+	for( DWORD i = 0; i < arcs.size(); ++i ) {
+		if( arcs[i].first >= nodes.size() || arcs[i].second >= nodes.size() ) {
+			throw new CTextException( "CBinaryLatticeWriter::Close", "The arc " + StdExt::to_string( arcs[i].second )
+				+ "->" + StdExt::to_string( arcs[i].first ) + " refers to a node out of " + StdExt::to_string( nodes.size() ) + " nodes" );
+		}
+	}
+	sort( arcs.begin(), arcs.end() );
+	header.ArcsOffset = offset;
+	DWORD arcNum = 0;
+	for( DWORD d = 0; d <= nodes.size(); ++d ) {
+		while( arcNum < arcs.size() && arcs[arcNum].first < d ) {
+			++arcNum;
+		}
+		writeBytes( &arcNum, sizeof( arcNum ) );
+	}
+	assert( arcNum == arcs.size() );
+	for( DWORD i = 0; i < arcs.size(); ++i ) {
+		writeBytes( &arcs[i].second, sizeof( DWORD ) );
+	}
+
+	// String table
+	alignData();
+	header.StringsCount = strings.size() / 2;
+	header.StringsOffset = offset;
+	if( !strings.empty() ) {
+		writeBytes( &strings[0], strings.size() * sizeof( uint64_t ) );
+	}
+
+	if( fseek( file, 0, SEEK_SET ) != 0 ) {
+		throw new CTextException( "CBinaryLatticeWriter::Close", "Cannot write the header" );
+	}
+	writeBytes( &header, sizeof( header ) );
+	fclose( file );
+	file = 0;
+
+	nodes.clear();
+	arcs.clear();
+	strings.clear();
+}
+
+void CBinaryLatticeWriter::writeBytes( const void* data, size_t size )
+{
+	if( fwrite( data, 1, size, file ) != size ) {
+		throw new CTextException( "CBinaryLatticeWriter::writeBytes", "Cannot write to the file" );
+	}
+	offset += size;
+}
+
+// Aligns the data section to 8 bytes for the following arrays
+void CBinaryLatticeWriter::alignData()
+{
+	static const char zeros[8] = { 0 };
+	const size_t padding = ( 8 - offset % 8 ) % 8;
+	if( padding > 0 ) {
+		writeBytes( zeros, padding );
+	}
+}
+
+DWORD CBinaryLatticeWriter::addString( const std::string& str )
+{
+	strings.push_back( offset );
+	strings.push_back( str.length() );
+	writeBytes( str.c_str(), str.length() );
+	return strings.size() / 2 - 1;
+}
+
+void CBinaryLatticeWriter::writeExtent( const DWORD* ext, DWORD extSize, CBinaryLatticeNode& node )
+{
+	node.ExtSize = extSize;
+	if( ext == 0 ) {
+		node.ExtCodec = BLC_None;
+		return;
+	}
+
+	bool isSorted = true;
+	for( DWORD i = 1; i < extSize && isSorted; ++i ) {
+		isSorted = ext[i - 1] < ext[i];
+	}
+	const DWORD bitmapWords = extSize == 0 ? 0 : ext[extSize - 1] / 32 + 1;
+
+	alignData();
+	node.ExtOffset = offset;
+	if( isSorted && bitmapWords < extSize ) {
+		// A dense extent is shorter as a bitmap
+		bitmap.assign( bitmapWords, 0 );
+		for( DWORD i = 0; i < extSize; ++i ) {
+			bitmap[ext[i] / 32] |= 1u << ( ext[i] % 32 );
+		}
+		node.ExtCodec = BLC_Bitmap;
+		node.ExtWords = bitmapWords;
+		writeBytes( &bitmap[0], bitmapWords * sizeof( DWORD ) );
+	} else {
+		node.ExtCodec = BLC_Array;
+		node.ExtWords = extSize;
+		writeBytes( ext, extSize * sizeof( DWORD ) );
+	}
+}
+
+void CBinaryLatticeWriter::writeIntent( const DWORD* intent, DWORD intSize, CBinaryLatticeNode& node )
+{
+	node.IntSize = intSize;
+	if( intent == 0 ) {
+		node.IntCodec = BLC_None;
+		return;
+	}
+	alignData();
+	node.IntOffset = offset;
+	node.IntCodec = BLC_Array;
+	node.IntWords = intSize;
+	writeBytes( intent, intSize * sizeof( DWORD ) );
+}
+
+// Reads {"Count":N,"Inds":[...]} or {"Count":N,"Names":[...]} into inds.
+//  Any other value has no binary form.
+bool CBinaryLatticeWriter::readInds( const rapidjson::Value& json, std::map<std::string,DWORD>& names, bool& useNames )
+{
+	if( !json.IsObject() ) {
+		return false;
+	}
+	const bool hasCount = json.HasMember( "Count" );
+	useNames = json.HasMember( "Names" );
+	const char* arrayName = useNames ? "Names" : "Inds";
+	if( !json.HasMember( arrayName ) || json.MemberCount() != ( hasCount ? 2 : 1 ) ) {
+		return false;
+	}
+	const rapidjson::Value& arr = json[arrayName];
+	if( !arr.IsArray() || ( hasCount && ( !json["Count"].IsUint() || json["Count"].GetUint() != arr.Size() ) ) ) {
+		return false;
+	}
+
+	inds.resize( arr.Size() );
+	for( DWORD i = 0; i < arr.Size(); ++i ) {
+		const rapidjson::Value& v = arr[i];
+		if( useNames ) {
+			if( !v.IsString() ) {
+				return false;
+			}
+			const string name( v.GetString(), v.GetStringLength() );
+			map<string,DWORD>::const_iterator itr = names.find( name );
+			if( itr == names.end() ) {
+				itr = names.insert( pair<string,DWORD>( name, names.size() ) ).first;
+			}
+			inds[i] = itr->second;
+		} else {
+			if( !v.IsUint() ) {
+				return false;
+			}
+			inds[i] = v.GetUint();
+		}
+	}
+	return true;
+}
+
+// Writes the names in the order of their indices, returns the string index of the first one
+DWORD CBinaryLatticeWriter::writeNames( const std::map<std::string,DWORD>& names )
+{
+	vector<const string*> ordered( names.size(), 0 );
+	for( map<string,DWORD>::const_iterator itr = names.begin(); itr != names.end(); ++itr ) {
+		ordered[itr->second] = &itr->first;
+	}
+	const DWORD first = strings.size() / 2;
+	for( DWORD i = 0; i < ordered.size(); ++i ) {
+		addString( *ordered[i] );
+	}
+	return first;
+}
+
+////////////////////////////////////////////////////////////////////
+
+CBinaryLatticeReader::CBinaryLatticeReader( const std::string& path ) :
+	data( 0 ),
+	header( 0 ),
+	nodes( 0 ),
+	arcRows( 0 ),
+	arcs( 0 ),
+	strings( 0 )
+{
+	static const char place[] = "CBinaryLatticeReader::CBinaryLatticeReader";
+	try {
+		boost::interprocess::file_mapping( path.c_str(), boost::interprocess::read_only ).swap( mapping );
+		boost::interprocess::mapped_region( mapping, boost::interprocess::read_only ).swap( region );
+	} catch( boost::interprocess::interprocess_exception& e ) {
+		throw new CTextException( place, "Cannot map the file '" + path + "': " + e.what() );
+	}
+
+	data = static_cast<const char*>( region.get_address() );
+	const size_t size = region.get_size();
+	header = reinterpret_cast<const CBinaryLatticeHeader*>( data );
+	if( size < sizeof( CBinaryLatticeHeader )
+		|| memcmp( header->Magic, binaryLatticeMagic, sizeof( binaryLatticeMagic ) ) != 0 )
+	{
+		throw new CTextException( place, "'" + path + "' is not a binary lattice" );
+	}
+	if( header->Version != binaryLatticeVersion ) {
+		throw new CTextException( place, "Unsupported version of the binary lattice '" + path + "'" );
+	}
+	if( header->NodesOffset + static_cast<uint64_t>( header->NodesCount ) * sizeof( CBinaryLatticeNode ) > size
+		|| header->ArcsOffset + ( static_cast<uint64_t>( header->NodesCount ) + 1 + header->ArcsCount ) * sizeof( DWORD ) > size
+		|| header->StringsOffset + static_cast<uint64_t>( header->StringsCount ) * 2 * sizeof( uint64_t ) > size )
+	{
+		throw new CTextException( place, "The binary lattice '" + path + "' is truncated" );
+	}
+
+	nodes = reinterpret_cast<const CBinaryLatticeNode*>( data + header->NodesOffset );
+	arcRows = reinterpret_cast<const DWORD*>( data + header->ArcsOffset );
+	arcs = arcRows + header->NodesCount + 1;
+	strings = reinterpret_cast<const uint64_t*>( data + header->StringsOffset );
+	validate( path );
+}
+
+// Checks that all offsets of the nodes, the arcs and the strings are inside the file,
+//  so the getters never read out of the mapped region
+void CBinaryLatticeReader::validate( const std::string& path ) const
+{
+	static const char place[] = "CBinaryLatticeReader::validate";
+	const uint64_t size = region.get_size();
+	if( header->NodesOffset % sizeof( uint64_t ) != 0 || header->ArcsOffset % sizeof( DWORD ) != 0
+		|| header->StringsOffset % sizeof( uint64_t ) != 0 || header->NodesOffset < sizeof( CBinaryLatticeHeader ) )
+	{
+		throw new CTextException( place, "The sections of the binary lattice '" + path + "' are misplaced" );
+	}
+	for( DWORD i = 0; i < header->StringsCount; ++i ) {
+		if( strings[2 * i] > size || strings[2 * i + 1] > size - strings[2 * i] ) {
+			throw new CTextException( place, "The string " + StdExt::to_string( i )
+				+ " of the binary lattice '" + path + "' is out of the file" );
+		}
+	}
+	if( !isStringValid( header->Params )
+		|| ( header->ObjNamesCount > 0 && static_cast<uint64_t>( header->ObjNames ) + header->ObjNamesCount > header->StringsCount )
+		|| ( header->AttrNamesCount > 0 && static_cast<uint64_t>( header->AttrNames ) + header->AttrNamesCount > header->StringsCount ) )
+	{
+		throw new CTextException( place, "The header of the binary lattice '" + path + "' refers to absent strings" );
+	}
+	for( DWORD i = 0; i < header->NodesCount; ++i ) {
+		const CBinaryLatticeNode& node = nodes[i];
+		// The intent array is read by its size, the other arrays by the number of words
+		if( !isDataValid( node.ExtCodec, node.ExtOffset, node.ExtWords )
+			|| !isDataValid( node.IntCodec, node.IntOffset, node.IntCodec == BLC_Array ? node.IntSize : node.IntWords )
+			|| ( node.Extra != BinaryLatticeNoString && !isStringValid( node.Extra ) )
+			|| ( node.ExtCodec == BLC_Bitmap && static_cast<uint64_t>( node.ExtWords ) * 32 < node.ExtSize ) )
+		{
+			throw new CTextException( place, "The node " + StdExt::to_string( i )
+				+ " of the binary lattice '" + path + "' is broken" );
+		}
+	}
+	if( arcRows[0] != 0 || arcRows[header->NodesCount] != header->ArcsCount ) {
+		throw new CTextException( place, "The arcs of the binary lattice '" + path + "' are broken" );
+	}
+	for( DWORD i = 0; i < header->NodesCount; ++i ) {
+		if( arcRows[i + 1] < arcRows[i] ) {
+			throw new CTextException( place, "The arcs of the binary lattice '" + path + "' are broken" );
+		}
+	}
+	for( DWORD i = 0; i < header->ArcsCount; ++i ) {
+		if( arcs[i] >= header->NodesCount ) {
+			throw new CTextException( place, "The arcs of the binary lattice '" + path + "' refer to absent nodes" );
+		}
+	}
+}
+
+// Checks that an extent or an intent is inside the data section
+bool CBinaryLatticeReader::isDataValid( uint8_t codec, uint64_t offset, DWORD words ) const
+{
+	switch( codec ) {
+	case BLC_None:
+		return true;
+	case BLC_Array:
+	case BLC_Bitmap:
+		return offset % sizeof( DWORD ) == 0 && offset >= sizeof( CBinaryLatticeHeader )
+			&& offset <= header->NodesOffset
+			&& static_cast<uint64_t>( words ) * sizeof( DWORD ) <= header->NodesOffset - offset;
+	case BLC_Json:
+		return offset < header->StringsCount;
+	default:
+		return false;
+	}
+}
+
+bool CBinaryLatticeReader::GetExtent( DWORD i, std::vector<DWORD>& ext ) const
+{
+	const CBinaryLatticeNode& node = GetNode( i );
+	ext.clear();
+	switch( node.ExtCodec ) {
+	case BLC_Array: {
+		const DWORD* inds = getData( node.ExtOffset );
+		ext.assign( inds, inds + node.ExtWords );
+		return true;
+	}
+	case BLC_Bitmap: {
+		const DWORD* words = getData( node.ExtOffset );
+		ext.reserve( node.ExtSize );
+		for( DWORD w = 0; w < node.ExtWords; ++w ) {
+			for( DWORD word = words[w], bit = 0; word != 0; word >>= 1, ++bit ) {
+				if( ( word & 1 ) != 0 ) {
+					ext.push_back( w * 32 + bit );
+				}
+			}
+		}
+		assert( ext.size() == node.ExtSize );
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+const DWORD* CBinaryLatticeReader::GetIntent( DWORD i, DWORD& size ) const
+{
+	const CBinaryLatticeNode& node = GetNode( i );
+	size = node.IntSize;
+	return node.IntCodec == BLC_Array ? getData( node.IntOffset ) : 0;
+}
+
+const DWORD* CBinaryLatticeReader::GetParents( DWORD i, DWORD& count ) const
+{
+	assert( i < header->NodesCount );
+	count = arcRows[i + 1] - arcRows[i];
+	return arcs + arcRows[i];
+}
+
+JSON CBinaryLatticeReader::GetString( DWORD i ) const
+{
+	assert( i < header->StringsCount );
+	return JSON( data + strings[2 * i], strings[2 * i + 1] );
+}
+
+void CBinaryLatticeReader::GetJsonNode( DWORD i, rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& alloc ) const
+{
+	const CBinaryLatticeNode& node = GetNode( i );
+	json.SetObject();
+
+	rapidjson::Value ext;
+	if( node.ExtCodec == BLC_None ) {
+		ext.SetUint( node.ExtSize );
+	} else if( node.ExtCodec == BLC_Json ) {
+		addJsonString( node.ExtOffset, ext, alloc );
+	} else {
+		vector<DWORD> inds;
+		GetExtent( i, inds );
+		const bool useNames = HasAllFlags( node.Flags, BLNF_ExtentNames );
+		addIndsToJson( inds.empty() ? 0 : &inds[0], inds.size(),
+			header->ObjNames, useNames ? header->ObjNamesCount : 0, ext, alloc );
+	}
+	json.AddMember( "Ext", ext, alloc );
+
+	if( node.IntCodec != BLC_None ) {
+		rapidjson::Value intent;
+		if( node.IntCodec == BLC_Json ) {
+			addJsonString( node.IntOffset, intent, alloc );
+		} else {
+			const bool useNames = HasAllFlags( node.Flags, BLNF_IntentNames );
+			addIndsToJson( getData( node.IntOffset ), node.IntSize,
+				header->AttrNames, useNames ? header->AttrNamesCount : 0, intent, alloc );
+		}
+		json.AddMember( "Int", intent, alloc );
+	}
+
+	if( node.Extra != BinaryLatticeNoString ) {
+		rapidjson::Value extra;
+		addJsonString( node.Extra, extra, alloc );
+		for( rapidjson::Value::MemberIterator m = extra.MemberBegin(); m != extra.MemberEnd(); ++m ) {
+			json.AddMember( m->name, m->value, alloc );
+		}
+	}
+	if( HasAllFlags( node.Flags, BLNF_HasInterest ) ) {
+		json.AddMember( "Interest", rapidjson::Value().SetDouble( node.Interest ), alloc );
+	}
+}
+
+// Writes the indices as {"Count":N,"Inds":[...]} or as {"Count":N,"Names":[...]} if namesCount > 0
+void CBinaryLatticeReader::addIndsToJson( const DWORD* inds, DWORD size, DWORD names, DWORD namesCount,
+	rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& alloc ) const
+{
+	json.SetObject()
+		.AddMember( "Count", rapidjson::Value().SetUint( size ), alloc );
+	rapidjson::Value arr;
+	arr.SetArray();
+	arr.Reserve( size, alloc );
+	for( DWORD i = 0; i < size; ++i ) {
+		if( namesCount > 0 ) {
+			if( inds[i] >= namesCount ) {
+				throw new CTextException( "CBinaryLatticeReader::addIndsToJson", "Broken name index in the binary lattice" );
+			}
+			const JSON name = GetString( names + inds[i] );
+			arr.PushBack( rapidjson::Value().SetString( name.c_str(), name.length(), alloc ), alloc );
+		} else {
+			arr.PushBack( rapidjson::Value().SetUint( inds[i] ), alloc );
+		}
+	}
+	json.AddMember( namesCount > 0 ? "Names" : "Inds", arr, alloc );
+}
+
+void CBinaryLatticeReader::addJsonString( DWORD i, rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& alloc ) const
+{
+	assert( i < header->StringsCount );
+	rapidjson::Document doc( &alloc );
+	doc.Parse( data + strings[2 * i], strings[2 * i + 1] );
+	if( doc.HasParseError() ) {
+		throw new CTextException( "CBinaryLatticeReader::addJsonString", "Broken JSON value in the binary lattice" );
+	}
+	json = doc.Move();
+}
+
+////////////////////////////////////////////////////////////////////
+
+bool IsBinaryLatticeFile( const std::string& path )
+{
+	FILE* file = fopen( path.c_str(), "rb" );
+	if( file == 0 ) {
+		return false;
+	}
+	char magic[sizeof( binaryLatticeMagic )];
+	const bool result = fread( magic, 1, sizeof( magic ), file ) == sizeof( magic )
+		&& memcmp( magic, binaryLatticeMagic, sizeof( magic ) ) == 0;
+	fclose( file );
+	return result;
+}
+
+bool HasBinaryLatticeExt( const std::string& path )
+{
+	const size_t extLength = strlen( BinaryLatticeExt );
+	return path.length() >= extLength
+		&& path.compare( path.length() - extLength, extLength, BinaryLatticeExt ) == 0;
+}
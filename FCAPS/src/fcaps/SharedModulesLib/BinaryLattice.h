@@ -0,0 +1,223 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Compact binary format of a lattice (a result of concept computation).
+//  It keeps the same information as the JSON lattice [{Params},{Nodes},{Arcs}],
+//  but can be read by mmap without any parsing.
+//
+//  Layout of the file:
+//   CBinaryLatticeHeader
+//   Data section: extents and intents of the nodes as arrays of DWORDs, and the strings
+//   Node table: NodesCount records of CBinaryLatticeNode
+//   Arcs in CSR form: (NodesCount+1) DWORD row starts and ArcsCount DWORDs of parents (S) of every node (D)
+//   String table: StringsCount pairs of uint64_t (offset, length) of the strings kept in the data section
+//
+//  Extents are stored either as a sorted array of indices or as a bitmap, whichever is shorter.
+//  Intents are arrays of attribute indices (sorted, as they are produced by the pattern managers). The parts of a node that have no binary form
+//   (e.g., interval intents or additional quality fields) are kept as JSON in the string table.
+
+#ifndef BINARYLATTICE_H
+#define BINARYLATTICE_H
+
+#include <common.h>
+
+#include <fcaps/BasicTypes.h>
+
+#include <JSONTools.h>
+
+#include <rapidjson/document.h>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <stdint.h>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+
+// The extension of binary lattice files
+const char BinaryLatticeExt[] = ".bin";
+// The index of an absent string
+const DWORD BinaryLatticeNoString = static_cast<DWORD>( -1 );
+
+// Codecs for extents and intents of a node
+enum TBinaryLatticeCodec {
+	// Only the size is known
+	BLC_None = 0,
+	// Array of indices
+	BLC_Array,
+	// Bitmap of indices, 32 bits per DWORD
+	BLC_Bitmap,
+	// JSON value from the string table
+	BLC_Json,
+
+	BLC_EnumCount
+};
+
+// Flags of a node
+enum TBinaryLatticeNodeFlags {
+	// Extent indices should be written as names of objects
+	BLNF_ExtentNames = 1,
+	// Intent indices should be written as names of attributes
+	BLNF_IntentNames = 2,
+	// Interest of the node is set
+	BLNF_HasInterest = 4
+};
+
+#pragma pack(push, 8)
+struct CBinaryLatticeHeader {
+	char Magic[8];
+	DWORD Version;
+	DWORD NodesCount;
+	DWORD ArcsCount;
+	DWORD StringsCount;
+	// String index of the lattice params (DATA[0])
+	DWORD Params;
+	// The first string index and the number of names of objects and attributes
+	DWORD ObjNames;
+	DWORD ObjNamesCount;
+	DWORD AttrNames;
+	DWORD AttrNamesCount;
+	DWORD Reserved;
+	uint64_t NodesOffset;
+	uint64_t ArcsOffset;
+	uint64_t StringsOffset;
+};
+
+struct CBinaryLatticeNode {
+	// Offset of the extent/intent in the data section (or the string index for BLC_Json)
+	uint64_t ExtOffset;
+	uint64_t IntOffset;
+	// The number of elements and the number of stored DWORDs
+	DWORD ExtSize;
+	DWORD ExtWords;
+	DWORD IntSize;
+	DWORD IntWords;
+	// TBinaryLatticeCodec
+	uint8_t ExtCodec;
+	uint8_t IntCodec;
+	// TBinaryLatticeNodeFlags
+	uint16_t Flags;
+	// String index of a JSON object with the rest of the node fields
+	DWORD Extra;
+	double Interest;
+};
+#pragma pack(pop)
+
+////////////////////////////////////////////////////////////////////
+
+// Writes a binary lattice, the nodes are written as soon as they are added
+class CBinaryLatticeWriter {
+public:
+	CBinaryLatticeWriter( const std::string& path );
+	~CBinaryLatticeWriter();
+
+	// Params of the lattice, i.e., DATA[0]
+	void SetParams( const JSON& params );
+
+	// Adds a node given as an element of DATA[1].Nodes
+	void AddNode( const rapidjson::Value& node );
+	// Adds a binary node. ext can be null if only the size is known
+	void AddNode( const DWORD* ext, DWORD extSize, const DWORD* intent, DWORD intSize,
+		const JSON& extra = JSON() );
+	// Adds an arc from s to d, s is a parent of d
+	void AddArc( DWORD s, DWORD d );
+
+	// Writes the node table, the arcs and the strings.
+	//  Called by destructor if not yet called, but then the errors are ignored.
+	void Close();
+
+private:
+	FILE* file;
+	// Current offset in the file
+	uint64_t offset;
+	std::vector<CBinaryLatticeNode> nodes;
+	// Arcs as (D,S) pairs, converted to CSR on close
+	std::vector< std::pair<DWORD,DWORD> > arcs;
+	// Offsets and lengths of strings
+	std::vector<uint64_t> strings;
+	JSON params;
+	// Names of objects and attributes found in the nodes
+	std::map<std::string,DWORD> objNames;
+	std::map<std::string,DWORD> attrNames;
+	// Temporary storage for indices and bitmaps
+	std::vector<DWORD> inds;
+	std::vector<DWORD> bitmap;
+
+	CBinaryLatticeWriter( const CBinaryLatticeWriter& );
+	CBinaryLatticeWriter& operator=( const CBinaryLatticeWriter& );
+
+	void writeBytes( const void* data, size_t size );
+	void alignData();
+	DWORD addString( const std::string& str );
+	void writeExtent( const DWORD* ext, DWORD extSize, CBinaryLatticeNode& node );
+	void writeIntent( const DWORD* intent, DWORD intSize, CBinaryLatticeNode& node );
+	bool readInds( const rapidjson::Value& json, std::map<std::string,DWORD>& names, bool& useNames );
+	DWORD writeNames( const std::map<std::string,DWORD>& names );
+};
+
+////////////////////////////////////////////////////////////////////
+
+// Reads a binary lattice by mapping the file to memory
+class CBinaryLatticeReader {
+public:
+	CBinaryLatticeReader( const std::string& path );
+
+	DWORD GetNodesCount() const
+		{ return header->NodesCount; }
+	DWORD GetArcsCount() const
+		{ return header->ArcsCount; }
+	JSON GetParams() const
+		{ return GetString( header->Params ); }
+
+	const CBinaryLatticeNode& GetNode( DWORD i ) const
+		{ assert( i < header->NodesCount ); return nodes[i]; }
+
+	DWORD GetExtentSize( DWORD i ) const
+		{ return GetNode(i).ExtSize; }
+	// Decodes the extent of the node, returns false if only the size of the extent is known
+	bool GetExtent( DWORD i, std::vector<DWORD>& ext ) const;
+	// Returns the sorted array of intent attributes, or null if the intent is not binary
+	const DWORD* GetIntent( DWORD i, DWORD& size ) const;
+	// Returns the parents of the node in the lattice
+	const DWORD* GetParents( DWORD i, DWORD& count ) const;
+
+	DWORD GetStringsCount() const
+		{ return header->StringsCount; }
+	JSON GetString( DWORD i ) const;
+
+	// Converts the node to the JSON form of DATA[1].Nodes
+	void GetJsonNode( DWORD i, rapidjson::Value& node, rapidjson::MemoryPoolAllocator<>& alloc ) const;
+
+private:
+	boost::interprocess::file_mapping mapping;
+	boost::interprocess::mapped_region region;
+	const char* data;
+	const CBinaryLatticeHeader* header;
+	const CBinaryLatticeNode* nodes;
+	const DWORD* arcRows;
+	const DWORD* arcs;
+	const uint64_t* strings;
+
+	const DWORD* getData( uint64_t offset ) const
+		{ return reinterpret_cast<const DWORD*>( data + offset ); }
+	void validate( const std::string& path ) const;
+	bool isDataValid( uint8_t codec, uint64_t offset, DWORD words ) const;
+	bool isStringValid( DWORD i ) const
+		{ return i < header->StringsCount; }
+	void addIndsToJson( const DWORD* inds, DWORD size, DWORD names, DWORD namesCount,
+		rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& alloc ) const;
+	void addJsonString( DWORD i, rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& alloc ) const;
+};
+
+////////////////////////////////////////////////////////////////////
+
+// Checks if the file is a binary lattice
+bool IsBinaryLatticeFile( const std::string& path );
+// Checks if the path has the extension of the binary lattice
+bool HasBinaryLatticeExt( const std::string& path );
+
+#endif // BINARYLATTICE_H
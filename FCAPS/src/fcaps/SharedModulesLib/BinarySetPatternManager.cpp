@@ -3,19 +3,187 @@
 #include "BinarySetPatternManager.h"
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 #include <rapidjson/document.h>
 
 ////////////////////////////////////////////////////////////////////
 
 #include "ParallelListIteration.inl"
 
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
 using namespace std;
 
 ////////////////////////////////////////////////////////////////////
 
+// If an array is this times longer than the other one, the elements of the shorter are searched in the longer
+static const size_t GallopingRatio = 32;
+
+// Finds the first element not less than value by the exponential search
+static const DWORD* gallop( const DWORD* begin, const DWORD* end, DWORD value )
+{
+	const DWORD* lo = begin;
+	const DWORD* hi = begin;
+	for( size_t step = 1; hi < end && *hi < value; step *= 2 ) {
+		lo = hi + 1;
+		hi = static_cast<size_t>( end - hi ) > step ? hi + step : end;
+	}
+	return lower_bound( lo, hi, value );
+}
+
+static void intersectArrays( const vector<DWORD>& first, const vector<DWORD>& second, vector<DWORD>& result )
+{
+	const bool isFirstSmaller = first.size() <= second.size();
+	const vector<DWORD>& small = isFirstSmaller ? first : second;
+	const vector<DWORD>& big = isFirstSmaller ? second : first;
+	if( small.empty() ) {
+		return;
+	}
+	const DWORD* a = &small[0];
+	const DWORD* b = &big[0];
+	const size_t aSize = small.size();
+	const size_t bSize = big.size();
+	result.reserve( aSize );
+
+	if( aSize * GallopingRatio < bSize ) {
+		const DWORD* bEnd = b + bSize;
+		for( size_t i = 0; i < aSize && b != bEnd; ++i ) {
+			b = gallop( b, bEnd, a[i] );
+			if( b != bEnd && *b == a[i] ) {
+				result.push_back( a[i] );
+				++b;
+			}
+		}
+		return;
+	}
+
+	size_t i = 0;
+	size_t j = 0;
+#ifdef USE_SSE2
+	// Blocks of 4 elements are compared all against all by the rotations of the second block
+	while( i + 4 <= aSize && j + 4 <= bSize ) {
+		const __m128i va = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) );
+		const __m128i vb = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + j ) );
+		__m128i eq = _mm_cmpeq_epi32( va, vb );
+		eq = _mm_or_si128( eq, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE( 0, 3, 2, 1 ) ) ) );
+		eq = _mm_or_si128( eq, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE( 1, 0, 3, 2 ) ) ) );
+		eq = _mm_or_si128( eq, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE( 2, 1, 0, 3 ) ) ) );
+		const int mask = _mm_movemask_ps( _mm_castsi128_ps( eq ) );
+		for( int k = 0; k < 4; ++k ) {
+			if( ( mask & ( 1 << k ) ) != 0 ) {
+				result.push_back( a[i + k] );
+			}
+		}
+		const DWORD aLast = a[i + 3];
+		const DWORD bLast = b[j + 3];
+		if( aLast <= bLast ) {
+			i += 4;
+		}
+		if( bLast <= aLast ) {
+			j += 4;
+		}
+	}
+#endif
+	while( i < aSize && j < bSize ) {
+		if( a[i] < b[j] ) {
+			++i;
+		} else if( a[i] > b[j] ) {
+			++j;
+		} else {
+			result.push_back( a[i] );
+			++i;
+			++j;
+		}
+	}
+}
+
+static bool isSubsetArray( const vector<DWORD>& subset, const vector<DWORD>& set )
+{
+	if( subset.size() > set.size() ) {
+		return false;
+	}
+	if( subset.size() * GallopingRatio >= set.size() ) {
+		return includes( set.begin(), set.end(), subset.begin(), subset.end() );
+	}
+	const DWORD* b = set.empty() ? 0 : &set[0];
+	const DWORD* bEnd = b + set.size();
+	for( size_t i = 0; i < subset.size(); ++i ) {
+		b = gallop( b, bEnd, subset[i] );
+		if( b == bEnd || *b != subset[i] ) {
+			return false;
+		}
+		++b;
+	}
+	return true;
+}
+
+// The bitsets have no trailing zero words
+static void intersectBitsets( const vector<DWORD>& first, const vector<DWORD>& second, vector<DWORD>& result )
+{
+	result.resize( min( first.size(), second.size() ) );
+	for( size_t i = 0; i < result.size(); ++i ) {
+		result[i] = first[i] & second[i];
+	}
+	while( !result.empty() && result.back() == 0 ) {
+		result.pop_back();
+	}
+}
+
+static void unionBitsets( const vector<DWORD>& first, const vector<DWORD>& second, vector<DWORD>& result )
+{
+	const vector<DWORD>& longer = first.size() >= second.size() ? first : second;
+	const vector<DWORD>& shorter = first.size() >= second.size() ? second : first;
+	result = longer;
+	for( size_t i = 0; i < shorter.size(); ++i ) {
+		result[i] |= shorter[i];
+	}
+}
+
+static bool isSubsetBitset( const vector<DWORD>& subset, const vector<DWORD>& set )
+{
+	if( subset.size() > set.size() ) {
+		return false;
+	}
+	for( size_t i = 0; i < subset.size(); ++i ) {
+		if( ( subset[i] & ~set[i] ) != 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Guards building of the lists of packed patterns, it is needed only once per pattern
+static boost::mutex listBuildMutex;
+
 CBinarySetPatternDescriptor::CBinarySetPatternDescriptor() :
-	hash( 0 )
+	isListBuilt( true ),
+	hash( 0 ),
+	representation( BSR_List ),
+	packedSize( 0 )
+{
+}
+
+// The atomic flag is not copyable, the list of other can be being built in another thread
+CBinarySetPatternDescriptor::CBinarySetPatternDescriptor( const CBinarySetPatternDescriptor& other ) :
+	isListBuilt( false ),
+	hash( other.hash ),
+	representation( other.representation ),
+	packed( other.packed ),
+	packedSize( other.packedSize )
 {
+	boost::mutex::scoped_lock lock( listBuildMutex );
+	other.attribsSet.CopyTo( attribsSet );
+	isListBuilt.store( other.isListBuilt.load( memory_order_relaxed ), memory_order_relaxed );
 }
 
 CBinarySetPatternDescriptor::~CBinarySetPatternDescriptor()
@@ -23,18 +191,41 @@ CBinarySetPatternDescriptor::~CBinarySetPatternDescriptor()
 
 }
 
+// Mixes the next attribute to the hash
+static inline void addToHash( size_t& hash, char& shift, DWORD value )
+{
+	const char maxShift = sizeof( size_t ) << 3;
+	const char headShift = shift + (sizeof(DWORD) << 3) - maxShift;
+	hash ^= ((value << shift) | (headShift > 0 ? (value >> headShift) : 0 ) );
+	shift = ((shift + 5) % maxShift );
+}
+
 size_t CBinarySetPatternDescriptor::Hash() const
 {
 	if( hash != 0 ) {
 		return hash;
 	}
-	CStdIterator<CList<DWORD>::CConstIterator, false> itr( attribsSet );
+	// The hash does not depend on the representation and does not need the list
 	char shift = 0;
-	const char maxShift = sizeof( size_t ) << 3;
-	for( ; !itr.IsEnd(); ++itr, shift = ((shift + 5) % maxShift )) {
-		const DWORD value = *itr;
-		const char headShift = shift + (sizeof(DWORD) << 3) - maxShift;
-		hash ^= ((value << shift) | (headShift > 0 ? (value >> headShift) : 0 ) );
+	if( isListBuilt.load( memory_order_acquire ) ) {
+		CStdIterator<CList<DWORD>::CConstIterator, false> itr( attribsSet );
+		for( ; !itr.IsEnd(); ++itr ) {
+			addToHash( hash, shift, *itr );
+		}
+	} else if( representation == BSR_Array ) {
+		for( size_t i = 0; i < packed.size(); ++i ) {
+			addToHash( hash, shift, packed[i] );
+		}
+	} else {
+		assert( representation == BSR_Bitset );
+		for( size_t i = 0; i < packed.size(); ++i ) {
+			DWORD word = packed[i];
+			for( DWORD bit = 0; word != 0; ++bit, word >>= 1 ) {
+				if( ( word & 1 ) != 0 ) {
+					addToHash( hash, shift, i * 32 + bit );
+				}
+			}
+		}
 	}
 	if( hash == 0 ) {
 		// hash == 0 is not valable
@@ -43,8 +234,34 @@ size_t CBinarySetPatternDescriptor::Hash() const
 	return hash;
 }
 
+void CBinarySetPatternDescriptor::buildList() const
+{
+	boost::mutex::scoped_lock lock( listBuildMutex );
+	if( isListBuilt.load( memory_order_relaxed ) ) {
+		return;
+	}
+	assert( attribsSet.IsEmpty() );
+	if( representation == BSR_Array ) {
+		for( size_t i = 0; i < packed.size(); ++i ) {
+			attribsSet.PushBack( packed[i] );
+		}
+	} else {
+		assert( representation == BSR_Bitset );
+		for( size_t i = 0; i < packed.size(); ++i ) {
+			DWORD word = packed[i];
+			for( DWORD bit = 0; word != 0; ++bit, word >>= 1 ) {
+				if( ( word & 1 ) != 0 ) {
+					attribsSet.PushBack( i * 32 + bit );
+				}
+			}
+		}
+	}
+	isListBuilt.store( true, memory_order_release );
+}
+
 void CBinarySetPatternDescriptor::AddNextAttribNumber( DWORD attribNum )
 {
+	dropPacked();
 	if( attribsSet.IsEmpty() ) {
 		attribsSet.PushBack( attribNum );
 		hash = 0;
@@ -106,6 +323,11 @@ STR(\
 		"UseNames":{\
 			"description": "Should write pattern attributes by their names",\
 			"type":"boolean"\
+		},\
+		"Representation":{\
+			"description": "The contiguous copy of patterns used for comparison: a sorted array or a bitset (for a small number of attributes)",\
+			"type":"string",\
+			"enum":["List","Array","Bitset"]\
 		}\
 	}\
 )
@@ -122,9 +344,13 @@ const char CBinarySetDescriptorsComparatorBase::jsonUseNames[] = "UseNames";
 const char CBinarySetDescriptorsComparatorBase::jsonInds[] = "Inds";
 const char CBinarySetDescriptorsComparatorBase::jsonNames[] = "Names";
 const char CBinarySetDescriptorsComparatorBase::jsonCount[] = "Count";
+const char CBinarySetDescriptorsComparatorBase::jsonRepresentation[] = "Representation";
+
+static const char* const representationNames[BSR_EnumCount] = { "List", "Array", "Bitset" };
 
 CBinarySetDescriptorsComparatorBase::CBinarySetDescriptorsComparatorBase() :
-	flags( BSDC_UseInds )
+	flags( BSDC_UseInds ),
+	representation( BSR_List )
 {
 
 }
@@ -166,6 +392,17 @@ void CBinarySetDescriptorsComparatorBase::LoadParams( const JSON& json )
 			flags &= ~BSDC_UseNames;
 		}
 	}
+	if( params.HasMember( jsonRepresentation ) && params[jsonRepresentation].IsString() ) {
+		const string name = params[jsonRepresentation].GetString();
+		int i = 0;
+		for( ; i < BSR_EnumCount && name != representationNames[i]; ++i ) {
+		}
+		if( i == BSR_EnumCount ) {
+			throw new CJsonException( "CBinarySetDescriptorsComparator",
+				CJsonError( json, "Unknown Representation '" + name + "', should be List, Array or Bitset" ) );
+		}
+		representation = static_cast<TBinarySetRepresentation>( i );
+	}
 }
 JSON CBinarySetDescriptorsComparatorBase::SaveParams() const
 {
@@ -179,7 +416,8 @@ JSON CBinarySetDescriptorsComparatorBase::SaveParams() const
 		.AddMember( "Params", rapidjson::Value().SetObject(), params.GetAllocator() );
 	params["Params"]
 		.AddMember( jsonUseNames, rapidjson::Value().SetBool( HasAllFlags( flags, BSDC_UseNames ) ), params.GetAllocator() )
-		.AddMember( jsonUseInds, rapidjson::Value().SetBool( HasAllFlags( flags, BSDC_UseInds ) ), params.GetAllocator() ) ;
+		.AddMember( jsonUseInds, rapidjson::Value().SetBool( HasAllFlags( flags, BSDC_UseInds ) ), params.GetAllocator() )
+		.AddMember( jsonRepresentation, rapidjson::StringRef( representationNames[representation] ), params.GetAllocator() );
 	if( !names.empty() ) {
 		params["Params"].AddMember( jsonAttrNames, rapidjson::Value().SetArray(), params.GetAllocator() );
 		rapidjson::Value& namesJson = params["Params"][jsonAttrNames];
@@ -206,6 +444,41 @@ JSON CBinarySetDescriptorsComparatorBase::SavePattern( const IPatternDescriptor*
 {
 	return savePattern( ptrn );
 }
+void CBinarySetDescriptorsComparatorBase::WritePattern( const IPatternDescriptor* ptrn, CJsonFileWriter& dst ) const
+{
+	assert( ptrn != 0 && dynamic_cast<const CBinarySetPatternDescriptor*>(ptrn) != 0  );
+
+	const CBinarySetPatternDescriptor& pattern = debug_cast<const CBinarySetPatternDescriptor&>( *ptrn );
+	const CBinarySetPatternDescriptor::CAttrsList& attrs = pattern.GetAttribs();
+
+	CJsonFileWriter::TWriter& writer = dst.Writer();
+	writer.StartObject();
+	writer.Key( jsonCount );
+	writer.Uint( attrs.Size() );
+	if( HasAllFlags( flags, BSDC_UseInds ) ) {
+		writer.Key( jsonInds );
+		writer.StartArray();
+		CStdIterator<CBinarySetPatternDescriptor::CAttrsList::CConstIterator, false> itr( attrs );
+		for( ; !itr.IsEnd(); ++itr ) {
+			writer.Uint( *itr );
+		}
+		writer.EndArray();
+	}
+	if( HasAllFlags( flags, BSDC_UseNames ) && !names.empty() ) {
+		writer.Key( jsonNames );
+		writer.StartArray();
+		CStdIterator<CBinarySetPatternDescriptor::CAttrsList::CConstIterator, false> itr( attrs );
+		for( ; !itr.IsEnd(); ++itr ) {
+			if( *itr < names.size() ) {
+				dst.String( names[*itr] );
+			} else {
+				writer.Uint( *itr );
+			}
+		}
+		writer.EndArray();
+	}
+	writer.EndObject();
+}
 const CBinarySetPatternDescriptor* CBinarySetDescriptorsComparatorBase::LoadPattern( const JSON& json )
 {
 	return LoadRWPattern( json );
@@ -261,6 +534,19 @@ inline CBinarySetPatternDescriptor* CBinarySetDescriptorsComparatorBase::UnionSe
 	CBinarySetPatternDescriptor* result = NewPattern();
 	unique_ptr<CBinarySetPatternDescriptor> resultPattern( result );
 
+	if( isPacked( first, second ) ) {
+		vector<DWORD> packed;
+		if( representation == BSR_Array ) {
+			packed.reserve( first.packed.size() + second.packed.size() );
+			set_union( first.packed.begin(), first.packed.end(),
+				second.packed.begin(), second.packed.end(), back_inserter( packed ) );
+		} else {
+			unionBitsets( first.packed, second.packed, packed );
+		}
+		setPacked( packed, *result );
+		return resultPattern.release();
+	}
+
 	PARALLEL_LIST_ITERATION_BEGIN( CBinarySetPatternDescriptor::CAttrsList, CBinarySetPatternDescriptor::CAttrsList::CConstIterator, first.GetAttribs(), second.GetAttribs(), firstIter, lastIter );
 		result->AddSortedNextAttribNumber( *firstIter < *lastIter ? *firstIter : *lastIter );
 	PARALLEL_LIST_ITERATION_END( firstIter, lastIter );
@@ -279,6 +565,16 @@ CBinarySetPatternDescriptor* CBinarySetDescriptorsComparatorBase::IntersectSets(
 {
 	CBinarySetPatternDescriptor* result = NewPattern();
 	unique_ptr<CBinarySetPatternDescriptor> resultPattern( result );
+	if( isPacked( first, second ) ) {
+		vector<DWORD> packed;
+		if( representation == BSR_Array ) {
+			intersectArrays( first.packed, second.packed, packed );
+		} else {
+			intersectBitsets( first.packed, second.packed, packed );
+		}
+		setPacked( packed, *result );
+		return resultPattern.release();
+	}
 	PARALLEL_LIST_ITERATION_BEGIN( CBinarySetPatternDescriptor::CAttrsList, CBinarySetPatternDescriptor::CAttrsList::CConstIterator, first.GetAttribs(), second.GetAttribs(), firstIter, lastIter );
 		if( *firstIter == *lastIter ) {
 			result->AddSortedNextAttribNumber( *firstIter );
@@ -290,6 +586,9 @@ CBinarySetPatternDescriptor* CBinarySetDescriptorsComparatorBase::IntersectSets(
 inline bool CBinarySetDescriptorsComparatorBase::IsEqualSets(
 	 const CBinarySetPatternDescriptor& first, const CBinarySetPatternDescriptor& second  ) const
 {
+	if( isPacked( first, second ) ) {
+		return first.packed == second.packed;
+	}
 	PARALLEL_LIST_ITERATION_BEGIN( CBinarySetPatternDescriptor::CAttrsList, CBinarySetPatternDescriptor::CAttrsList::CConstIterator, first.GetAttribs(), second.GetAttribs(), firstItr, lastItr );
 		if( *firstItr != *lastItr ) {
 			return false;
@@ -301,6 +600,9 @@ inline bool CBinarySetDescriptorsComparatorBase::IsEqualSets(
 inline bool CBinarySetDescriptorsComparatorBase::IsSubsetOf(
 	 const CBinarySetPatternDescriptor& subset, const CBinarySetPatternDescriptor& set ) const
 {
+	if( isPacked( subset, set ) ) {
+		return representation == BSR_Array ? isSubsetArray( subset.packed, set.packed ) : isSubsetBitset( subset.packed, set.packed );
+	}
 	PARALLEL_LIST_ITERATION_BEGIN( CBinarySetPatternDescriptor::CAttrsList, CBinarySetPatternDescriptor::CAttrsList::CConstIterator, subset.GetAttribs(), set.GetAttribs(), subsetItr, setItr );
 		if( *setItr > *subsetItr ) {
 			return false;
@@ -331,9 +633,52 @@ CBinarySetPatternDescriptor* CBinarySetDescriptorsComparatorBase::LoadRWPattern(
 		}
 		pattern->AddNextAttribNumber( indsJson[i].GetUint() );
 	}
+	Pack( *pattern );
 	return pattern.release();
 }
 
+void CBinarySetDescriptorsComparatorBase::Pack( CBinarySetPatternDescriptor& pattern ) const
+{
+	pattern.dropPacked();
+	if( representation == BSR_List ) {
+		return;
+	}
+	const CBinarySetPatternDescriptor::CAttrsList& attrs = pattern.attribsSet;
+	if( representation == BSR_Array ) {
+		pattern.packed.assign( attrs.Begin(), attrs.End() );
+	} else {
+		pattern.packed.assign( attrs.IsEmpty() ? 0 : attrs.Back() / 32 + 1, 0 );
+		CStdIterator<CBinarySetPatternDescriptor::CAttrsList::CConstIterator, false> itr( attrs );
+		for( ; !itr.IsEnd(); ++itr ) {
+			pattern.packed[*itr / 32] |= 1u << ( *itr % 32 );
+		}
+	}
+	pattern.packedSize = attrs.Size();
+	pattern.representation = representation;
+}
+
+// Fills the empty pattern by the packed attributes, packed is swapped to the pattern.
+//  The list is built only if somebody asks for it.
+void CBinarySetDescriptorsComparatorBase::setPacked( vector<DWORD>& packed, CBinarySetPatternDescriptor& pattern ) const
+{
+	assert( representation != BSR_List && pattern.attribsSet.IsEmpty() );
+	DWORD size = 0;
+	if( representation == BSR_Array ) {
+		size = packed.size();
+	} else {
+		for( size_t i = 0; i < packed.size(); ++i ) {
+			for( DWORD word = packed[i]; word != 0; word &= word - 1 ) {
+				++size;
+			}
+		}
+	}
+	pattern.packed.swap( packed );
+	pattern.packedSize = size;
+	pattern.representation = representation;
+	pattern.isListBuilt.store( false, memory_order_release );
+	pattern.hash = 0;
+}
+
 JSON CBinarySetDescriptorsComparatorBase::savePattern( const IPatternDescriptor* ptrn ) const
 {
 	assert( ptrn != 0 && dynamic_cast<const CBinarySetPatternDescriptor*>(ptrn) != 0  );
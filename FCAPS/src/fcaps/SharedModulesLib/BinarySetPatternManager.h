@@ -14,8 +14,11 @@
 
 #include <ListWrapper.h>
 
+#include <atomic>
 #include <vector>
 
+class CJsonFileWriter;
+
 ////////////////////////////////////////////////////////////////////
 
 const char BinarySetDescriptorsComparator[] = "BinarySetJoinPatternManagerModule";
@@ -29,21 +32,36 @@ const DWORD BSDC_UseInds = 1;
 // Use string names
 const DWORD BSDC_UseNames = 2;
 
+// Contiguous representations of binary sets for comparison and similarity
+enum TBinarySetRepresentation {
+	// Only the list of attributes
+	BSR_List = 0,
+	// Sorted array of attribute numbers
+	BSR_Array,
+	// Bitset of attributes, 32 bits per DWORD
+	BSR_Bitset,
+
+	BSR_EnumCount
+};
+
 ////////////////////////////////////////////////////////////////////
 
 class CBinarySetDescriptorsComparator;
+class CBinarySetDescriptorsComparatorBase;
 
 class CBinarySetPatternDescriptor : public IPatternDescriptor {
+	friend class CBinarySetDescriptorsComparatorBase;
 public:
 	typedef CList<DWORD> CAttrsList;
 
 public:
 	CBinarySetPatternDescriptor();
+	CBinarySetPatternDescriptor( const CBinarySetPatternDescriptor& other );
 	~CBinarySetPatternDescriptor();
 
 	//Methods of IPatternDescriptor
 	virtual bool IsMostGeneral() const
-		{ return attribsSet.IsEmpty(); }
+		{ return Size() == 0; }
 	virtual size_t Hash() const;
 
 	// Methods of class
@@ -54,19 +72,54 @@ public:
 	// Add a set of attributes to the set.
 	void AddList( const CAttrsList& listToAdd );
 
+	// The number of attributes, the list is not built for it
+	DWORD Size() const
+		{ return representation == BSR_List ? attribsSet.Size() : packedSize; }
+	// The list can be changed, so the packed copy is dropped
 	CAttrsList& GetAttribs()
-		{ return attribsSet; }
+		{ dropPacked(); hash = 0; return attribsSet; }
+	// The list of a pattern computed in the packed form is built on the first call
 	const CAttrsList& GetAttribs() const
-		{ return attribsSet; }
+		{ if( !isListBuilt.load( std::memory_order_acquire ) ) { buildList(); } return attribsSet; }
+
+	// Representation of the packed copy of the list, BSR_List if there is no copy
+	TBinarySetRepresentation GetRepresentation() const
+		{ return representation; }
+	// The sorted attribute numbers or the bitset depending on the representation
+	const std::vector<DWORD>& GetPacked() const
+		{ return packed; }
 
 private:
 	// List of numbers of attributes
-	CAttrsList attribsSet;
+	mutable CAttrsList attribsSet;
+	// False until the list of a pattern computed in the packed form is built
+	mutable std::atomic<bool> isListBuilt;
 	mutable size_t hash;
+	// Contiguous copy of attribsSet
+	TBinarySetRepresentation representation;
+	std::vector<DWORD> packed;
+	// The number of attributes in packed
+	DWORD packedSize;
+
+	void buildList() const;
+	void dropPacked();
 };
 
+inline void CBinarySetPatternDescriptor::dropPacked()
+{
+	if( representation == BSR_List ) {
+		return;
+	}
+	if( !isListBuilt.load( std::memory_order_acquire ) ) {
+		buildList();
+	}
+	representation = BSR_List;
+	packed.clear();
+}
+
 inline void CBinarySetPatternDescriptor::AddSortedNextAttribNumber( DWORD attribNum )
 {
+	dropPacked();
 	if( attribsSet.IsEmpty() ) {
 		attribsSet.PushBack( attribNum );
 		hash = 0;
@@ -83,7 +136,7 @@ inline void CBinarySetPatternDescriptor::AddSortedNextAttribNumber( DWORD attrib
 
 ////////////////////////////////////////////////////////////////////
 
-class CBinarySetDescriptorsComparatorBase : public IPatternManager, public IModule {
+class CBinarySetDescriptorsComparatorBase : public IPatternManager, public IConcurrentPatternManager, public IModule {
 public:
 	CBinarySetDescriptorsComparatorBase();
 
@@ -111,7 +164,13 @@ public:
 
 	virtual void Write( const IPatternDescriptor* pattern, std::ostream& dst ) const;
 
+	// Methods of IConcurrentPatternManager
+	virtual bool IsThreadSafe() const
+		{ return true; }
+
 	// Methods of Class
+	// Writes the pattern directly to the JSON stream in the format of SavePattern
+	void WritePattern( const IPatternDescriptor* ptrn, CJsonFileWriter& dst ) const;
 	// Creating a new pattern
 	virtual CBinarySetPatternDescriptor* NewPattern() const
 		{ return new CBinarySetPatternDescriptor; }
@@ -132,6 +191,11 @@ public:
         { return flags;}
     void SetFlags(DWORD f)
         {flags=f;}
+	// The representation used for comparison of the patterns created by the manager
+	TBinarySetRepresentation GetRepresentation() const
+		{ return representation; }
+	void SetRepresentation( TBinarySetRepresentation r )
+		{ representation = r; }
 
 protected:
 	// Build Set as union of sets
@@ -149,11 +213,14 @@ protected:
 
 	// Loads pattern for read/write
 	CBinarySetPatternDescriptor* LoadRWPattern( const JSON& json );
+	// Creates the packed copy of the pattern in the representation of the manager
+	void Pack( CBinarySetPatternDescriptor& pattern ) const;
 
 private:
 	static const char jsonAttrNames[];
 	static const char jsonUseInds[];
 	static const char jsonUseNames[];
+	static const char jsonRepresentation[];
 	static const char jsonInds[];
 	static const char jsonNames[];
 	static const char jsonCount[];
@@ -162,6 +229,8 @@ private:
 	std::vector<std::string> names;
 	// Flags of processing BSDC_*
 	DWORD flags;
+	// The packed representation of patterns
+	TBinarySetRepresentation representation;
 
 	// Get Object Name
 	virtual const char* getModuleName() const = 0;
@@ -172,6 +241,9 @@ private:
 	virtual TCompareResult fastCompare( DWORD firstSize, DWORD secondSize ) const = 0;
 
 	JSON savePattern( const IPatternDescriptor* ptrn ) const;
+	bool isPacked( const CBinarySetPatternDescriptor& first, const CBinarySetPatternDescriptor& second ) const
+		{ return representation != BSR_List && first.representation == representation && second.representation == representation; }
+	void setPacked( std::vector<DWORD>& packed, CBinarySetPatternDescriptor& pattern ) const;
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -226,8 +298,8 @@ inline TCompareResult CBinarySetDescriptorsComparatorBase::Compare(
 	const CBinarySetPatternDescriptor& first, const CBinarySetPatternDescriptor& second,
 	DWORD interestingResults, DWORD possibleResults ) const
 {
-	const DWORD firstSize = first.GetAttribs().Size();
-	const DWORD secondSize = second.GetAttribs().Size();
+	const DWORD firstSize = first.Size();
+	const DWORD secondSize = second.Size();
 	interestingResults &= possibleResults;
 	const bool isIncomparablePossible = HasAllFlags( possibleResults, CR_Incomparable );
 
@@ -0,0 +1,178 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include <fcaps/SharedModulesLib/ClassMasks.h>
+
+#include <algorithm>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+static const DWORD BlockBits = sizeof( uintptr_t ) * 8;
+
+// Counts the set bits of the block
+static inline DWORD getBitsCount( uintptr_t block )
+{
+#ifdef __GNUC__
+	return __builtin_popcountll( static_cast<unsigned long long>( block ) );
+#else
+	DWORD count = 0;
+	for( ; block != 0; block &= block - 1 ) {
+		++count;
+	}
+	return count;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////
+
+CClassMasks::CClassMasks() :
+	blocksCount( 0 )
+{
+}
+
+bool CClassMasks::Build( const vector<bool>& classes, const vector<double>& weights )
+{
+	assert( classes.size() == weights.size() );
+	levels.clear();
+	objectCodes.clear();
+	masks.clear();
+	blocksCount = 0;
+
+	vector<DWORD> objectLevels( weights.size() );
+	for( DWORD i = 0; i < weights.size(); ++i ) {
+		const DWORD level = find( levels.begin(), levels.end(), weights[i] ) - levels.begin();
+		if( level == levels.size() ) {
+			if( levels.size() == MaxLevelsCount ) {
+				levels.clear();
+				return false;
+			}
+			levels.push_back( weights[i] );
+		}
+		objectLevels[i] = level;
+	}
+	if( levels.empty() ) {
+		return false;
+	}
+
+	blocksCount = ( weights.size() + BlockBits - 1 ) / BlockBits;
+	masks.assign( ( levels.size() == 1 ? 1 : 2 * levels.size() ) * blocksCount, 0 );
+	objectCodes.resize( weights.size() );
+	for( DWORD i = 0; i < weights.size(); ++i ) {
+		const uintptr_t bit = static_cast<uintptr_t>( 1 ) << ( i % BlockBits );
+		if( classes[i] ) {
+			masks[2 * objectLevels[i] * blocksCount + i / BlockBits] |= bit;
+		}
+		if( levels.size() > 1 ) {
+			masks[( 2 * objectLevels[i] + 1 ) * blocksCount + i / BlockBits] |= bit;
+		}
+		objectCodes[i] = static_cast<unsigned char>( 2 * objectLevels[i] + ( classes[i] ? 1 : 0 ) );
+	}
+	return true;
+}
+
+void CClassMasks::GetWeights( const IExtent& ext, double& wPlus, double& wAll ) const
+{
+	assert( IsBuilt() );
+	const IBitsetExtent* bitset = dynamic_cast<const IBitsetExtent*>( &ext );
+	if( bitset != 0 ) {
+		const uintptr_t* blocks = 0;
+		DWORD count = 0;
+		bitset->GetBitset( blocks, count );
+		GetWeights( blocks, count, wPlus, wAll );
+		return;
+	}
+
+	CPatternImage img;
+	CPatternImageHolder holder( &ext, img );
+	GetWeights( img, wPlus, wAll );
+}
+
+void CClassMasks::GetWeights( const uintptr_t* blocks, DWORD count, double& wPlus, double& wAll ) const
+{
+	assert( IsBuilt() );
+	// The bitset has no objects beyond the masks
+	count = min( count, blocksCount );
+	wPlus = 0;
+	wAll = 0;
+	if( levels.size() == 1 ) {
+		const uintptr_t* positive = positiveMask( 0 );
+		DWORD plusCount = 0;
+		DWORD allCount = 0;
+		for( DWORD i = 0; i < count; ++i ) {
+			plusCount += getBitsCount( blocks[i] & positive[i] );
+			allCount += getBitsCount( blocks[i] );
+		}
+		wPlus = levels[0] * plusCount;
+		wAll = levels[0] * allCount;
+		return;
+	}
+	for( DWORD l = 0; l < levels.size(); ++l ) {
+		const uintptr_t* positive = positiveMask( l );
+		const uintptr_t* level = levelMask( l );
+		DWORD plusCount = 0;
+		DWORD allCount = 0;
+		for( DWORD i = 0; i < count; ++i ) {
+			plusCount += getBitsCount( blocks[i] & positive[i] );
+			allCount += getBitsCount( blocks[i] & level[i] );
+		}
+		wPlus += levels[l] * plusCount;
+		wAll += levels[l] * allCount;
+	}
+}
+
+void CClassMasks::BuildPositiveMasks( const vector<bool>& classes, uintptr_t* result ) const
+{
+	assert( IsBuilt() );
+	assert( classes.size() == objectCodes.size() );
+	uintptr_t* const positive = result;
+	fill( positive, positive + blocksCount, 0 );
+	for( DWORD i = 0; i < classes.size(); ++i ) {
+		if( classes[i] ) {
+			positive[i / BlockBits] |= static_cast<uintptr_t>( 1 ) << ( i % BlockBits );
+		}
+	}
+	if( levels.size() == 1 ) {
+		return;
+	}
+	// The first level is written last, since its place is taken by the positive objects
+	for( DWORD l = levels.size(); l > 0; --l ) {
+		const uintptr_t* level = levelMask( l - 1 );
+		uintptr_t* levelPositive = result + ( l - 1 ) * blocksCount;
+		for( DWORD i = 0; i < blocksCount; ++i ) {
+			levelPositive[i] = positive[i] & level[i];
+		}
+	}
+}
+
+double CClassMasks::GetPositiveWeight( const uintptr_t* blocks, DWORD count, const uintptr_t* positiveMasks ) const
+{
+	assert( IsBuilt() );
+	count = min( count, blocksCount );
+	double wPlus = 0;
+	for( DWORD l = 0; l < levels.size(); ++l ) {
+		const uintptr_t* positive = positiveMasks + l * blocksCount;
+		DWORD plusCount = 0;
+		for( DWORD i = 0; i < count; ++i ) {
+			plusCount += getBitsCount( blocks[i] & positive[i] );
+		}
+		wPlus += levels[l] * plusCount;
+	}
+	return wPlus;
+}
+
+void CClassMasks::GetWeights( const CPatternImage& img, double& wPlus, double& wAll ) const
+{
+	assert( IsBuilt() );
+	DWORD counts[2 * MaxLevelsCount] = {};
+	for( int i = 0; i < img.ImageSize; ++i ) {
+		assert( 0 <= img.Objects[i] && img.Objects[i] < objectCodes.size() );
+		++counts[objectCodes[img.Objects[i]]];
+	}
+	wPlus = 0;
+	wAll = 0;
+	for( DWORD l = 0; l < levels.size(); ++l ) {
+		wPlus += levels[l] * counts[2 * l + 1];
+		wAll += levels[l] * ( counts[2 * l] + counts[2 * l + 1] );
+	}
+}
@@ -0,0 +1,63 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Binary classes and weights of objects packed for computing the weights of extents.
+//  The objects with the same weight form a level. Every level has the bitset of its objects and of its positive objects,
+//  so the weights of an extent given by a bitset are popcounts. For a list of objects the objects of every level are counted.
+//  Other labelings of the same objects (e.g., permuted classes) are kept as positive masks only, see BuildPositiveMasks.
+
+#ifndef CLASSMASKS_H
+#define CLASSMASKS_H
+
+#include <common.h>
+
+#include <fcaps/Extent.h>
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+
+class CClassMasks {
+public:
+	// If the weights take more values, the masks are not built
+	static const DWORD MaxLevelsCount = 16;
+
+public:
+	CClassMasks();
+
+	// Builds the masks for the classes and the weights of all objects.
+	//  Returns false if there are too many distinct weights.
+	bool Build( const std::vector<bool>& classes, const std::vector<double>& weights );
+	bool IsBuilt() const
+		{ return !levels.empty(); }
+
+	// Computes the weight of the positive objects and the weight of all objects of the extent
+	void GetWeights( const IExtent& ext, double& wPlus, double& wAll ) const;
+	void GetWeights( const uintptr_t* blocks, DWORD count, double& wPlus, double& wAll ) const;
+	void GetWeights( const CPatternImage& img, double& wPlus, double& wAll ) const;
+
+	// The size of the positive masks of a labeling of the objects in blocks
+	DWORD PositiveMasksSize() const
+		{ return levels.size() * blocksCount; }
+	// Builds the positive masks of every level for other classes of the same objects
+	void BuildPositiveMasks( const std::vector<bool>& classes, uintptr_t* result ) const;
+	// Computes the weight of the positive objects of the extent given the masks from BuildPositiveMasks
+	double GetPositiveWeight( const uintptr_t* blocks, DWORD count, const uintptr_t* positiveMasks ) const;
+
+private:
+	// The weight of every level
+	std::vector<double> levels;
+	// The level of every object multiplied by 2 plus 1 for the positive objects
+	std::vector<unsigned char> objectCodes;
+	// The bitsets of positive objects and of all objects of every level, blocksCount blocks each.
+	//  The bitset of all objects is not kept if there is only one level.
+	std::vector<uintptr_t> masks;
+	DWORD blocksCount;
+
+	const uintptr_t* positiveMask( DWORD level ) const
+		{ return &masks[2 * level * blocksCount]; }
+	const uintptr_t* levelMask( DWORD level ) const
+		{ return &masks[( 2 * level + 1 ) * blocksCount]; }
+};
+
+#endif // CLASSMASKS_H
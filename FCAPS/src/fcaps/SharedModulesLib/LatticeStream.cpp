@@ -0,0 +1,443 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include <fcaps/SharedModulesLib/LatticeStream.h>
+
+#include <fcaps/SharedModulesLib/BinaryLattice.h>
+
+#include <JSONTools.h>
+#include <JsonWriter.h>
+#include <PowerfulSaxJson.h>
+#include <StdTools.h>
+
+#include <rapidjson/reader.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+// Reads one of the parts of a JSON lattice [{Params},{"Nodes":[...]},{"Arcs":[...]}].
+//  Parsing is stopped as soon as the requested part is read.
+class CLatticeSaxReader : public CSaxJsonDefaultTemplate {
+public:
+	enum TPart {
+		P_Params = 1,
+		P_Nodes,
+		P_Arcs
+	};
+
+public:
+	CLatticeSaxReader( TPart _part ) :
+		part( _part ), status( S_Begin ), objectCounter( 0 ),
+		params( 0 ), nodesProcessor( 0 ), arcsProcessor( 0 ),
+		batchSize( 0 ), firstNode( 0 ), s( -1 ), d( -1 ), isFinished( false ) {}
+
+	void SetParams( rapidjson::Document& p )
+		{ assert( part == P_Params ); params = &p; }
+	void SetNodesProcessor( DWORD size, ILatticeNodesProcessor& processor )
+		{ assert( part == P_Nodes ); batchSize = size; nodesProcessor = &processor; batch.SetArray(); }
+	void SetArcsProcessor( ILatticeArcsProcessor& processor )
+		{ assert( part == P_Arcs ); arcsProcessor = &processor; }
+
+	bool IsFinished() const
+		{ return isFinished; }
+
+	// Methods of CSaxJsonDefaultTemplate
+	bool Null() { return true; }
+	bool Bool(bool /*b*/) { return true; }
+	bool Int(int /*i*/) { return true; }
+	bool Int64(int64_t /*i*/) { return true; }
+	bool Uint64(int64_t /*u*/) { return true; }
+	bool Double(double /*d*/) { return true; }
+	bool String(const char* /*str*/, size_t /*length*/, bool /*copy*/) { return true; }
+	bool Uint(unsigned u) {
+		if( status == S_ArcS ) {
+			s = u;
+		} else if( status == S_ArcD ) {
+			d = u;
+		}
+		if( status == S_ArcS || status == S_ArcD ) {
+			status = S_Arc;
+		}
+		return true;
+	}
+
+	TPowerfulSaxJsonResults Key(const char* str, size_t length, bool /*copy*/) {
+		const string key( str, length );
+		switch(status) {
+			case S_NodesObject:
+				if( key != "Nodes" ) {
+					return PSJR_Skip;
+				}
+				status = S_NodesArray;
+				return PSJR_Iterate;
+			case S_ArcsObject:
+				if( key != "Arcs" ) {
+					return PSJR_Skip;
+				}
+				status = S_ArcsArray;
+				return PSJR_Iterate;
+			case S_Arc:
+				if( key == "S" ) {
+					status = S_ArcS;
+				} else if( key == "D" ) {
+					status = S_ArcD;
+				} else {
+					return PSJR_Skip;
+				}
+				return PSJR_Iterate;
+			default:
+				return PSJR_Error;
+		}
+	}
+
+	TPowerfulSaxJsonResults StartObject() {
+		switch(status) {
+			case S_Array:
+				++objectCounter;
+				if( objectCounter != part ) {
+					return PSJR_Skip;
+				}
+				switch( part ) {
+					case P_Params:
+						return PSJR_Load;
+					case P_Nodes:
+						status = S_NodesObject;
+						return PSJR_Iterate;
+					case P_Arcs:
+						status = S_ArcsObject;
+						return PSJR_Iterate;
+					default:
+						return PSJR_Error;
+				}
+			case S_Nodes:
+				return PSJR_Load;
+			case S_Arcs:
+				status = S_Arc;
+				s = -1;
+				d = -1;
+				return PSJR_Iterate;
+			default:
+				return PSJR_Error;
+		}
+	}
+	bool EndObject(size_t /*memberCount*/) {
+		if( status == S_Arc ) {
+			if( s == static_cast<DWORD>(-1) || d == static_cast<DWORD>(-1) ) {
+				throw new CTextException( "CLatticeSaxReader::EndObject", "An arc without 'S' or 'D'" );
+			}
+			arcsProcessor->ProcessArc( s, d );
+			status = S_Arcs;
+		} else if( status == S_ArcsObject ) {
+			// The third part has no arcs
+			return finish();
+		}
+		return true;
+	}
+	TPowerfulSaxJsonResults StartArray() {
+		switch(status) {
+			case S_Begin:
+				status = S_Array;
+				objectCounter = 0;
+				return PSJR_Iterate;
+			case S_NodesArray:
+				status = S_Nodes;
+				return PSJR_Iterate;
+			case S_ArcsArray:
+				status = S_Arcs;
+				return PSJR_Iterate;
+			default:
+				return PSJR_Error;
+		}
+	}
+	bool EndArray(size_t /*elementCount*/) {
+		switch( status ) {
+			case S_Nodes:
+				flushNodes();
+				// The rest of the file is not needed
+				return finish();
+			case S_Arcs:
+				return finish();
+			case S_Array:
+				// A lattice without the third part has no arcs, e.g., the result of best-first search
+				return part == P_Arcs ? finish() : true;
+			default:
+				return true;
+		}
+	}
+
+	bool LoadValue( rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& /*alloc*/ ) {
+		if( status == S_Array ) {
+			assert( part == P_Params );
+			params->CopyFrom( json, params->GetAllocator() );
+			return finish();
+		}
+		assert( status == S_Nodes );
+		if( !json.IsObject() ) {
+			throw new CTextException( "CLatticeSaxReader::LoadValue", "Wrong node " + StdExt::to_string( firstNode + batch.Size() ) );
+		}
+		rapidjson::Value node( json, batch.GetAllocator() );
+		batch.PushBack( node, batch.GetAllocator() );
+		if( batch.Size() >= batchSize ) {
+			flushNodes();
+		}
+		return true;
+	}
+
+private:
+	enum TStatus {
+		S_Begin = 0,
+		S_Array,
+		S_NodesObject,
+		S_NodesArray,
+		S_Nodes,
+		S_ArcsObject,
+		S_ArcsArray,
+		S_Arcs,
+		S_Arc,
+		S_ArcS,
+		S_ArcD,
+		S_End,
+
+		S_EnumCount
+	};
+
+private:
+	const TPart part;
+	TStatus status;
+	DWORD objectCounter;
+
+	rapidjson::Document* params;
+	ILatticeNodesProcessor* nodesProcessor;
+	ILatticeArcsProcessor* arcsProcessor;
+
+	// The current batch of nodes
+	rapidjson::Document batch;
+	DWORD batchSize;
+	// The index of the first node in the batch
+	DWORD firstNode;
+	// The current arc
+	DWORD s;
+	DWORD d;
+
+	bool isFinished;
+
+	void flushNodes() {
+		if( batch.Size() == 0 ) {
+			return;
+		}
+		nodesProcessor->ProcessNodes( firstNode, batch, batch.GetAllocator() );
+		firstNode += batch.Size();
+		// Releasing the memory of the batch
+		rapidjson::Document empty;
+		batch.Swap( empty );
+		batch.SetArray();
+	}
+	bool finish() {
+		status = S_End;
+		isFinished = true;
+		// Stops the parsing
+		return false;
+	}
+};
+
+////////////////////////////////////////////////////////////////////
+
+static void parseLatticeFile( const string& path, CLatticeSaxReader& handler )
+{
+	static const char place[] = "CLatticeStreamReader::parseLatticeFile";
+
+	FILE* fp = fopen( path.c_str(), "rb" );
+	if( fp == 0 ) {
+		throw new CTextException( place, "File not found (" + path + ')' );
+	}
+	char buffer[64 * 1024];
+	rapidjson::FileReadStream is( fp, buffer, sizeof(buffer) );
+	rapidjson::Reader reader;
+	CPowerfulSaxJson<CLatticeSaxReader, CValueJsonPartLoader> saxHandler( handler );
+	const rapidjson::ParseResult result = reader.Parse( is, saxHandler );
+	fclose( fp );
+
+	if( !handler.IsFinished() ) {
+		CJsonError error( path, "Not a valid lattice" );
+		if( result.IsError() ) {
+			error.Error = rapidjson::GetParseError_En( result.Code() );
+			error.Offset = result.Offset();
+		}
+		throw new CJsonException( place, error );
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+CLatticeStreamReader::CLatticeStreamReader( const std::string& _path ) :
+	path( _path )
+{
+	if( IsBinaryLatticeFile( path ) ) {
+		binary.reset( new CBinaryLatticeReader( path ) );
+	}
+}
+
+CLatticeStreamReader::~CLatticeStreamReader()
+{
+}
+
+void CLatticeStreamReader::ReadParams( rapidjson::Document& params )
+{
+	if( binary == 0 ) {
+		CLatticeSaxReader handler( CLatticeSaxReader::P_Params );
+		handler.SetParams( params );
+		parseLatticeFile( path, handler );
+		return;
+	}
+
+	CJsonError error;
+	if( !ReadJsonString( binary->GetParams(), params, error ) ) {
+		error.Data = path;
+		throw new CJsonException( "CLatticeStreamReader::ReadParams", error );
+	}
+}
+
+void CLatticeStreamReader::ReadNodes( DWORD batchSize, ILatticeNodesProcessor& processor )
+{
+	assert( batchSize > 0 );
+	if( binary == 0 ) {
+		CLatticeSaxReader handler( CLatticeSaxReader::P_Nodes );
+		handler.SetNodesProcessor( batchSize, processor );
+		parseLatticeFile( path, handler );
+		return;
+	}
+
+	const DWORD nodesCount = binary->GetNodesCount();
+	for( DWORD firstNode = 0; firstNode < nodesCount; firstNode += batchSize ) {
+		rapidjson::Document batch;
+		batch.SetArray();
+		rapidjson::MemoryPoolAllocator<>& alloc = batch.GetAllocator();
+		const DWORD lastNode = min( nodesCount, firstNode + batchSize );
+		batch.Reserve( lastNode - firstNode, alloc );
+		for( DWORD i = firstNode; i < lastNode; ++i ) {
+			rapidjson::Value node;
+			binary->GetJsonNode( i, node, alloc );
+			batch.PushBack( node, alloc );
+		}
+		processor.ProcessNodes( firstNode, batch, alloc );
+	}
+}
+
+void CLatticeStreamReader::ReadArcs( ILatticeArcsProcessor& processor )
+{
+	if( binary == 0 ) {
+		CLatticeSaxReader handler( CLatticeSaxReader::P_Arcs );
+		handler.SetArcsProcessor( processor );
+		parseLatticeFile( path, handler );
+		return;
+	}
+
+	for( DWORD d = 0; d < binary->GetNodesCount(); ++d ) {
+		DWORD count = 0;
+		const DWORD* parents = binary->GetParents( d, count );
+		for( DWORD i = 0; i < count; ++i ) {
+			processor.ProcessArc( parents[i], d );
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+CLatticeStreamWriter::CLatticeStreamWriter( const std::string& path ) :
+	state( S_Params )
+{
+	if( HasBinaryLatticeExt( path ) ) {
+		binary.reset( new CBinaryLatticeWriter( path ) );
+	} else {
+		json.reset( new CJsonFileWriter( path ) );
+		json->StartArray();
+	}
+}
+
+CLatticeStreamWriter::~CLatticeStreamWriter()
+{
+	if( state != S_Nodes && state != S_Arcs ) {
+		return;
+	}
+	// A destructor should not throw, the errors are reported only by explicit Close
+	try {
+		Close();
+	} catch( CException* e ) {
+		delete e;
+	} catch( std::exception& ) {
+	}
+}
+
+void CLatticeStreamWriter::WriteParams( const rapidjson::Value& params )
+{
+	assert( state == S_Params );
+	if( binary != 0 ) {
+		JSON paramsStr;
+		CreateStringFromJSON( params, paramsStr );
+		binary->SetParams( paramsStr );
+	} else {
+		params.Accept( json->Writer() );
+		json->StartObject();
+		json->Key( "Nodes" );
+		json->StartArray();
+	}
+	state = S_Nodes;
+}
+
+void CLatticeStreamWriter::WriteNode( const rapidjson::Value& node )
+{
+	assert( state == S_Nodes );
+	if( binary != 0 ) {
+		binary->AddNode( node );
+	} else {
+		node.Accept( json->Writer() );
+	}
+}
+
+void CLatticeStreamWriter::WriteArc( DWORD s, DWORD d )
+{
+	if( state == S_Nodes ) {
+		startArcs();
+	}
+	assert( state == S_Arcs );
+	if( binary != 0 ) {
+		binary->AddArc( s, d );
+	} else {
+		json->StartObject();
+		json->Key( "S" );
+		json->Uint( s );
+		json->Key( "D" );
+		json->Uint( d );
+		json->EndObject();
+	}
+}
+
+void CLatticeStreamWriter::Close()
+{
+	assert( state == S_Nodes || state == S_Arcs );
+	if( state == S_Nodes ) {
+		startArcs();
+	}
+	if( binary != 0 ) {
+		binary->Close();
+	} else {
+		json->EndArray();
+		json->EndObject();
+		json->EndArray();
+		json.reset();
+	}
+	state = S_Closed;
+}
+
+void CLatticeStreamWriter::startArcs()
+{
+	assert( state == S_Nodes );
+	if( json != 0 ) {
+		json->EndArray();
+		json->EndObject();
+		json->StartObject();
+		json->Key( "Arcs" );
+		json->StartArray();
+	}
+	state = S_Arcs;
+}
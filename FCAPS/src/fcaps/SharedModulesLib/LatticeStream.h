@@ -0,0 +1,105 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Streaming access to lattice files (JSON or binary).
+//  The nodes are read in batches of bounded size and the arcs are read in a separate pass,
+//  so the memory needed for processing is proportional to a batch rather than to the lattice.
+
+#ifndef LATTICESTREAM_H
+#define LATTICESTREAM_H
+
+#include <common.h>
+
+#include <fcaps/BasicTypes.h>
+
+#include <rapidjson/document.h>
+
+#include <string>
+
+class CBinaryLatticeReader;
+class CBinaryLatticeWriter;
+class CJsonFileWriter;
+
+////////////////////////////////////////////////////////////////////
+
+// Receives batches of nodes of a lattice
+interface ILatticeNodesProcessor : public virtual IObject {
+	// nodes is an array of DATA[1].Nodes elements starting from the node with index firstNode.
+	//  The nodes can be modified, the allocator is the one of the batch.
+	virtual void ProcessNodes( DWORD firstNode, rapidjson::Value& nodes, rapidjson::MemoryPoolAllocator<>& alloc ) = 0;
+};
+
+// Receives arcs of a lattice, s is a parent of d
+interface ILatticeArcsProcessor : public virtual IObject {
+	virtual void ProcessArc( DWORD s, DWORD d ) = 0;
+};
+
+////////////////////////////////////////////////////////////////////
+
+class CLatticeStreamReader {
+public:
+	CLatticeStreamReader( const std::string& path );
+	~CLatticeStreamReader();
+
+	// Reads DATA[0] of the lattice
+	void ReadParams( rapidjson::Document& params );
+	// Passes all nodes of the lattice to the processor by batches of at most batchSize nodes
+	void ReadNodes( DWORD batchSize, ILatticeNodesProcessor& processor );
+	// Passes all arcs of the lattice to the processor, a lattice without the arcs part has no arcs
+	void ReadArcs( ILatticeArcsProcessor& processor );
+
+private:
+	std::string path;
+	// The reader for binary lattices
+	CPtrOwner<CBinaryLatticeReader> binary;
+};
+
+////////////////////////////////////////////////////////////////////
+
+// Writes a lattice part by part: first params, then the nodes, then the arcs.
+//  The format is binary if the path has BinaryLatticeExt and JSON otherwise.
+class CLatticeStreamWriter {
+public:
+	CLatticeStreamWriter( const std::string& path );
+	~CLatticeStreamWriter();
+
+	void WriteParams( const rapidjson::Value& params );
+	void WriteNode( const rapidjson::Value& node );
+	void WriteArc( DWORD s, DWORD d );
+	// Finishes the file, called by destructor if not yet called, but then the errors are ignored
+	void Close();
+
+private:
+	enum TState {
+		S_Params = 0,
+		S_Nodes,
+		S_Arcs,
+		S_Closed,
+
+		S_EnumCount
+	};
+
+private:
+	CPtrOwner<CJsonFileWriter> json;
+	CPtrOwner<CBinaryLatticeWriter> binary;
+	TState state;
+
+	void startArcs();
+};
+
+////////////////////////////////////////////////////////////////////
+
+// Copies the arcs of a lattice to a writer
+class CLatticeArcsCopier : public ILatticeArcsProcessor {
+public:
+	CLatticeArcsCopier( CLatticeStreamWriter& _dst ) :
+		dst( _dst ) {}
+
+	// Methods of ILatticeArcsProcessor
+	virtual void ProcessArc( DWORD s, DWORD d )
+		{ dst.WriteArc( s, d ); }
+private:
+	CLatticeStreamWriter& dst;
+};
+
+#endif // LATTICESTREAM_H
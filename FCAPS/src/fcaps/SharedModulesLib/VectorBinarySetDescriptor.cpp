@@ -3,6 +3,7 @@
 #include "VectorBinarySetDescriptor.h"
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 
 #include <rapidjson/document.h>
 
@@ -10,6 +11,7 @@
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
+#include <algorithm>
 #include <cstdlib>
 #include <ios>
 
@@ -100,6 +102,39 @@ JSON CVectorBinarySetJoinComparator::SavePattern( const IPatternDescriptor* ptrn
 	CreateStringFromJSON( patternJson, result );
 	return result;
 }
+void CVectorBinarySetJoinComparator::WritePattern( const IPatternDescriptor* ptrn, CJsonFileWriter& dst ) const
+{
+	assert( ptrn != 0 && dynamic_cast<const CVectorBinarySetDescriptor*>(ptrn) != 0  );
+
+	const CVectorBinarySetDescriptor& pattern = debug_cast<const CVectorBinarySetDescriptor&>( *ptrn );
+	const bool useNames = shouldWriteNames && !names.empty();
+
+	CJsonFileWriter::TWriter& writer = dst.Writer();
+	writer.StartObject();
+	writer.Key( "Count" );
+	writer.Uint( pattern.Size() );
+	writer.Key( useNames ? "Names" : "Inds" );
+	writer.StartArray();
+
+	// The bits are enumerated directly from the blocks, no intermediate list is built
+	const DWORD attrBlockNum = getAttrBlockCount();
+	const uintptr_t* attrBlocks = getAttrBlocks( pattern );
+	for( DWORD attrBlock = 0; attrBlock < attrBlockNum; ++attrBlock ) {
+		const uintptr_t block = getAttrBlock( attrBlocks, attrBlock );
+		char nextBit = -1;
+		while( (nextBit = getNextBit( block, nextBit )) != NotFound ) {
+			const DWORD attr = static_cast<DWORD>( attrBlock * sizeof( uintptr_t ) * 8 + nextBit );
+			if( useNames && attr < names.size() ) {
+				dst.String( names[attr] );
+			} else {
+				writer.Uint( attr );
+			}
+		}
+	}
+
+	writer.EndArray();
+	writer.EndObject();
+}
 const CVectorBinarySetDescriptor* CVectorBinarySetJoinComparator::LoadPattern( const JSON& json )
 {
 	CJsonError error;
@@ -275,6 +310,19 @@ inline uintptr_t getBitsCount( uintptr_t v )
 }
 #endif
 
+// Hash of a block of attributes at the given position (multiply-xorshift).
+//  Zero blocks have zero hash without branching, so the loops over blocks can be vectorized.
+static inline uint64_t getBlockHash( uintptr_t block, DWORD blockNum )
+{
+	uint64_t x = static_cast<uint64_t>( block ) ^ ( static_cast<uint64_t>( blockNum ) + 1 ) * 0x9E3779B97F4A7C15ULL;
+	x ^= x >> 32;
+	x *= 0xD6E8FEB86659FD93ULL;
+	x ^= x >> 32;
+	x *= 0xD6E8FEB86659FD93ULL;
+	x ^= x >> 32;
+	return x & ( 0ULL - static_cast<uint64_t>( block != 0 ) );
+}
+
 const CVectorBinarySetDescriptor* CVectorBinarySetJoinComparator::CalculateSimilarity(
 	const CVectorBinarySetDescriptor& first, const CVectorBinarySetDescriptor& second )
 {
@@ -286,20 +334,34 @@ const CVectorBinarySetDescriptor* CVectorBinarySetJoinComparator::CalculateSimil
 	const uintptr_t* secondAttrBlock = getAttrBlocks( second );
 	uintptr_t* resultAttrBlock = getAttrBlocks( *result );
 
-	result->hash = 0;
-	result->size = 0;
+	// The hash and the size are accumulated independently for every block
+	uint64_t hash = 0;
+	size_t size = 0;
 	for( DWORD attrBlock = 0; attrBlock < attrBlockNum; ++attrBlock ) {
 		const uintptr_t& firstBlock = getAttrBlock( firstAttrBlock, attrBlock );
 		const uintptr_t& secondBlock = getAttrBlock( secondAttrBlock, attrBlock );
 		uintptr_t& resultBlock = getAttrBlock( resultAttrBlock, attrBlock );
 		resultBlock = firstBlock & secondBlock;
-		result->hash ^= resultBlock;
-		result->size += getBitsCount( resultBlock );
+		hash += getBlockHash( resultBlock, attrBlock );
+		size += getBitsCount( resultBlock );
 	}
+	result->hash = hash;
+	result->size = size;
 
 	return result;
 }
 
+CVectorBinarySetDescriptor* CVectorBinarySetJoinComparator::Clone( const CVectorBinarySetDescriptor& descr )
+{
+	CVectorBinarySetDescriptor* result = newPattern( false );
+	assert( result != 0 );
+	const uintptr_t* attrBlocks = getAttrBlocks( descr );
+	copy( attrBlocks, attrBlocks + getAttrBlockCount(), getAttrBlocks( *result ) );
+	result->hash = descr.hash;
+	result->size = descr.size;
+	return result;
+}
+
 void CVectorBinarySetJoinComparator::AddList( const CList<DWORD>& values, CVectorBinarySetDescriptor& descr )
 {
 	CStdIterator<CList<DWORD>::CConstIterator, false> itr( values );
@@ -328,10 +390,42 @@ void CVectorBinarySetJoinComparator::AddValue( DWORD value, CVectorBinarySetDesc
 		return;
 	}
 
+	descr.hash -= getBlockHash( result, index );
 	result |= bit;
+	descr.hash += getBlockHash( result, index );
 
 	++descr.size;
-	descr.hash ^= bit;
+}
+bool CVectorBinarySetJoinComparator::RemoveValue( DWORD value, CVectorBinarySetDescriptor& descr )
+{
+	assert( value < GetMaxAttrNumber() );
+	const size_t blockBits = sizeof( uintptr_t ) * 8;
+	const size_t index = value / blockBits;
+	const uintptr_t bit = (uintptr_t)(1) << ( value % blockBits );
+
+	uintptr_t& result = getAttrBlock( getAttrBlocks( descr ), index );
+	if( ( result & bit ) == 0 ) {
+		return false;
+	}
+
+	descr.hash -= getBlockHash( result, index );
+	result &= ~bit;
+	descr.hash += getBlockHash( result, index );
+
+	--descr.size;
+	return true;
+}
+bool CVectorBinarySetJoinComparator::HasValue( DWORD value, const CVectorBinarySetDescriptor& descr ) const
+{
+	assert( value < GetMaxAttrNumber() );
+	const size_t blockBits = sizeof( uintptr_t ) * 8;
+	const uintptr_t bit = (uintptr_t)(1) << ( value % blockBits );
+	return ( getAttrBlock( getAttrBlocks( descr ), value / blockBits ) & bit ) != 0;
+}
+
+DWORD CVectorBinarySetJoinComparator::GetBlocksCount() const
+{
+	return getAttrBlockCount();
 }
 
 void CVectorBinarySetJoinComparator::EnumValues( const CVectorBinarySetDescriptor& descr, CList<DWORD>& result ) const
@@ -12,6 +12,8 @@
 
 #include <stdint.h>
 
+class CJsonFileWriter;
+
 ////////////////////////////////////////////////////////////////////
 
 class CVectorBinarySetDescriptor : public IPatternDescriptor {
@@ -21,13 +23,14 @@ public:
 	virtual bool IsMostGeneral() const
 		{ return size == 0; };
 	virtual size_t Hash() const
-		{ return hash; }
+		{ return static_cast<size_t>( hash ); }
 
 	// Get size of the set
 	size_t Size() const
 		{ return size; }
 private:
-	size_t hash;
+	// The sum of hashes of nonzero attribute blocks, so it can be updated block by block
+	uint64_t hash;
 	size_t size;
 
 #ifdef _DEBUG
@@ -59,10 +62,13 @@ public:
 		const IPatternDescriptor* first, const IPatternDescriptor* second );
 
 	virtual void FreePattern( const IPatternDescriptor * );
-
+
 	virtual void Write( const IPatternDescriptor* pattern, std::ostream& dst ) const;
 
 	// Methods of Class
+	// Writes the pattern directly to the JSON stream in the format of SavePattern
+	void WritePattern( const IPatternDescriptor* ptrn, CJsonFileWriter& dst ) const;
+
 	// Get/Set maximal number of attributes.
 	DWORD GetMaxAttrNumber() const;
 	//  Can be called only once before any other commands processing.
@@ -93,9 +99,22 @@ public:
 	CVectorBinarySetDescriptor* NewPattern()
 		{ return newPattern( true ); }
 
+	// Allocate a copy of the pattern
+	CVectorBinarySetDescriptor* Clone( const CVectorBinarySetDescriptor& descr );
+
 	// Add new values to the descriptors.
 	void AddList( const CList<DWORD>& values, CVectorBinarySetDescriptor& descr );
 	void AddValue( DWORD value, CVectorBinarySetDescriptor& descr );
+	// Remove a value from the descriptor, returns false if there is no such value
+	bool RemoveValue( DWORD value, CVectorBinarySetDescriptor& descr );
+	// Check if the descriptor has the value
+	bool HasValue( DWORD value, const CVectorBinarySetDescriptor& descr ) const;
+
+	// Direct access to the bitset of the descriptor, the value i is in the bit i % W of the block i / W,
+	//  W is the number of bits in uintptr_t
+	const uintptr_t* GetBlocks( const CVectorBinarySetDescriptor& descr ) const
+		{ return getAttrBlocks( descr ); }
+	DWORD GetBlocksCount() const;
 
 	// Enumerate values in the descriptor.
 	void EnumValues( const CVectorBinarySetDescriptor& descr, CList<DWORD>& result ) const;
@@ -10,6 +10,7 @@
 #include <ModuleJSONTools.h>
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 
 #include <fcaps/SharedModulesLib/FindConceptOrder.h>
 
@@ -109,7 +110,6 @@ CSofiaContextProcessor::CSofiaContextProcessor() :
 	maxKnownConceptSize(-1),
 	maxKnownConceptFreq(1.0)
 {
-	storage.Reserve( mpn );
 }
 CSofiaContextProcessor::~CSofiaContextProcessor()
 {
@@ -725,117 +725,92 @@ void CSofiaContextProcessor::saveToFile(
 	const CFindConceptOrder<CConceptsForOrder>& order,
 	const std::string& path )
 {
-	CDestStream dst(path);
-	CList<DWORD> tops;
-	vector<bool> bottoms;
-	bottoms.resize( concepts.size(), true );
-	DWORD arcsCount = 0;
-	for( DWORD i = 0; i < concepts.size(); ++i ) {
-		const CList<DWORD>& parents = order.GetParents( i );
-		arcsCount += parents.Size();
-		if( parents.Size() == 0 ) {
-			tops.PushBack( i );
-		}
-		CStdIterator<CList<DWORD>::CConstIterator,false> p( parents );
-		for( ; !p.IsEnd(); ++p ) {
-			bottoms[*p] = false;
-		}
-	}
+	CJsonFileWriter dst(path);
 
-	bool isFirst = true;
-
-	dst << "[";
+	dst.StartArray();
 
 	// Params of the lattice
-	dst << "{\n";
-		dst << "\"NodesCount\":" << concepts.size() << ",";
-		dst << "\"ArcsCount\":" << arcsCount << ",";
-
-        if( shouldFindPartialOrder ) {
-            dst << "\"Top\":[";
-            CStdIterator<CList<DWORD>::CConstIterator, false> top(tops);
-            for( ;!top.IsEnd(); ++top ) {
-                if(!isFirst) {
-                    dst << ",";
-                }
-                isFirst = false;
-                dst << *top;
-            }
-            dst << "],";
-
-            dst << "\"Bottom\":[";
-            isFirst=true;
-            for( DWORD i = 0; i < bottoms.size(); ++i ) {
-                if(!bottoms[i]) {
-                    continue;
-                }
-                if(!isFirst) {
-                    dst << ",";
-                }
-                isFirst=false;
-                dst << i;
-            }
-            dst << "],";
-		}
-        dst << "\n";
-		dst << "\"Params\":" << SaveParams();
-	dst << "\n},";
+	dst.StartObject();
+		dst.Key( "NodesCount" );
+		dst.Uint( concepts.size() );
+		dst.Key( "ArcsCount" );
+		dst.Uint( order.GetArcsCount() );
+
+		if( shouldFindPartialOrder ) {
+			dst.Key( "Top" );
+			dst.StartArray();
+			CStdIterator<CList<DWORD>::CConstIterator, false> top( order.GetTops() );
+			for( ;!top.IsEnd(); ++top ) {
+				dst.Uint( *top );
+			}
+			dst.EndArray();
+
+			dst.Key( "Bottom" );
+			dst.StartArray();
+			CStdIterator<CList<DWORD>::CConstIterator, false> bottom( order.GetBottoms() );
+			for( ;!bottom.IsEnd(); ++bottom ) {
+				dst.Uint( *bottom );
+			}
+			dst.EndArray();
+		}
+		dst.Key( "Params" );
+		dst.RawValue( SaveParams() );
+	dst.EndObject();
 
 	// Nodes of the lattice
-	dst << "{";
-		dst << "\"Nodes\":[\n";
-		isFirst=true;
+	dst.StartObject();
+		dst.Key( "Nodes" );
+		dst.StartArray();
 		for( DWORD i = 0; i < concepts.size(); ++i ) {
-			if(!isFirst){
-				dst << ",\n";
-			}
-			isFirst=false;
-			dst << "  ";
 			printConceptToJson( concepts[i], dst );
 		}
-		dst << "\n]";
-	dst << "},";
+		dst.EndArray();
+	dst.EndObject();
 
 	// Arcs of the poset
-	dst << "{";
-		dst << "\"Arcs\":[\n";
-		isFirst = true;
+	dst.StartObject();
+		dst.Key( "Arcs" );
+		dst.StartArray();
 		if( shouldFindPartialOrder ) {
 			for( DWORD i = 0; i < concepts.size(); ++i ) {
 				CStdIterator<CList<DWORD>::CConstIterator,false> p( order.GetParents( i ) );
 				for( ;!p.IsEnd(); ++p ) {
-					if(!isFirst) {
-						dst << ",";
-					}
-					isFirst=false;
-					dst << "  {\"S\":" << *p << ",\"D\":" << i << "}";
+					dst.StartObject();
+					dst.Key( "S" );
+					dst.Uint( *p );
+					dst.Key( "D" );
+					dst.Uint( i );
+					dst.EndObject();
 				}
 			}
 		}
-		dst << "]";
-	dst << "}";
+		dst.EndArray();
+	dst.EndObject();
 
-	dst << "]\n";
+	dst.EndArray();
 }
 
-void CSofiaContextProcessor::printConceptToJson( const CPatternMeasurePair& c, std::ostream& dst )
+void CSofiaContextProcessor::printConceptToJson( const CPatternMeasurePair& c, CJsonFileWriter& dst )
 {
-dst << "{";
+	dst.StartObject();
 
+	dst.Key( "Ext" );
 	if( outParams.OutExtent ) {
-		dst << "\"Ext\":" << pChain->SaveExtent( c.first ) << ",";
+		pChain->WriteExtent( c.first, dst );
 	} else {
-		dst << "\"Ext\":" << pChain->GetExtentSize( c.first ) << ",";
+		dst.Uint( pChain->GetExtentSize( c.first ) );
 	}
 	if( outParams.OutIntent ) {
-		dst << "\"Int\":" << pChain->SaveIntent( c.first ) << ",";
+		dst.Key( "Int" );
+		pChain->WriteIntent( c.first, dst );
 	}
 	if(oest != 0) {
-		dst << "\"PatternQuality\":" << oest->GetJsonQuality(dynamic_cast<const IExtent*>(c.first)) << ",";
+		dst.Key( "PatternQuality" );
+		dst.RawValue( oest->GetJsonQuality(dynamic_cast<const IExtent*>(c.first)) );
 	}
-	//dst << "\"IsKnown\":" << isUnderKnownPatterns(c.first) << ",";
 
-	dst << "\"Interest\":" << c.second;
+	dst.Key( "Interest" );
+	dst.Double( c.second );
 
-dst << "}";
+	dst.EndObject();
 }
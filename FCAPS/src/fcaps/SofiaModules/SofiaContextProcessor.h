@@ -9,12 +9,13 @@
 
 #include <fcaps/ProjectionChain.h>
 
-#include <fcaps/storages/CachedPatternStorage.h>
+#include <fcaps/storages/ConcurrentPatternStorage.h>
 
 #include <unordered_map>
 
 interface IComputationCallback;
 interface IOptimisticEstimator;
+class CJsonFileWriter;
 
 template<typename T>
 class CFindConceptOrder;
@@ -141,7 +142,7 @@ private:
 	// TODO: move hashed storage to projections.
 	//  then it would be possible to check if a stability for a pattern should be computed
 	//  and if a pattern has been nicely created.
-	CCachedPatternStorage<CHasher> storage;
+	CConcurrentPatternStorage<CHasher> storage;
 	// The set of patterns that are used for passing through projection.
 	CList<const IPatternDescriptor*> projectionPatterns;
 	// A correspondance between patterns and their quality
@@ -167,7 +168,7 @@ private:
 	void reportProgress() const;
 
 	void saveToFile( const std::vector<CPatternMeasurePair>& concepts, const CFindConceptOrder<CConceptsForOrder>& order, const std::string& path );
-	void printConceptToJson( const CPatternMeasurePair& c, std::ostream& dst );
+	void printConceptToJson( const CPatternMeasurePair& c, CJsonFileWriter& dst );
 };
 
 #endif // CSOFYACONCEPTBUILDER_H
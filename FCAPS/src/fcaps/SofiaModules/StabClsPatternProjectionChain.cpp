@@ -12,6 +12,7 @@
 #include <ModuleJSONTools.h>
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 
 using namespace std;
 
@@ -257,6 +258,20 @@ JSON CStabClsPatternProjectionChain::SaveIntent( const IPatternDescriptor* d ) c
 	CreateStringFromJSON( params, result );
 	return result;
 }
+void CStabClsPatternProjectionChain::WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	extCmp->WritePattern( &Ptrn(d).Extent(), dst );
+}
+void CStabClsPatternProjectionChain::WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	const CStabClsPatternDescription& ptrn = Ptrn(d);
+	dst.StartObject();
+	dst.Key( "GraphCount" );
+	dst.Uint( ptrn.GraphCount() );
+	dst.Key( "MinGraphSupport" );
+	dst.Uint( ptrn.MinGraphSupport() );
+	dst.EndObject();
+}
 
 void CStabClsPatternProjectionChain::LoadParams( const JSON& json )
 {
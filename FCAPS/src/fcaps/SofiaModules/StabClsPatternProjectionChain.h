@@ -47,6 +47,8 @@ public:
 	const IPatternDescriptor* LoadPatternByExtent(JSON);
 	virtual JSON SaveExtent( const IPatternDescriptor* d ) const;
 	virtual JSON SaveIntent( const IPatternDescriptor* d ) const;
+	virtual void WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
+	virtual void WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
 
 	// Methods of IModule
 	virtual void LoadParams( const JSON& );
@@ -146,15 +146,13 @@ const double& CStabIntervalClsPatternsProjectionChain::computeStability( const C
 bool CStabIntervalClsPatternsProjectionChain::isStable(const CStabPatternDescription& p, int attr ) const
 {
 	bool res = true;
-	CList<DWORD> extent;
-	ExtCmp().EnumValues( p.Extent(), extent );
-	p.Stability() = extent.Size();
+	p.Stability() = p.Extent().Size();
 	res = p.Stability() >= Thld();
 
 	if( attr < 0 ) {
-		res = res && isLeftStable(extent, p, -attr - 1 ) && isRightStable(extent, p, 0);
+		res = res && isLeftStable( p, -attr - 1 ) && isRightStable( p, 0 );
 	} else {
-		res = res && isRightStable(extent, p, attr - 1 ) && isLeftStable(extent, p, 0);
+		res = res && isRightStable( p, attr - 1 ) && isLeftStable( p, 0 );
 	}
 
 	p.StabState() = currStateNum;
@@ -165,15 +163,15 @@ bool CStabIntervalClsPatternsProjectionChain::isStable(const CStabPatternDescrip
 //  @param p is a pattern
 //  @param attr is a 0-based index of attribute to start
 bool CStabIntervalClsPatternsProjectionChain::isLeftStable(
-	const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const
+	const CStabPatternDescription& p, int attr ) const
 {
 	for( int i = attr; i >=0; --i ) {
-		if(!isLeftStableForAttr(ext,p,i) ) {
+		if(!isLeftStableForAttr(p,i) ) {
 			return false;
 		}
 	}
 	for( int i = attr+1; i < AttrOrder().size(); ++i ) {
-		if(!isLeftStableForAttr(ext,p,i) ) {
+		if(!isLeftStableForAttr(p,i) ) {
 			return false;
 
 		}
@@ -185,15 +183,15 @@ bool CStabIntervalClsPatternsProjectionChain::isLeftStable(
 //  @param p is a pattern
 //  @param attr is a 0-based index of attribute to start
 bool CStabIntervalClsPatternsProjectionChain::isRightStable(
-	const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const
+	const CStabPatternDescription& p, int attr ) const
 {
 	for( int i = attr; i >=0; --i ) {
-		if(!isRightStableForAttr(ext,p,i) ) {
+		if(!isRightStableForAttr(p,i) ) {
 			return false;
 		}
 	}
 	for( int i = attr+1; i < AttrOrder().size(); ++i ) {
-		if(!isRightStableForAttr(ext,p,i) ) {
+		if(!isRightStableForAttr(p,i) ) {
 			return false;
 		}
 	}
@@ -202,14 +200,14 @@ bool CStabIntervalClsPatternsProjectionChain::isRightStable(
 }
 // Checks if a child in the direction of left @param attr forbids for a pattern to be stable.
 bool CStabIntervalClsPatternsProjectionChain::isLeftStableForAttr(
-	const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const
+	const CStabPatternDescription& p, int attr ) const
 {
 	if( !canChangeLeft(p,attr)) {
 		return true;
 	}
-	const DWORD childSize = computeLeftIntersectionSize(
-		ext,attr, p.Intent()[AttrOrder()[attr]].first + 1);
-	const DWORD diff = p.Extent().Size() - childSize;
+	// The child loses the objects with the left bound equal to the one of the pattern
+	const DWORD diff = LeftBoundObjectsCount(
+		p.Extent(), AttrOrder()[attr], p.Intent()[AttrOrder()[attr]].first );
 	if( diff >= p.Stability() ) {
 		return true;
 	} else {
@@ -220,14 +218,14 @@ bool CStabIntervalClsPatternsProjectionChain::isLeftStableForAttr(
 }
 // Checks if a child in the direction of right @param attr forbids for a pattern to be stable.
 bool CStabIntervalClsPatternsProjectionChain::isRightStableForAttr(
-	const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const
+	const CStabPatternDescription& p, int attr ) const
 {
 	if( !canChangeRight(p,attr)) {
 		return true;
 	}
-	const DWORD childSize = computeRightIntersectionSize(
-		ext,attr,p.Intent()[AttrOrder()[attr]].second - 1);
-	const DWORD diff = p.Extent().Size() - childSize;
+	// The child loses the objects with the right bound equal to the one of the pattern
+	const DWORD diff = RightBoundObjectsCount(
+		p.Extent(), AttrOrder()[attr], p.Intent()[AttrOrder()[attr]].second );
 	if( diff >= p.Stability() ) {
 		return true;
 	} else {
@@ -254,29 +252,3 @@ bool CStabIntervalClsPatternsProjectionChain::canChangeRight(const CStabPatternD
 			&& State().State == CCurrState::S_Right
 			&& attr <= State().AttrNum;
 }
-
-DWORD CStabIntervalClsPatternsProjectionChain::computeLeftIntersectionSize(
-	const CList<DWORD>& ext, int attr, DWORD valueNum ) const
-{
-	const DWORD currSize = ext.Size();
-	DWORD resultSize = currSize;
-	CStdIterator<CList<DWORD>::CConstIterator, false> itr(ext);
-	for( ; !itr.IsEnd(); ++itr ) {
-		if( Context()[*itr][AttrOrder()[attr]].first < valueNum ) {
-			--resultSize;
-		}
-	}
-	return resultSize;
-}
-DWORD CStabIntervalClsPatternsProjectionChain::computeRightIntersectionSize(
-	const CList<DWORD>& ext, int attr, DWORD valueNum ) const
-{
-	DWORD resultSize = ext.Size();
-	CStdIterator<CList<DWORD>::CConstIterator, false> itr(ext);
-	for( ; !itr.IsEnd(); ++itr ) {
-		if( Context()[*itr][AttrOrder()[attr]].second > valueNum ) {
-			--resultSize;
-		}
-	}
-	return resultSize;
-}
@@ -73,14 +73,12 @@ private:
 
 	const double& computeStability( const CStabPatternDescription& p ) const;
 	bool isStable(const CStabPatternDescription& p, int attr ) const;
-	bool isLeftStable(const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const;
-	bool isRightStable(const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const;
-	bool isLeftStableForAttr(const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const;
-	bool isRightStableForAttr(const CList<DWORD>& ext, const CStabPatternDescription& p, int attr ) const;
+	bool isLeftStable(const CStabPatternDescription& p, int attr ) const;
+	bool isRightStable(const CStabPatternDescription& p, int attr ) const;
+	bool isLeftStableForAttr(const CStabPatternDescription& p, int attr ) const;
+	bool isRightStableForAttr(const CStabPatternDescription& p, int attr ) const;
 	bool canChangeLeft(const CStabPatternDescription& p, int attr ) const;
 	bool canChangeRight(const CStabPatternDescription& p, int attr ) const;
-	DWORD computeLeftIntersectionSize(const CList<DWORD>& ext, int attr, DWORD valueNum) const;
-	DWORD computeRightIntersectionSize(const CList<DWORD>& ext, int attr, DWORD valueNum) const;
 };
 
 #endif // CSTABINTERVALCLSPATTERNSPROJECTIONCHAIN_H
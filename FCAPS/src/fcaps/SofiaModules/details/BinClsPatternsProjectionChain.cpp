@@ -5,6 +5,7 @@
 #include <fcaps/SharedModulesLib/BinarySetPatternManager.h>
 
 #include <JSONTools.h>
+#include <JsonWriter.h>
 
 #include <rapidjson/document.h>
 
@@ -173,6 +174,16 @@ JSON CBinClsPatternsProjectionChain::SaveIntent( const IPatternDescriptor* d ) c
 	intentDescr.AddList( intent );
 	return intCmp->SavePattern( &intentDescr );
 }
+void CBinClsPatternsProjectionChain::WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	extCmp->WritePattern( &Pattern(d).Extent(), dst );
+}
+void CBinClsPatternsProjectionChain::WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	CBinarySetPatternDescriptor intentDescr;
+	computeIntent( Pattern(d), intentDescr.GetAttribs() );
+	intCmp->WritePattern( &intentDescr, dst );
+}
 
 void CBinClsPatternsProjectionChain::LoadCommonParams( const JSON& json )
 {
@@ -57,6 +57,8 @@ public:
 	virtual const IPatternDescriptor* LoadPatternByExtent(JSON);
 	virtual JSON SaveExtent( const IPatternDescriptor* d ) const;
 	virtual JSON SaveIntent( const IPatternDescriptor* d ) const;
+	virtual void WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
+	virtual void WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
 
 	// Methdos of the class
 	// Get minimal support of a pattern. If less the pattern is suppressed.
@@ -64,7 +66,7 @@ public:
 		{ return Thld();}
 
 protected:
-	class CPatternDescription : public IPatternDescriptor, public IExtent {
+	class CPatternDescription : public IPatternDescriptor, public IExtent, public IBitsetExtent {
 	public:
 		CPatternDescription( const CVectorBinarySetJoinComparator& _cmp, const CSharedPtr<const CVectorBinarySetDescriptor>& e ) :
 			cmp(_cmp), extent(e), nextOptimAttr(-1) {}
@@ -78,6 +80,10 @@ protected:
 		virtual void GetExtent( CPatternImage& extent ) const;
 		virtual void ClearMemory( CPatternImage& extent ) const;
 
+		// Methods of IBitsetExtent
+		virtual void GetBitset( const uintptr_t*& blocks, DWORD& blocksCount ) const
+			{ blocks = cmp.GetBlocks( *extent ); blocksCount = cmp.GetBlocksCount(); }
+
 		// Methods of this class
 		const CVectorBinarySetDescriptor& Extent() const
 		    { return *extent;}
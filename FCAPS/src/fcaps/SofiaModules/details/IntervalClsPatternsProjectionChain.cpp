@@ -3,6 +3,7 @@
 #include <fcaps/SofiaModules/details/IntervalClsPatternsProjectionChain.h>
 
 #include <Exception.h>
+#include <JsonWriter.h>
 
 using namespace std;
 
@@ -70,6 +71,7 @@ void CIntervalClsPatternsProjectionChain::ComputeZeroProjection( CPatternList& p
 {
 	convertContext();
 	computeAttrOrder();
+	computeBoundIndices();
 
 	state.State = CCurrState::S_Left;
 	state.AttrNum = -1;
@@ -102,7 +104,6 @@ bool CIntervalClsPatternsProjectionChain::NextProjection()
 	if( state.State == CCurrState::S_End ) {
 		return false;
 	}
-	stateObjs.reset();
 
 	++state.AttrNum;
 	if( state.AttrNum < values.size() ) {
@@ -186,6 +187,24 @@ JSON CIntervalClsPatternsProjectionChain::SaveIntent( const IPatternDescriptor*
 	}
 	return JsonIntervalPattern::SavePattern( ptrn );
 }
+void CIntervalClsPatternsProjectionChain::WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	extCmp->WritePattern( &Pattern(d).Extent(), dst );
+}
+void CIntervalClsPatternsProjectionChain::WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const
+{
+	const CIntent& intent = Pattern(d).Intent();
+	dst.StartArray();
+	for( DWORD i = 0; i < intent.size(); ++i ) {
+		assert( intent[i].first <= intent[i].second );
+		assert( intent[i].second < values[i].size() );
+		dst.StartArray();
+		dst.Double( values[i][intent[i].first] );
+		dst.Double( values[i][intent[i].second] );
+		dst.EndArray();
+	}
+	dst.EndArray();
+}
 
 void CIntervalClsPatternsProjectionChain::JustPreimages( const CPatternDescription& p, CPatternList& preimages )
 {
@@ -315,86 +334,112 @@ void CIntervalClsPatternsProjectionChain::computeAttrOrder()
 	sort( attrOrder.begin(), attrOrder.end(), cmp);
 }
 
+// Builds the orders of objects by bounds of all attributes.
+void CIntervalClsPatternsProjectionChain::computeBoundIndices()
+{
+	leftIndex.resize( values.size() );
+	rightIndex.resize( values.size() );
+	for( DWORD attr = 0; attr < values.size(); ++attr ) {
+		indexBounds( attr, true, leftIndex[attr] );
+		indexBounds( attr, false, rightIndex[attr] );
+	}
+}
+// Counting sort of objects by the left (right) bound of an attribute.
+void CIntervalClsPatternsProjectionChain::indexBounds( DWORD attr, bool isLeft, CBoundIndex& index ) const
+{
+	index.Offsets.assign( values[attr].size() + 1, 0 );
+	for( DWORD obj = 0; obj < context.size(); ++obj ) {
+		const DWORD value = isLeft ? context[obj][attr].first : context[obj][attr].second;
+		assert( value < values[attr].size() );
+		++index.Offsets[value + 1];
+	}
+	for( DWORD v = 0; v < values[attr].size(); ++v ) {
+		index.Offsets[v + 1] += index.Offsets[v];
+	}
+	index.Objects.resize( context.size() );
+	vector<DWORD> next( index.Offsets.begin(), index.Offsets.end() - 1 );
+	for( DWORD obj = 0; obj < context.size(); ++obj ) {
+		const DWORD value = isLeft ? context[obj][attr].first : context[obj][attr].second;
+		index.Objects[next[value]] = obj;
+		++next[value];
+	}
+}
+
 // Find preimages of a pattern in the case of state.State = S_Left.
+//  The objects of the extent have the left bound not less than the left bound of the intent,
+//  so the preimage removes from the extent the objects with the left bound equal to the current value.
 void CIntervalClsPatternsProjectionChain::leftPreimages(
 	const CPatternDescription& p, CPatternList& preimages )
 {
+	const DWORD attr = attrOrder[state.AttrNum];
 	CIntent& intent = p.Intent();
-	if( intent[attrOrder[state.AttrNum]].first != state.ValueNum // There is another pattern which is more close
-		|| intent[attrOrder[state.AttrNum]].second == state.ValueNum ) // The pattern of the form [x,x] gives it self for projection x.
+	if( intent[attr].first != state.ValueNum // There is another pattern which is more close
+		|| intent[attr].second == state.ValueNum ) // The pattern of the form [x,x] gives it self for projection x.
 	{
 		return;
 	}
-	const CVectorBinarySetDescriptor& descr = getStateObjs();
-	CSharedPtr<const CVectorBinarySetDescriptor> sim(
-		extCmp->CalculateSimilarity( p.Extent(), descr ), extDeleter );
-	const DWORD diff = p.Extent().Size() - sim->Size();
-	if( diff == 0 ) {
+	if( countObjects( p.Extent(), leftIndex[attr], state.ValueNum ) == 0 ) {
 		// Not closed pattern
-		intent[attrOrder[state.AttrNum]].first = state.ValueNum + 1;
+		intent[attr].first = state.ValueNum + 1;
 		return;
 	}
+	CSharedPtr<const CVectorBinarySetDescriptor> ext(
+		removeObjects( p.Extent(), leftIndex[attr], state.ValueNum ), extDeleter );
 
-    unique_ptr<CPatternDescription> res( NewPattern(sim) );
-    res->Intent() = intent;
-    res->Intent()[attrOrder[state.AttrNum]].first = state.ValueNum + 1;
+	unique_ptr<CPatternDescription> res( NewPattern(ext) );
+	res->Intent() = intent;
+	res->Intent()[attr].first = state.ValueNum + 1;
 	preimages.PushBack(res.release());
 }
 
+// The same as leftPreimages for the right bound, the values are taken from the end.
 void CIntervalClsPatternsProjectionChain::rightPreimages(
 	const CPatternDescription& p, CPatternList& preimages )
 {
-	const DWORD currValue = values[attrOrder[state.AttrNum]].size() - 1 - state.ValueNum;
-	assert( 0 < currValue && currValue < values[attrOrder[state.AttrNum]].size() ); // Type overfilling should not happen.
+	const DWORD attr = attrOrder[state.AttrNum];
+	const DWORD currValue = values[attr].size() - 1 - state.ValueNum;
+	assert( 0 < currValue && currValue < values[attr].size() ); // Type overfilling should not happen.
 	CIntent& intent = p.Intent();
-	if( intent[attrOrder[state.AttrNum]].second != currValue // There is another pattern which is more close
-		|| intent[attrOrder[state.AttrNum]].first == currValue ) // The pattern of the form [x,x] gives it self for projection x.
+	if( intent[attr].second != currValue // There is another pattern which is more close
+		|| intent[attr].first == currValue ) // The pattern of the form [x,x] gives it self for projection x.
 	{
 		return;
 	}
-
-	const CVectorBinarySetDescriptor& descr = getStateObjs();
-	CSharedPtr<const CVectorBinarySetDescriptor> sim(
-		extCmp->CalculateSimilarity( p.Extent(), descr ), extDeleter );
-	const DWORD diff = p.Extent().Size() - sim->Size();
-	if( diff == 0 ) {
+	if( countObjects( p.Extent(), rightIndex[attr], currValue ) == 0 ) {
 		// Not closed pattern
-		intent[attrOrder[state.AttrNum]].second = currValue - 1;
+		intent[attr].second = currValue - 1;
 		return;
 	}
+	CSharedPtr<const CVectorBinarySetDescriptor> ext(
+		removeObjects( p.Extent(), rightIndex[attr], currValue ), extDeleter );
 
-    unique_ptr<CPatternDescription> res( NewPattern(sim) );
-    res->Intent() = intent;
-    res->Intent()[attrOrder[state.AttrNum]].second = currValue - 1;
+	unique_ptr<CPatternDescription> res( NewPattern(ext) );
+	res->Intent() = intent;
+	res->Intent()[attr].second = currValue - 1;
 	preimages.PushBack(res.release());
 }
 
-const CVectorBinarySetDescriptor& CIntervalClsPatternsProjectionChain::getStateObjs()
+// Counts the objects of the extent in the slice of the index for the value
+DWORD CIntervalClsPatternsProjectionChain::countObjects(
+	const CVectorBinarySetDescriptor& ext, const CBoundIndex& index, DWORD valueNum ) const
 {
-	if( stateObjs != 0 ){
-		return *stateObjs;
-	}
-
-	CList<DWORD> objs;
-	switch( state.State ) {
-	case CCurrState::S_Left:
-		for( DWORD i = 0; i < context.size(); ++i ) {
-			if( state.ValueNum + 1 <= context[i][attrOrder[state.AttrNum]].first ) {
-				objs.PushBack(i);
-			}
-		}
-		break;
-	case CCurrState::S_Right:
-		for( DWORD i = 0; i < context.size(); ++i ) {
-			if( context[i][attrOrder[state.AttrNum]].second <= values[attrOrder[state.AttrNum]].size() - 2 - state.ValueNum ) {
-				objs.PushBack(i);
-			}
+	assert( valueNum + 1 < index.Offsets.size() );
+	DWORD result = 0;
+	for( DWORD i = index.Offsets[valueNum]; i < index.Offsets[valueNum + 1]; ++i ) {
+		if( extCmp->HasValue( index.Objects[i], ext ) ) {
+			++result;
 		}
-		break;
-	default:
-		assert(false);
 	}
-	stateObjs.reset(extCmp->NewPattern(), extDeleter );
-	extCmp->AddList(objs, *stateObjs );
-	return *stateObjs;
+	return result;
+}
+// Copies the extent without the objects in the slice of the index for the value
+const CVectorBinarySetDescriptor* CIntervalClsPatternsProjectionChain::removeObjects(
+	const CVectorBinarySetDescriptor& ext, const CBoundIndex& index, DWORD valueNum ) const
+{
+	assert( valueNum + 1 < index.Offsets.size() );
+	CVectorBinarySetDescriptor* result = extCmp->Clone( ext );
+	for( DWORD i = index.Offsets[valueNum]; i < index.Offsets[valueNum + 1]; ++i ) {
+		extCmp->RemoveValue( index.Objects[i], *result );
+	}
+	return result;
 }
@@ -40,6 +40,8 @@ public:
 	const IPatternDescriptor* LoadPatternByExtent(JSON json);
 	virtual JSON SaveExtent( const IPatternDescriptor* d ) const;
 	virtual JSON SaveIntent( const IPatternDescriptor* d ) const;
+	virtual void WriteExtent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
+	virtual void WriteIntent( const IPatternDescriptor* d, CJsonFileWriter& dst ) const;
 
 protected:
 	typedef std::vector< std::pair<DWORD,DWORD> > CIntent;
@@ -109,9 +111,21 @@ protected:
 	// A version of preimages function without a threshold verification.
 	void JustPreimages( const CPatternDescription& p, CPatternList& preimages );
 
+	// The number of objects from the extent with the left (right) bound of the attribute equal to the value.
+	DWORD LeftBoundObjectsCount( const CVectorBinarySetDescriptor& ext, DWORD attr, DWORD valueNum ) const
+		{ assert( attr < leftIndex.size() ); return countObjects( ext, leftIndex[attr], valueNum ); }
+	DWORD RightBoundObjectsCount( const CVectorBinarySetDescriptor& ext, DWORD attr, DWORD valueNum ) const
+		{ assert( attr < rightIndex.size() ); return countObjects( ext, rightIndex[attr], valueNum ); }
+
 private:
 	typedef std::deque<JsonIntervalPattern::CPattern> CTempContext;
 	typedef std::vector< std::vector<double> > CAttrValues;
+	// Objects sorted by a bound of an attribute.
+	//  The objects with the bound equal to value v are Objects[Offsets[v]], ..., Objects[Offsets[v+1]-1].
+	struct CBoundIndex {
+		std::vector<DWORD> Objects;
+		std::vector<DWORD> Offsets;
+	};
 
 private:
 	// Comparator for extents
@@ -129,8 +143,10 @@ private:
 	std::vector<double> precisions;
 	// Auto finding of precisions. The value [0,1] and the thld is set as maxDiff * thld.
 	double propPrecisionThld;
-	// A binary attribute corresponding to the corrent projection.
-	CSharedPtr<CVectorBinarySetDescriptor> stateObjs;
+	// Objects sorted by the left and by the right bounds of every attribute.
+	//  A projection removes the objects with one bound value, i.e. a slice of the order.
+	std::vector<CBoundIndex> leftIndex;
+	std::vector<CBoundIndex> rightIndex;
 
 	// State of the projection
 	CCurrState state;
@@ -140,10 +156,14 @@ private:
 
 	void convertContext();
 	void computeAttrOrder();
+	void computeBoundIndices();
+	void indexBounds( DWORD attr, bool isLeft, CBoundIndex& index ) const;
 
 	void leftPreimages( const CPatternDescription& p, CPatternList& preimages );
 	void rightPreimages( const CPatternDescription& p, CPatternList& preimages );
-	const CVectorBinarySetDescriptor& getStateObjs();
+	DWORD countObjects( const CVectorBinarySetDescriptor& ext, const CBoundIndex& index, DWORD valueNum ) const;
+	const CVectorBinarySetDescriptor* removeObjects(
+		const CVectorBinarySetDescriptor& ext, const CBoundIndex& index, DWORD valueNum ) const;
 };
 
 #endif // CINTERVALCLSPATTERNSPROJECTIONCHAIN_H
@@ -4,6 +4,7 @@
 
 #include "details/AddIntentLatticeBuilder.h"
 #include "details/ExtentImpl.h"
+#include "details/LatticeMerger.h"
 #include <fcaps/ComputationProcedure.h>
 #include <fcaps/PatternManager.h>
 
@@ -13,6 +14,10 @@
 #include <ModuleJSONTools.h>
 #include <JSONTools.h>
 
+#include <boost/thread.hpp>
+
+#include <exception>
+
 using namespace std;
 
 ////////////////////////////////////////////////////////////////////
@@ -32,6 +37,25 @@ STR(
 					"description": "The object describes how the data should be read and how the similarity on this data is defined. Basically it defines the semilattice of descriptions.",
 					"type": "@PatternManagerModules"
 				},
+				"ThreadsCount":{
+					"description": "The number of threads. If more than one, the objects are split into parts, the lattices of the parts are built in parallel and then merged. The pattern manager should be known to allow for concurrent comparison and similarity computation, otherwise it is an error. Stability is also computed in parallel.",
+					"type": "integer",
+					"minimum": 1
+				},
+				"Iceberg":{
+					"description": "If true, the concepts that cannot reach OutputParams.MinExtentSize are removed during the construction (every time the lattice grows by an eighth), so only the iceberg lattice is built. Requires ObjectCount. The stability and the lift are computed w.r.t. the kept concepts, so the output lattices are marked with Iceberg. Works only with one thread, it is an error otherwise.",
+					"type": "boolean"
+				},
+				"ObjectCount":{
+					"description": "The total number of objects that are going to be added. Required by Iceberg, since a concept can be removed only if the rest of objects cannot make it large enough.",
+					"type": "integer",
+					"minimum": 1
+				},
+				"SimilarityCacheSize":{
+					"description": "The number of computed similarities of intents that are memoized, so the same pair of intents is not intersected twice. 0 (default) switches the memo off. Works only with one thread.",
+					"type": "integer",
+					"minimum": 0
+				},
 				"OutputParams":{
 					"description": "The set of parameters controlling what should be printed out as the result",
 					"type": "object",
@@ -96,7 +120,11 @@ CAddIntentContextProcessor::CAddIntentContextProcessor() :
 	intStorage( new CVectorIntentStorage ),
 	extStorage( new CDequeExtentStorage ),
 	builder( new CAddIntentLatticeBuilder ),
-	objectCount(0)
+	objectCount(0),
+	threadsCount(1),
+	isIceberg(false),
+	totalObjectCount(0),
+	similarityCacheSize(0)
 {
 	//ctor
 }
@@ -125,32 +153,166 @@ void CAddIntentContextProcessor::PassDescriptionParams( const JSON& json )
 	cmpModule.LoadParams( params );
 }
 
+void CAddIntentContextProcessor::Prepare()
+{
+	builder->SetPrunner( CSharedPtr<IPatternPrunner>() );
+	if( !isPruned() ) {
+		return;
+	}
+	// The number of objects is required to know how much a concept can grow
+	builder->SetPrunner( CSharedPtr<IPatternPrunner>(
+		new CMinSupportPrunner( extStorage, outputParams.MinExtentSize, totalObjectCount ) ) );
+}
+
 void CAddIntentContextProcessor::AddObject( DWORD objectNum, const JSON& intent )
 {
 	assert(cmp != 0);
 	const DWORD intentID = intStorage->LoadObject( intent );
 	assert( intentID != NotFound );
+	++objectCount;
+	if( threadsCount > 1 ) {
+		// The lattice is built when all objects are known
+		objects.push_back( pair<DWORD, TIntentId>( objectNum, intentID ) );
+		if( callback != 0 ) {
+			callback->ReportProgress( 1, "Objects Loaded " + StdExt::to_string( objectCount ) );
+		}
+		return;
+	}
 	builder->AddObject( objectNum, intentID );
 	if( callback != 0 ) {
 		callback->ReportProgress( 1, "Lattice Size is " + StdExt::to_string( lattice.Size() ) );
 	}
-	++objectCount;
 }
 void CAddIntentContextProcessor::ProcessAllObjectsAddition()
 {
-	// Counting edge number
-	CStdIterator<CLatticeNodes::const_iterator> node( lattice.GetNodes() );
-	DWORD edgeCount = 0;
-	for( ; !node.IsEnd(); ++node ) {
-		edgeCount += (*node).Parents.size();
+	if( isPruned() && objectCount > totalObjectCount ) {
+		// The concepts were removed assuming less objects than were added
+		throw new CTextException( "CAddIntentContextProcessor::ProcessAllObjectsAddition",
+			StdExt::to_string( objectCount ) + " objects are added, but ObjectCount is "
+			+ StdExt::to_string( totalObjectCount ) + ", so the iceberg lattice is incomplete" );
+	}
+	if( !objects.empty() ) {
+		buildInParallel();
 	}
 
+	builder->ProcessAllObjectsAddition();
+	// The lattice is not changed anymore
+	frozenLattice.Freeze( lattice );
+
 	if( callback != 0 ) {
 		callback->ReportProgress( 1,
-			"Lattice Size = " + StdExt::to_string( lattice.Size() ) + " "
-			"Edges Count = " + StdExt::to_string( edgeCount ) );
+			"Lattice Size = " + StdExt::to_string( frozenLattice.Size() ) + " "
+			"Edges Count = " + StdExt::to_string( frozenLattice.ArcsCount() ) );
+		if( similarityCacheSize > 0 ) {
+			const CSimilarityCache& cache = dynamic_cast<const CVectorIntentStorage&>( *intStorage ).GetSimilarityCache();
+			callback->ReportProgress( 1,
+				"Similarity Cache Hits = " + StdExt::to_string( cache.Hits() ) + " "
+				"Misses = " + StdExt::to_string( cache.Misses() ) );
+		}
+	}
+}
+
+bool CAddIntentContextProcessor::isPruned() const
+{
+	return isIceberg && outputParams.MinExtentSize > 1;
+}
+
+// Builds the lattice of a part of objects
+class CAddIntentContextProcessor::CPartBuilder {
+public:
+	CPartBuilder( CLatticePart& _part, const vector< pair<DWORD, TIntentId> >& _objects, CException*& _error ) :
+		part( _part ), objects( _objects ), error( _error ) {}
+
+	void operator()();
+private:
+	CLatticePart& part;
+	const vector< pair<DWORD, TIntentId> >& objects;
+	CException*& error;
+};
+
+void CAddIntentContextProcessor::CPartBuilder::operator()()
+{
+	try {
+		CAddIntentLatticeBuilder partBuilder;
+		partBuilder.Initialize( part.Extents, part.Intents );
+		partBuilder.SetResultLattice( part.Lattice );
+		for( DWORD i = 0; i < objects.size(); ++i ) {
+			partBuilder.AddObject( objects[i].first, objects[i].second );
+		}
+		partBuilder.ProcessAllObjectsAddition();
+	} catch( CException* e ) {
+		error = e;
+	} catch( std::exception& e ) {
+		error = new CTextException( "CAddIntentContextProcessor::CPartBuilder", e.what() );
+	}
+}
+
+void CAddIntentContextProcessor::buildInParallel()
+{
+	CVectorIntentStorage& storage = dynamic_cast<CVectorIntentStorage&>( *intStorage );
+
+	// Every part gets a consecutive range of objects and its own storages,
+	//  so the parts are merged with sorted extents
+	const DWORD partsCount = min<DWORD>( threadsCount, objects.size() );
+	vector< CSharedPtr<CLatticePart> > parts( partsCount );
+	vector< vector< pair<DWORD, TIntentId> > > partObjects( partsCount );
+	for( DWORD i = 0; i < partsCount; ++i ) {
+		parts[i].reset( new CLatticePart );
+		parts[i]->Intents.reset( new CVectorIntentStorage );
+		parts[i]->Intents->Initialize( cmp );
+		parts[i]->Extents.reset( new CDequeExtentStorage );
+		parts[i]->Extents->SetNames( extStorage->GetNames() );
+
+		const DWORD first = objects.size() * i / partsCount;
+		const DWORD last = objects.size() * ( i + 1 ) / partsCount;
+		for( DWORD j = first; j < last; ++j ) {
+			partObjects[i].push_back( pair<DWORD, TIntentId>( objects[j].first,
+				parts[i]->Intents->AddPattern( storage.ReleasePattern( objects[j].second ) ) ) );
+		}
+	}
+	objects.clear();
+
+	vector<CException*> errors( partsCount, static_cast<CException*>( 0 ) );
+	boost::thread_group threads;
+	for( DWORD i = 0; i < partsCount; ++i ) {
+		threads.create_thread( CPartBuilder( *parts[i], partObjects[i], errors[i] ) );
 	}
+	threads.join_all();
+	for( DWORD i = 0; i < partsCount; ++i ) {
+		if( errors[i] != 0 ) {
+			for( DWORD j = i + 1; j < partsCount; ++j ) {
+				delete errors[j];
+			}
+			throw errors[i];
+		}
+	}
+	if( callback != 0 ) {
+		callback->ReportProgress( 1, "Parts are built: " + StdExt::to_string( partsCount ) );
+	}
+
+	// Neighbouring parts are merged until one lattice remains
+	CLatticeMerger merger( cmp, threadsCount );
+	while( parts.size() > 1 ) {
+		vector< CSharedPtr<CLatticePart> > merged;
+		for( DWORD i = 0; i < parts.size(); i += 2 ) {
+			if( i + 1 == parts.size() ) {
+				merged.push_back( parts[i] );
+				continue;
+			}
+			merged.push_back( CSharedPtr<CLatticePart>( new CLatticePart ) );
+			merger.Merge( *parts[i], *parts[i + 1], *merged.back() );
+			parts[i].reset();
+			parts[i + 1].reset();
+		}
+		parts.swap( merged );
+	}
+
+	intStorage = parts[0]->Intents;
+	extStorage = parts[0]->Extents;
+	lattice.GetNodes().swap( parts[0]->Lattice.GetNodes() );
+	builder->Initialize( extStorage, intStorage );
 }
+
 void CAddIntentContextProcessor::SaveResult( const std::string& path )
 {
 	const string outFullDataPath( path );
@@ -163,8 +325,10 @@ void CAddIntentContextProcessor::SaveResult( const std::string& path )
 	outSelectedDataPath += ".selected.json";
 
 	outputParams.PercentageBase = objectCount;
+	outputParams.ThreadsCount = threadsCount;
+	outputParams.IsIceberg = isPruned();
 
-	CLatticeWriter( lattice, intStorage, extStorage, outputParams )
+	CLatticeWriter( frozenLattice, intStorage, extStorage, outputParams )
 		.Write( outFullDataPath, outSelectedDataPath );
 }
 
@@ -200,26 +364,48 @@ void CAddIntentContextProcessor::LoadParams( const JSON& json )
 	builder->Initialize( extStorage, intStorage );
 	builder->SetResultLattice( lattice );
 	objectCount = 0;
+	objects.clear();
+
+	threadsCount = 1;
+	if( p.HasMember( "ThreadsCount" ) && p["ThreadsCount"].IsUint() && p["ThreadsCount"].GetUint() > 0 ) {
+		threadsCount = p["ThreadsCount"].GetUint();
+	}
+	if( threadsCount > 1 && !IsThreadSafePatternManager( *cmp ) ) {
+		// The parts and the merger share the pattern manager
+		error.Data = json;
+		error.Error = "THIS.Params.PatternManager is not known to be thread-safe, so ThreadsCount should be 1.";
+		throw new CJsonException(place, error);
+	}
+	isIceberg = p.HasMember( "Iceberg" ) && p["Iceberg"].IsBool() && p["Iceberg"].GetBool();
+	totalObjectCount = 0;
+	if( p.HasMember( "ObjectCount" ) && p["ObjectCount"].IsUint() ) {
+		totalObjectCount = p["ObjectCount"].GetUint();
+	}
+	if( isIceberg && totalObjectCount == 0 ) {
+		error.Data = json;
+		error.Error = "THIS.Params.ObjectCount is not found. Necessary for Iceberg.";
+		throw new CJsonException(place, error);
+	}
+	if( isIceberg && threadsCount > 1 ) {
+		// The parts of the parallel construction cannot be pruned independently
+		error.Data = json;
+		error.Error = "THIS.Params.Iceberg works only with one thread.";
+		throw new CJsonException(place, error);
+	}
+	similarityCacheSize = 0;
+	if( p.HasMember( "SimilarityCacheSize" ) && p["SimilarityCacheSize"].IsUint() ) {
+		similarityCacheSize = p["SimilarityCacheSize"].GetUint();
+	}
+	if( similarityCacheSize > 0 && threadsCount > 1 ) {
+		// The parts move their intents between storages, so the ids cannot be shared
+		error.Data = json;
+		error.Error = "THIS.Params.SimilarityCacheSize works only with one thread.";
+		throw new CJsonException(place, error);
+	}
+	dynamic_cast<CVectorIntentStorage&>( *intStorage ).SetSimilarityCacheCapacity( similarityCacheSize );
 
 	if( p.HasMember( "OutputParams") && p["OutputParams"].IsObject() ) {
-		const rapidjson::Value& opJson = p["OutputParams"];
-#define	getFromJson( name, opp ) \
-		if( opJson.HasMember( #name ) && opJson[#name].Is##opp() ) { \
-			outputParams.name = opJson[#name].Get##opp(); \
-		}
-		getFromJson( MinExtentSize, Uint );
-		getFromJson( MinLift, Uint );
-		// We should check IsNumber rather than IsDouble here.
-		if( opJson.HasMember( "MinStab" ) && opJson["MinStab"].IsNumber() ) {
-			outputParams.MinStab = opJson["MinStab"].GetDouble();
-		}
-		getFromJson( OutExtent, Bool );
-		getFromJson( OutSupport, Bool );
-		getFromJson( OutOrder, Bool );
-		getFromJson( OutStabEstimation, Bool );
-		getFromJson( OutStability, Bool );
-		getFromJson( IsStabilityInLog, Bool );
-#undef	getFromJson
+		LoadLatticeFilterParams( p["OutputParams"], outputParams );
 	}
 }
 
@@ -229,25 +415,18 @@ JSON CAddIntentContextProcessor::SaveParams() const
 	rapidjson::Document params;
 	rapidjson::MemoryPoolAllocator<>& alloc = params.GetAllocator();
 
-#define	addToJson( name, opp ) \
-		.AddMember( #name , rapidjson::Value().Set##opp( outputParams.name ), alloc )
+	rapidjson::Value outputParamsJson;
+	SaveLatticeFilterParams( outputParams, outputParamsJson, alloc );
 	params.SetObject()
 		.AddMember( "Type", ContextProcessorModuleType, alloc )
 		.AddMember( "Name", AddIntentContextProcessorModule, alloc )
 		.AddMember( "Params", rapidjson::Value().SetObject()
-			.AddMember( "OutputParams", rapidjson::Value().SetObject()
-				addToJson( MinExtentSize, Uint )
-				addToJson( MinLift, Uint )
-				addToJson( MinStab, Double )
-				addToJson( OutExtent, Bool )
-				addToJson( OutSupport, Bool )
-				addToJson( OutOrder, Bool )
-				addToJson( OutStabEstimation, Bool )
-				addToJson( OutStability, Bool )
-				addToJson( IsStabilityInLog, Bool ),
-			alloc ),
+			.AddMember( "ThreadsCount", rapidjson::Value().SetUint( threadsCount ), alloc )
+			.AddMember( "Iceberg", rapidjson::Value().SetBool( isIceberg ), alloc )
+			.AddMember( "ObjectCount", rapidjson::Value().SetUint( totalObjectCount ), alloc )
+			.AddMember( "SimilarityCacheSize", rapidjson::Value().SetUint( similarityCacheSize ), alloc )
+			.AddMember( "OutputParams", outputParamsJson, alloc ),
 		alloc );
-#undef addToJson
 
 	IModule* m = dynamic_cast<IModule*>(cmp.get());
 	assert( m!=0);
@@ -8,8 +8,12 @@
 #include <ModuleTools.h>
 
 #include "details/Lattice.h"
+#include "details/CompactLattice.h"
 #include "details/FCAUtils.h"
 
+#include <utility>
+#include <vector>
+
 interface IComputationCallback;
 interface IPatternManager;
 interface IIntentStorage;
@@ -22,6 +26,10 @@ const char AddIntentContextProcessorModule[] = "AddIntentContextProcessorModule"
 
 ////////////////////////////////////////////////////////////////////
 
+struct CLatticePart;
+
+////////////////////////////////////////////////////////////////////
+
 class CAddIntentContextProcessor : public IContextProcessor, public IModule {
 public:
 	CAddIntentContextProcessor();
@@ -32,8 +40,7 @@ public:
 	virtual const std::vector<std::string>& GetObjNames() const;
 	virtual void SetObjNames( const std::vector<std::string>& names );
 	virtual void PassDescriptionParams( const JSON& json );
-	virtual void Prepare()
-		{}
+	virtual void Prepare();
 	virtual void AddObject( DWORD objectNum, const JSON& intent );
 	virtual void ProcessAllObjectsAddition();
 	virtual void SaveResult( const std::string& path );
@@ -59,9 +66,28 @@ private:
 	CSharedPtr<IIntentStorage> intStorage;
 	CSharedPtr<IExtentStorage> extStorage;
 	CSharedPtr<ILatticeBuilder> builder;
+	// The lattice under construction
 	CLattice lattice;
+	// The built lattice, filled by ProcessAllObjectsAddition
+	CCompactLattice frozenLattice;
 	DWORD objectCount;
 	CLatticeFilterParams outputParams;
+	// If more than one, the objects are split into parts processed in parallel.
+	//  The parts share the pattern manager, so it must be known to be thread-safe (see IConcurrentPatternManager).
+	DWORD threadsCount;
+	// If true, the concepts that cannot reach the minimal extent size are removed during the construction
+	bool isIceberg;
+	// The total number of objects that are going to be added, 0 if unknown. Required for isIceberg.
+	DWORD totalObjectCount;
+	// The capacity of the similarity memo of the intent storage, 0 if switched off
+	DWORD similarityCacheSize;
+	// The objects waiting for the parallel processing (object number and intent)
+	std::vector< std::pair<DWORD, TIntentId> > objects;
+
+	class CPartBuilder;
+
+	bool isPruned() const;
+	void buildInParallel();
 };
 
 ////////////////////////////////////////////////////////////////////
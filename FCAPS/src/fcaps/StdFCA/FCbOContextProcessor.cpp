@@ -0,0 +1,288 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include "FCbOContextProcessor.h"
+
+#include "details/ExtentImpl.h"
+#include "details/ParallelCbO.h"
+#include <fcaps/ComputationProcedure.h>
+#include <fcaps/PatternManager.h>
+#include <fcaps/SharedModulesLib/BinarySetPatternManager.h>
+
+#include <fcaps/storages/VectorIntentStorage.h>
+
+#include <ModuleTools.h>
+#include <ModuleJSONTools.h>
+#include <JSONTools.h>
+
+#include <algorithm>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+#define STR(...) #__VA_ARGS__
+
+const char description[] =
+STR(
+	{
+	"Name":"FCbO algorithm for binary contexts",
+	"Description":"Enumerates concepts of a binary context by parallel FCbO and finds the order of them. The result is the same as for AddIntent with BinarySetJoinPatternManagerModule but it is computed much faster.",
+	"Params": {
+			"$schema": "http://json-schema.org/draft-04/schema#",
+			"title": "Params of FCbO Context processor",
+			"type": "object",
+			"properties": {
+				"PatternManager":{
+					"description": "The object describes how the data should be read. Only BinarySetJoinPatternManagerModule is supported.",
+					"type": "@PatternManagerModules"
+				},
+				"ThreadsCount":{
+					"description": "The number of threads enumerating concepts and computing their order and stability",
+					"type": "integer",
+					"minimum": 1
+				},
+				"OutputParams":{
+					"description": "The set of parameters controlling what should be printed out as the result",
+					"type": "object",
+					"properties": {
+						"MinExtentSize":{
+							"description": "The minimal size of concept extent for reporting the concept.",
+							"type":"integer",
+							"minimum": 1
+						},
+						"MinLift":{
+							"description": "The minimum DELTA-measure for reported concept",
+							"type":"integer",
+							"minimum":1
+						},
+						"MinStab":{
+							"description": "The minimum stability of a concept to be reported",
+							"type":"number"
+						},
+						"OutExtent":{
+							"description": "A flag indicating if the extent should be reported",
+							"type":"boolean"
+						},
+						"OutSupport":{
+							"description": "A flag indicating if the support of concept should be reported",
+							"type":"boolean"
+						},
+						"OutOrder":{
+							"description": "A flag indicating if the order of filtered concepts should be found and reported",
+							"type":"boolean"
+						},
+						"OutStabEstimation":{
+							"description": "A flag indicating if stability estimate should be reported",
+							"type":"boolean"
+						},
+						"OutStability":{
+							"description": "A flag indicating if the stability should be computed and reported",
+							"type":"boolean"
+						},
+						"IsStabilityInLog":{
+							"description": "A flag indicating if stability should be reported in log scale (more readable for stability close to one)",
+							"type":"boolean"
+						}
+					}
+				}
+			}
+		}
+	}
+);
+
+////////////////////////////////////////////////////////////////////
+
+const CModuleRegistrar<CFCbOContextProcessor> CFCbOContextProcessor::registrar;
+const char* const CFCbOContextProcessor::Desc()
+{
+	return description;
+}
+
+////////////////////////////////////////////////////////////////////
+
+CFCbOContextProcessor::CFCbOContextProcessor() :
+	callback( 0 ),
+	intStorage( new CVectorIntentStorage ),
+	extStorage( new CDequeExtentStorage ),
+	threadsCount( 1 ),
+	attrsCount( 0 )
+{
+}
+
+const std::vector<std::string>& CFCbOContextProcessor::GetObjNames() const
+{
+	assert(extStorage != 0 );
+	return extStorage->GetNames();
+}
+void CFCbOContextProcessor::SetObjNames( const std::vector<std::string>& names )
+{
+	assert(extStorage != 0 );
+	extStorage->SetNames( names );
+}
+
+void CFCbOContextProcessor::PassDescriptionParams( const JSON& json )
+{
+	assert( cmp != 0 );
+	const JSON params = string("{") +
+		"\"Type\":\"" + cmp->GetType() + "\","
+		"\"Name\":\"" + cmp->GetName() + "\","
+		"\"Params\":" + json +
+		"}";
+	cmp->LoadParams( params );
+}
+
+void CFCbOContextProcessor::AddObject( DWORD objectNum, const JSON& intent )
+{
+	assert(cmp != 0);
+	CPatternDeleter deleter( cmp );
+	CSharedPtr<const CBinarySetPatternDescriptor> object( cmp->LoadObject( intent ), deleter );
+	if( object == 0 ) {
+		throw new CTextException( "CFCbOContextProcessor::AddObject", "Cannot load object " + intent );
+	}
+
+	objects.push_back( objectNum );
+	rows.push_back( vector<DWORD>() );
+	vector<DWORD>& row = rows.back();
+	row.reserve( object->GetAttribs().Size() );
+	CStdIterator<CBinarySetPatternDescriptor::CAttrsList::CConstIterator, false> attr( object->GetAttribs() );
+	for( ; !attr.IsEnd(); ++attr ) {
+		row.push_back( *attr );
+		attrsCount = max<DWORD>( attrsCount, *attr + 1 );
+	}
+
+	if( callback != 0 ) {
+		callback->ReportProgress( 1, "Objects Loaded " + StdExt::to_string( objects.size() ) );
+	}
+}
+void CFCbOContextProcessor::ProcessAllObjectsAddition()
+{
+	CParallelCbO cbo( threadsCount );
+	cbo.SetContext( rows, attrsCount );
+	vector< vector<DWORD> >().swap( rows );
+
+	cbo.Run();
+	if( callback != 0 ) {
+		callback->ReportProgress( 1, "Concepts Found " + StdExt::to_string( cbo.GetConcepts().size() ) );
+	}
+	vector< vector<TLatticeNodeId> > parents;
+	cbo.FindOrder( parents );
+
+	// Concepts are moved to the storages, the bottom is the first one
+	CVectorIntentStorage& intents = dynamic_cast<CVectorIntentStorage&>( *intStorage );
+	const vector<CParallelCbO::CConcept>& found = cbo.GetConcepts();
+	vector<CLatticeConcept> concepts( found.size() );
+	for( DWORD i = 0; i < found.size(); ++i ) {
+		const CParallelCbO::CBitset& extent = found[i].Extent;
+		concepts[i].Extent = extStorage->Clone( -1 );
+		for( CParallelCbO::CBitset::size_type g = extent.find_first(); g != CParallelCbO::CBitset::npos; g = extent.find_next( g ) ) {
+			extStorage->AddObject( objects[g], concepts[i].Extent );
+		}
+
+		const CParallelCbO::CBitset& intent = found[i].Intent;
+		CBinarySetPatternDescriptor* pattern = cmp->NewPattern();
+		for( CParallelCbO::CBitset::size_type m = intent.find_first(); m != CParallelCbO::CBitset::npos; m = intent.find_next( m ) ) {
+			pattern->AddSortedNextAttribNumber( m );
+		}
+		concepts[i].Intent = intents.AddPattern( pattern );
+	}
+	lattice.Build( concepts, parents );
+
+	if( callback != 0 ) {
+		callback->ReportProgress( 1,
+			"Lattice Size = " + StdExt::to_string( lattice.Size() ) + " "
+			"Edges Count = " + StdExt::to_string( lattice.ArcsCount() ) );
+	}
+}
+void CFCbOContextProcessor::SaveResult( const std::string& path )
+{
+	const string outFullDataPath( path );
+
+	string outSelectedDataPath( path );
+	const size_t ext = outSelectedDataPath.find_last_of( "." );
+	if( ext != string::npos ) {
+		outSelectedDataPath = outSelectedDataPath.substr(0,ext);
+	}
+	outSelectedDataPath += ".selected.json";
+
+	outputParams.PercentageBase = objects.size();
+	outputParams.ThreadsCount = threadsCount;
+
+	CLatticeWriter( lattice, intStorage, extStorage, outputParams )
+		.Write( outFullDataPath, outSelectedDataPath );
+}
+
+void CFCbOContextProcessor::LoadParams( const JSON& json )
+{
+	static char place[]="CFCbOContextProcessor::LoadParams";
+	CJsonError error;
+	rapidjson::Document params;
+	if( !ReadJsonString( json, params, error ) ) {
+		throw new CJsonException( place, error );
+	}
+	assert( string( params["Type"].GetString() ) == ContextProcessorModuleType );
+	assert( string( params["Name"].GetString() ) == FCbOContextProcessorModule );
+	if( !(params.HasMember( "Params" ) && params["Params"].IsObject()) ) {
+		error.Data = json;
+		error.Error = "Params is not found. Necessary for PatternManager";
+		throw new CJsonException(place, error);
+	}
+	const rapidjson::Value& p = params["Params"];
+
+	if( !p.HasMember( "PatternManager") || !p["PatternManager"].IsObject() ) {
+		error.Data = json;
+		error.Error = "THIS.Params.PatternManager is not found.";
+		throw new CJsonException(place, error);
+	}
+	const rapidjson::Value& pm = params["Params"]["PatternManager"];
+	string errorText;
+	CSharedPtr<IPatternManager> pmModule( CreateModuleFromJSON<IPatternManager>(pm,errorText) );
+	if( pmModule == 0 ) {
+		throw new CJsonException( place, CJsonError( json, errorText ) );
+	}
+	cmp = boost::dynamic_pointer_cast<CBinarySetDescriptorsComparator>( pmModule );
+	if( cmp == 0 ) {
+		throw new CJsonException( place, CJsonError( json,
+			string( "THIS.Params.PatternManager should be " ) + BinarySetDescriptorsComparator ) );
+	}
+	intStorage->Initialize( cmp );
+	objects.clear();
+	rows.clear();
+	attrsCount = 0;
+
+	threadsCount = 1;
+	if( p.HasMember( "ThreadsCount" ) && p["ThreadsCount"].IsUint() && p["ThreadsCount"].GetUint() > 0 ) {
+		threadsCount = p["ThreadsCount"].GetUint();
+	}
+
+	if( p.HasMember( "OutputParams") && p["OutputParams"].IsObject() ) {
+		LoadLatticeFilterParams( p["OutputParams"], outputParams );
+	}
+}
+
+JSON CFCbOContextProcessor::SaveParams() const
+{
+	rapidjson::Document params;
+	rapidjson::MemoryPoolAllocator<>& alloc = params.GetAllocator();
+
+	rapidjson::Value outputParamsJson;
+	SaveLatticeFilterParams( outputParams, outputParamsJson, alloc );
+	params.SetObject()
+		.AddMember( "Type", ContextProcessorModuleType, alloc )
+		.AddMember( "Name", FCbOContextProcessorModule, alloc )
+		.AddMember( "Params", rapidjson::Value().SetObject()
+			.AddMember( "ThreadsCount", rapidjson::Value().SetUint( threadsCount ), alloc )
+			.AddMember( "OutputParams", outputParamsJson, alloc ),
+		alloc );
+
+	if( cmp != 0 ) {
+		JSON cmpParams = cmp->SaveParams();
+		rapidjson::Document cmpParamsDoc;
+		CJsonError error;
+		const bool rslt = ReadJsonString( cmpParams, cmpParamsDoc, error );
+		assert(rslt);
+		params["Params"].AddMember("PatternManager", cmpParamsDoc.Move(), alloc );
+	}
+
+	JSON result;
+	CreateStringFromJSON( params, result );
+	return result;
+}
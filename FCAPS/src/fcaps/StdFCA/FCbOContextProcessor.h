@@ -0,0 +1,76 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#ifndef CFCBOCONTEXTPROCESSOR_H
+#define CFCBOCONTEXTPROCESSOR_H
+
+#include <fcaps/ContextProcessor.h>
+#include <fcaps/Module.h>
+#include <ModuleTools.h>
+
+#include "details/CompactLattice.h"
+#include "details/FCAUtils.h"
+
+#include <vector>
+
+interface IComputationCallback;
+interface IIntentStorage;
+interface IExtentStorage;
+class CBinarySetDescriptorsComparator;
+
+////////////////////////////////////////////////////////////////////
+
+const char FCbOContextProcessorModule[] = "FCbOContextProcessorModule";
+
+////////////////////////////////////////////////////////////////////
+
+// Builds the concept lattice of a binary context by FCbO.
+//  The result is the same as for AddIntent with BinarySetPatternManager.
+class CFCbOContextProcessor : public IContextProcessor, public IModule {
+public:
+	CFCbOContextProcessor();
+
+	// Methods of IContextProcessor
+	virtual void SetCallback( const IComputationCallback * cb )
+		{callback = cb;}
+	virtual const std::vector<std::string>& GetObjNames() const;
+	virtual void SetObjNames( const std::vector<std::string>& names );
+	virtual void PassDescriptionParams( const JSON& json );
+	virtual void Prepare()
+		{}
+	virtual void AddObject( DWORD objectNum, const JSON& intent );
+	virtual void ProcessAllObjectsAddition();
+	virtual void SaveResult( const std::string& path );
+
+	// Methods of IModule
+	virtual void LoadParams( const JSON& json );
+	virtual JSON SaveParams() const;
+	virtual const char* const GetType() const
+		{ return Type(); };
+	virtual const char* const GetName() const
+		{ return Name(); };
+	// For CModuleRegistrar
+	static const char* const Type()
+		{ return ContextProcessorModuleType;}
+	static const char* const Name()
+		{ return FCbOContextProcessorModule; }
+	static const char* const Desc();
+
+private:
+	static const CModuleRegistrar<CFCbOContextProcessor> registrar;
+	const IComputationCallback * callback;
+	CSharedPtr<CBinarySetDescriptorsComparator> cmp;
+	CSharedPtr<IIntentStorage> intStorage;
+	CSharedPtr<IExtentStorage> extStorage;
+	CCompactLattice lattice;
+	CLatticeFilterParams outputParams;
+	DWORD threadsCount;
+
+	// Objects numbers and their attributes
+	std::vector<DWORD> objects;
+	std::vector< std::vector<DWORD> > rows;
+	DWORD attrsCount;
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif // CFCBOCONTEXTPROCESSOR_H
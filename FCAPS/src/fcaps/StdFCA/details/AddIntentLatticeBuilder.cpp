@@ -9,14 +9,21 @@
 
 #include <StdTools.h>
 
+#include <vector>
+
 
 using namespace std;
 using namespace boost;
 
 ////////////////////////////////////////////////////////////////////
 
+// The lattice is filtered when it grows by this part of its size since the last filtering
+static const DWORD FilterGrowthDivisor = 8;
+
+////////////////////////////////////////////////////////////////////
+
 CAddIntentLatticeBuilder::CAddIntentLatticeBuilder() :
-	lattice( 0 ), processingObject( 0 ), currObjDescrID( -1 )
+	lattice( 0 ), processingObject( 0 ), currObjDescrID( -1 ), filteredSize( 0 )
 {
 
 }
@@ -37,6 +44,7 @@ void CAddIntentLatticeBuilder::SetResultLattice( CLattice& result )
 	lattice = &result;
 
 	lessConcept = 0;
+	filteredSize = 0;
 }
 
 void CAddIntentLatticeBuilder::SetPrunner( const CSharedPtr<IPatternPrunner>& _prunner )
@@ -66,6 +74,22 @@ void CAddIntentLatticeBuilder::AddObject( DWORD objectNum, DWORD descriptionID )
 //	comparator->PreprocessObjectDescription( description );
 	currObjDescrID = descriptionID;
 	addIntent( descriptionID );
+
+	if( prunner != 0 ) {
+		prunner->OnObjectAdded();
+		// The scan of the lattice is paid by the concepts added since the last filtering
+		if( lattice->Size() >= filteredSize + filteredSize / FilterGrowthDivisor ) {
+			filterLattice();
+		}
+	}
+}
+
+void CAddIntentLatticeBuilder::ProcessAllObjectsAddition()
+{
+	if( prunner != 0 && lattice != 0 ) {
+		// The concepts that were not filtered yet
+		filterLattice();
+	}
 }
 
 bool CAddIntentLatticeBuilder::FindMaxConcept(
@@ -120,6 +144,12 @@ inline void CAddIntentLatticeBuilder::InitializeNewConcept(
 	getConcept(node).Extent = extent;
 }
 
+void CAddIntentLatticeBuilder::DeleteConcept( CLatticeNode& node )
+{
+	comparator->DeletePattern( node.Data.Intent );
+	extStorage->Delete( node.Data.Extent );
+}
+
 inline CLatticeConcept& CAddIntentLatticeBuilder::getConcept( TLatticeNodeId id )
 {
 	return lattice->GetNode( id ).Data;
@@ -140,9 +170,6 @@ void CAddIntentLatticeBuilder::addIntent( DWORD description )
 
 	if( lessConcept != 0 ) {
 		addNewObjectToConceptTree( description, lessConcept );
-		if( prunner != 0 ) {
-			filterLattice();
-		}
 	}
 }
 
@@ -285,31 +312,83 @@ void CAddIntentLatticeBuilder::addNewObjectToConceptTree(
 	}
 }
 
+// Removes the concepts that are not needed anymore. They form the bottom part of the lattice,
+//  so the parents of the kept concepts are kept and the minimal kept concepts become the parents of the bottom.
+//  The removed concepts get the last kept concepts in their places, so only the parents of the moved ones are changed.
 void CAddIntentLatticeBuilder::filterLattice()
 {
-// TODO
-
-//	assert( prunner != 0 );
-//
-//	CLatticeNodes& nodes = lattice->GetNodes();
-//	CStdIterator<CLatticeNodes::CIterator, false> node( nodes );
-//	for( ; !node.IsEnd(); ) {
-//		TLatticeNodeId concept( node );
-//		node++;
-//		if( prunner->IsUseful( PS_PatternWithParents, concept->Extent, concept->Intent ) ) {
-//			continue;
-//		}
-//		CStdIterator<CEdgeToNodeMap::iterator> itr( concept.ChildrenBegin(), concept.ChildrenEnd() );
-//		for( ; !itr.IsEnd(); ++itr ) {
-//			if( prunner->IsUseful( PS_PatternWithParents, (*itr)->Extent, (*itr)->Intent ) ){
-//				break;
-//			}
-//		}
-//		if( !itr.IsEnd() ) {
-//			continue;
-//		}
-//		lattice->Delete( concept );
-//	}
+	assert( prunner != 0 );
+
+	CLatticeNodes& nodes = lattice->GetNodes();
+	const DWORD size = nodes.size();
+	vector<bool> isRemoved( size, false );
+	DWORD keptCount = size;
+	for( TLatticeNodeId i = 1; i < size; ++i ) {
+		const CLatticeConcept& concept = nodes[i].Data;
+		if( !prunner->IsUseful( concept.Extent, concept.Intent ) ) {
+			isRemoved[i] = true;
+			--keptCount;
+		}
+	}
+	filteredSize = keptCount;
+	if( keptCount == size ) {
+		return;
+	}
+
+	vector<TLatticeNodeId> newIds( size );
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		newIds[i] = i;
+	}
+	TLatticeNodeId moved = keptCount;
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		if( !isRemoved[i] ) {
+			continue;
+		}
+		DeleteConcept( nodes[i] );
+		if( i >= keptCount ) {
+			continue;
+		}
+		// The hole is filled by a kept concept from the end
+		while( isRemoved[moved] ) {
+			++moved;
+		}
+		assert( moved < size );
+		newIds[moved] = i;
+		CLatticeNode& hole = nodes[i];
+		CLatticeNode& node = nodes[moved];
+		hole.Parents.swap( node.Parents );
+		hole.Data = node.Data;
+		hole.UserData = node.UserData;
+		node.UserData = 0;
+		++moved;
+	}
+	nodes.erase( nodes.begin() + keptCount, nodes.end() );
+
+	vector<bool> hasChildren( keptCount, false );
+	vector<TLatticeNodeId> changed;
+	for( TLatticeNodeId i = 1; i < keptCount; ++i ) {
+		CEdges& parents = nodes[i].Parents;
+		changed.clear();
+		CStdIterator<CEdges::const_iterator> parent( parents );
+		for( ; !parent.IsEnd(); ++parent ) {
+			assert( !isRemoved[*parent] );
+			if( newIds[*parent] != *parent ) {
+				changed.push_back( *parent );
+			}
+			hasChildren[newIds[*parent]] = true;
+		}
+		for( DWORD j = 0; j < changed.size(); ++j ) {
+			parents.erase( changed[j] );
+			parents.insert( newIds[changed[j]] );
+		}
+	}
+	CEdges& bottomParents = nodes[0].Parents;
+	bottomParents.clear();
+	for( TLatticeNodeId i = 1; i < keptCount; ++i ) {
+		if( !hasChildren[i] ) {
+			bottomParents.insert( i );
+		}
+	}
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -326,6 +405,8 @@ struct CCacheNode {
 
 void CAddIntentLatticeBuilderExt::ProcessAllObjectsAddition()
 {
+	CAddIntentLatticeBuilder::ProcessAllObjectsAddition();
+
 	CStdIterator<CLatticeNodes::iterator> node( lattice->GetNodes() );
 	for( ; !node.IsEnd(); ++node ) {
 		delete reinterpret_cast<CCacheNode*>((*node).UserData);
@@ -337,6 +418,13 @@ void CAddIntentLatticeBuilderExt::ProcessAllObjectsAddition()
 //	return reinterpret_cast<CCacheNode*>( parentNode.GetUserData() );
 //}
 
+void CAddIntentLatticeBuilderExt::DeleteConcept( CLatticeNode& node )
+{
+	delete reinterpret_cast<CCacheNode*>( node.UserData );
+	node.UserData = 0;
+	CAddIntentLatticeBuilder::DeleteConcept( node );
+}
+
 bool CAddIntentLatticeBuilderExt::FindMaxConcept(
 	DWORD intent, TLatticeNodeId generatorConcept,
 	TLatticeNodeId& maxGeneratorConcept )
@@ -512,3 +600,20 @@ TCompareResult CAddIntentLatticeBuilderExt::isIntentMoreEqGeneralExt(
 }
 
 ////////////////////////////////////////////////////////////////////
+
+CMinSupportPrunner::CMinSupportPrunner( const CSharedPtr<IExtentStorage>& _extStorage, DWORD _minSupport, DWORD _objectsCount ) :
+	extStorage( _extStorage ),
+	minSupport( _minSupport ),
+	objectsCount( _objectsCount ),
+	addedObjectsCount( 0 )
+{
+	assert( extStorage != 0 );
+}
+
+bool CMinSupportPrunner::IsUseful( DWORD extent, DWORD intent ) const
+{
+	const DWORD restObjectsCount = addedObjectsCount < objectsCount ? objectsCount - addedObjectsCount : 0;
+	return extStorage->Size( extent ) + restObjectsCount >= minSupport;
+}
+
+////////////////////////////////////////////////////////////////////
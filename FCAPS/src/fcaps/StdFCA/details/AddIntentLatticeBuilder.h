@@ -45,8 +45,7 @@ public:
 	virtual void SetResultLattice( CLattice& result );
 	virtual void SetPrunner( const CSharedPtr<IPatternPrunner>& prunner );
 	virtual void AddObject( DWORD objectNum, DWORD patternID );
-	virtual void ProcessAllObjectsAddition()
-		{}
+	virtual void ProcessAllObjectsAddition();
 
 protected:
 	// Find the biggest concept giving the birth to the intent, i.e. more specific than the intent.
@@ -66,6 +65,8 @@ protected:
 	virtual void InitializeNewConcept(
 		DWORD extent, DWORD intent,
 		const TLatticeNodeId& node );
+	// Release the data of a concept removed by the prunner.
+	virtual void DeleteConcept( CLatticeNode& node );
 
 	// The object to process extents.
 	CSharedPtr<IExtentStorage> extStorage;
@@ -89,6 +90,8 @@ private:
 
 	// Description of currently processing object
 	DWORD currObjDescrID;
+	// The size of the lattice after the last filtering
+	DWORD filteredSize;
 
 	void addIntent( DWORD descriptionID );
 	void addState( DWORD intent, TLatticeNodeId generatorConcept );
@@ -121,6 +124,7 @@ protected:
 	virtual void InitializeNewConcept(
 		DWORD extent, DWORD intent,
 		const TLatticeNodeId& node );
+	virtual void DeleteConcept( CLatticeNode& node );
 
 private:
 	TCompareResult isIntentMoreEqGeneral( DWORD intent, const TLatticeNodeId& parentCandidate );
@@ -128,5 +132,26 @@ private:
 	TCompareResult isIntentMoreEqGeneralExt( DWORD intent, const TLatticeNodeId& parentCandidate );
 };
 
+////////////////////////////////////////////////////////////////////
+
+// Prunner for iceberg lattices: keeps only concepts that can still reach the minimal support.
+//  A concept can get at most all the objects that are not yet added.
+class CMinSupportPrunner : public IPatternPrunner {
+public:
+	// objectsCount -- the total number of objects that are going to be added
+	CMinSupportPrunner( const CSharedPtr<IExtentStorage>& extStorage, DWORD minSupport, DWORD objectsCount );
+
+	// Methods of IPatternPrunner
+	virtual void OnObjectAdded()
+		{ ++addedObjectsCount; }
+	virtual bool IsUseful( DWORD extent, DWORD intent ) const;
+
+private:
+	const CSharedPtr<IExtentStorage> extStorage;
+	const DWORD minSupport;
+	const DWORD objectsCount;
+	DWORD addedObjectsCount;
+};
+
 ///////////////////////////////////////////////////////////////////////////////////
 #endif // ADDINTENTLATTICEBUILDER_H_
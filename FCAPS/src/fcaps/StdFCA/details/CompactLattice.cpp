@@ -0,0 +1,74 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include "CompactLattice.h"
+
+#include <algorithm>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+void CCompactLattice::Freeze( CLattice& lattice )
+{
+	const DWORD size = lattice.Size();
+	const CLatticeNodes& nodes = lattice.GetNodes();
+
+	concepts.resize( size );
+	parentOffsets.assign( size + 1, 0 );
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		concepts[i] = nodes[i].Data;
+		parentOffsets[i + 1] = parentOffsets[i] + nodes[i].Parents.size();
+	}
+	parents.resize( parentOffsets.back() );
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		copy( nodes[i].Parents.begin(), nodes[i].Parents.end(), parents.begin() + parentOffsets[i] );
+		sort( parents.begin() + parentOffsets[i], parents.begin() + parentOffsets[i + 1] );
+	}
+	lattice.GetNodes().clear();
+
+	fillChildren();
+}
+
+void CCompactLattice::Build( vector<CLatticeConcept>& newConcepts, const vector< vector<TLatticeNodeId> >& newParents )
+{
+	assert( newConcepts.size() == newParents.size() );
+	const DWORD size = newConcepts.size();
+
+	concepts.swap( newConcepts );
+	newConcepts.clear();
+	parentOffsets.assign( size + 1, 0 );
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		parentOffsets[i + 1] = parentOffsets[i] + newParents[i].size();
+	}
+	parents.resize( parentOffsets.back() );
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		copy( newParents[i].begin(), newParents[i].end(), parents.begin() + parentOffsets[i] );
+		sort( parents.begin() + parentOffsets[i], parents.begin() + parentOffsets[i + 1] );
+	}
+
+	fillChildren();
+}
+
+// Children are the transposition of parents
+void CCompactLattice::fillChildren()
+{
+	const DWORD size = concepts.size();
+	childOffsets.assign( size + 1, 0 );
+	for( DWORD i = 0; i < parents.size(); ++i ) {
+		assert( parents[i] < size );
+		++childOffsets[parents[i] + 1];
+	}
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		childOffsets[i + 1] += childOffsets[i];
+	}
+
+	children.resize( childOffsets.back() );
+	vector<DWORD> childrenEnd( childOffsets.begin(), childOffsets.end() - 1 );
+	// Children are added in the increasing order of ids
+	for( TLatticeNodeId i = 0; i < size; ++i ) {
+		for( DWORD j = parentOffsets[i]; j < parentOffsets[i + 1]; ++j ) {
+			children[childrenEnd[parents[j]]] = i;
+			++childrenEnd[parents[j]];
+		}
+	}
+}
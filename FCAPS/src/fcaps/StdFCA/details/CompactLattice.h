@@ -0,0 +1,64 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Read-only lattice with flat storage of concepts and arcs.
+//  Parents and children of all nodes are kept in two arrays (compressed sparse rows),
+//  the arcs of node i are in [Offsets[i], Offsets[i+1]).
+//  It is built by freezing CLattice when the construction is finished.
+
+#ifndef COMPACTLATTICE_H_INCLUDED
+#define COMPACTLATTICE_H_INCLUDED
+
+#include <common.h>
+
+#include "Lattice.h"
+
+#include <vector>
+
+class CCompactLattice {
+public:
+	CCompactLattice()
+		{}
+
+	// Moves the lattice to the compact form, the source lattice is cleared.
+	void Freeze( CLattice& lattice );
+	// Builds the lattice from concepts and their parents, the concepts are taken.
+	void Build( std::vector<CLatticeConcept>& concepts, const std::vector< std::vector<TLatticeNodeId> >& parents );
+
+	DWORD Size() const
+		{ return concepts.size(); }
+	DWORD ArcsCount() const
+		{ return parents.size(); }
+
+	const CLatticeConcept& GetConcept( TLatticeNodeId id ) const
+		{ assert( id < concepts.size() ); return concepts[id]; }
+
+	// The parents (children) of a node are sorted by ids
+	DWORD ParentsCount( TLatticeNodeId id ) const
+		{ return parentOffsets[id + 1] - parentOffsets[id]; }
+	const TLatticeNodeId* ParentsBegin( TLatticeNodeId id ) const
+		{ return parents.data() + parentOffsets[id]; }
+	const TLatticeNodeId* ParentsEnd( TLatticeNodeId id ) const
+		{ return parents.data() + parentOffsets[id + 1]; }
+
+	DWORD ChildrenCount( TLatticeNodeId id ) const
+		{ return childOffsets[id + 1] - childOffsets[id]; }
+	const TLatticeNodeId* ChildrenBegin( TLatticeNodeId id ) const
+		{ return children.data() + childOffsets[id]; }
+	const TLatticeNodeId* ChildrenEnd( TLatticeNodeId id ) const
+		{ return children.data() + childOffsets[id + 1]; }
+
+private:
+	std::vector<CLatticeConcept> concepts;
+	std::vector<DWORD> parentOffsets;
+	std::vector<TLatticeNodeId> parents;
+	std::vector<DWORD> childOffsets;
+	std::vector<TLatticeNodeId> children;
+
+	void fillChildren();
+
+	CCompactLattice( const CCompactLattice& );
+	CCompactLattice& operator=( const CCompactLattice& );
+};
+
+#endif // COMPACTLATTICE_H_INCLUDED
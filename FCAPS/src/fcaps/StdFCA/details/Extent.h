@@ -19,6 +19,8 @@ interface IExtentStorage : public virtual IObject {
 	virtual bool AddObject( DWORD objectID, DWORD extentID ) = 0;
 	// Clone given extent
 	virtual DWORD Clone( DWORD extentID ) = 0;
+	// Remove the extent from the storage, the id should not be used anymore
+	virtual void Delete( DWORD extentID ) = 0;
 	// Get size of the extent given by id
 	virtual DWORD Size( DWORD extentID ) const = 0;
 	// Get last added object ot the extent
@@ -22,6 +22,8 @@ public:
 	// Methods of IExtentStorage
 	virtual bool AddObject( DWORD objectID, DWORD extentID );
 	virtual DWORD Clone( DWORD extentID );
+	virtual void Delete( DWORD extentID )
+		{ extents.replace( extentID, 0 ); }
 	virtual DWORD Size( DWORD extentID ) const;
 	virtual DWORD GetLastAddedObject( DWORD extentID ) const;
 	virtual void ListObjects( DWORD extentId, CList<DWORD>& list ) const;
@@ -36,9 +38,6 @@ public:
 	// Get extent by id
 	const CExtent& GetExtent( DWORD extentID ) const
 		{ assert( extentID < extents.size() ); return extents[extentID]; }
-	// Remove extent from the set
-	void Delete( DWORD extentID )
-		{ extents.replace( extentID, 0 ); }
 
 private:
 	boost::ptr_deque< boost::nullable<CExtent> > extents;
@@ -56,6 +55,8 @@ public:
 	// Methods of IExtentStorage
 	virtual bool AddObject( DWORD objectID, DWORD extentID );
 	virtual DWORD Clone( DWORD extentID );
+	virtual void Delete( DWORD extentID )
+		{ extents.replace( extentID, new CExtent ); }
 	virtual DWORD Size( DWORD extentID ) const;
 	virtual DWORD GetLastAddedObject( DWORD extentID ) const;
 	virtual void ListObjects( DWORD extentId, CList<DWORD>& list ) const;
@@ -3,7 +3,7 @@
 #include <common.h>
 
 #include "FCAUtils.h"
-#include "Lattice.h"
+#include "CompactLattice.h"
 #include "Extent.h"
 #include <fcaps/storages/IntentStorage.h>
 #include <fcaps/SharedModulesLib/FindConceptOrder.h>
@@ -12,6 +12,9 @@
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+
 #include <vector>
 #include <iostream>
 #include <math.h>
@@ -29,11 +32,52 @@ template<typename T> bool isfinite(T arg)
 
 ////////////////////////////////////////////////////////////////////
 
+void LoadLatticeFilterParams( const rapidjson::Value& opJson, CLatticeFilterParams& params )
+{
+#define	getFromJson( name, opp ) \
+	if( opJson.HasMember( #name ) && opJson[#name].Is##opp() ) { \
+		params.name = opJson[#name].Get##opp(); \
+	}
+	getFromJson( MinExtentSize, Uint );
+	getFromJson( MinLift, Uint );
+	// We should check IsNumber rather than IsDouble here.
+	if( opJson.HasMember( "MinStab" ) && opJson["MinStab"].IsNumber() ) {
+		params.MinStab = opJson["MinStab"].GetDouble();
+	}
+	getFromJson( OutExtent, Bool );
+	getFromJson( OutSupport, Bool );
+	getFromJson( OutOrder, Bool );
+	getFromJson( OutStabEstimation, Bool );
+	getFromJson( OutStability, Bool );
+	getFromJson( IsStabilityInLog, Bool );
+#undef	getFromJson
+}
+
+void SaveLatticeFilterParams( const CLatticeFilterParams& params,
+	rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& alloc )
+{
+#define	addToJson( name, opp ) \
+	.AddMember( #name , rapidjson::Value().Set##opp( params.name ), alloc )
+	json.SetObject()
+		addToJson( MinExtentSize, Uint )
+		addToJson( MinLift, Uint )
+		addToJson( MinStab, Double )
+		addToJson( OutExtent, Bool )
+		addToJson( OutSupport, Bool )
+		addToJson( OutOrder, Bool )
+		addToJson( OutStabEstimation, Bool )
+		addToJson( OutStability, Bool )
+		addToJson( IsStabilityInLog, Bool );
+#undef addToJson
+}
+
+////////////////////////////////////////////////////////////////////
+
 class CInterestingConcepts {
 public:
 	CInterestingConcepts(
 		const vector<TLatticeNodeId>& _nodes,
-		const CLattice& _lattice,
+		const CCompactLattice& _lattice,
 		const IIntentStorage& _cmp,
 		const IExtentStorage& _extCmp
 	) : nodes(_nodes),lattice(_lattice),cmp(_cmp),extCmp(_extCmp) {}
@@ -47,22 +91,22 @@ public:
 	// Topological sort of concepts Compare(c1,c2) == CR_MoreGeneral => operator<(c1,c2) = true
 	bool IsTopologicallyLess( DWORD c1, DWORD c2 ) const
 	{
-		 return extCmp.Size(lattice.GetNode(nodes[c1]).Data.Extent)
-			> extCmp.Size(lattice.GetNode(nodes[c2]).Data.Extent);
+		 return extCmp.Size(lattice.GetConcept(nodes[c1]).Extent)
+			> extCmp.Size(lattice.GetConcept(nodes[c2]).Extent);
 	}
 	// Comparison of two concepts
 	bool IsLess( DWORD c1, DWORD c2 ) const
 	{
 		return cmp.Compare(
-			lattice.GetNode(nodes[c1]).Data.Intent,
-			lattice.GetNode(nodes[c2]).Data.Intent,
+			lattice.GetConcept(nodes[c1]).Intent,
+			lattice.GetConcept(nodes[c2]).Intent,
 			CR_MoreGeneral
 		) != CR_Incomparable;
 	}
 
 private:
 	const vector<TLatticeNodeId>& nodes;
-	const CLattice& lattice;
+	const CCompactLattice& lattice;
 	const IIntentStorage& cmp;
 	const IExtentStorage& extCmp;
 };
@@ -94,48 +138,32 @@ void CLatticeWriter::Write( const std::string& latticePath, const std::string& s
 void CLatticeWriter::computeConceptData()
 {
 	cData.clear();
-	cData.resize( lattice.GetNodes().size() );
+	cData.resize( lattice.Size() );
 
-	fillChildren();
+	// Children are stored in the lattice
+	arcsCount = lattice.ArcsCount();
 
 	// fill log stability range
-	const CLatticeNodes& nodes = lattice.GetNodes();
-	for( TLatticeNodeId nodeId = 0; nodeId < nodes.size(); ++nodeId ) {
+	for( TLatticeNodeId nodeId = 0; nodeId < lattice.Size(); ++nodeId ) {
 		fillConceptStabilityLogRange( nodeId );
 	}
 }
-// Computes children of concepts.
-void CLatticeWriter::fillChildren()
-{
-	arcsCount = 0;
-	const CLatticeNodes& nodes = lattice.GetNodes();
-	for( TLatticeNodeId nodeId = 0; nodeId < nodes.size(); ++nodeId ) {
-		const CLatticeNode& node = nodes[nodeId];
-		CStdIterator<CEdges::const_iterator> parent( node.Parents );
-		for( ; !parent.IsEnd(); ++parent ) {
-			TLatticeNodeId parentNodeId = *parent;
-			assert( 0 <= parentNodeId && parentNodeId < cData.size() );
-			cData[parentNodeId].Children.push_back( nodeId );
-			++arcsCount;
-		}
-	}
-}
 
 // estimates stability for a given concept
 void CLatticeWriter::fillConceptStabilityLogRange( TLatticeNodeId concept )
 {
-	assert( 0 <= concept && concept < lattice.GetNodes().size() );
-	assert( cData.size() == lattice.GetNodes().size() );
+	assert( 0 <= concept && concept < lattice.Size() );
+	assert( cData.size() == lattice.Size() );
 
 	DWORD& maxStab = cData[concept].MaxStab;
 	double& minStab = cData[concept].MinStab;
 
-	const int extSize = extStorage->Size( lattice.GetNode(concept).Data.Extent );
+	const int extSize = extStorage->Size( lattice.GetConcept(concept).Extent );
 	maxStab = extSize;
 	vector<int> diffs;
-	CStdIterator<vector<TLatticeNodeId>::const_iterator> child( cData[concept].Children );
-	for( ; !child.IsEnd(); ++child ) {
-		const int childSize = extStorage->Size( lattice.GetNode(*child).Data.Extent );
+	const TLatticeNodeId* child = lattice.ChildrenBegin( concept );
+	for( ; child != lattice.ChildrenEnd( concept ); ++child ) {
+		const int childSize = extStorage->Size( lattice.GetConcept(*child).Extent );
 		maxStab = std::min( (int)maxStab, extSize - childSize );
 		diffs.push_back( extSize - childSize );
 	}
@@ -160,16 +188,20 @@ void CLatticeWriter::computeStabilityData()
 	flags.resize( sData.size(), false );
 	std::cout << ">>Flags size done.\n";
 
-	CStdIterator<CLatticeNodes::const_iterator> node( lattice.GetNodes() );
-	TLatticeNodeId nodeId = 0;
-	for( ; !node.IsEnd(); ++node, ++nodeId ) {
+	for( TLatticeNodeId nodeId = 0; nodeId < lattice.Size(); ++nodeId ) {
 		indecis[nodeId] = nodeId;
-		sData[nodeId].ExtentSize = extStorage->Size( (*node).Data.Extent );
+		sData[nodeId].ExtentSize = extStorage->Size( lattice.GetConcept( nodeId ).Extent );
 	}
 
 	CStabilityIndecisCmp cmp( sData );
 	std::sort( indecis.begin(), indecis.end(), cmp );
 
+	if( params.ThreadsCount > 1 ) {
+		computeStabilityInParallel( indecis );
+		std::cout << "\nStability Calculation END                                      \n";
+		return;
+	}
+
 	int lastNodeExtentSize = 0;
 	for( size_t i = 0; i < indecis.size(); ++i ) {
 		const TLatticeNodeId conceptNum = indecis[i];
@@ -190,8 +222,8 @@ void CLatticeWriter::computeStabilityData()
 
 void CLatticeWriter::unmarkFlags( TLatticeNodeId node, CStabilityContext& context )
 {
-	CStdIterator<CEdges::const_iterator> itr( lattice.GetNode( node ).Parents );
-	for( ; !itr.IsEnd(); ++itr ) {
+	const TLatticeNodeId* itr = lattice.ParentsBegin( node );
+	for( ; itr != lattice.ParentsEnd( node ); ++itr ) {
 		const TLatticeNodeId nodeId = *itr;
 		if( !context.Flags[nodeId] ) {
 			continue;
@@ -203,8 +235,8 @@ void CLatticeWriter::unmarkFlags( TLatticeNodeId node, CStabilityContext& contex
 
 void CLatticeWriter::correctParents( TLatticeNodeId node, CStabilityContext& context )
 {
-	CStdIterator<CEdges::const_iterator> itr( lattice.GetNode( node ).Parents );
-	for( ; !itr.IsEnd(); ++itr ) {
+	const TLatticeNodeId* itr = lattice.ParentsBegin( node );
+	for( ; itr != lattice.ParentsEnd( node ); ++itr ) {
 		const TLatticeNodeId nodeId = *itr;
 		if( context.Flags[nodeId] ) {
 			continue;
@@ -217,6 +249,145 @@ void CLatticeWriter::correctParents( TLatticeNodeId node, CStabilityContext& con
 	}
 }
 
+// The number of concepts of a chunk per thread, bounds the memory for the corrections
+static const DWORD StabilityChunkSizePerThread = 256;
+
+// The corrections of stability found by one thread for the ancestors owned by another thread
+struct CLatticeWriter::CStabilityCorrections {
+	// The ancestor and the value to subtract from its stability
+	vector< pair<TLatticeNodeId, long double> > Values;
+	// The end of the values of every concept of the chunk processed by the thread
+	vector<DWORD> Ends;
+};
+
+// Concepts of the same extent size are incomparable, so they are processed together as a wave.
+//  A wave is split into chunks of bounded size. At first every thread finds the ancestors of its concepts of the chunk
+//  and computes the corrections, splitting them by the thread owning the ancestor (the id modulo the number of threads).
+//  Then every thread applies the corrections of its ancestors, taking the concepts in the same order as the sequential version.
+//  So the result is exactly the same.
+class CLatticeWriter::CStabilityThread {
+public:
+	CStabilityThread( CLatticeWriter& _writer, const vector<TLatticeNodeId>& _indecis, const vector<DWORD>& _chunks,
+			vector<CStabilityCorrections>& _corrections, boost::barrier& _barrier, DWORD _thread, DWORD _threadsCount ) :
+		writer( _writer ), indecis( _indecis ), chunks( _chunks ), corrections( _corrections ),
+		barrier( _barrier ), thread( _thread ), threadsCount( _threadsCount ) {}
+
+	void operator()();
+private:
+	CLatticeWriter& writer;
+	const vector<TLatticeNodeId>& indecis;
+	// Starts of chunks in indecis
+	const vector<DWORD>& chunks;
+	// The corrections of the current chunk found by thread i for the ancestors of thread j are at i * threadsCount + j
+	vector<CStabilityCorrections>& corrections;
+	boost::barrier& barrier;
+	const DWORD thread;
+	const DWORD threadsCount;
+
+	void findCorrections( DWORD chunk, vector<bool>& flags, vector<TLatticeNodeId>& ancestors );
+	void applyCorrections( DWORD chunk );
+};
+
+void CLatticeWriter::CStabilityThread::operator()()
+{
+	vector<bool> flags( writer.sData.size(), false );
+	vector<TLatticeNodeId> ancestors;
+	for( DWORD c = 0; c + 1 < chunks.size(); ++c ) {
+		findCorrections( c, flags, ancestors );
+		barrier.wait();
+		applyCorrections( c );
+		barrier.wait();
+
+		if( thread == 0 ) {
+			std::cout << "\r>>Processed: " << chunks[c + 1] << "(" << indecis.size() << ")";
+		}
+	}
+}
+
+void CLatticeWriter::CStabilityThread::findCorrections( DWORD chunk,
+	vector<bool>& flags, vector<TLatticeNodeId>& ancestors )
+{
+	const vector<CStabilityData>& sData = writer.sData;
+	CStabilityCorrections* const out = &corrections[thread * threadsCount];
+	for( DWORD t = 0; t < threadsCount; ++t ) {
+		out[t].Values.clear();
+		out[t].Ends.clear();
+	}
+
+	for( DWORD i = chunks[chunk] + thread; i < chunks[chunk + 1]; i += threadsCount ) {
+		const CStabilityData& node = sData[indecis[i]];
+		writer.findAncestors( indecis[i], flags, ancestors );
+		for( DWORD j = 0; j < ancestors.size(); ++j ) {
+			const CStabilityData& parentData = sData[ancestors[j]];
+			out[ancestors[j] % threadsCount].Values.push_back( pair<TLatticeNodeId, long double>( ancestors[j],
+				node.Stability * pow( (long double)2.0, node.ExtentSize - parentData.ExtentSize ) ) );
+		}
+		for( DWORD t = 0; t < threadsCount; ++t ) {
+			out[t].Ends.push_back( out[t].Values.size() );
+		}
+	}
+}
+
+void CLatticeWriter::CStabilityThread::applyCorrections( DWORD chunk )
+{
+	vector<CStabilityData>& sData = writer.sData;
+	// The next correction from every thread
+	vector<DWORD> positions( threadsCount, 0 );
+	for( DWORD i = 0; i < chunks[chunk + 1] - chunks[chunk]; ++i ) {
+		const DWORD source = i % threadsCount;
+		const CStabilityCorrections& in = corrections[source * threadsCount + thread];
+		const DWORD end = in.Ends[i / threadsCount];
+		for( DWORD& pos = positions[source]; pos < end; ++pos ) {
+			sData[in.Values[pos].first].Stability -= in.Values[pos].second;
+		}
+	}
+}
+
+void CLatticeWriter::computeStabilityInParallel( const vector<TLatticeNodeId>& indecis )
+{
+	const DWORD chunkSize = StabilityChunkSizePerThread * params.ThreadsCount;
+	vector<DWORD> chunks;
+	for( DWORD i = 0; i < indecis.size(); ++i ) {
+		if( i == 0 || sData[indecis[i]].ExtentSize != sData[indecis[i - 1]].ExtentSize
+			|| i - chunks.back() == chunkSize )
+		{
+			chunks.push_back( i );
+		}
+	}
+	chunks.push_back( indecis.size() );
+
+	vector<CStabilityCorrections> corrections( params.ThreadsCount * params.ThreadsCount );
+	boost::barrier barrier( params.ThreadsCount );
+	boost::thread_group threads;
+	for( DWORD i = 0; i < params.ThreadsCount; ++i ) {
+		threads.create_thread( CStabilityThread( *this, indecis, chunks, corrections, barrier, i, params.ThreadsCount ) );
+	}
+	threads.join_all();
+}
+
+// All ancestors of a node, flags are cleared at the end
+void CLatticeWriter::findAncestors( TLatticeNodeId node, vector<bool>& flags, vector<TLatticeNodeId>& ancestors ) const
+{
+	ancestors.clear();
+	vector<TLatticeNodeId> stack( 1, node );
+	while( !stack.empty() ) {
+		const TLatticeNodeId current = stack.back();
+		stack.pop_back();
+		const TLatticeNodeId* itr = lattice.ParentsBegin( current );
+		for( ; itr != lattice.ParentsEnd( current ); ++itr ) {
+			if( flags[*itr] ) {
+				continue;
+			}
+			flags[*itr] = true;
+			ancestors.push_back( *itr );
+			stack.push_back( *itr );
+		}
+	}
+	for( DWORD i = 0; i < ancestors.size(); ++i ) {
+		flags[ancestors[i]] = false;
+	}
+}
+
 // Out full lattice in the file.
 void CLatticeWriter::outLattice( const std::string& latticeOutPath )
 {
@@ -226,20 +397,24 @@ void CLatticeWriter::outLattice( const std::string& latticeOutPath )
 	OStreamWrapper os( dst );
 	Writer<OStreamWrapper> writer( os );
 
-	const CLatticeNodes& nodes = lattice.GetNodes();
+	const DWORD nodesCount = lattice.Size();
 
 	Document latParams;
 	MemoryPoolAllocator<>& alloc = latParams.GetAllocator();
 
 	latParams.SetObject()
-		.AddMember( "NodesCount", Value().SetUint( nodes.size() ), alloc )
+		.AddMember( "NodesCount", Value().SetUint( nodesCount ), alloc )
 		.AddMember( "ArcsCount", Value().SetUint( arcsCount ), alloc )
 		.AddMember( "Bottom", Value().SetArray()
 			.PushBack( Value().SetUint( 0 ), alloc ), alloc )
 		.AddMember( "Top", Value().SetArray(), alloc );
+	if( params.IsIceberg ) {
+		// Stability and lift are computed on the pruned lattice
+		latParams.AddMember( "Iceberg", Value().SetBool( true ), alloc );
+	}
 	Value& topJson = latParams["Top"];
-	for( TLatticeNodeId i = 0; i < nodes.size(); ++i ) {
-		if( nodes[i].Parents.empty() ) {
+	for( TLatticeNodeId i = 0; i < nodesCount; ++i ) {
+		if( lattice.ParentsCount( i ) == 0 ) {
 			topJson.PushBack( Value().SetUint( i), alloc );
 		}
 	}
@@ -249,7 +424,7 @@ void CLatticeWriter::outLattice( const std::string& latticeOutPath )
 	dst << ",{ \"Nodes\":[\n";
 
 	TLatticeNodeId nodeId = 0;
-	for( ; nodeId < nodes.size(); ++nodeId ) {
+	for( ; nodeId < nodesCount; ++nodeId ) {
 		Document conceptJson;
 		conceptJson.SetObject();
 		fillConceptJson( nodeId, conceptJson.GetAllocator(), conceptJson );
@@ -257,7 +432,7 @@ void CLatticeWriter::outLattice( const std::string& latticeOutPath )
 		conceptJson.Accept( writer );
 		writer.Reset(os);
 
-		if( nodeId < nodes.size() -1 ) {
+		if( nodeId < nodesCount -1 ) {
 			dst << ",";
 		}
 		dst << "\n";
@@ -269,19 +444,15 @@ void CLatticeWriter::outLattice( const std::string& latticeOutPath )
 		dst << ",{ \"Arcs\":[\n";
 		nodeId = 0;
 		bool isFirst = true;
-		for( ; nodeId < nodes.size(); ++nodeId ) {
-			CStdIterator<std::vector<TLatticeNodeId>::const_iterator> ch( cData[nodeId].Children );
-			for( ; !ch.IsEnd(); ) {
+		for( ; nodeId < nodesCount; ++nodeId ) {
+			const TLatticeNodeId* ch = lattice.ChildrenBegin( nodeId );
+			for( ; ch != lattice.ChildrenEnd( nodeId ); ++ch ) {
 				if( isFirst ) {
 					isFirst = false;
 				} else {
 					dst << ",\n";
 				}
 				dst << "{\"S\":" << nodeId << ",\"D\":" << *ch << "}";
-				++ch;
-				if( ch.IsEnd() ) {
-					break;
-				}
 			}
 		}
 		dst << "]}";
@@ -294,18 +465,18 @@ void CLatticeWriter::outLattice( const std::string& latticeOutPath )
 void CLatticeWriter::fillConceptJson( TLatticeNodeId nodeId, MemoryPoolAllocator<>& alloc, Value& result )
 {
 	CJsonError errorText;
-	const CLatticeNode& node = lattice.GetNode( nodeId );
+	const CLatticeConcept& node = lattice.GetConcept( nodeId );
 	if( params.OutExtent ) {
 		Document extent( &alloc );
-		const bool rslt = ReadJsonString( extStorage->Save( node.Data.Extent ), extent, errorText );
+		const bool rslt = ReadJsonString( extStorage->Save( node.Extent ), extent, errorText );
 		assert( rslt );
 		result.AddMember( "Ext", extent.Move(), alloc );
 	}
 	if( params.OutSupport ) {
-		result.AddMember( "Supp", extStorage->Size( node.Data.Extent ), alloc );
+		result.AddMember( "Supp", extStorage->Size( node.Extent ), alloc );
 	}
 	if( params.OutStabEstimation ) {
-		assert( cData.size() == lattice.GetNodes().size() );
+		assert( cData.size() == lattice.Size() );
 		if( isfinite( cData[nodeId].MinStab ) && cData[nodeId].MaxStab > 0 ) {
 			if( params.IsStabilityInLog ) {
 				result
@@ -319,7 +490,7 @@ void CLatticeWriter::fillConceptJson( TLatticeNodeId nodeId, MemoryPoolAllocator
 		}
 	}
 	if( params.OutStability ) {
-		assert( sData.size() == lattice.GetNodes().size() );
+		assert( sData.size() == lattice.Size() );
 		if( params.IsStabilityInLog ) {
 			const double stab = -log( 1 - sData[nodeId].Stability ) / log( 2 );
 			if( isfinite( stab ) ) {
@@ -333,7 +504,7 @@ void CLatticeWriter::fillConceptJson( TLatticeNodeId nodeId, MemoryPoolAllocator
 	}
 
 	Document intent( &alloc );
-	const bool rslt = ReadJsonString( cmp->SavePattern( node.Data.Intent ), intent, errorText );
+	const bool rslt = ReadJsonString( cmp->SavePattern( node.Intent ), intent, errorText );
 	assert( rslt );
 	result.AddMember( "Int", intent.Move(), alloc );
 }
@@ -355,7 +526,7 @@ bool CLatticeWriter::isNodeInteresting( TLatticeNodeId node )
 	assert( cData.size() > node );
 	assert( !params.OutStability || sData.size() > node );
 
-	if( extStorage->Size( lattice.GetNode( node ).Data.Extent ) < params.MinExtentSize ) {
+	if( extStorage->Size( lattice.GetConcept( node ).Extent ) < params.MinExtentSize ) {
 		return false;
 	}
 	if( cData[node].MaxStab < params.MinLift ) {
@@ -400,6 +571,10 @@ void CLatticeWriter::outInterestingConcepts(
 		.AddMember( "Bottom", Value().SetArray(), alloc )
 		.AddMember( "Top", Value().SetArray(), alloc );
 
+	if( params.IsIceberg ) {
+		// Stability and lift are computed on the pruned lattice
+		latParams.AddMember( "Iceberg", Value().SetBool( true ), alloc );
+	}
 	Value& bottomJson = latParams["Bottom"];
 	CStdIterator<CList<DWORD>::CConstIterator,false> itr( order.GetBottoms() );
 	for( ; !itr.IsEnd(); ++itr ) {
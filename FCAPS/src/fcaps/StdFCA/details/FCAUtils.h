@@ -3,6 +3,9 @@
 // Author: Aleksey Buzmakov
 // Different small FCA utils
 
+#ifndef FCAUTILS_H_
+#define FCAUTILS_H_
+
 #include <common.h>
 #include "Lattice.h"
 
@@ -36,15 +39,24 @@ struct CLatticeFilterParams {
 	// Base number to count percentage for the extent,
 	//  if 0 no percentage counting
 	DWORD PercentageBase;
+	// The number of threads computing stability
+	DWORD ThreadsCount;
+	// The lattice is an iceberg one, so stability and lift are computed only w.r.t. the kept concepts
+	bool IsIceberg;
 
 	CLatticeFilterParams() :
 		MinExtentSize( 0 ), MinLift( 1 ), MinStab( 0.95 ),
 		OutExtent( false ), OutSupport( true ), OutOrder( true ),
 		OutStabEstimation( true ), OutStability( false ), IsStabilityInLog( true ),
-		PercentageBase( 0 ) {}
+		PercentageBase( 0 ), ThreadsCount( 1 ), IsIceberg( false ) {}
 };
 
-class CLattice;
+// Read/write OutputParams of context processors, absent members are not changed.
+void LoadLatticeFilterParams( const rapidjson::Value& json, CLatticeFilterParams& params );
+void SaveLatticeFilterParams( const CLatticeFilterParams& params,
+	rapidjson::Value& json, rapidjson::MemoryPoolAllocator<>& alloc );
+
+class CCompactLattice;
 interface IIntentStorage;
 interface IExtentStorage;
 
@@ -56,7 +68,7 @@ interface IExtentStorage;
 class CLatticeWriter {
 public:
 	CLatticeWriter(
-			const CLattice& _lattice,
+			const CCompactLattice& _lattice,
 			const CSharedPtr<IIntentStorage>& _cmp,
 			const CSharedPtr<IExtentStorage>& _extStorage,
 			const CLatticeFilterParams& _params ) :
@@ -73,7 +85,6 @@ private:
 	struct CConceptData {
 		DWORD MaxStab;
 		double MinStab;
-		std::vector<TLatticeNodeId> Children;
 
 		CConceptData() :
 			MaxStab(-1), MinStab(0) {}
@@ -110,9 +121,11 @@ private:
 		CStabilityContext( const CStabilityData& node, std::vector<bool>& flags ) :
 			Node( node ), Flags( flags ) {}
 	};
+	struct CStabilityCorrections;
+	class CStabilityThread;
 
 private:
-	const CLattice& lattice;
+	const CCompactLattice& lattice;
 	const CSharedPtr<IIntentStorage> cmp;
 	const CSharedPtr<IExtentStorage> extStorage;
 	const CLatticeFilterParams& params;
@@ -122,11 +135,12 @@ private:
 	DWORD arcsCount;
 
 	void computeConceptData();
-	void fillChildren();
 	void fillConceptStabilityLogRange( TLatticeNodeId concept );
 	void computeStabilityData();
 	void unmarkFlags( TLatticeNodeId node, CStabilityContext& context );
 	void correctParents( TLatticeNodeId node, CStabilityContext& context );
+	void computeStabilityInParallel( const std::vector<TLatticeNodeId>& indecis );
+	void findAncestors( TLatticeNodeId node, std::vector<bool>& flags, std::vector<TLatticeNodeId>& ancestors ) const;
 	void outLattice( const std::string& latticeOutPath );
 	void fillConceptJson( TLatticeNodeId node, rapidjson::MemoryPoolAllocator<>& alloc, rapidjson::Value& result );
 
@@ -135,3 +149,5 @@ private:
 	void outInterestingConcepts(
 		const std::vector<TLatticeNodeId>& nodes, const std::string& path );
 };
+
+#endif // FCAUTILS_H_
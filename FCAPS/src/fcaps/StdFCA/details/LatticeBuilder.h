@@ -11,10 +11,18 @@
 ////////////////////////////////////////////////////////////////////////
 
 class CLattice;
-interface IPatternPrunner;
 interface IExtentStorage;
 interface IIntentStorage;
 
+// Decides which concepts are needed in the result.
+interface IPatternPrunner : public virtual IObject {
+	// Notification that the next object is added to the lattice.
+	virtual void OnObjectAdded() = 0;
+	// Returns whether the concept is needed.
+	//  If a concept is not needed then all its descendants are not needed too.
+	virtual bool IsUseful( DWORD extent, DWORD intent ) const = 0;
+};
+
 interface ILatticeBuilder : public virtual IObject {
 	// extentManager - operations with extents;
 	// comparator - operations with patterns.
@@ -0,0 +1,376 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Merging of two lattices built on disjoint sets of objects.
+
+#include "LatticeMerger.h"
+#include "ExtentImpl.h"
+
+#include <fcaps/PatternManager.h>
+#include <fcaps/storages/VectorIntentStorage.h>
+
+#include <Exception.h>
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+class CLatticeMerger::CTaskRunner {
+public:
+	virtual ~CTaskRunner()
+		{}
+	virtual void Run( DWORD task ) = 0;
+};
+
+class CLatticeMerger::CCandidatesTask : public CTaskRunner {
+public:
+	CCandidatesTask( CLatticeMerger& _merger ) :
+		merger( _merger ) {}
+
+	virtual void Run( DWORD task )
+		{ merger.addCandidates( task ); }
+private:
+	CLatticeMerger& merger;
+};
+
+class CLatticeMerger::CParentsTask : public CTaskRunner {
+public:
+	CParentsTask( CLatticeMerger& _merger, CLattice& _result ) :
+		merger( _merger ), result( _result ) {}
+
+	virtual void Run( DWORD task )
+		{ merger.findParents( task, result ); }
+private:
+	CLatticeMerger& merger;
+	CLattice& result;
+};
+
+////////////////////////////////////////////////////////////////////
+
+// Tasks are taken one by one by all threads
+class CLatticeMerger::CTaskQueue {
+public:
+	CTaskQueue( DWORD _count ) :
+		next( 0 ), count( _count ), error( 0 ) {}
+	~CTaskQueue()
+		{ delete error; }
+
+	bool Next( DWORD& task );
+	void SetError( CException* e );
+	// Rethrows the first error of the workers
+	void CheckError();
+
+private:
+	boost::mutex access;
+	DWORD next;
+	const DWORD count;
+	CException* error;
+};
+
+bool CLatticeMerger::CTaskQueue::Next( DWORD& task )
+{
+	boost::lock_guard<boost::mutex> lock( access );
+	if( next >= count ) {
+		return false;
+	}
+	task = next;
+	++next;
+	return true;
+}
+
+void CLatticeMerger::CTaskQueue::SetError( CException* e )
+{
+	boost::lock_guard<boost::mutex> lock( access );
+	// Other workers stop after the current task
+	next = count;
+	if( error == 0 ) {
+		error = e;
+	} else {
+		delete e;
+	}
+}
+
+void CLatticeMerger::CTaskQueue::CheckError()
+{
+	if( error != 0 ) {
+		CException* e = error;
+		error = 0;
+		throw e;
+	}
+}
+
+class CLatticeMerger::CWorker {
+public:
+	CWorker( CTaskRunner& _runner, CTaskQueue& _queue ) :
+		runner( _runner ), queue( _queue ) {}
+
+	void operator()();
+private:
+	CTaskRunner& runner;
+	CTaskQueue& queue;
+};
+
+void CLatticeMerger::CWorker::operator()()
+{
+	try {
+		DWORD task = 0;
+		while( queue.Next( task ) ) {
+			runner.Run( task );
+		}
+	} catch( CException* e ) {
+		queue.SetError( e );
+	} catch( std::exception& e ) {
+		queue.SetError( new CTextException( "CLatticeMerger::CWorker", e.what() ) );
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+CLatticeMerger::CLatticeMerger( const CSharedPtr<IPatternManager>& _cmp, DWORD _threadsCount ) :
+	cmp( _cmp ),
+	threadsCount( max<DWORD>( _threadsCount, 1 ) ),
+	first( 0 ),
+	second( 0 )
+{
+	assert( cmp != 0 );
+}
+
+void CLatticeMerger::Merge( CLatticePart& f, CLatticePart& s, CLatticePart& result )
+{
+	assert( f.Lattice.Size() > 0 && s.Lattice.Size() > 0 );
+	assert( result.Lattice.Size() == 0 );
+	first = &f;
+	second = &s;
+
+	// Canonical pairs are the nodes of the result, the pair of bottoms is the joint bottom
+	pairs.assign( 1, CPair() );
+	pairs[0].First = 0;
+	pairs[0].Second = 0;
+	pairs[0].Intent = similarity( 0, 0 );
+	pairIndex.clear();
+	pairIndex.insert( make_pair( pairKey( 0, 0 ), 0 ) );
+	parentCandidates.assign( 1, vector<DWORD>() );
+	// Every concept is an upper neighbour of another one, so all of them are found going up from the bottom
+	level.assign( 1, 0 );
+	CCandidatesTask candidatesTask( *this );
+	while( !level.empty() ) {
+		levelCandidates.assign( level.size(), vector<CCandidate>() );
+		runInParallel( level.size(), candidatesTask );
+		vector<DWORD> nextLevel;
+		processLevel( nextLevel );
+		level.swap( nextLevel );
+	}
+	levelCandidates.clear();
+	pairIndex.clear();
+
+	for( DWORD i = 0; i < pairs.size(); ++i ) {
+		result.Lattice.AddNewNode();
+	}
+	CParentsTask parentsTask( *this, result.Lattice );
+	runInParallel( pairs.size(), parentsTask );
+
+	joinExtents( f, s, result );
+	moveIntents( f, s, result );
+
+	pairs.clear();
+	parentCandidates.clear();
+	first = 0;
+	second = 0;
+}
+
+// Finds the canonical pairs generated by the parents of the concepts of a pair of the current level
+void CLatticeMerger::addCandidates( DWORD levelPos )
+{
+	const CPair& pair = pairs[level[levelPos]];
+	vector<CCandidate>& candidates = levelCandidates[levelPos];
+	CStdIterator<CEdges::const_iterator> p1( first->Lattice.GetNode( pair.First ).Parents );
+	for( ; !p1.IsEnd(); ++p1 ) {
+		addCandidate( *p1, pair.Second, candidates );
+	}
+	CStdIterator<CEdges::const_iterator> p2( second->Lattice.GetNode( pair.Second ).Parents );
+	for( ; !p2.IsEnd(); ++p2 ) {
+		addCandidate( pair.First, *p2, candidates );
+	}
+}
+
+void CLatticeMerger::addCandidate( TLatticeNodeId n1, TLatticeNodeId n2, vector<CCandidate>& candidates )
+{
+	const IPatternDescriptor* p = similarity( n1, n2 );
+	candidates.push_back( CCandidate() );
+	CCandidate& candidate = candidates.back();
+	candidate.First = climb( *first, n1, p );
+	candidate.Second = climb( *second, n2, p );
+	if( isOwned( n1, n2 ) ) {
+		// The nodes only go up, so the canonical pair has no bottoms as well
+		candidate.Intent = p;
+	} else {
+		// The similarity with a bottom is one of the intents, the canonical pair can have another one
+		candidate.Intent = similarity( candidate.First, candidate.Second );
+	}
+}
+
+// Adds the new pairs found from the current level, they form the next level
+void CLatticeMerger::processLevel( vector<DWORD>& nextLevel )
+{
+	for( DWORD i = 0; i < level.size(); ++i ) {
+		vector<CCandidate>& candidates = levelCandidates[i];
+		for( DWORD j = 0; j < candidates.size(); ++j ) {
+			const CCandidate& candidate = candidates[j];
+			const unsigned long long key = pairKey( candidate.First, candidate.Second );
+			boost::unordered_map<unsigned long long, DWORD>::const_iterator itr = pairIndex.find( key );
+			DWORD node = 0;
+			if( itr != pairIndex.end() ) {
+				node = itr->second;
+				free( candidate.First, candidate.Second, candidate.Intent );
+			} else {
+				node = pairs.size();
+				pairIndex.insert( make_pair( key, node ) );
+				pairs.push_back( CPair() );
+				pairs.back().First = candidate.First;
+				pairs.back().Second = candidate.Second;
+				pairs.back().Intent = candidate.Intent;
+				parentCandidates.push_back( vector<DWORD>() );
+				nextLevel.push_back( node );
+			}
+			parentCandidates[level[i]].push_back( node );
+		}
+		vector<CCandidate>().swap( candidates );
+	}
+}
+
+void CLatticeMerger::findParents( TLatticeNodeId node, CLattice& result )
+{
+	// Upper neighbours are generated by a parent of one of the concepts in the pair
+	vector<DWORD>& candidates = parentCandidates[node];
+	sort( candidates.begin(), candidates.end() );
+	candidates.erase( unique( candidates.begin(), candidates.end() ), candidates.end() );
+
+	// Only the most specific candidates are parents
+	CEdges& parents = result.GetNode( node ).Parents;
+	for( DWORD i = 0; i < candidates.size(); ++i ) {
+		bool isMinimal = true;
+		for( DWORD j = 0; j < candidates.size() && isMinimal; ++j ) {
+			isMinimal = i == j || cmp->CompareZero( pairs[candidates[i]].Intent, pairs[candidates[j]].Intent,
+				CR_MoreGeneral ) != CR_MoreGeneral;
+		}
+		if( isMinimal ) {
+			parents.insert( candidates[i] );
+		}
+	}
+	vector<DWORD>().swap( candidates );
+}
+
+inline bool CLatticeMerger::isOwned( TLatticeNodeId n1, TLatticeNodeId n2 ) const
+{
+	return first->Lattice.GetNode( n1 ).Data.Intent != -1
+		&& second->Lattice.GetNode( n2 ).Data.Intent != -1;
+}
+
+inline const IPatternDescriptor* CLatticeMerger::similarity( TLatticeNodeId n1, TLatticeNodeId n2 )
+{
+	return cmp->CalculateSimilarityZero(
+		first->Intents->GetPattern( first->Lattice.GetNode( n1 ).Data.Intent ),
+		second->Intents->GetPattern( second->Lattice.GetNode( n2 ).Data.Intent ) );
+}
+
+inline void CLatticeMerger::free( TLatticeNodeId n1, TLatticeNodeId n2, const IPatternDescriptor* p )
+{
+	if( isOwned( n1, n2 ) ) {
+		cmp->FreePattern( p );
+	}
+}
+
+// The same as FindMaxConcept of AddIntent: goes up while the intent is more specific than p
+TLatticeNodeId CLatticeMerger::climb( const CLatticePart& part, TLatticeNodeId node, const IPatternDescriptor* p )
+{
+	bool isFound = true;
+	while( isFound ) {
+		isFound = false;
+		CStdIterator<CEdges::const_iterator> parent( part.Lattice.GetNode( node ).Parents );
+		for( ; !parent.IsEnd(); ++parent ) {
+			const IPatternDescriptor* parentIntent = part.Intents->GetPattern( part.Lattice.GetNode( *parent ).Data.Intent );
+			if( cmp->CompareZero( p, parentIntent, CR_MoreOrEqual ) != CR_Incomparable ) {
+				node = *parent;
+				isFound = true;
+				break;
+			}
+		}
+	}
+	return node;
+}
+
+void CLatticeMerger::runInParallel( DWORD tasksCount, CTaskRunner& runner )
+{
+	if( threadsCount == 1 ) {
+		for( DWORD i = 0; i < tasksCount; ++i ) {
+			runner.Run( i );
+		}
+		return;
+	}
+
+	CTaskQueue queue( tasksCount );
+	boost::thread_group threads;
+	for( DWORD i = 0; i < threadsCount; ++i ) {
+		threads.create_thread( CWorker( runner, queue ) );
+	}
+	threads.join_all();
+	queue.CheckError();
+}
+
+void CLatticeMerger::joinExtents( CLatticePart& f, CLatticePart& s, CLatticePart& result )
+{
+	if( result.Extents == 0 ) {
+		result.Extents.reset( new CDequeExtentStorage );
+		result.Extents->SetNames( f.Extents->GetNames() );
+	}
+	for( DWORD i = 0; i < pairs.size(); ++i ) {
+		const TIntentId ext1 = f.Lattice.GetNode( pairs[i].First ).Data.Extent;
+		const TIntentId ext2 = s.Lattice.GetNode( pairs[i].Second ).Data.Extent;
+		TIntentId& ext = result.Lattice.GetNode( i ).Data.Extent;
+		if( ext1 == -1 && ext2 == -1 ) {
+			ext = -1;
+			continue;
+		}
+		ext = result.Extents->Clone( -1 );
+		if( ext1 != -1 ) {
+			CStdIterator<CDequeExtentStorage::CExtent::CConstIterator, false> obj( f.Extents->GetExtent( ext1 ) );
+			for( ; !obj.IsEnd(); ++obj ) {
+				result.Extents->AddObject( *obj, ext );
+			}
+		}
+		if( ext2 != -1 ) {
+			CStdIterator<CDequeExtentStorage::CExtent::CConstIterator, false> obj( s.Extents->GetExtent( ext2 ) );
+			for( ; !obj.IsEnd(); ++obj ) {
+				result.Extents->AddObject( *obj, ext );
+			}
+		}
+	}
+}
+
+void CLatticeMerger::moveIntents( CLatticePart& f, CLatticePart& s, CLatticePart& result )
+{
+	if( result.Intents == 0 ) {
+		result.Intents.reset( new CVectorIntentStorage );
+		result.Intents->Initialize( cmp );
+	}
+	for( DWORD i = 0; i < pairs.size(); ++i ) {
+		const TIntentId int1 = f.Lattice.GetNode( pairs[i].First ).Data.Intent;
+		const TIntentId int2 = s.Lattice.GetNode( pairs[i].Second ).Data.Intent;
+		TIntentId& intent = result.Lattice.GetNode( i ).Data.Intent;
+		if( int1 == -1 && int2 == -1 ) {
+			intent = -1;
+		} else if( int2 == -1 ) {
+			// Similarity with the bottom is the intent itself
+			intent = result.Intents->AddPattern( f.Intents->ReleasePattern( int1 ) );
+		} else if( int1 == -1 ) {
+			intent = result.Intents->AddPattern( s.Intents->ReleasePattern( int2 ) );
+		} else {
+			intent = result.Intents->AddPattern( pairs[i].Intent );
+		}
+	}
+}
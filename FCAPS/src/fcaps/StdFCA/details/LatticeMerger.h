@@ -0,0 +1,104 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Merging of two lattices built on disjoint sets of objects.
+//  An intent of the joint lattice is the similarity of an intent of the first lattice and an intent of the second one.
+//  Every such intent is produced by exactly one canonical pair of concepts, i.e., the pair of the most general concepts
+//  whose intents are still more specific than the similarity. The parents of a joint concept are found among
+//  the concepts generated by the parents of the concepts in its pair, so the joint concepts are enumerated
+//  level by level from the bottom and only the pairs generated this way are ever intersected.
+
+#ifndef LATTICEMERGER_H_
+#define LATTICEMERGER_H_
+
+#include <common.h>
+
+#include "Lattice.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <vector>
+
+interface IPatternManager;
+interface IPatternDescriptor;
+class CVectorIntentStorage;
+class CDequeExtentStorage;
+
+////////////////////////////////////////////////////////////////////
+
+// A lattice with its own storages of intents and extents
+struct CLatticePart {
+	CLattice Lattice;
+	CSharedPtr<CVectorIntentStorage> Intents;
+	CSharedPtr<CDequeExtentStorage> Extents;
+};
+
+////////////////////////////////////////////////////////////////////
+
+// The pattern manager is accessed concurrently if threadsCount > 1,
+//  so its comparison and similarity should not modify any shared state.
+class CLatticeMerger {
+public:
+	// If threadsCount > 1, cmp must be thread-safe: Compare, CalculateSimilarity and FreePattern
+	//  are called from several threads at once without any locking on the merger side.
+	CLatticeMerger( const CSharedPtr<IPatternManager>& cmp, DWORD threadsCount = 1 );
+
+	// Builds the lattice for the union of objects of first and second.
+	//  The intents of first and second are moved to the result, so the parts are not usable afterwards.
+	//  The lattices should be built by AddIntent, i.e., node 0 is the bottom with -1 intent and extent.
+	void Merge( CLatticePart& first, CLatticePart& second, CLatticePart& result );
+
+private:
+	// A node of the joint lattice
+	struct CPair {
+		TLatticeNodeId First;
+		TLatticeNodeId Second;
+		// The similarity of the intents, it is owned only if both intents are not bottoms
+		const IPatternDescriptor* Intent;
+	};
+	// A canonical pair generated by a parent of a concept of a pair
+	struct CCandidate {
+		TLatticeNodeId First;
+		TLatticeNodeId Second;
+		// The similarity of the intents of the canonical pair, owned as in CPair
+		const IPatternDescriptor* Intent;
+	};
+	class CCandidatesTask;
+	class CParentsTask;
+	class CTaskRunner;
+	class CTaskQueue;
+	class CWorker;
+
+private:
+	CSharedPtr<IPatternManager> cmp;
+	const DWORD threadsCount;
+
+	// The currently merged lattices
+	const CLatticePart* first;
+	const CLatticePart* second;
+	// All canonical pairs, the index is the node in the joint lattice
+	std::vector<CPair> pairs;
+	// The index of every canonical pair by the key of its nodes
+	boost::unordered_map<unsigned long long, DWORD> pairIndex;
+	// For every pair the pairs generated by the parents of its concepts, the upper neighbours are among them
+	std::vector< std::vector<DWORD> > parentCandidates;
+	// The pairs of the current level and the candidates found for them
+	std::vector<DWORD> level;
+	std::vector< std::vector<CCandidate> > levelCandidates;
+
+	void addCandidates( DWORD levelPos );
+	void addCandidate( TLatticeNodeId n1, TLatticeNodeId n2, std::vector<CCandidate>& candidates );
+	void processLevel( std::vector<DWORD>& nextLevel );
+	void findParents( TLatticeNodeId node, CLattice& result );
+	bool isOwned( TLatticeNodeId n1, TLatticeNodeId n2 ) const;
+	const IPatternDescriptor* similarity( TLatticeNodeId n1, TLatticeNodeId n2 );
+	void free( TLatticeNodeId n1, TLatticeNodeId n2, const IPatternDescriptor* p );
+	TLatticeNodeId climb( const CLatticePart& part, TLatticeNodeId node, const IPatternDescriptor* p );
+	static unsigned long long pairKey( TLatticeNodeId n1, TLatticeNodeId n2 )
+		{ return ( static_cast<unsigned long long>( n1 ) << 32 ) | n2; }
+	void runInParallel( DWORD tasksCount, CTaskRunner& runner );
+	void moveIntents( CLatticePart& first, CLatticePart& second, CLatticePart& result );
+	void joinExtents( CLatticePart& first, CLatticePart& second, CLatticePart& result );
+};
+
+#endif // LATTICEMERGER_H_
@@ -0,0 +1,460 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Parallel enumeration of concepts of a binary context by FCbO.
+
+#include "ParallelCbO.h"
+
+#include <Exception.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+// A subtree of the search
+struct CParallelCbO::CTask {
+	CBitset Extent;
+	CBitset Intent;
+	// The first attribute to add
+	DWORD Attr;
+	// For every attribute the intent that failed the canonicity test (N^j in FCbO).
+	//  Only the tasks in the pool have it, it is shared by all children of a concept that are put to the pool.
+	CSharedPtr<const std::vector<CBitset> > Failed;
+};
+
+////////////////////////////////////////////////////////////////////
+
+// The tasks waiting for a thread.
+//  A thread shares a subtree only if there are not enough waiting tasks, otherwise it goes deeper itself.
+class CParallelCbO::CTaskPool {
+public:
+	CTaskPool( DWORD _threadsCount ) :
+		threadsCount( _threadsCount ), active( 0 ), error( 0 ) {}
+	~CTaskPool();
+
+	// Returns false if all tasks are done
+	bool Pop( CTask*& task );
+	void Push( CTask* task );
+	// The task taken by Pop is processed
+	void Done();
+	bool IsHungry();
+
+	void SetError( CException* e );
+	// Rethrows the first error of the threads
+	void CheckError();
+
+private:
+	const DWORD threadsCount;
+	boost::mutex access;
+	boost::condition_variable hasTasks;
+	std::deque<CTask*> tasks;
+	// The number of threads processing a task
+	DWORD active;
+	CException* error;
+};
+
+CParallelCbO::CTaskPool::~CTaskPool()
+{
+	for( DWORD i = 0; i < tasks.size(); ++i ) {
+		delete tasks[i];
+	}
+	delete error;
+}
+
+bool CParallelCbO::CTaskPool::Pop( CTask*& task )
+{
+	boost::unique_lock<boost::mutex> lock( access );
+	while( tasks.empty() && active > 0 && error == 0 ) {
+		hasTasks.wait( lock );
+	}
+	if( tasks.empty() || error != 0 ) {
+		return false;
+	}
+	task = tasks.front();
+	tasks.pop_front();
+	++active;
+	return true;
+}
+
+void CParallelCbO::CTaskPool::Push( CTask* task )
+{
+	{
+		boost::lock_guard<boost::mutex> lock( access );
+		tasks.push_back( task );
+	}
+	hasTasks.notify_one();
+}
+
+void CParallelCbO::CTaskPool::Done()
+{
+	bool isFinished = false;
+	{
+		boost::lock_guard<boost::mutex> lock( access );
+		assert( active > 0 );
+		--active;
+		isFinished = active == 0 && tasks.empty();
+	}
+	if( isFinished ) {
+		hasTasks.notify_all();
+	}
+}
+
+bool CParallelCbO::CTaskPool::IsHungry()
+{
+	boost::lock_guard<boost::mutex> lock( access );
+	return threadsCount > 1 && tasks.size() < threadsCount;
+}
+
+void CParallelCbO::CTaskPool::SetError( CException* e )
+{
+	{
+		boost::lock_guard<boost::mutex> lock( access );
+		if( error == 0 ) {
+			error = e;
+		} else {
+			delete e;
+		}
+	}
+	hasTasks.notify_all();
+}
+
+void CParallelCbO::CTaskPool::CheckError()
+{
+	if( error != 0 ) {
+		CException* e = error;
+		error = 0;
+		throw e;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+class CParallelCbO::CSearchThread {
+public:
+	CSearchThread( const CParallelCbO& _cbo, CTaskPool& _pool, vector<CConcept>& _result ) :
+		cbo( _cbo ), pool( _pool ), result( _result ) {}
+
+	void operator()();
+private:
+	const CParallelCbO& cbo;
+	CTaskPool& pool;
+	vector<CConcept>& result;
+	// The failed intents of the current branch of the search
+	vector<CBitset> failed;
+};
+
+void CParallelCbO::CSearchThread::operator()()
+{
+	CTask* task = 0;
+	while( pool.Pop( task ) ) {
+		try {
+			assert( task->Failed != 0 );
+			failed = *task->Failed;
+			task->Failed.reset();
+			cbo.processTask( *task, pool, failed, result );
+		} catch( CException* e ) {
+			pool.SetError( e );
+		} catch( std::exception& e ) {
+			pool.SetError( new CTextException( "CParallelCbO::CSearchThread", e.what() ) );
+		}
+		delete task;
+		pool.Done();
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Search of a concept by its intent
+class CParallelCbO::CIntentIndex {
+public:
+	CIntentIndex( const vector<CConcept>& concepts );
+
+	DWORD Find( const CBitset& intent ) const;
+
+private:
+	struct CHash {
+		size_t operator()( const CBitset& b ) const;
+	};
+	boost::unordered_map<CBitset, DWORD, CHash> index;
+};
+
+size_t CParallelCbO::CIntentIndex::CHash::operator()( const CBitset& b ) const
+{
+	size_t seed = 0;
+	for( CBitset::size_type i = b.find_first(); i != CBitset::npos; i = b.find_next( i ) ) {
+		boost::hash_combine( seed, i );
+	}
+	return seed;
+}
+
+CParallelCbO::CIntentIndex::CIntentIndex( const vector<CConcept>& concepts )
+{
+	for( DWORD i = 0; i < concepts.size(); ++i ) {
+		index.insert( make_pair( concepts[i].Intent, i ) );
+	}
+}
+
+DWORD CParallelCbO::CIntentIndex::Find( const CBitset& intent ) const
+{
+	boost::unordered_map<CBitset, DWORD, CHash>::const_iterator itr = index.find( intent );
+	assert( itr != index.end() );
+	return itr->second;
+}
+
+////////////////////////////////////////////////////////////////////
+
+// Every thread finds parents of every threadsCount-th concept
+class CParallelCbO::COrderThread {
+public:
+	COrderThread( const CParallelCbO& _cbo, const CIntentIndex& _index,
+			DWORD _first, vector< vector<DWORD> >& _parents, CException*& _error ) :
+		cbo( _cbo ), index( _index ), first( _first ), parents( _parents ), error( _error ) {}
+
+	void operator()();
+private:
+	const CParallelCbO& cbo;
+	const CIntentIndex& index;
+	const DWORD first;
+	vector< vector<DWORD> >& parents;
+	CException*& error;
+};
+
+void CParallelCbO::COrderThread::operator()()
+{
+	try {
+		for( DWORD i = first; i < parents.size(); i += cbo.threadsCount ) {
+			cbo.findParents( i, index, parents[i] );
+		}
+	} catch( CException* e ) {
+		error = e;
+	} catch( std::exception& e ) {
+		error = new CTextException( "CParallelCbO::COrderThread", e.what() );
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+class CParallelCbO::CConceptsOrder {
+public:
+	CConceptsOrder( const vector<CConcept>& _concepts, const vector<DWORD>& _sizes ) :
+		concepts( _concepts ), sizes( _sizes ) {}
+
+	bool operator()( DWORD i, DWORD j ) const
+		{ return sizes[i] < sizes[j] || ( sizes[i] == sizes[j] && concepts[i].Intent < concepts[j].Intent ); }
+private:
+	const vector<CConcept>& concepts;
+	const vector<DWORD>& sizes;
+};
+
+////////////////////////////////////////////////////////////////////
+
+CParallelCbO::CParallelCbO( DWORD _threadsCount ) :
+	threadsCount( max<DWORD>( _threadsCount, 1 ) ),
+	objectsCount( 0 ),
+	attrsCount( 0 )
+{
+}
+
+void CParallelCbO::SetContext( const vector< vector<DWORD> >& rows, DWORD _attrsCount )
+{
+	objectsCount = rows.size();
+	attrsCount = _attrsCount;
+	attrExtents.assign( attrsCount, CBitset( objectsCount ) );
+	objIntents.assign( objectsCount, CBitset( attrsCount ) );
+	for( DWORD g = 0; g < rows.size(); ++g ) {
+		for( DWORD i = 0; i < rows[g].size(); ++i ) {
+			const DWORD m = rows[g][i];
+			assert( m < attrsCount );
+			attrExtents[m].set( g );
+			objIntents[g].set( m );
+		}
+	}
+	concepts.clear();
+}
+
+void CParallelCbO::Run()
+{
+	concepts.clear();
+
+	CTask* root = new CTask;
+	root->Extent.resize( objectsCount, true );
+	computeIntent( root->Extent, root->Intent );
+	root->Attr = 0;
+	root->Failed.reset( new vector<CBitset>( attrsCount, CBitset( attrsCount ) ) );
+
+	CTaskPool pool( threadsCount );
+	pool.Push( root );
+	vector< vector<CConcept> > results( threadsCount );
+	if( threadsCount == 1 ) {
+		CSearchThread( *this, pool, results[0] )();
+	} else {
+		boost::thread_group threads;
+		for( DWORD i = 0; i < threadsCount; ++i ) {
+			threads.create_thread( CSearchThread( *this, pool, results[i] ) );
+		}
+		threads.join_all();
+	}
+	pool.CheckError();
+
+	for( DWORD i = 0; i < results.size(); ++i ) {
+		concepts.reserve( concepts.size() + results[i].size() );
+		for( DWORD j = 0; j < results[i].size(); ++j ) {
+			concepts.push_back( CConcept() );
+			concepts.back().Extent.swap( results[i][j].Extent );
+			concepts.back().Intent.swap( results[i][j].Intent );
+		}
+		vector<CConcept>().swap( results[i] );
+	}
+	sortConcepts();
+}
+
+void CParallelCbO::FindOrder( vector< vector<DWORD> >& parents ) const
+{
+	parents.assign( concepts.size(), vector<DWORD>() );
+	const CIntentIndex index( concepts );
+
+	vector<CException*> errors( threadsCount, static_cast<CException*>( 0 ) );
+	if( threadsCount == 1 ) {
+		COrderThread( *this, index, 0, parents, errors[0] )();
+	} else {
+		boost::thread_group threads;
+		for( DWORD i = 0; i < threadsCount; ++i ) {
+			threads.create_thread( COrderThread( *this, index, i, parents, errors[i] ) );
+		}
+		threads.join_all();
+	}
+	for( DWORD i = 0; i < errors.size(); ++i ) {
+		if( errors[i] != 0 ) {
+			for( DWORD j = i + 1; j < errors.size(); ++j ) {
+				delete errors[j];
+			}
+			throw errors[i];
+		}
+	}
+}
+
+// The attributes common for all objects of the extent
+void CParallelCbO::computeIntent( const CBitset& extent, CBitset& intent ) const
+{
+	intent.resize( attrsCount );
+	intent.reset();
+	for( DWORD m = 0; m < attrsCount; ++m ) {
+		if( extent.is_subset_of( attrExtents[m] ) ) {
+			intent.set( m );
+		}
+	}
+}
+
+// The failed intents are changed in place for the children (M^j in FCbO) and are restored for the siblings
+void CParallelCbO::processTask( CTask& task, CTaskPool& pool, vector<CBitset>& failed, vector<CConcept>& result ) const
+{
+	result.push_back( CConcept() );
+	result.back().Extent = task.Extent;
+	result.back().Intent = task.Intent;
+
+	// The failed intents of the parent replaced by this concept
+	vector< pair<DWORD, CBitset> > replaced;
+	deque<CTask> children;
+	CBitset extent( objectsCount );
+	CBitset intent( attrsCount );
+	for( DWORD j = task.Attr; j < attrsCount; ++j ) {
+		if( task.Intent.test( j ) ) {
+			continue;
+		}
+		// If an intent failed for an ancestor, the new intent fails as well
+		if( ( failed[j] - task.Intent ).find_first() < j ) {
+			continue;
+		}
+		extent = task.Extent;
+		extent &= attrExtents[j];
+		computeIntent( extent, intent );
+		if( ( intent - task.Intent ).find_first() < j ) {
+			// Not canonical, the entry is not read anymore by this concept
+			replaced.push_back( pair<DWORD, CBitset>( j, CBitset() ) );
+			replaced.back().second.swap( failed[j] );
+			failed[j].swap( intent );
+			intent.resize( attrsCount );
+			continue;
+		}
+		children.push_back( CTask() );
+		children.back().Extent.swap( extent );
+		children.back().Intent.swap( intent );
+		children.back().Attr = j + 1;
+		extent.resize( objectsCount );
+		intent.resize( attrsCount );
+	}
+
+	// The failed intents are copied only if a child goes to another thread
+	CSharedPtr<const vector<CBitset> > sharedFailed;
+	for( ; !children.empty(); children.pop_front() ) {
+		CTask& child = children.front();
+		if( pool.IsHungry() ) {
+			if( sharedFailed == 0 ) {
+				sharedFailed.reset( new vector<CBitset>( failed ) );
+			}
+			CTask* shared = new CTask;
+			swap( *shared, child );
+			shared->Failed = sharedFailed;
+			pool.Push( shared );
+		} else {
+			processTask( child, pool, failed, result );
+		}
+	}
+
+	for( DWORD i = 0; i < replaced.size(); ++i ) {
+		failed[replaced[i].first].swap( replaced[i].second );
+	}
+}
+
+// Lindig's algorithm: the intent of an upper neighbour is the intersection of the intent with an object
+//  and the number of such objects is the difference between the extents.
+void CParallelCbO::findParents( DWORD concept, const CIntentIndex& index, vector<DWORD>& parents ) const
+{
+	const CConcept& c = concepts[concept];
+	const DWORD extentSize = c.Extent.count();
+	boost::unordered_map<DWORD, DWORD> candidates;
+	CBitset intent( attrsCount );
+	for( DWORD g = 0; g < objectsCount; ++g ) {
+		if( c.Extent.test( g ) ) {
+			continue;
+		}
+		intent = c.Intent;
+		intent &= objIntents[g];
+		++candidates[index.Find( intent )];
+	}
+
+	boost::unordered_map<DWORD, DWORD>::const_iterator itr = candidates.begin();
+	for( ; itr != candidates.end(); ++itr ) {
+		if( itr->second + extentSize == concepts[itr->first].Extent.count() ) {
+			parents.push_back( itr->first );
+		}
+	}
+	sort( parents.begin(), parents.end() );
+}
+
+// Concepts are sorted by the extent size and by the intent
+void CParallelCbO::sortConcepts()
+{
+	vector<DWORD> sizes( concepts.size() );
+	vector<DWORD> order( concepts.size() );
+	for( DWORD i = 0; i < concepts.size(); ++i ) {
+		sizes[i] = concepts[i].Extent.count();
+		order[i] = i;
+	}
+	sort( order.begin(), order.end(), CConceptsOrder( concepts, sizes ) );
+
+	vector<CConcept> sorted( concepts.size() );
+	for( DWORD i = 0; i < order.size(); ++i ) {
+		sorted[i].Extent.swap( concepts[order[i]].Extent );
+		sorted[i].Intent.swap( concepts[order[i]].Intent );
+	}
+	concepts.swap( sorted );
+}
@@ -0,0 +1,71 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Parallel enumeration of concepts of a binary context by FCbO.
+//  The context is stored by attributes (columns) as bitsets of objects, so closures and canonicity tests
+//  are word-parallel subset checks. Subtrees of the search are distributed over threads.
+
+// Outrata J., Vychodil V.
+// Fast algorithm for computing fixpoints of Galois connections induced by object-attribute relational data
+// // Information Sciences. 2012. Vol. 185, № 1. P. 114–127.
+
+#ifndef PARALLELCBO_H_
+#define PARALLELCBO_H_
+
+#include <common.h>
+
+#include <boost/dynamic_bitset.hpp>
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+
+class CParallelCbO {
+public:
+	typedef boost::dynamic_bitset<unsigned long long> CBitset;
+	struct CConcept {
+		// Bitset of object indices
+		CBitset Extent;
+		// Bitset of attributes
+		CBitset Intent;
+	};
+
+public:
+	CParallelCbO( DWORD threadsCount = 1 );
+
+	// Sets the context, rows[g] is the list of attributes of object g, every attribute is less than attrsCount.
+	void SetContext( const std::vector< std::vector<DWORD> >& rows, DWORD attrsCount );
+	// Enumerates all concepts. They are sorted by the extent size, so the bottom is the first and the top is the last.
+	void Run();
+
+	const std::vector<CConcept>& GetConcepts() const
+		{ return concepts; }
+	// Finds the upper neighbours of all concepts, i.e. the diagram of the lattice
+	void FindOrder( std::vector< std::vector<DWORD> >& parents ) const;
+
+private:
+	struct CTask;
+	class CTaskPool;
+	class CSearchThread;
+	class COrderThread;
+	class CIntentIndex;
+	class CConceptsOrder;
+
+private:
+	const DWORD threadsCount;
+	DWORD objectsCount;
+	DWORD attrsCount;
+	// Columns of the context
+	std::vector<CBitset> attrExtents;
+	// Rows of the context
+	std::vector<CBitset> objIntents;
+
+	std::vector<CConcept> concepts;
+
+	void computeIntent( const CBitset& extent, CBitset& intent ) const;
+	void processTask( CTask& task, CTaskPool& pool, std::vector<CBitset>& failed, std::vector<CConcept>& result ) const;
+	void findParents( DWORD concept, const CIntentIndex& index, std::vector<DWORD>& parents ) const;
+	void sortConcepts();
+};
+
+#endif // PARALLELCBO_H_
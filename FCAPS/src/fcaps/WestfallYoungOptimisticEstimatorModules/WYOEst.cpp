@@ -11,6 +11,8 @@
 #include <rapidjson/document.h>
 
 #include <boost/math/distributions/chi_squared.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
 #include <sstream>
 
 using namespace std;
@@ -36,6 +38,11 @@ STR(
 					"description": "A number of permutations to be computed.",
 					"type": "integer",
 					"minimum": 0
+				},
+				"Seed": {
+					"description": "The seed of the random generator of permutations. The optimistic estimator should be a binary classification one.",
+					"type": "integer",
+					"minimum": 0
 				}
 			}
 		}
@@ -51,15 +58,40 @@ const char* const CWYOEst::Desc()
 }
 
 CWYOEst::CWYOEst() :
-	permutationCount(0)
+	binOest(0),
+	permutationCount(0),
+	seed(1234),
+	objectsCount(0)
 {
 }
 
 void CWYOEst::GetValue(const IExtent* ext, CWYOEstValue& val ) const
 {
-	// TODO
-	//   Normally just iterate over all permutations and compute the quality
-	//   Permutations should be computed just once at initialization then they should be reused
+	assert(ext != 0 && oest != 0);
+	oest->GetValue(ext, val.Value);
+	if( val.PermutationCount == 0 ) {
+		return;
+	}
+	assert(val.PermutationCount == permutationCount && val.PermuttedValues != 0);
+	assert(classMasks.IsBuilt());
+
+	// The extent is taken once as a bitset and is intersected with the rows of all used permutations
+	const uintptr_t* blocks = 0;
+	DWORD blocksCount = 0;
+	vector<uintptr_t> buffer;
+	getBitset(*ext, blocks, blocksCount, buffer);
+	// The weights are not permuted
+	double wPlus = 0;
+	double wAll = 0;
+	classMasks.GetWeights(blocks, blocksCount, wPlus, wAll);
+	const DWORD rowSize = classMasks.PositiveMasksSize();
+	for( int i = 0; i < val.PermutationCount; ++i ) {
+		if( !val.IsPermutationUsed(i) ) {
+			continue;
+		}
+		wPlus = classMasks.GetPositiveWeight(blocks, blocksCount, &permutations[i * rowSize]);
+		binOest->GetValueByWeights(wPlus, wAll, val.PermuttedValues[i]);
+	}
 }
 
 void CWYOEst::LoadParams( const JSON& json )
@@ -100,7 +132,15 @@ void CWYOEst::LoadParams( const JSON& json )
 		throw new CJsonException( "CSofiaContextProcessor::LoadParams", CJsonError( json, errorText ) );
 	}
 
-	// TODO: normally here initialization should be done
+	binOest = dynamic_cast<const IBinaryClassificationOptimisticEstimator*>(oest.get());
+	if( binOest == 0 ) {
+		throw new CTextException("CWYOEst::LoadParams", "Params.OptimisticEstimator should be a binary classification estimator to permute the classes");
+	}
+	if(p.HasMember("Seed") && p["Seed"].IsUint()) {
+		seed = p["Seed"].GetUint();
+	}
+
+	initPermutations();
 }
 
 JSON CWYOEst::SaveParams() const
@@ -112,6 +152,7 @@ JSON CWYOEst::SaveParams() const
 		.AddMember( "Name", WYOptimisticEstimator, alloc )
 		.AddMember( "Params", rapidjson::Value().SetObject()
 		            .AddMember("PermutationCount",rapidjson::Value().SetUint(permutationCount),alloc)
+		            .AddMember("Seed",rapidjson::Value().SetUint(seed),alloc)
 		            , alloc );
 
 	IModule* m = dynamic_cast<IModule*>(oest.get());
@@ -131,3 +172,63 @@ JSON CWYOEst::SaveParams() const
 	CreateStringFromJSON( params, result );
 	return result;
 }
+
+// Generates the permutations of classes of objects and builds their masks
+void CWYOEst::initPermutations()
+{
+	assert(binOest != 0);
+	const vector<bool>& classes = binOest->GetClasses();
+	const vector<double>& weights = binOest->GetWeights();
+	assert(classes.size() == weights.size());
+	objectsCount = classes.size();
+	permutations.clear();
+	if( objectsCount == 0 ) {
+		classMasks = CClassMasks();
+		return;
+	}
+	if( !classMasks.Build(classes, weights) ) {
+		throw new CTextException("CWYOEst::initPermutations", "The weights of objects take more than "
+			+ StdExt::to_string(CClassMasks::MaxLevelsCount) + " values, the permutations cannot be built");
+	}
+
+	boost::random::mt19937 rnd(seed);
+	vector<DWORD> order(objectsCount);
+	for( DWORD i = 0; i < objectsCount; ++i ) {
+		order[i] = i;
+	}
+	vector<bool> permutedClasses(objectsCount);
+	const DWORD rowSize = classMasks.PositiveMasksSize();
+	permutations.resize(permutationCount * rowSize);
+	for( DWORD p = 0; p < permutationCount; ++p ) {
+		for( DWORD i = objectsCount; i > 1; --i ) {
+			boost::random::uniform_int_distribution<DWORD> position(0, i - 1);
+			swap(order[i - 1], order[position(rnd)]);
+		}
+		for( DWORD i = 0; i < objectsCount; ++i ) {
+			permutedClasses[i] = classes[order[i]];
+		}
+		classMasks.BuildPositiveMasks(permutedClasses, &permutations[p * rowSize]);
+	}
+}
+
+// Returns the extent as a bitset, the buffer is used if the extent is not a bitset itself
+void CWYOEst::getBitset( const IExtent& ext, const uintptr_t*& blocks, DWORD& blocksCount, vector<uintptr_t>& buffer ) const
+{
+	const IBitsetExtent* bitset = dynamic_cast<const IBitsetExtent*>(&ext);
+	if( bitset != 0 ) {
+		bitset->GetBitset(blocks, blocksCount);
+		return;
+	}
+
+	static const DWORD blockBits = sizeof(uintptr_t) * 8;
+	buffer.assign((objectsCount + blockBits - 1) / blockBits, 0);
+	CPatternImage img;
+	CPatternImageHolder holder(&ext, img);
+	for( int i = 0; i < img.ImageSize; ++i ) {
+		const DWORD obj = img.Objects[i];
+		assert(obj < objectsCount);
+		buffer[obj / blockBits] |= static_cast<uintptr_t>(1) << (obj % blockBits);
+	}
+	blocks = buffer.empty() ? 0 : &buffer[0];
+	blocksCount = buffer.size();
+}
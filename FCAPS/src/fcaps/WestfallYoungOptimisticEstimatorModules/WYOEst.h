@@ -8,8 +8,10 @@
 #include <fcaps/WestfallYoungOptimisticEstimator.h>
 #include <fcaps/Module.h>
 #include <ModuleTools.h>
+#include <fcaps/SharedModulesLib/ClassMasks.h>
 
 #include <unordered_set>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////
 
@@ -17,6 +19,9 @@ const char WYOptimisticEstimator[] = "WYOptimisticEstimatorModule";
 
 ////////////////////////////////////////////////////////////////////
 
+// The class labels of objects are permuted PermutationCount times at initialization, the weights stay with the objects.
+//  So the weight of an extent is the same for all permutations and is computed once, and every permutation is kept
+//  as the bitsets of positive objects by levels of weights, the positive weight is popcounts of the extent and the row.
 class CWYOEst : public IWestfallYoungOptimisticEstimator, public IModule {
 public:
 	CWYOEst();
@@ -50,8 +55,20 @@ private:
 	static const CModuleRegistrar<CWYOEst> registrar;
 	// This this the external object that evaluates Q and OEst of Q on original and permutated objects
 	CSharedPtr<IOptimisticEstimator> oest;
+	// The same estimator, it evaluates the permuted classes
+	const IBinaryClassificationOptimisticEstimator* binOest;
 	// Number of permutations that need to be computed
 	DWORD permutationCount;
+	// The seed of the random permutations
+	DWORD seed;
+	// The masks of the original classes and weights
+	CClassMasks classMasks;
+	// The positive masks of every permutation, classMasks.PositiveMasksSize() blocks each
+	std::vector<uintptr_t> permutations;
+	DWORD objectsCount;
+
+	void initPermutations();
+	void getBitset( const IExtent& ext, const uintptr_t*& blocks, DWORD& blocksCount, std::vector<uintptr_t>& buffer ) const;
 };
 
 #endif // WESTFALLYOUNGOPTIMISTICESTIMATOR_H
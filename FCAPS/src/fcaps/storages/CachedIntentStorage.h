@@ -4,7 +4,7 @@
 #define CACHEDINTENTSTORAGE_H
 
 #include <fcaps/storages/IntentStorage.h>
-#include <fcaps/storages/CachedPatternStorage.h>
+#include <fcaps/storages/ConcurrentPatternStorage.h>
 
 class CCachedIntentStorage : public IIntentStorage {
 public:
@@ -30,7 +30,7 @@ public:
 private:
 	CSharedPtr<IPatternManager> cmp;
 	CPatternComparatorHasher hasher;
-	CCachedPatternStorage<CPatternComparatorHasher> storage;
+	CConcurrentPatternStorage<CPatternComparatorHasher> storage;
 
 	const IPatternDescriptor* getPattern( TIntentId id ) const;
 	TIntentId addPattern(const IPatternDescriptor*);
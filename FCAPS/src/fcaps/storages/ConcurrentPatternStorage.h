@@ -0,0 +1,124 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: A set of patterns without duplicates that can be used from several threads.
+//  Patterns are distributed over segments by their hash, every segment is an open-addressing table
+//  with linear probing under its own lock. Full hashes are kept near the patterns,
+//  so the equality of patterns is checked only if the hashes are the same.
+
+#ifndef CCONCURRENTPATTERNSTORAGE_H
+#define CCONCURRENTPATTERNSTORAGE_H
+
+#include <common.h>
+
+#include <fcaps/PatternManager.h>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <utility>
+#include <vector>
+
+template<typename THasher>
+class CConcurrentPatternStorage {
+public:
+	typedef std::vector<const IPatternDescriptor*> CPatternsVector;
+
+public:
+	CConcurrentPatternStorage();
+	~CConcurrentPatternStorage()
+		{Clear();}
+
+	void Initialize( const THasher& h );
+
+	void Reserve( size_t size );
+
+	// Add pattern to the storage.
+	//  Returns the pattern from the storage, if it is not p then p is freed as a duplicate.
+	const IPatternDescriptor* AddPattern( const IPatternDescriptor* p );
+	// Add several patterns, result[i] is the pattern from the storage equal to patterns[i]
+	void AddPatterns( const CPatternsVector& patterns, CPatternsVector& result );
+	// Check if pattern is in the storage
+	bool HasPattern( const IPatternDescriptor* p ) const;
+	// Removes pattern from the storage, p should be the pattern returned by AddPattern
+	void RemovePattern(const IPatternDescriptor* p);
+	void RemovePatterns( const CPatternsVector& patterns );
+
+	// Number of patterns in the set
+	DWORD Size() const;
+
+	// Clear the storage
+	void Clear();
+
+private:
+	static const DWORD SegmentsCountLog = 6;
+	static const DWORD MinSegmentSize = 64;
+	struct CSlot {
+		size_t Hash;
+		// Zero for an empty slot
+		const IPatternDescriptor* Pattern;
+
+		CSlot() : Hash( 0 ), Pattern( 0 ) {}
+	};
+	struct CSegment {
+		mutable boost::mutex Mutex;
+		// The size is a power of two
+		std::vector<CSlot> Slots;
+		size_t Count;
+
+		CSegment() : Count( 0 ) {}
+	};
+	// Order of hashes by their segments
+	class CSegmentOrder {
+	public:
+		CSegmentOrder( size_t _mask ) : mask( _mask ) {}
+		bool operator()( const std::pair<size_t, DWORD>& a, const std::pair<size_t, DWORD>& b ) const
+			{ return ( a.first & mask ) < ( b.first & mask ); }
+	private:
+		size_t mask;
+	};
+
+private:
+	THasher hasher;
+
+	boost::ptr_vector<CSegment> segments;
+
+	size_t getHash( const IPatternDescriptor* p ) const;
+	CSegment& getSegment( size_t hash )
+		{ return segments[hash & ( segments.size() - 1 )]; }
+	const CSegment& getSegment( size_t hash ) const
+		{ return segments[hash & ( segments.size() - 1 )]; }
+	static size_t getSlot( const CSegment& segment, size_t hash )
+		{ return ( hash >> SegmentsCountLog ) & ( segment.Slots.size() - 1 ); }
+
+	const IPatternDescriptor* insert( CSegment& segment, size_t hash, const IPatternDescriptor* p );
+	bool remove( CSegment& segment, size_t hash, const IPatternDescriptor* p );
+	void resize( CSegment& segment, size_t slotsCount );
+};
+
+////////////////////////////////////////////////////////////////////
+
+class CPatternComparatorHasher {
+public:
+	CPatternComparatorHasher()
+		{}
+	CPatternComparatorHasher( const CSharedPtr<IPatternManager>& _cmp ) :
+		cmp(_cmp) {}
+	void Init( const CSharedPtr<IPatternManager>& _cmp )
+		{ cmp = _cmp; }
+
+	// boost Hasher
+	bool operator()(
+		const IPatternDescriptor* x, const IPatternDescriptor* y) const;
+	size_t operator()( const IPatternDescriptor* x) const;
+	// Removing of a pattern
+	void Free( const IPatternDescriptor* x);
+
+
+private:
+	CSharedPtr<IPatternManager> cmp;
+};
+
+#include "ConcurrentPatternStorage.inl"
+
+#endif // CCONCURRENTPATTERNSTORAGE_H
@@ -0,0 +1,264 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////
+
+template<typename THasher>
+CConcurrentPatternStorage<THasher>::CConcurrentPatternStorage()
+{
+	//ctor
+}
+
+template<typename THasher>
+void CConcurrentPatternStorage<THasher>::Initialize( const THasher& h )
+{
+	Clear();
+	hasher = h;
+	segments.clear();
+	for( DWORD i = 0; i < ( 1 << SegmentsCountLog ); ++i ) {
+		CSegment* segment = new CSegment;
+		segments.push_back( segment );
+		segment->Slots.resize( MinSegmentSize );
+	}
+}
+
+template<typename THasher>
+void CConcurrentPatternStorage<THasher>::Reserve( size_t size )
+{
+	if( segments.empty() ) {
+		// Nothing to reserve before Initialize
+		return;
+	}
+	// The load factor of a segment is kept below 3/4
+	const size_t segmentSize = size / segments.size() * 4 / 3 + 1;
+	for( DWORD i = 0; i < segments.size(); ++i ) {
+		CSegment& segment = segments[i];
+		boost::mutex::scoped_lock lock( segment.Mutex );
+		size_t slotsCount = segment.Slots.size();
+		while( slotsCount < segmentSize ) {
+			slotsCount *= 2;
+		}
+		if( slotsCount > segment.Slots.size() ) {
+			resize( segment, slotsCount );
+		}
+	}
+}
+
+template<typename THasher>
+const IPatternDescriptor* CConcurrentPatternStorage<THasher>::AddPattern( const IPatternDescriptor* p )
+{
+	assert( !segments.empty() );
+	assert( p != 0 );
+	const size_t hash = getHash( p );
+	CSegment& segment = getSegment( hash );
+	const IPatternDescriptor* result = 0;
+	{
+		boost::mutex::scoped_lock lock( segment.Mutex );
+		result = insert( segment, hash, p );
+	}
+	if( result != p ) {
+		hasher.Free( p );
+	}
+	return result;
+}
+
+template<typename THasher>
+void CConcurrentPatternStorage<THasher>::AddPatterns( const CPatternsVector& patterns, CPatternsVector& result )
+{
+	assert( !segments.empty() );
+	result.resize( patterns.size() );
+	if( patterns.empty() ) {
+		return;
+	}
+	// Patterns are grouped by segments, so every segment is locked once
+	std::vector< std::pair<size_t, DWORD> > hashes( patterns.size() );
+	for( DWORD i = 0; i < patterns.size(); ++i ) {
+		assert( patterns[i] != 0 );
+		hashes[i].first = getHash( patterns[i] );
+		hashes[i].second = i;
+	}
+	const size_t segmentMask = segments.size() - 1;
+	std::sort( hashes.begin(), hashes.end(), CSegmentOrder( segmentMask ) );
+
+	for( DWORD i = 0; i < hashes.size(); ) {
+		CSegment& segment = getSegment( hashes[i].first );
+		boost::mutex::scoped_lock lock( segment.Mutex );
+		const size_t segmentNum = hashes[i].first & segmentMask;
+		for( ; i < hashes.size() && ( hashes[i].first & segmentMask ) == segmentNum; ++i ) {
+			const DWORD num = hashes[i].second;
+			result[num] = insert( segment, hashes[i].first, patterns[num] );
+		}
+	}
+
+	for( DWORD i = 0; i < patterns.size(); ++i ) {
+		if( result[i] != patterns[i] ) {
+			hasher.Free( patterns[i] );
+		}
+	}
+}
+
+template<typename THasher>
+bool CConcurrentPatternStorage<THasher>::HasPattern( const IPatternDescriptor* p ) const
+{
+	assert( !segments.empty() );
+	assert( p != 0 );
+	const size_t hash = getHash( p );
+	const CSegment& segment = getSegment( hash );
+	boost::mutex::scoped_lock lock( segment.Mutex );
+	const size_t mask = segment.Slots.size() - 1;
+	for( size_t i = getSlot( segment, hash ); segment.Slots[i].Pattern != 0; i = ( i + 1 ) & mask ) {
+		const CSlot& slot = segment.Slots[i];
+		if( slot.Hash == hash && ( slot.Pattern == p || hasher( slot.Pattern, p ) ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template<typename THasher>
+void CConcurrentPatternStorage<THasher>::RemovePattern(const IPatternDescriptor* p)
+{
+	assert( !segments.empty() );
+	assert( p != 0 );
+	const size_t hash = getHash( p );
+	CSegment& segment = getSegment( hash );
+	{
+		boost::mutex::scoped_lock lock( segment.Mutex );
+		const bool isRemoved = remove( segment, hash, p );
+		assert( isRemoved );
+	}
+	hasher.Free(p);
+}
+
+template<typename THasher>
+void CConcurrentPatternStorage<THasher>::RemovePatterns( const CPatternsVector& patterns )
+{
+	for( DWORD i = 0; i < patterns.size(); ++i ) {
+		RemovePattern( patterns[i] );
+	}
+}
+
+template<typename THasher>
+DWORD CConcurrentPatternStorage<THasher>::Size() const
+{
+	size_t result = 0;
+	for( DWORD i = 0; i < segments.size(); ++i ) {
+		boost::mutex::scoped_lock lock( segments[i].Mutex );
+		result += segments[i].Count;
+	}
+	return result;
+}
+
+template<typename THasher>
+void CConcurrentPatternStorage<THasher>::Clear()
+{
+	for( DWORD i = 0; i < segments.size(); ++i ) {
+		CSegment& segment = segments[i];
+		boost::mutex::scoped_lock lock( segment.Mutex );
+		for( size_t j = 0; j < segment.Slots.size(); ++j ) {
+			if( segment.Slots[j].Pattern != 0 ) {
+				hasher.Free( segment.Slots[j].Pattern );
+			}
+		}
+		std::vector<CSlot>( MinSegmentSize ).swap( segment.Slots );
+		segment.Count = 0;
+	}
+}
+
+// The hash of a pattern is mixed, since the segment and the slot are taken from its different bits
+template<typename THasher>
+size_t CConcurrentPatternStorage<THasher>::getHash( const IPatternDescriptor* p ) const
+{
+	unsigned long long h = hasher( p );
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return static_cast<size_t>( h );
+}
+
+// Returns the pattern equal to p from the segment, p is added if there is no such pattern
+template<typename THasher>
+const IPatternDescriptor* CConcurrentPatternStorage<THasher>::insert( CSegment& segment, size_t hash, const IPatternDescriptor* p )
+{
+	const size_t mask = segment.Slots.size() - 1;
+	size_t i = getSlot( segment, hash );
+	for( ; segment.Slots[i].Pattern != 0; i = ( i + 1 ) & mask ) {
+		const CSlot& slot = segment.Slots[i];
+		if( slot.Hash == hash && ( slot.Pattern == p || hasher( slot.Pattern, p ) ) ) {
+			return slot.Pattern;
+		}
+	}
+	segment.Slots[i].Hash = hash;
+	segment.Slots[i].Pattern = p;
+	++segment.Count;
+	if( segment.Count * 4 > segment.Slots.size() * 3 ) {
+		resize( segment, segment.Slots.size() * 2 );
+	}
+	return p;
+}
+
+// Removes the pattern without tombstones, the following patterns of the cluster are shifted back
+template<typename THasher>
+bool CConcurrentPatternStorage<THasher>::remove( CSegment& segment, size_t hash, const IPatternDescriptor* p )
+{
+	const size_t mask = segment.Slots.size() - 1;
+	size_t i = getSlot( segment, hash );
+	for( ; segment.Slots[i].Pattern != p; i = ( i + 1 ) & mask ) {
+		if( segment.Slots[i].Pattern == 0 ) {
+			return false;
+		}
+	}
+	for( size_t j = ( i + 1 ) & mask; segment.Slots[j].Pattern != 0; j = ( j + 1 ) & mask ) {
+		// The slot j can be moved to i if its home slot is not in (i, j]
+		const size_t home = getSlot( segment, segment.Slots[j].Hash );
+		if( ( ( j - home ) & mask ) >= ( ( j - i ) & mask ) ) {
+			segment.Slots[i] = segment.Slots[j];
+			i = j;
+		}
+	}
+	segment.Slots[i] = CSlot();
+	--segment.Count;
+	return true;
+}
+
+template<typename THasher>
+void CConcurrentPatternStorage<THasher>::resize( CSegment& segment, size_t slotsCount )
+{
+	std::vector<CSlot> oldSlots( slotsCount );
+	oldSlots.swap( segment.Slots );
+	const size_t mask = slotsCount - 1;
+	for( size_t i = 0; i < oldSlots.size(); ++i ) {
+		if( oldSlots[i].Pattern == 0 ) {
+			continue;
+		}
+		size_t j = getSlot( segment, oldSlots[i].Hash );
+		while( segment.Slots[j].Pattern != 0 ) {
+			j = ( j + 1 ) & mask;
+		}
+		segment.Slots[j] = oldSlots[i];
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+inline bool CPatternComparatorHasher::operator()(
+	const IPatternDescriptor* x, const IPatternDescriptor* y) const
+{
+	assert( x != 0 && y != 0 );
+	return cmp->Compare( x, y, CR_Equal ) == CR_Equal;
+}
+
+inline size_t CPatternComparatorHasher::operator()( const IPatternDescriptor* x) const
+{
+	assert( x != 0 );
+	return x->Hash();
+}
+inline void CPatternComparatorHasher::Free( const IPatternDescriptor* x)
+{
+	cmp->FreePattern(x);
+}
+
+////////////////////////////////////////////////////////////////////
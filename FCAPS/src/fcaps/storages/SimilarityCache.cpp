@@ -0,0 +1,166 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+#include <fcaps/storages/SimilarityCache.h>
+
+#include <algorithm>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+CSimilarityCache::CSimilarityCache( size_t capacity, DWORD _shardsCount ) :
+	shardsCount( max<DWORD>( _shardsCount, 1 ) ),
+	setsCount( 0 )
+{
+	for( DWORD i = 0; i < GenerationsCount; ++i ) {
+		generations[i].store( 0, memory_order_relaxed );
+	}
+	SetCapacity( capacity );
+}
+
+void CSimilarityCache::SetCapacity( size_t capacity )
+{
+	shards.clear();
+	setsCount = 0;
+	if( capacity == 0 ) {
+		return;
+	}
+	// Small caches are not split into many shards
+	const DWORD count = min<size_t>( shardsCount, max<size_t>( capacity / ( Ways * 64 ), 1 ) );
+	setsCount = max<size_t>( capacity / ( count * Ways ), 1 );
+	for( DWORD i = 0; i < count; ++i ) {
+		CShard* shard = new CShard;
+		shards.push_back( shard );
+		shard->Entries.resize( setsCount * Ways );
+		shard->Hands.resize( setsCount, 0 );
+	}
+}
+
+bool CSimilarityCache::Find( TIntentId first, TIntentId second, TIntentId& result )
+{
+	if( shards.empty() || first == -1 || second == -1 ) {
+		return false;
+	}
+	if( second < first ) {
+		swap( first, second );
+	}
+	const size_t hash = hashKey( first, second );
+	CShard& shard = getShard( hash );
+	CEntry* const set = &shard.Entries[getSet( hash ) * Ways];
+
+	boost::mutex::scoped_lock lock( shard.Mutex );
+	for( DWORD i = 0; i < Ways; ++i ) {
+		CEntry& entry = set[i];
+		if( entry.First == first && entry.Second == second ) {
+			if( !isActual( entry ) ) {
+				// One of the intents was deleted, the id may be reused
+				entry = CEntry();
+				break;
+			}
+			entry.IsReferenced = true;
+			result = entry.Result;
+			++shard.Hits;
+			return true;
+		}
+	}
+	++shard.Misses;
+	return false;
+}
+
+void CSimilarityCache::Add( TIntentId first, TIntentId second, TIntentId result )
+{
+	if( shards.empty() || first == -1 || second == -1 ) {
+		return;
+	}
+	if( second < first ) {
+		swap( first, second );
+	}
+	const size_t hash = hashKey( first, second );
+	CShard& shard = getShard( hash );
+	const size_t setNum = getSet( hash );
+	CEntry* const set = &shard.Entries[setNum * Ways];
+
+	boost::mutex::scoped_lock lock( shard.Mutex );
+	CEntry* target = 0;
+	for( DWORD i = 0; i < Ways && target == 0; ++i ) {
+		if( set[i].First == -1 || ( set[i].First == first && set[i].Second == second ) ) {
+			target = &set[i];
+		}
+	}
+	// The clock hand skips recently used entries once
+	unsigned char& hand = shard.Hands[setNum];
+	while( target == 0 ) {
+		CEntry& entry = set[hand];
+		hand = ( hand + 1 ) % Ways;
+		if( entry.IsReferenced ) {
+			entry.IsReferenced = false;
+		} else {
+			target = &entry;
+		}
+	}
+	target->First = first;
+	target->Second = second;
+	target->Result = result;
+	target->FirstGeneration = getGeneration( first );
+	target->SecondGeneration = getGeneration( second );
+	target->ResultGeneration = getGeneration( result );
+	target->IsReferenced = false;
+}
+
+void CSimilarityCache::Invalidate( TIntentId id )
+{
+	if( shards.empty() ) {
+		return;
+	}
+	generations[hashKey( id, 0 ) % GenerationsCount].fetch_add( 1, memory_order_acq_rel );
+}
+
+void CSimilarityCache::Clear()
+{
+	for( DWORD i = 0; i < shards.size(); ++i ) {
+		CShard& shard = shards[i];
+		boost::mutex::scoped_lock lock( shard.Mutex );
+		fill( shard.Entries.begin(), shard.Entries.end(), CEntry() );
+		fill( shard.Hands.begin(), shard.Hands.end(), 0 );
+	}
+}
+
+bool CSimilarityCache::isActual( const CEntry& entry ) const
+{
+	return entry.FirstGeneration == getGeneration( entry.First )
+		&& entry.SecondGeneration == getGeneration( entry.Second )
+		&& entry.ResultGeneration == getGeneration( entry.Result );
+}
+
+unsigned long long CSimilarityCache::Hits() const
+{
+	unsigned long long result = 0;
+	for( DWORD i = 0; i < shards.size(); ++i ) {
+		boost::mutex::scoped_lock lock( shards[i].Mutex );
+		result += shards[i].Hits;
+	}
+	return result;
+}
+
+unsigned long long CSimilarityCache::Misses() const
+{
+	unsigned long long result = 0;
+	for( DWORD i = 0; i < shards.size(); ++i ) {
+		boost::mutex::scoped_lock lock( shards[i].Mutex );
+		result += shards[i].Misses;
+	}
+	return result;
+}
+
+// Intent ids are often pointers or consecutive numbers, so the bits are mixed (splitmix64 finalizer)
+size_t CSimilarityCache::hashKey( TIntentId first, TIntentId second )
+{
+	unsigned long long h = static_cast<unsigned long long>( first ) * 0x9E3779B97F4A7C15ULL
+		^ static_cast<unsigned long long>( second );
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return static_cast<size_t>( h );
+}
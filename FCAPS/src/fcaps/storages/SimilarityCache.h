@@ -0,0 +1,103 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Bounded memo table of pattern similarities keyed by the pair of intent ids.
+//  The table is split into shards with their own locks. Every shard is set-associative,
+//  a full set evicts an entry by the second chance (clock) policy.
+//  Invalidation of an intent bumps the generation of the intent and entries with outdated generations are never found.
+
+#ifndef SIMILARITYCACHE_H
+#define SIMILARITYCACHE_H
+
+#include <common.h>
+
+#include <fcaps/storages/IntentStorage.h>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+
+class CSimilarityCache {
+public:
+	static const size_t DefaultCapacity = 1 << 16;
+	static const DWORD DefaultShardsCount = 16;
+
+public:
+	// capacity -- the maximal number of kept similarities, 0 switches the cache off
+	CSimilarityCache( size_t capacity = DefaultCapacity, DWORD shardsCount = DefaultShardsCount );
+
+	// Changes the capacity, all kept similarities are forgotten
+	void SetCapacity( size_t capacity );
+	size_t Capacity() const
+		{ return shards.size() * setsCount * Ways; }
+
+	// Finds the similarity of two intents, the order of intents is not important
+	bool Find( TIntentId first, TIntentId second, TIntentId& result );
+	// Keeps the similarity of two intents
+	void Add( TIntentId first, TIntentId second, TIntentId result );
+	// Forgets all similarities where the intent is involved. Should be called before the intent is deleted.
+	//  Takes constant time and no locks.
+	void Invalidate( TIntentId id );
+	// Forgets everything
+	void Clear();
+
+	// The number of successful and failed searches
+	unsigned long long Hits() const;
+	unsigned long long Misses() const;
+
+private:
+	static const DWORD Ways = 4;
+	// Intents share generations by hash, a collision only forgets more similarities
+	static const DWORD GenerationsCount = 1 << 12;
+	struct CEntry {
+		TIntentId First;
+		TIntentId Second;
+		TIntentId Result;
+		// The generations of the intents when the entry was added
+		DWORD FirstGeneration;
+		DWORD SecondGeneration;
+		DWORD ResultGeneration;
+		// Second chance flag of the clock eviction
+		bool IsReferenced;
+
+		CEntry() : First( -1 ), Second( -1 ), Result( -1 ),
+			FirstGeneration( 0 ), SecondGeneration( 0 ), ResultGeneration( 0 ), IsReferenced( false ) {}
+	};
+	struct CShard {
+		mutable boost::mutex Mutex;
+		// setsCount sets of Ways entries
+		std::vector<CEntry> Entries;
+		// Clock hand of every set
+		std::vector<unsigned char> Hands;
+		unsigned long long Hits;
+		unsigned long long Misses;
+
+		CShard() : Hits( 0 ), Misses( 0 ) {}
+	};
+
+private:
+	const DWORD shardsCount;
+	size_t setsCount;
+	boost::ptr_vector<CShard> shards;
+	std::atomic<DWORD> generations[GenerationsCount];
+
+	static size_t hashKey( TIntentId first, TIntentId second );
+	CShard& getShard( size_t hash )
+		{ return shards[hash % shards.size()]; }
+	size_t getSet( size_t hash ) const
+		{ return ( hash / shards.size() ) % setsCount; }
+	DWORD getGeneration( TIntentId id ) const
+		{ return generations[hashKey( id, 0 ) % GenerationsCount].load( std::memory_order_acquire ); }
+	bool isActual( const CEntry& entry ) const;
+
+	CSimilarityCache( const CSimilarityCache& );
+	CSimilarityCache& operator=( const CSimilarityCache& );
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif // SIMILARITYCACHE_H
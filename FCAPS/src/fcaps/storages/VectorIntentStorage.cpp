@@ -7,7 +7,8 @@ using namespace std;
 
 ////////////////////////////////////////////////////////////////////
 
-CVectorIntentStorage::CVectorIntentStorage()
+CVectorIntentStorage::CVectorIntentStorage() :
+	similarities( 0 )
 {
 //	patterns.reserve( 5000000 ); // More patterns than that is unlikely processable.
 }
@@ -28,8 +29,7 @@ TIntentId CVectorIntentStorage::LoadObject( const JSON& json )
 	if( ptrn.get() == 0 ) {
 		return -1;
 	}
-	patterns.push_back( ptrn.release() );
-	return patterns.size() - 1;
+	return addPattern( ptrn.release() );
 }
 JSON CVectorIntentStorage::SavePattern( TIntentId id ) const
 {
@@ -47,15 +47,21 @@ TIntentId CVectorIntentStorage::LoadPattern( const JSON& json )
 	if( ptrn.get() == 0 ) {
 		return -1;
 	}
-	patterns.push_back( ptrn.release() );
-	return patterns.size() - 1;
+	return addPattern( ptrn.release() );
 }
 
 void CVectorIntentStorage::DeletePattern( TIntentId id )
 {
+	assert( owners[id] > 0 );
+	if( --owners[id] > 0 ) {
+		return;
+	}
+	// The id can be given to another pattern
+	similarities.Invalidate( id );
 	deletePattern( getPattern(id) );
 	if( id == patterns.size() - 1 ) {
 		patterns.pop_back();
+		owners.pop_back();
 	} else {
 		patterns[id] = 0;
 	}
@@ -68,8 +74,14 @@ const IPatternDescriptor* CVectorIntentStorage::GetPattern( TIntentId id ) const
 
 TIntentId CVectorIntentStorage::CalculateSimilarity( TIntentId first, TIntentId second )
 {
-	patterns.push_back( cmp->CalculateSimilarity( getPattern(first), getPattern(second) ) );
-	return patterns.size() - 1;
+	TIntentId result = -1;
+	if( similarities.Find( first, second, result ) ) {
+		++owners[result];
+		return result;
+	}
+	result = addPattern( cmp->CalculateSimilarity( getPattern(first), getPattern(second) ) );
+	similarities.Add( first, second, result );
+	return result;
 }
 
 TCompareResult CVectorIntentStorage::Compare( TIntentId first, TIntentId second,
@@ -83,6 +95,22 @@ void CVectorIntentStorage::Write( TIntentId id, std::ostream& dst ) const
 	cmp->WriteZero( getPattern(id), dst );
 }
 
+TIntentId CVectorIntentStorage::AddPattern( const IPatternDescriptor* p )
+{
+	assert( p != 0 );
+	return addPattern( p );
+}
+
+const IPatternDescriptor* CVectorIntentStorage::ReleasePattern( TIntentId id )
+{
+	assert( owners[id] == 1 );
+	const IPatternDescriptor* p = getPattern( id );
+	similarities.Invalidate( id );
+	patterns[id] = 0;
+	owners[id] = 0;
+	return p;
+}
+
 inline const IPatternDescriptor* CVectorIntentStorage::getPattern(TIntentId id) const
 {
 	assert( id == -1 || patterns[id] != 0 );
@@ -90,6 +118,13 @@ inline const IPatternDescriptor* CVectorIntentStorage::getPattern(TIntentId id)
 	return id == -1 ? 0 : patterns[id];
 }
 
+TIntentId CVectorIntentStorage::addPattern( const IPatternDescriptor* p )
+{
+	patterns.push_back( p );
+	owners.push_back( 1 );
+	return patterns.size() - 1;
+}
+
 void CVectorIntentStorage::deletePattern( const IPatternDescriptor* p ) const
 {
 	delete p;
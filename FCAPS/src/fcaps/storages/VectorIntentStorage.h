@@ -4,6 +4,7 @@
 #define VECTORINTENTSTORAGE_H
 
 #include <fcaps/storages/IntentStorage.h>
+#include <fcaps/storages/SimilarityCache.h>
 #include <deque>
 
 class CVectorIntentStorage : public IIntentStorage {
@@ -25,11 +26,28 @@ public:
 		TIntentId interestingResults = CR_AllResults, TIntentId possibleResults = CR_AllResults | CR_Incomparable ) const;
 	virtual void Write( TIntentId id, std::ostream& dst ) const;
 
+	// Methods of the class
+	// Takes the ownership of the pattern, e.g., a pattern from another storage.
+	TIntentId AddPattern( const IPatternDescriptor* p );
+	// Gives up the ownership of the pattern, the id cannot be used anymore.
+	const IPatternDescriptor* ReleasePattern( TIntentId id );
+	// The memo of computed similarities, the capacity 0 (default) switches it off.
+	//  A memoized similarity is returned as the same id, so every id counts its owners
+	//  and DeletePattern frees the pattern only when the last owner deletes it.
+	void SetSimilarityCacheCapacity( size_t capacity )
+		{ similarities.SetCapacity( capacity ); }
+	const CSimilarityCache& GetSimilarityCache() const
+		{ return similarities; }
+
 private:
 	CSharedPtr<IPatternManager> cmp;
 	std::deque<const IPatternDescriptor*> patterns;
+	// The number of owners of every pattern
+	std::deque<DWORD> owners;
+	CSimilarityCache similarities;
 
 	const IPatternDescriptor* getPattern(TIntentId id) const;
+	TIntentId addPattern( const IPatternDescriptor* p );
 	void deletePattern( const IPatternDescriptor* ) const;
 };
 
@@ -0,0 +1,81 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Streaming output of large JSON files by means of rapidjson::Writer over a buffered file stream.
+
+#ifndef JSONWRITER_H_INCLUDED
+#define JSONWRITER_H_INCLUDED
+
+#include <common.h>
+
+#include <fcaps/BasicTypes.h>
+
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/writer.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+// The writer owns the file and the output buffer.
+//  The values are written as soon as they are passed to the writer,
+//  so no intermediate document is kept in memory.
+
+class CJsonFileWriter {
+public:
+	typedef rapidjson::Writer<rapidjson::FileWriteStream> TWriter;
+	// The default size of the output buffer
+	static const size_t DefaultBufferSize = 4 * 1024 * 1024;
+
+public:
+	CJsonFileWriter( const std::string& path, size_t bufferSize = DefaultBufferSize );
+	~CJsonFileWriter();
+
+	// Direct access to the rapidjson writer
+	TWriter& Writer()
+		{ return writer; }
+
+	// Shortcuts for the most used calls of the writer
+	void Key( const char* key )
+		{ writer.Key( key ); }
+	void String( const std::string& str )
+		{ writer.String( str.c_str(), static_cast<rapidjson::SizeType>( str.length() ), true ); }
+	void Uint( DWORD value )
+		{ writer.Uint( value ); }
+	// JSON has no NaN and infinities, they are written as null
+	void Double( double value )
+		{ if( std::isfinite( value ) ) { writer.Double( value ); } else { writer.Null(); } }
+	void StartObject()
+		{ writer.StartObject(); }
+	void EndObject()
+		{ writer.EndObject(); }
+	void StartArray()
+		{ writer.StartArray(); }
+	void EndArray()
+		{ writer.EndArray(); }
+
+	// Writes an already serialized JSON value (e.g., coming from a module)
+	void RawValue( const JSON& json, rapidjson::Type type = rapidjson::kObjectType );
+	// Writes a set of indices as {"Count":N,"Inds":[...]}
+	void Indices( const int* inds, DWORD count );
+
+	// Flushes the buffer to the file
+	void Flush();
+
+private:
+	std::vector<char> buffer;
+	FILE* file;
+	rapidjson::FileWriteStream stream;
+	TWriter writer;
+
+	CJsonFileWriter( const CJsonFileWriter& );
+	CJsonFileWriter& operator=( const CJsonFileWriter& );
+
+	static FILE* openFile( const std::string& path );
+};
+
+////////////////////////////////////////////////////////////////////
+
+#endif // JSONWRITER_H_INCLUDED
@@ -4,8 +4,12 @@
 #define CPOWERFULSAXJSON_H
 
 #include <rapidjson/rapidjson.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 #include <string>
 #include <sstream>
+#include <vector>
 
 enum TPowerfulSaxJsonResults{
 	// An array, an object, or a member should be skiped
@@ -21,6 +25,11 @@ enum TPowerfulSaxJsonResults{
 };
 
 ////////////////////////////////////////////////////////////////////
+// A JsonPartLoader receives all SAX events of a loaded part
+//  and passes the result to the handler by PassTo( handler ).
+//  CStdJsonPartLoader and CWriterJsonPartLoader call handler.Load( const std::string& ),
+//  CRawJsonPartLoader calls handler.LoadRaw( const char*, size_t ),
+//  CValueJsonPartLoader calls handler.LoadValue( rapidjson::Value&, rapidjson::MemoryPoolAllocator<>& ).
 
 class CStdJsonPartLoader {
 public:
@@ -72,6 +81,8 @@ public:
 		isCommaNeeded=false;
 		return result;
 	}
+	template<typename Handler>
+	bool PassTo( Handler& handler ) { return handler.Load( GetValue() ); }
 
 private:
 	std::stringstream ss;
@@ -85,12 +96,175 @@ private:
 	}
 };
 
+////////////////////////////////////////////////////////////////////
+// Loads parts of JSON by means of rapidjson::Writer,
+//  so the strings are escaped and the numbers keep their precision.
+
+class CWriterJsonPartLoader {
+public:
+	CWriterJsonPartLoader() :
+		writer( buffer ) {}
+	bool Null() { return writer.Null(); }
+	bool Bool(bool b) { return writer.Bool(b); }
+	bool Int(int i) { return writer.Int(i); }
+	bool Uint(unsigned u) { return writer.Uint(u); }
+	bool Int64(int64_t i) { return writer.Int64(i); }
+	bool Uint64(int64_t u) { return writer.Uint64(u); }
+	bool Double(double d) { return writer.Double(d); }
+	bool String(const char* str, size_t length, bool copy)
+		{ return writer.String(str, static_cast<rapidjson::SizeType>(length), copy); }
+	bool Key(const char* str, size_t length, bool copy)
+		{ return writer.Key(str, static_cast<rapidjson::SizeType>(length), copy); }
+	bool StartObject() { return writer.StartObject(); }
+	bool EndObject(size_t memberCount)
+		{ return writer.EndObject(static_cast<rapidjson::SizeType>(memberCount)); }
+	bool StartArray() { return writer.StartArray(); }
+	bool EndArray(size_t elementCount)
+		{ return writer.EndArray(static_cast<rapidjson::SizeType>(elementCount)); }
+
+	std::string GetValue() {
+		std::string result( buffer.GetString(), buffer.GetSize() );
+		buffer.Clear();
+		writer.Reset( buffer );
+		return result;
+	}
+	template<typename Handler>
+	bool PassTo( Handler& handler ) { return handler.Load( GetValue() ); }
+
+private:
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer;
+};
+
+////////////////////////////////////////////////////////////////////
+// Finds the original bytes of the loaded part without any copy.
+//  The input stream should be a memory stream over unmodified data (e.g., rapidjson::MemoryStream over a mapped file),
+//  the in-situ parsing modifies the strings and cannot be used.
+//  Only objects and arrays can be loaded this way, since the reader calls StartObject/StartArray
+//  right after '{'/'[' and EndObject/EndArray right after '}'/']'.
+
+template<typename InputStream>
+class CRawJsonPartLoader {
+public:
+	// begin is the first character of the data read by the stream
+	CRawJsonPartLoader( const InputStream& _is, const typename InputStream::Ch* _begin ) :
+		is( _is ), begin( _begin ), depth( 0 ), start( 0 ), end( 0 ) {}
+	bool Null() { return true; }
+	bool Bool(bool /*b*/) { return true; }
+	bool Int(int /*i*/) { return true; }
+	bool Uint(unsigned /*u*/) { return true; }
+	bool Int64(int64_t /*i*/) { return true; }
+	bool Uint64(int64_t /*u*/) { return true; }
+	bool Double(double /*d*/) { return true; }
+	bool String(const char* /*str*/, size_t /*length*/, bool /*copy*/) { return true; }
+	bool Key(const char* /*str*/, size_t /*length*/, bool /*copy*/) { return true; }
+	bool StartObject() { return startPart(); }
+	bool EndObject(size_t /*memberCount*/) { return endPart(); }
+	bool StartArray() { return startPart(); }
+	bool EndArray(size_t /*elementCount*/) { return endPart(); }
+
+	std::string GetValue() const
+		{ return std::string( begin + start, end - start ); }
+	template<typename Handler>
+	bool PassTo( Handler& handler ) { return handler.LoadRaw( begin + start, end - start ); }
+
+private:
+	const InputStream& is;
+	const typename InputStream::Ch* begin;
+	// The depth of nested objects and arrays in the loaded part
+	int depth;
+	// The range of the last loaded part
+	size_t start;
+	size_t end;
+
+	bool startPart() {
+		if( depth == 0 ) {
+			assert( is.Tell() > 0 );
+			start = is.Tell() - 1;
+		}
+		++depth;
+		return true;
+	}
+	bool endPart() {
+		assert( depth > 0 );
+		--depth;
+		if( depth == 0 ) {
+			end = is.Tell();
+		}
+		return true;
+	}
+};
+
+////////////////////////////////////////////////////////////////////
+// Builds the loaded part as rapidjson::Value directly from the typed SAX events,
+//  so the part is neither printed nor parsed again.
+//  The value passed to the handler is valid only during LoadValue.
+
+class CValueJsonPartLoader {
+public:
+	bool Null() { return addValue( rapidjson::Value() ); }
+	bool Bool(bool b) { return addValue( rapidjson::Value( b ) ); }
+	bool Int(int i) { return addValue( rapidjson::Value( i ) ); }
+	bool Uint(unsigned u) { return addValue( rapidjson::Value( u ) ); }
+	bool Int64(int64_t i) { return addValue( rapidjson::Value( i ) ); }
+	bool Uint64(int64_t u) { return addValue( rapidjson::Value( static_cast<uint64_t>( u ) ) ); }
+	bool Double(double d) { return addValue( rapidjson::Value( d ) ); }
+	bool String(const char* str, size_t length, bool /*copy*/) {
+		return addValue( rapidjson::Value( str, static_cast<rapidjson::SizeType>( length ), alloc ) );
+	}
+	bool Key(const char* str, size_t length, bool /*copy*/) {
+		key.SetString( str, static_cast<rapidjson::SizeType>( length ), alloc );
+		return true;
+	}
+	bool StartObject() { return addValue( rapidjson::Value( rapidjson::kObjectType ), true ); }
+	bool EndObject(size_t /*memberCount*/) { stack.pop_back(); return true; }
+	bool StartArray() { return addValue( rapidjson::Value( rapidjson::kArrayType ), true ); }
+	bool EndArray(size_t /*elementCount*/) { stack.pop_back(); return true; }
+
+	template<typename Handler>
+	bool PassTo( Handler& handler ) {
+		assert( stack.empty() );
+		const bool result = handler.LoadValue( root, alloc );
+		root.SetNull();
+		key.SetNull();
+		alloc.Clear();
+		return result;
+	}
+
+private:
+	rapidjson::MemoryPoolAllocator<> alloc;
+	rapidjson::Value root;
+	// The key of the next member of the current object
+	rapidjson::Value key;
+	// The objects and arrays that are being filled
+	std::vector<rapidjson::Value*> stack;
+
+	bool addValue( rapidjson::Value value, bool isContainer = false ) {
+		rapidjson::Value* added = 0;
+		if( stack.empty() ) {
+			root = value;
+			added = &root;
+		} else if( stack.back()->IsArray() ) {
+			rapidjson::Value& arr = *stack.back();
+			arr.PushBack( value, alloc );
+			added = &arr[arr.Size() - 1];
+		} else {
+			rapidjson::Value& obj = *stack.back();
+			obj.AddMember( key, value, alloc );
+			added = &( obj.MemberEnd() - 1 )->value;
+		}
+		if( isContainer ) {
+			stack.push_back( added );
+		}
+		return true;
+	}
+};
 
 ////////////////////////////////////////////////////////////////////
 // The members of SaxJsonClass are those rapidjson::Handler
 //  but Array, Object and Key returns TPowerfulSaxJsonResults
-//  it also should have a method bool Load(const std:string& )
-//  for loading a whole entity
+//  it also should have a method for loading a whole entity,
+//  the one that is called by JsonPartLoader::PassTo
 
 #define PassValue(v) \
 switch(state) { \
@@ -105,6 +279,9 @@ class CPowerfulSaxJson {
 public:
 	CPowerfulSaxJson( SaxJsonClass& _handler ) :
 		handler(_handler), term(PT_Object), state( PSJR_Iterate) { }
+	// For loaders that need the parameters, e.g., CRawJsonPartLoader
+	CPowerfulSaxJson( SaxJsonClass& _handler, const JsonPartLoader& _loader ) :
+		handler(_handler), loader(_loader), term(PT_Object), state( PSJR_Iterate) { }
 
 	bool Null() { PassValue(Null()); }
 	bool Bool(bool b) { PassValue(Bool(b)); }
@@ -124,8 +301,8 @@ public:
 		case PSJR_Load:
 			return loader.Key(str,length,copy);
 		case PSJR_Iterate:
-			state = handler.Key(str,length,copy);;
-			if( state == PSJR_Load ) {
+			state = handler.Key(str,length,copy);
+			if( state == PSJR_Load || state == PSJR_Skip ) {
 				term=PT_Member;
 			}
 			return state != PSJR_Error;
@@ -139,6 +316,9 @@ public:
 		case PSJR_Skip:
 			if( term == PT_Object ) {
 				++paranthesisCounter;
+			} else if( term == PT_Member ) {
+				term = PT_Object;
+				paranthesisCounter = 1;
 			}
 			return true;
 		case PSJR_Load:
@@ -151,6 +331,7 @@ public:
 			return loader.StartObject();
 		case PSJR_Iterate:
 			state = handler.StartObject();
+			term = PT_Object;
 			paranthesisCounter = 1;
 			if( state == PSJR_Load ) {
 				return loader.StartObject();
@@ -178,7 +359,7 @@ public:
 				--paranthesisCounter;
 				if( paranthesisCounter == 0 ) {
 					state = PSJR_Iterate;
-					return handler.Load(loader.GetValue());
+					return loader.PassTo(handler);
 				}
 			}
 			return true;
@@ -194,6 +375,9 @@ public:
 		case PSJR_Skip:
 			if( term == PT_Array ) {
 				++paranthesisCounter;
+			} else if( term == PT_Member ) {
+				term = PT_Array;
+				paranthesisCounter = 1;
 			}
 			return true;
 		case PSJR_Load:
@@ -206,6 +390,7 @@ public:
 			return loader.StartArray();
 		case PSJR_Iterate:
 			state = handler.StartArray();
+			term = PT_Array;
 			paranthesisCounter = 1;
 			if( state == PSJR_Load ) {
 				return loader.StartArray();
@@ -233,7 +418,7 @@ public:
 				--paranthesisCounter;
 				if( paranthesisCounter == 0 ) {
 					state = PSJR_Iterate;
-					return handler.Load(loader.GetValue());
+					return loader.PassTo(handler);
 				}
 			}
 			return true;
@@ -297,5 +482,11 @@ public:
 	bool Load( const std::string& /*json*/ ) {
 		return true;
 	}
+	bool LoadRaw( const char* /*json*/, size_t /*length*/ ) {
+		return true;
+	}
+	bool LoadValue( rapidjson::Value& /*json*/, rapidjson::MemoryPoolAllocator<>& /*alloc*/ ) {
+		return true;
+	}
 };
 #endif // CPOWERFULSAXJSON_H
@@ -0,0 +1,60 @@
+// Initial software, Aleksey Buzmakov, Copyright (c) National Research University Higher School of Economics, GPL v2 license, 2018, v0.8
+
+// Author: Aleksey Buzmakov
+// Description: Streaming output of large JSON files by means of rapidjson::Writer over a buffered file stream.
+
+#include <JsonWriter.h>
+
+#include <Exception.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////
+
+CJsonFileWriter::CJsonFileWriter( const std::string& path, size_t bufferSize ) :
+	buffer( bufferSize ),
+	file( openFile( path ) ),
+	stream( file, &buffer[0], buffer.size() ),
+	writer( stream )
+{
+}
+
+CJsonFileWriter::~CJsonFileWriter()
+{
+	stream.Flush();
+	fclose( file );
+}
+
+void CJsonFileWriter::RawValue( const JSON& json, rapidjson::Type type )
+{
+	writer.RawValue( json.c_str(), json.length(), type );
+}
+
+void CJsonFileWriter::Indices( const int* inds, DWORD count )
+{
+	assert( count == 0 || inds != 0 );
+	writer.StartObject();
+	writer.Key( "Count" );
+	writer.Uint( count );
+	writer.Key( "Inds" );
+	writer.StartArray();
+	for( DWORD i = 0; i < count; ++i ) {
+		writer.Uint( inds[i] );
+	}
+	writer.EndArray();
+	writer.EndObject();
+}
+
+void CJsonFileWriter::Flush()
+{
+	stream.Flush();
+}
+
+FILE* CJsonFileWriter::openFile( const std::string& path )
+{
+	FILE* f = fopen( path.c_str(), "wb" );
+	if( f == 0 ) {
+		throw new CTextException( "CJsonFileWriter::CJsonFileWriter", "Cannot open the file '" + path + "' for writing" );
+	}
+	return f;
+}
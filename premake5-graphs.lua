@@ -114,6 +114,13 @@ solution "Sofia-PS"
 			"Storages",
 			"SharedModulesLib"
 		}
+		filter{ "system:not windows" }
+			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
+			}
+		filter{}
 
 	project "PS-Modules"
 		DefaultConfig("modules")
@@ -138,8 +145,16 @@ solution "Sofia-PS"
 
 		links{ 
 			"SharedTools",
+			"Storages",
 			"SharedModulesLib"
 		}
+		filter{ "system:not windows" }
+			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
+			}
+		filter{}
 
 	project "SofiaModules"
 		DefaultConfig("modules")
@@ -255,6 +270,13 @@ solution "Sofia-PS"
 			"SharedModulesLib",
 			"Storages"
 		}
+		filter{ "system:not windows" }
+			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
+			}
+		filter{}
 
 	project "FilterModules"
 		DefaultConfig("modules")
@@ -114,6 +114,13 @@ solution "Sofia-PS"
 			"Storages",
 			"SharedModulesLib"
 		}
+		filter{ "system:not windows" }
+			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
+			}
+		filter{}
 
 	project "PS-Modules"
 		DefaultConfig("modules")
@@ -138,8 +145,16 @@ solution "Sofia-PS"
 
 		links{ 
 			"SharedTools",
+			"Storages",
 			"SharedModulesLib"
 		}
+		filter{ "system:not windows" }
+			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
+			}
+		filter{}
 
 	project "SofiaModules"
 		DefaultConfig("modules")
@@ -166,6 +181,13 @@ solution "Sofia-PS"
 			"SharedTools",
 			"SharedModulesLib"
 		}
+		filter{ "system:not windows" }
+			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
+			}
+		filter{}
 
 --	project "ParallelPatternEnumeratorModules"
 --		DefaultConfig("modules")
@@ -254,6 +276,13 @@ solution "Sofia-PS"
 			"SharedModulesLib",
 			"Storages"
 		}
+		filter{ "system:not windows" }
+			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
+			}
+		filter{}
 
 	project "FilterModules"
 		DefaultConfig("modules")
@@ -365,6 +394,9 @@ solution "Sofia-PS"
 		}
 		filter{ "system:not windows" }
 			links{ 
+				"boost_thread",
+				"boost_system",
+				"pthread"
 			}
 		filter{}
 